@@ -0,0 +1,557 @@
+/** @file benchUF23Field.cxx
+
+    @brief  benchmark suite of the UF23 field evaluation and tools
+    @return 0 upon success
+
+    command line options are
+
+      --filter=<substring>  run only benchmarks whose name contains it
+      --min-time=<seconds>  minimum measurement time per benchmark (0.2)
+      --json=<file>         write the results to a JSON file
+      --max-threads=<n>     maximum number of threads of the scaling
+                            benchmarks (default: all hardware threads,
+                            at most 128)
+      --pinning=<p>         pinning of the threads of the scaling
+                            benchmarks: none (default), compact or scatter
+
+    For each benchmark, the number of repetitions is doubled until the
+    minimum time is reached and the time per item (field value,
+    parameter update or random draw) of the fastest of three
+    measurements is reported. The scaling benchmarks (ParallelFor/ and
+    StaticSplit/) report the wall-clock time per field value for 1, 2,
+    4, ... threads. The fast evaluation modes (EvaluateTolerance/,
+    Grid/, Octree/, Cursor/) and the derivatives (EvaluateWithJacobian/,
+    EvaluateWithParameterGradient/) can be compared to Field/ (the
+    scalar operator()) for the same model and positions, see
+    testUF23FieldAccuracy for their accuracy, EvaluateParameterSets/ to
+    SetParametersEvaluate/ for the same number of positions and
+    FieldSet/ to Evaluate/ of the single models. The JSON output
+    follows the format of Google Benchmark (time unit ns per item),
+    e.g. for tracking the results across compilers and releases with
+    its compare.py.
+
+*/
+
+#include "../UF23Field.h"
+#include "../ParameterCovariance.h"
+#include "../UF23FieldComponents.h"
+#include "../UF23FieldCursor.h"
+#include "../UF23FieldGrid.h"
+#include "../UF23FieldOctree.h"
+#include "../UF23FieldSet.h"
+#include "../UF23Parallel.h"
+#include "../UF23Units.h"
+
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// sink for the results, prevents elimination of the benchmarked code
+volatile double gSink = 0;
+
+struct Result {
+  string fName;
+  size_t fItems;
+  double fRealTime;  // ns per item
+  double fCPUTime;   // ns per item
+};
+
+class Runner {
+public:
+  Runner(const string& filter, const double minTime) :
+    fFilter(filter), fMinTime(minTime) {}
+
+  /// benchmark f(nRep), which returns the number of processed items
+  void
+  Run(const string& name, const function<size_t(size_t)>& f)
+  {
+    if (name.find(fFilter) == string::npos)
+      return;
+    Result best{name, 0, 1e99, 1e99};
+    for (unsigned int i = 0; i < 3; ++i) {
+      size_t nRep = 1;
+      while (true) {
+        const clock_t cpuStart = clock();
+        const auto start = chrono::steady_clock::now();
+        const size_t nItems = f(nRep);
+        const auto stop = chrono::steady_clock::now();
+        const clock_t cpuStop = clock();
+        const double t = chrono::duration<double>(stop - start).count();
+        if (t >= fMinTime / 3 || nRep > (size_t(1) << 40)) {
+          const double realTime = t * 1e9 / nItems;
+          if (realTime < best.fRealTime) {
+            best.fItems = nItems;
+            best.fRealTime = realTime;
+            best.fCPUTime =
+              double(cpuStop - cpuStart) / CLOCKS_PER_SEC * 1e9 / nItems;
+          }
+          break;
+        }
+        nRep *= 2;
+      }
+    }
+    cout << " " << left << setw(48) << name << right << fixed
+         << setprecision(2) << setw(12) << best.fRealTime << " ns"
+         << setw(14) << best.fItems << endl;
+    fResults.push_back(best);
+  }
+
+  void
+  WriteJSON(const string& filename)
+    const
+  {
+    ofstream out(filename);
+    if (!out)
+      throw runtime_error("cannot open " + filename);
+    const time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    out << "{\n"
+        << "  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"executable\": \"benchUF23Field\",\n"
+        << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n"
+#ifdef __VERSION__
+        << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+#endif
+        << "    \"instruction_set\": \"" << UF23Field::GetInstructionSet()
+        << "\",\n"
+        << "    \"min_time\": " << fMinTime << "\n"
+        << "  },\n"
+        << "  \"benchmarks\": [";
+    for (unsigned int i = 0; i < fResults.size(); ++i) {
+      const Result& r = fResults[i];
+      out << (i ? "," : "") << "\n    {\n"
+          << "      \"name\": \"" << r.fName << "\",\n"
+          << "      \"iterations\": " << r.fItems << ",\n"
+          << setprecision(6) << scientific
+          << "      \"real_time\": " << r.fRealTime << ",\n"
+          << "      \"cpu_time\": " << r.fCPUTime << ",\n"
+          << "      \"time_unit\": \"ns\",\n"
+          << "      \"items_per_second\": " << 1e9 / r.fRealTime << "\n"
+          << "    }";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+private:
+  string fFilter;
+  double fMinTime;
+  vector<Result> fResults;
+};
+
+// uniformly distributed in the disk and halo
+vector<Vector3>
+GetRandomPositions(const size_t n)
+{
+  mt19937_64 engine(42);
+  uniform_real_distribution<double> u(-20, 20);
+  vector<Vector3> positions;
+  for (size_t i = 0; i < n; ++i)
+    positions.push_back(Vector3(u(engine), u(engine), u(engine) / 5));
+  return positions;
+}
+
+// helix with 1 pc steps starting at the Sun, e.g. a cosmic-ray trajectory
+vector<Vector3>
+GetTrajectoryPositions(const size_t n)
+{
+  vector<Vector3> positions;
+  const double step = 1e-3;
+  const double radius = 0.5;
+  for (size_t i = 0; i < n; ++i) {
+    const double phi = i * step / radius;
+    positions.push_back(Vector3(-8.2 + radius * (cos(phi) - 1),
+                                radius * sin(phi), 0.0208 + 0.2 * i * step));
+  }
+  return positions;
+}
+
+// positions of very different evaluation cost in contiguous blocks:
+// beyond the maximum radius, near the z-axis and in the disk
+vector<Vector3>
+GetMixedCostPositions(const size_t n)
+{
+  mt19937_64 engine(28);
+  uniform_real_distribution<double> u(-1, 1);
+  vector<Vector3> positions;
+  for (size_t i = 0; i < n / 4; ++i)
+    positions.push_back(Vector3(40 * u(engine), 40, 40 * u(engine)));
+  for (size_t i = 0; i < n / 4; ++i)
+    positions.push_back(Vector3(1e-3 * u(engine), 1e-3 * u(engine),
+                                10 * u(engine)));
+  while (positions.size() < n)
+    positions.push_back(Vector3(-8.2 + 3 * u(engine), 3 * u(engine),
+                                0.5 * u(engine)));
+  return positions;
+}
+
+// field values of positions [first, last)
+void
+EvaluateRange(const UF23Field& field, const vector<Vector3>& pos,
+              vector<Vector3>& b, const size_t first, const size_t last)
+{
+  field.Evaluate(&pos[first].x, &pos[first].y, &pos[first].z, 3,
+                 &b[first].x, &b[first].y, &b[first].z, 3, last - first);
+}
+
+double
+Sum(const vector<Vector3>& fields)
+{
+  double sum = 0;
+  for (const auto& b : fields)
+    sum += b.x + b.y + b.z;
+  return sum;
+}
+
+int
+main(const int argc, const char** argv)
+{
+  string filter;
+  string jsonFile;
+  double minTime = 0.2;
+  unsigned int maxThreads = min(128u, utl::GetNumberOfThreads(0));
+  utl::ParallelOptions::EPinning pinning = utl::ParallelOptions::eNoPinning;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg.find("--filter=") == 0)
+      filter = arg.substr(9);
+    else if (arg.find("--min-time=") == 0)
+      minTime = stod(arg.substr(11));
+    else if (arg.find("--json=") == 0)
+      jsonFile = arg.substr(7);
+    else if (arg.find("--max-threads=") == 0)
+      maxThreads = max(1, min(128, stoi(arg.substr(14))));
+    else if (arg == "--pinning=compact")
+      pinning = utl::ParallelOptions::eCompact;
+    else if (arg == "--pinning=scatter")
+      pinning = utl::ParallelOptions::eScatter;
+    else if (arg == "--pinning=none")
+      pinning = utl::ParallelOptions::eNoPinning;
+    else {
+      cerr << " usage: " << argv[0]
+           << " [--filter=<substring>] [--min-time=<s>] [--json=<file>]"
+           << " [--max-threads=<n>] [--pinning=<none|compact|scatter>]"
+           << endl;
+      return 1;
+    }
+  }
+
+  Runner runner(filter, minTime);
+  cout << " instruction set: " << UF23Field::GetInstructionSet() << "\n "
+       << left << setw(48) << "benchmark" << right << setw(15)
+       << "time/item" << setw(14) << "items" << endl;
+
+  const size_t n = 10000;
+  const vector<pair<string, vector<Vector3>>> orderings =
+    { {"random", GetRandomPositions(n)},
+      {"trajectory", GetTrajectoryPositions(n)} };
+
+  for (const auto& m : UF23Field::GetModelNames()) {
+    const string& model = m.second;
+    const UF23Field field(m.first);
+    // fast evaluation modes of testUF23FieldAccuracy
+    UF23Field tolerantField(field);
+    tolerantField.SetTolerance(1e-3);
+    const UF23FieldGrid grid(field, size_t(64) << 20);
+    const UF23FieldOctree octree(field, 0.01, 0.01, 8);
+    UF23FieldCursor cursor(field);
+    for (const auto& o : orderings) {
+      const vector<Vector3>& pos = o.second;
+      runner.Run("Field/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   double sum = 0;
+                   for (size_t r = 0; r < nRep; ++r)
+                     for (const auto& p : pos)
+                       sum += field(p).x;
+                   gSink = sum;
+                   return nRep * pos.size();
+                 });
+      runner.Run("Evaluate/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   vector<Vector3> b;
+                   for (size_t r = 0; r < nRep; ++r)
+                     field.Evaluate(pos, b);
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+      runner.Run("EvaluateTolerance/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   vector<Vector3> b;
+                   for (size_t r = 0; r < nRep; ++r)
+                     tolerantField.Evaluate(pos, b);
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+      runner.Run("Grid/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   double sum = 0;
+                   for (size_t r = 0; r < nRep; ++r)
+                     for (const auto& p : pos)
+                       sum += grid(p).x;
+                   gSink = sum;
+                   return nRep * pos.size();
+                 });
+      runner.Run("Octree/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   double sum = 0;
+                   for (size_t r = 0; r < nRep; ++r)
+                     for (const auto& p : pos)
+                       sum += octree(p).x;
+                   gSink = sum;
+                   return nRep * pos.size();
+                 });
+      runner.Run("Cursor/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   vector<Vector3> b;
+                   for (size_t r = 0; r < nRep; ++r)
+                     cursor.Evaluate(pos, b);
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+    }
+
+    // derivatives, cost relative to Field/
+    const vector<Vector3>& randomPos = orderings[0].second;
+    runner.Run("EvaluateWithJacobian/" + model + "/random",
+               [&](const size_t nRep) {
+                 vector<Vector3> b;
+                 vector<UF23Field::Matrix3> jacobians;
+                 for (size_t r = 0; r < nRep; ++r)
+                   field.EvaluateWithJacobian(randomPos, b, jacobians);
+                 gSink = Sum(b);
+                 return nRep * randomPos.size();
+               });
+    runner.Run("EvaluateWithParameterGradient/" + model + "/random",
+               [&](const size_t nRep) {
+                 vector<Vector3> b;
+                 vector<UF23Field::ParameterGradient> gradients;
+                 for (size_t r = 0; r < nRep; ++r)
+                   field.EvaluateWithParameterGradient(randomPos, b,
+                                                       gradients);
+                 gSink = Sum(b);
+                 return nRep * randomPos.size();
+               });
+
+    // variants of the batch evaluation
+    UF23Field fastField(field);
+    fastField.SetFastMath(true);
+    for (const auto& o : orderings) {
+      const vector<Vector3>& pos = o.second;
+      runner.Run("EvaluateFastMath/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   vector<Vector3> b;
+                   for (size_t r = 0; r < nRep; ++r)
+                     fastField.Evaluate(pos, b);
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+      vector<Vector3f> posf;
+      for (const auto& p : pos)
+        posf.push_back(Vector3f(p.x, p.y, p.z));
+      runner.Run("EvaluateFloat/" + model + "/" + o.first,
+                 [&](const size_t nRep) {
+                   vector<Vector3f> b;
+                   for (size_t r = 0; r < nRep; ++r)
+                     field.Evaluate(posf, b);
+                   gSink = b[0].x;
+                   return nRep * posf.size();
+                 });
+    }
+    const vector<Vector3>& pos = orderings[0].second;
+
+    // parameter updates, e.g. in a fit
+    const vector<double> par = field.GetParameters();
+    runner.Run("SetParameters/" + model,
+               [&](const size_t nRep) {
+                 UF23Field f(field);
+                 for (size_t r = 0; r < nRep; ++r)
+                   f.SetParameters(par);
+                 gSink = f(pos[0]).x;
+                 return nRep;
+               });
+    const vector<Vector3> fitPos(pos.begin(), pos.begin() + 1000);
+    runner.Run("SetParametersEvaluate/" + model + "/1000",
+               [&](const size_t nRep) {
+                 UF23Field f(field);
+                 vector<Vector3> b;
+                 for (size_t r = 0; r < nRep; ++r) {
+                   f.SetParameters(par);
+                   f.Evaluate(fitPos, b);
+                 }
+                 gSink = Sum(b);
+                 return nRep * fitPos.size();
+               });
+
+    vector<double> parSets;
+    for (unsigned int j = 0; j < UF23Field::kParameterSetChunk; ++j)
+      parSets.insert(parSets.end(), par.begin(), par.end());
+    runner.Run("EvaluateParameterSets/" + model + "/1000",
+               [&](const size_t nRep) {
+                 vector<Vector3> b;
+                 const size_t k = UF23Field::kParameterSetChunk;
+                 for (size_t r = 0; r < nRep; ++r)
+                   field.EvaluateParameterSets(parSets.data(), k, fitPos, b);
+                 gSink = Sum(b);
+                 return nRep * k * fitPos.size();
+               });
+    // setup of many parameter sets for few positions
+    const vector<Vector3> fewPos(pos.begin(), pos.begin() + 2);
+    runner.Run("SetParametersEvaluate/" + model + "/2",
+               [&](const size_t nRep) {
+                 UF23Field f(field);
+                 vector<Vector3> b;
+                 for (size_t r = 0; r < nRep; ++r) {
+                   f.SetParameters(par);
+                   f.Evaluate(fewPos, b);
+                 }
+                 gSink = Sum(b);
+                 return nRep * fewPos.size();
+               });
+    vector<double> manyParSets;
+    for (unsigned int j = 0; j < 4096; ++j)
+      manyParSets.insert(manyParSets.end(), par.begin(), par.end());
+    runner.Run("EvaluateParameterSets/" + model + "/2",
+               [&](const size_t nRep) {
+                 vector<Vector3> b;
+                 const size_t k = manyParSets.size() / UF23Field::eNpar;
+                 for (size_t r = 0; r < nRep; ++r)
+                   field.EvaluateParameterSets(manyParSets.data(), k, fewPos,
+                                               b);
+                 gSink = Sum(b);
+                 return nRep * k * fewPos.size();
+               });
+
+    // parameter realizations
+    const ParameterCovariance cov(m.first);
+    const unsigned int dim = cov.GetDimension();
+    mt19937_64 engine(1);
+    normal_distribution<double> gauss;
+    const size_t k = 256;
+    vector<double> normals(k * dim);
+    for (auto& x : normals)
+      x = gauss(engine);
+    runner.Run("GetRandomDelta/" + model,
+               [&](const size_t nRep) {
+                 double sum = 0;
+                 vector<double> nv(dim);
+                 for (size_t r = 0; r < nRep; ++r) {
+                   copy(normals.begin() + (r % k) * dim,
+                        normals.begin() + (r % k + 1) * dim, nv.begin());
+                   sum += cov.GetRandomDelta(nv)[0];
+                 }
+                 gSink = sum;
+                 return nRep;
+               });
+    runner.Run("GetRandomDeltas/" + model + "/256",
+               [&](const size_t nRep) {
+                 vector<double> deltas(k * dim);
+                 for (size_t r = 0; r < nRep; ++r)
+                   cov.GetRandomDeltas(normals.data(), k, deltas.data());
+                 gSink = deltas[0];
+                 return nRep * k;
+               });
+  }
+
+  // individual components on random positions (each including the
+  // cylindrical coordinates, see Component/Cylindrical)
+  const vector<pair<string, pair<UF23Field::ModelType, UF23Field::EComponent>>>
+    components =
+    { {"Cylindrical", {UF23Field::base, UF23Field::eCylindrical}},
+      {"SpiralField", {UF23Field::base, UF23Field::eSpiralField}},
+      {"SpurField", {UF23Field::spur, UF23Field::eSpurField}},
+      {"ToroidalHaloField", {UF23Field::base, UF23Field::eToroidalHaloField}},
+      {"PoloidalHaloField", {UF23Field::base, UF23Field::ePoloidalHaloField}},
+      {"PoloidalHaloFieldExpX",
+       {UF23Field::expX, UF23Field::ePoloidalHaloField}},
+      {"TwistedHaloField", {UF23Field::twistX, UF23Field::eTwistedHaloField}} };
+  for (const auto& c : components) {
+    const UF23Field field(c.second.first);
+    const vector<Vector3>& pos = orderings[0].second;
+    runner.Run("Component/" + c.first,
+               [&](const size_t nRep) {
+                 double sum = 0;
+                 for (size_t r = 0; r < nRep; ++r)
+                   sum += UF23FieldComponents::Evaluate(field, c.second.second,
+                                                        pos.data(), pos.size());
+                 gSink = sum;
+                 return nRep * pos.size();
+               });
+  }
+
+  // all models without spur in one pass, time per position and model
+  // compared to Evaluate/ of the single models
+  {
+    const UF23FieldSet set({UF23Field::base, UF23Field::neCL, UF23Field::expX,
+                            UF23Field::cre10, UF23Field::synCG,
+                            UF23Field::twistX, UF23Field::nebCor});
+    const vector<Vector3>& pos = orderings[0].second;
+    runner.Run("FieldSet/nospur/random",
+               [&](const size_t nRep) {
+                 vector<Vector3> b;
+                 for (size_t r = 0; r < nRep; ++r)
+                   set.Evaluate(pos, b);
+                 gSink = Sum(b);
+                 return nRep * pos.size() * set.GetNumberOfFields();
+               });
+  }
+
+  // scaling with the number of threads for positions of very different
+  // cost, work stealing over tasks of 512 positions compared to a
+  // static split into one range per thread
+  {
+    const UF23Field field(UF23Field::spur);
+    const vector<Vector3> pos = GetMixedCostPositions(100000);
+    vector<Vector3> b(pos.size());
+    const size_t taskSize = 512;
+    const size_t nTasks = (pos.size() + taskSize - 1) / taskSize;
+    vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t < maxThreads; t *= 2)
+      threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+    for (const unsigned int t : threadCounts) {
+      const utl::ParallelOptions options(t, pinning);
+      runner.Run("ParallelFor/spur/mixed/" + to_string(t),
+                 [&](const size_t nRep) {
+                   for (size_t r = 0; r < nRep; ++r)
+                     utl::ParallelFor(nTasks, options,
+                       [&](const size_t iTask, const unsigned int) {
+                         EvaluateRange(field, pos, b, iTask * taskSize,
+                                       min(pos.size(),
+                                           (iTask + 1) * taskSize));
+                       });
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+      runner.Run("StaticSplit/spur/mixed/" + to_string(t),
+                 [&](const size_t nRep) {
+                   for (size_t r = 0; r < nRep; ++r)
+                     utl::ParallelFor(t, options,
+                       [&](const size_t iThread, const unsigned int) {
+                         EvaluateRange(field, pos, b,
+                                       pos.size() * iThread / t,
+                                       pos.size() * (iThread + 1) / t);
+                       });
+                   gSink = Sum(b);
+                   return nRep * pos.size();
+                 });
+    }
+  }
+
+  if (!jsonFile.empty()) {
+    runner.WriteJSON(jsonFile);
+    cout << " results written to " << jsonFile << endl;
+  }
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "ParameterCovariance.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
@@ -485,3 +486,40 @@ ParameterCovariance::GetRandomDelta(const std::vector<double>& norm)
   }
   return delta;
 }
+
+void
+ParameterCovariance::GetRandomDeltas(const double* norm, const std::size_t k,
+                                     double* delta)
+  const
+{
+  // transposed blocks of kBlock random vectors, i.e. the inner loop
+  // over the random vectors of a block is vectorized
+  const unsigned int kBlock = 8;
+  const unsigned int n = GetDimension();
+  if (n > UF23Field::eNpar)
+    throw std::length_error("matrix dimension " + to_string(n) + " > "
+                            + to_string(UF23Field::eNpar));
+  double normT[UF23Field::eNpar][kBlock];
+  double deltaT[kBlock];
+  for (std::size_t first = 0; first < k; first += kBlock) {
+    const unsigned int nb = std::min<std::size_t>(kBlock, k - first);
+    const double* const nBlock = norm + first * n;
+    double* const dBlock = delta + first * n;
+    for (unsigned int j = 0; j < n; ++j)
+      for (unsigned int b = 0; b < kBlock; ++b)
+        normT[j][b] = b < nb ? nBlock[b * n + j] : 0;
+    unsigned int l = 0;
+    for (unsigned int i = 0; i < n; ++i) {
+      for (unsigned int b = 0; b < kBlock; ++b)
+        deltaT[b] = 0;
+      for (unsigned int j = 0; j <= i; ++j) {
+        const double Lij = fL[l];
+        ++l;
+        for (unsigned int b = 0; b < kBlock; ++b)
+          deltaT[b] += Lij * normT[j][b];
+      }
+      for (unsigned int b = 0; b < nb; ++b)
+        dBlock[b * n + i] = deltaT[b];
+    }
+  }
+}
@@ -8,6 +8,7 @@
 
  */
 
+#include <cstddef>
 #include <vector>
 #include "UF23Field.h"
 
@@ -22,6 +23,8 @@ public:
   /// no default constructor
   ParameterCovariance() = delete;
 
+  /// model type
+  UF23Field::ModelType GetModelType() const { return fModelType; }
   /// covariance matrix V (units: microGauss, kpc, degree, Myr)
   const std::vector<std::vector<double>>& GetCovarianceMatrix() const
   { return fV; }
@@ -44,6 +47,21 @@ public:
   */
   std::vector<double> GetRandomDelta(const std::vector<double>& n) const;
 
+  /**
+     @brief parameter offsets for k vectors of standard normal random
+            numbers
+     @param n k x GetDimension() standard normal random numbers, row i
+            is the i-th random vector
+     @param k number of random vectors
+     @param delta output: k x GetDimension() parameter offsets
+            delta_i = L * n_i (caller-provided buffer)
+
+     Equivalent to k calls of GetRandomDelta(), but without allocations
+     and vectorized over blocks of random vectors.
+  */
+  void GetRandomDeltas(const double* n, const std::size_t k,
+                       double* delta) const;
+
 private:
   /// model type
   const UF23Field::ModelType fModelType;
@@ -0,0 +1,489 @@
+/**
+ @file uf23.cc
+ @brief Python bindings of UF23Field, UF23FieldSet and ParameterCovariance
+
+ Build with "make python" (requires pybind11 and NumPy, see README).
+
+ The evaluation functions take NumPy arrays of shape (n, 3) or
+ separate x, y and z arrays of length n and fill the output array
+ through the batch interface of the C++ classes, i.e. without copies
+ of C-contiguous float64 (or float32) arrays and without a Python call
+ per position. The global interpreter lock is released during the
+ evaluation, i.e. Python threads (e.g. Dask workers) evaluate in
+ parallel. As in C++, the parameters of a field must not be changed
+ while other threads use it.
+
+ Example:
+
+   import numpy as np, uf23
+   field = uf23.UF23Field("base")
+   b = field.evaluate(np.array([[-8.2, 0, 0.0208], [1, 1, 1]]))
+
+ */
+
+#include "../UF23Field.h"
+#include "../UF23FieldSet.h"
+#include "../ParameterCovariance.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+using std::size_t;
+
+namespace {
+
+  /// input arrays, copied only if not C-contiguous or of another type
+  template<typename T>
+  using InputArray =
+    py::array_t<T, py::array::c_style | py::array::forcecast>;
+  /// single-precision input, C-contiguous float32 arrays only
+  typedef py::array_t<float, py::array::c_style> FloatArray;
+  template<typename T>
+  using OutputArray = py::array_t<T, py::array::c_style>;
+
+  /// out (checked) or a new array of the given shape
+  template<typename T>
+  OutputArray<T>
+  GetOutput(const py::object& out, const std::vector<size_t>& shape)
+  {
+    if (out.is_none())
+      return OutputArray<T>(shape);
+    if (!OutputArray<T>::check_(out))
+      throw std::invalid_argument(std::string("out must be a C-contiguous ") +
+                                  (sizeof(T) == sizeof(float) ?
+                                   "float32" : "float64") + " array");
+    OutputArray<T> result = py::reinterpret_borrow<OutputArray<T>>(out);
+    bool match = size_t(result.ndim()) == shape.size();
+    for (size_t i = 0; match && i < shape.size(); ++i)
+      match = size_t(result.shape(i)) == shape[i];
+    if (!match)
+      throw std::invalid_argument("out has the wrong shape");
+    if (!result.writeable())
+      throw std::invalid_argument("out is read-only");
+    return result;
+  }
+
+  /// number of positions of an (n, 3) array
+  size_t
+  GetNumberOfPositions(const py::array& positions)
+  {
+    if (positions.ndim() != 2 || positions.shape(1) != 3)
+      throw std::invalid_argument("positions must have shape (n, 3)");
+    return positions.shape(0);
+  }
+
+  /// number of positions of x, y and z arrays of shape (n,)
+  size_t
+  GetNumberOfPositions(const py::array& x, const py::array& y,
+                       const py::array& z)
+  {
+    if (x.ndim() != 1 || y.ndim() != 1 || z.ndim() != 1 ||
+        y.shape(0) != x.shape(0) || z.shape(0) != x.shape(0))
+      throw std::invalid_argument("x, y and z must have the same shape (n,)");
+    return x.shape(0);
+  }
+
+  /**
+     fields of nFields models (UF23Field or UF23FieldSet) at (n, 3)
+     positions, output shape (n, 3) for one field and (nFields, n, 3)
+     otherwise
+  */
+  template<typename T, typename F, typename A>
+  OutputArray<T>
+  EvaluatePositions(const F& field, const size_t nFields, const A& positions,
+                    const py::object& out)
+  {
+    const size_t n = GetNumberOfPositions(positions);
+    OutputArray<T> result =
+      GetOutput<T>(out, nFields == 1 ? std::vector<size_t>{ n, 3 } :
+                   std::vector<size_t>{ nFields, n, 3 });
+    if (n == 0)
+      return result;
+    const T* const p = positions.data();
+    T* const b = result.mutable_data();
+    {
+      py::gil_scoped_release release;
+      field.Evaluate(p, p + 1, p + 2, 3, b, b + 1, b + 2, 3, n);
+    }
+    return result;
+  }
+
+  /// fields at x, y, z positions, output shape (3, n) or (3, nFields, n)
+  template<typename T, typename F, typename A>
+  OutputArray<T>
+  EvaluateXYZ(const F& field, const size_t nFields,
+              const A& x, const A& y, const A& z, const py::object& out)
+  {
+    const size_t n = GetNumberOfPositions(x, y, z);
+    OutputArray<T> result =
+      GetOutput<T>(out, nFields == 1 ? std::vector<size_t>{ 3, n } :
+                   std::vector<size_t>{ 3, nFields, n });
+    if (n == 0)
+      return result;
+    const T* const xData = x.data();
+    const T* const yData = y.data();
+    const T* const zData = z.data();
+    T* const b = result.mutable_data();
+    const size_t size = nFields * n;
+    {
+      py::gil_scoped_release release;
+      field.Evaluate(xData, yData, zData, 1, b, b + size, b + 2 * size, 1, n);
+    }
+    return result;
+  }
+
+  /// k x eNpar parameter matrix of shape (k, eNpar)
+  size_t
+  GetNumberOfParameterSets(const py::array& parameters)
+  {
+    if (parameters.ndim() != 2 || parameters.shape(1) != UF23Field::eNpar)
+      throw std::invalid_argument("parameters must have shape (k, " +
+                                  std::to_string(UF23Field::eNpar) + ")");
+    return parameters.shape(0);
+  }
+
+  /// square matrix as NumPy array
+  OutputArray<double>
+  GetMatrix(const std::vector<std::vector<double>>& m)
+  {
+    const size_t n = m.size();
+    OutputArray<double> result(std::vector<size_t>{ n, n });
+    double* const r = result.mutable_data();
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j)
+        r[i * n + j] = m[i][j];
+    return result;
+  }
+
+  /// state of a UF23Field for pickling
+  py::tuple
+  GetState(const UF23Field& field)
+  {
+    return py::make_tuple(field.GetModelType(),
+                          std::sqrt(field.GetMaximumSquaredRadius()),
+                          field.GetParameters(), field.GetVectorization(),
+                          field.GetFastMath());
+  }
+
+  UF23Field
+  SetState(const py::tuple& state)
+  {
+    if (state.size() != 5)
+      throw std::runtime_error("UF23Field: invalid state");
+    UF23Field field(state[0].cast<UF23Field::ModelType>(),
+                    state[1].cast<double>());
+    field.SetParameters(state[2].cast<std::vector<double>>());
+    field.SetVectorization(state[3].cast<bool>());
+    field.SetFastMath(state[4].cast<bool>());
+    return field;
+  }
+
+  UF23Field::ModelType
+  GetModelType(const std::string& name)
+  {
+    for (const auto& m : UF23Field::GetModelNames())
+      if (m.second == name)
+        return m.first;
+    throw std::invalid_argument("unknown model " + name);
+  }
+}
+
+PYBIND11_MODULE(uf23, m)
+{
+  m.doc() = "UF23 models of the coherent Galactic magnetic field "
+    "(arXiv:2311.12120)";
+
+  py::class_<UF23Field> field(m, "UF23Field",
+    "UF23 coherent magnetic field model, positions in kpc in galactocentric "
+    "coordinates (Earth at negative x, North at positive z), fields in "
+    "microgauss");
+
+  py::enum_<UF23Field::ModelType>(field, "ModelType")
+    .value("base", UF23Field::base)
+    .value("neCL", UF23Field::neCL)
+    .value("expX", UF23Field::expX)
+    .value("spur", UF23Field::spur)
+    .value("cre10", UF23Field::cre10)
+    .value("synCG", UF23Field::synCG)
+    .value("twistX", UF23Field::twistX)
+    .value("nebCor", UF23Field::nebCor)
+    .export_values();
+
+  py::enum_<UF23Field::EPar>(field, "EPar")
+    .value("eDiskB1", UF23Field::eDiskB1)
+    .value("eDiskB2", UF23Field::eDiskB2)
+    .value("eDiskB3", UF23Field::eDiskB3)
+    .value("eDiskH", UF23Field::eDiskH)
+    .value("eDiskPhase1", UF23Field::eDiskPhase1)
+    .value("eDiskPhase2", UF23Field::eDiskPhase2)
+    .value("eDiskPhase3", UF23Field::eDiskPhase3)
+    .value("eDiskPitch", UF23Field::eDiskPitch)
+    .value("eDiskW", UF23Field::eDiskW)
+    .value("ePoloidalA", UF23Field::ePoloidalA)
+    .value("ePoloidalB", UF23Field::ePoloidalB)
+    .value("ePoloidalP", UF23Field::ePoloidalP)
+    .value("ePoloidalR", UF23Field::ePoloidalR)
+    .value("ePoloidalW", UF23Field::ePoloidalW)
+    .value("ePoloidalZ", UF23Field::ePoloidalZ)
+    .value("ePoloidalXi", UF23Field::ePoloidalXi)
+    .value("eSpurCenter", UF23Field::eSpurCenter)
+    .value("eSpurLength", UF23Field::eSpurLength)
+    .value("eSpurWidth", UF23Field::eSpurWidth)
+    .value("eStriation", UF23Field::eStriation)
+    .value("eToroidalBN", UF23Field::eToroidalBN)
+    .value("eToroidalBS", UF23Field::eToroidalBS)
+    .value("eToroidalR", UF23Field::eToroidalR)
+    .value("eToroidalW", UF23Field::eToroidalW)
+    .value("eToroidalZ", UF23Field::eToroidalZ)
+    .value("eTwistingTime", UF23Field::eTwistingTime);
+  field.attr("npar") = int(UF23Field::eNpar);
+
+  field
+    .def(py::init<UF23Field::ModelType, double>(),
+         py::arg("model"), py::arg("max_radius") = 30.)
+    .def(py::init([](const std::string& name, const double maxRadius)
+                  { return UF23Field(GetModelType(name), maxRadius); }),
+         py::arg("model"), py::arg("max_radius") = 30.)
+    .def("__call__",
+         [](const UF23Field& f, const double x, const double y,
+            const double z)
+         {
+           const Vector3 b = f(Vector3(x, y, z));
+           return py::make_tuple(b.x, b.y, b.z);
+         },
+         py::arg("x"), py::arg("y"), py::arg("z"),
+         "field at one position, use evaluate() for many positions")
+    .def("evaluate",
+         [](const UF23Field& f, const InputArray<double>& positions,
+            const py::object& out)
+         { return EvaluatePositions<double>(f, 1, positions, out); },
+         py::arg("positions"), py::arg("out") = py::none(),
+         "field at positions of shape (n, 3), returns (or fills out "
+         "with) an array of shape (n, 3)")
+    .def("evaluate",
+         [](const UF23Field& f, const FloatArray& positions,
+            const py::object& out)
+         { return EvaluatePositions<float>(f, 1, positions, out); },
+         py::arg("positions"), py::arg("out") = py::none(),
+         "single precision evaluation of float32 positions")
+    .def("evaluate",
+         [](const UF23Field& f, const InputArray<double>& x,
+            const InputArray<double>& y, const InputArray<double>& z,
+            const py::object& out)
+         { return EvaluateXYZ<double>(f, 1, x, y, z, out); },
+         py::arg("x"), py::arg("y"), py::arg("z"),
+         py::arg("out") = py::none(),
+         "field at positions x, y, z of shape (n,), returns (or fills "
+         "out with) an array of shape (3, n), i.e. bx, by, bz")
+    .def("evaluate",
+         [](const UF23Field& f, const FloatArray& x, const FloatArray& y,
+            const FloatArray& z, const py::object& out)
+         { return EvaluateXYZ<float>(f, 1, x, y, z, out); },
+         py::arg("x"), py::arg("y"), py::arg("z"),
+         py::arg("out") = py::none(),
+         "single precision evaluation of float32 positions")
+    .def("evaluate_parameter_sets",
+         [](const UF23Field& f, const InputArray<double>& parameters,
+            const InputArray<double>& positions, const py::object& out)
+         {
+           const size_t k = GetNumberOfParameterSets(parameters);
+           const size_t n = GetNumberOfPositions(positions);
+           OutputArray<double> result =
+             GetOutput<double>(out, std::vector<size_t>{ k, n, 3 });
+           if (k == 0 || n == 0)
+             return result;
+           const double* const p = positions.data();
+           double* const b = result.mutable_data();
+           {
+             py::gil_scoped_release release;
+             f.EvaluateParameterSets(parameters.data(), k,
+                                     p, p + 1, p + 2, 3,
+                                     b, b + 1, b + 2, 3, n);
+           }
+           return result;
+         },
+         py::arg("parameters"), py::arg("positions"),
+         py::arg("out") = py::none(),
+         "field for parameter sets of shape (k, npar) at positions of "
+         "shape (n, 3), returns an array of shape (k, n, 3)")
+    .def("get_parameters", &UF23Field::GetParameters,
+         "parameters (units: kpc, microgauss, degree, Myr)")
+    .def("set_parameters", &UF23Field::SetParameters, py::arg("parameters"))
+    .def_property_readonly("model_type", &UF23Field::GetModelType)
+    .def_property_readonly("model_name",
+                           [](const UF23Field& f) { return f.GetModelName(); })
+    .def_property("vectorization", &UF23Field::GetVectorization,
+                  &UF23Field::SetVectorization)
+    .def_property("fast_math", &UF23Field::GetFastMath,
+                  &UF23Field::SetFastMath)
+    .def_static("instruction_set", &UF23Field::GetInstructionSet)
+    .def_static("model_names",
+                []()
+                {
+                  std::vector<std::string> names;
+                  for (const auto& mn : UF23Field::GetModelNames())
+                    names.push_back(mn.second);
+                  return names;
+                })
+    .def(py::pickle(&GetState, &SetState));
+
+  py::class_<UF23FieldSet>(m, "UF23FieldSet",
+    "several UF23 models evaluated in one pass, fields of model m at "
+    "index m of the output")
+    .def(py::init<double>(), py::arg("max_radius") = 30.)
+    .def(py::init<const std::vector<UF23Field::ModelType>&, double>(),
+         py::arg("models"), py::arg("max_radius") = 30.)
+    .def(py::init<const std::vector<UF23Field>&>(), py::arg("fields"))
+    .def("__len__", &UF23FieldSet::GetNumberOfFields)
+    .def("get_field", &UF23FieldSet::GetField, py::arg("m"))
+    .def("evaluate",
+         [](const UF23FieldSet& s, const InputArray<double>& positions,
+            const py::object& out)
+         {
+           return EvaluatePositions<double>(s, s.GetNumberOfFields(),
+                                            positions, out);
+         },
+         py::arg("positions"), py::arg("out") = py::none(),
+         "fields at positions of shape (n, 3), returns an array of shape "
+         "(m, n, 3) for m models (or (n, 3) for one model)")
+    .def("evaluate",
+         [](const UF23FieldSet& s, const InputArray<double>& x,
+            const InputArray<double>& y, const InputArray<double>& z,
+            const py::object& out)
+         {
+           return EvaluateXYZ<double>(s, s.GetNumberOfFields(),
+                                      x, y, z, out);
+         },
+         py::arg("x"), py::arg("y"), py::arg("z"),
+         py::arg("out") = py::none(),
+         "fields at positions x, y, z of shape (n,), returns an array of "
+         "shape (3, m, n) for m models (or (3, n) for one model)")
+    .def_property("vectorization", &UF23FieldSet::GetVectorization,
+                  &UF23FieldSet::SetVectorization)
+    .def_property("fast_math", &UF23FieldSet::GetFastMath,
+                  &UF23FieldSet::SetFastMath)
+    .def(py::pickle(
+      [](const UF23FieldSet& s)
+      {
+        std::vector<UF23Field> fields;
+        for (unsigned int i = 0; i < s.GetNumberOfFields(); ++i)
+          fields.push_back(s.GetField(i));
+        return py::make_tuple(fields, s.GetVectorization(), s.GetFastMath());
+      },
+      [](const py::tuple& state)
+      {
+        if (state.size() != 3)
+          throw std::runtime_error("UF23FieldSet: invalid state");
+        UF23FieldSet s(state[0].cast<std::vector<UF23Field>>());
+        s.SetVectorization(state[1].cast<bool>());
+        s.SetFastMath(state[2].cast<bool>());
+        return s;
+      }));
+
+  py::class_<ParameterCovariance>(m, "ParameterCovariance",
+    "covariance of the parameters of a UF23 model (appendix C of "
+    "arXiv:2311.12120)")
+    .def(py::init<UF23Field::ModelType>(), py::arg("model"))
+    .def(py::init([](const std::string& name)
+                  { return ParameterCovariance(GetModelType(name)); }),
+         py::arg("model"))
+    .def_property_readonly("model_type", &ParameterCovariance::GetModelType)
+    .def_property_readonly("dimension", &ParameterCovariance::GetDimension)
+    .def_property_readonly("parameter_indices",
+                           &ParameterCovariance::GetParameterIndices,
+                           "parameter index of each matrix index")
+    .def_property_readonly("covariance_matrix",
+      [](const ParameterCovariance& c)
+      { return GetMatrix(c.GetCovarianceMatrix()); },
+      "covariance matrix V (units: microgauss, kpc, degree, Myr)")
+    .def_property_readonly("l_matrix",
+      [](const ParameterCovariance& c)
+      {
+        // unpack the lower-triangular matrix
+        const size_t n = c.GetDimension();
+        const std::vector<double>& l = c.GetLMatrix();
+        std::vector<std::vector<double>> lMatrix(n,
+                                                 std::vector<double>(n, 0.));
+        size_t k = 0;
+        for (size_t i = 0; i < n; ++i)
+          for (size_t j = 0; j <= i; ++j)
+            lMatrix[i][j] = l[k++];
+        return GetMatrix(lMatrix);
+      },
+      "lower-triangular matrix L of the Cholesky decomposition V = L L^T")
+    .def("random_deltas",
+         [](const ParameterCovariance& c, const InputArray<double>& normal,
+            const py::object& out)
+         {
+           const size_t d = c.GetDimension();
+           if (normal.ndim() != 2 || size_t(normal.shape(1)) != d)
+             throw std::invalid_argument("normal must have shape (k, " +
+                                         std::to_string(d) + ")");
+           const size_t k = normal.shape(0);
+           OutputArray<double> result =
+             GetOutput<double>(out, std::vector<size_t>{ k, d });
+           if (k == 0)
+             return result;
+           const double* const n = normal.data();
+           double* const delta = result.mutable_data();
+           {
+             py::gil_scoped_release release;
+             c.GetRandomDeltas(n, k, delta);
+           }
+           return result;
+         },
+         py::arg("normal"), py::arg("out") = py::none(),
+         "parameter offsets L n for standard normal random numbers of "
+         "shape (k, dimension), returns an array of shape (k, dimension)")
+    .def("sample_parameters",
+         [](const ParameterCovariance& c, const UF23Field& f,
+            const InputArray<double>& normal)
+         {
+           const size_t d = c.GetDimension();
+           if (normal.ndim() != 2 || size_t(normal.shape(1)) != d)
+             throw std::invalid_argument("normal must have shape (k, " +
+                                         std::to_string(d) + ")");
+           const size_t k = normal.shape(0);
+           const size_t nPar = UF23Field::eNpar;
+           OutputArray<double> result(std::vector<size_t>{ k, nPar });
+           if (k == 0)
+             return result;
+           const std::vector<double> central = f.GetParameters();
+           const std::vector<UF23Field::EPar>& indices =
+             c.GetParameterIndices();
+           const double* const n = normal.data();
+           double* const p = result.mutable_data();
+           {
+             py::gil_scoped_release release;
+             std::vector<double> delta(k * d);
+             c.GetRandomDeltas(n, k, delta.data());
+             for (size_t j = 0; j < k; ++j) {
+               double* const pj = p + j * nPar;
+               for (size_t i = 0; i < nPar; ++i)
+                 pj[i] = central[i];
+               for (size_t i = 0; i < d; ++i)
+                 pj[indices[i]] += delta[j * d + i];
+             }
+           }
+           return result;
+         },
+         py::arg("field"), py::arg("normal"),
+         "parameter sets of shape (k, npar) sampled around the parameters "
+         "of field for standard normal random numbers of shape "
+         "(k, dimension), e.g. for UF23Field.evaluate_parameter_sets()")
+    .def(py::pickle(
+      [](const ParameterCovariance& c) { return py::make_tuple(c.GetModelType()); },
+      [](const py::tuple& state)
+      {
+        if (state.size() != 1)
+          throw std::runtime_error("ParameterCovariance: invalid state");
+        return ParameterCovariance(state[0].cast<UF23Field::ModelType>());
+      }));
+}
@@ -0,0 +1,101 @@
+#ifndef _UF23TestPositions_h_
+#define _UF23TestPositions_h_
+/**
+ @file UF23TestPositions.h
+ @brief positions shared by the unit tests
+
+ The reference positions of testUF23Field, special positions (Galactic
+ center, z-axis, Sun, beyond the maximum radius) and random positions
+ in the disk and inner halo, |x|, |y| < halfWidth and |z| < halfWidth/5.
+ */
+
+#include "../Vector3.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+/// positions of the reference values of testUF23Field
+inline
+std::vector<Vector3>
+GetReferencePositions()
+{
+  return
+    {
+     {1, 1, 1}, {0, 0, -8}, {0.1, -0.1, -8}, {0.1, 0.1, 0.1}, {-1, 3, 4},
+     {-10, -3, 2}, {-10, -10, 20}, {-4, -2, 1}, {6, 5, -0.1}
+    };
+}
+
+/// Galactic center, on and next to the z-axis, Sun, beyond maximum radius
+inline
+std::vector<Vector3>
+GetSpecialPositions()
+{
+  return
+    {
+     {0, 0, 0}, {0, 0, 1}, {0, 0, -8}, {1e-9, 0, 0.1}, {1e-6, 0, 0.1},
+     {-8.2, 0, 0.0208}, {0.1, 0.1, 0.1}, {20, 20, 20}
+    };
+}
+
+/// n random positions in the disk and inner halo
+inline
+std::vector<Vector3>
+GetRandomPositions(const unsigned int n, const unsigned int seed,
+                   const double halfWidth = 25)
+{
+  std::mt19937_64 engine(seed);
+  std::uniform_real_distribution<double> u(-halfWidth, halfWidth);
+  std::vector<Vector3> positions;
+  for (unsigned int i = 0; i < n; ++i)
+    positions.push_back(Vector3(u(engine), u(engine), u(engine) / 5));
+  return positions;
+}
+
+/// special positions followed by n random positions
+inline
+std::vector<Vector3>
+GetTestPositions(const unsigned int n, const unsigned int seed)
+{
+  std::vector<Vector3> positions = GetSpecialPositions();
+  const std::vector<Vector3> random = GetRandomPositions(n, seed);
+  positions.insert(positions.end(), random.begin(), random.end());
+  return positions;
+}
+
+/**
+   n positions away from the discontinuities of the field at z = 0
+   and r = 0, e.g. for finite differences, starting with three
+   reference positions (one of them the Sun)
+*/
+inline
+std::vector<Vector3>
+GetSmoothPositions(const unsigned int n, const unsigned int seed)
+{
+  std::mt19937_64 engine(seed);
+  std::uniform_real_distribution<double> u(-20, 20);
+  std::vector<Vector3> positions = { {1, 1, 1}, {-8.2, 0, 0.0208}, {-1, 3, 4} };
+  while (positions.size() < n) {
+    const Vector3 p(u(engine), u(engine), u(engine) / 5);
+    if (std::abs(p.z) > 0.01 && p.x*p.x + p.y*p.y > 0.01)
+      positions.push_back(p);
+  }
+  return positions;
+}
+
+/**
+   positions farther than 1 kpc from the z-axis, across which the
+   toroidal halo field changes direction
+*/
+inline
+std::vector<Vector3>
+GetOffAxisPositions(const std::vector<Vector3>& positions)
+{
+  std::vector<Vector3> offAxis;
+  for (const auto& p : positions)
+    if (p.x*p.x + p.y*p.y > 1)
+      offAxis.push_back(p);
+  return offAxis;
+}
+
+#endif
@@ -42,18 +42,36 @@ main()
     cout << " " << UF23Field::GetModelName(model) << " ..." << flush;
     const ParameterCovariance pcov(model);
     const unsigned int n = pcov.GetDimension();
-    vector<double> normal(n);
 
-    // calculate sample covariance for nDraw draws ...
+    // calculate sample covariance for nDraw draws in batches ...
+    const unsigned int nBatch = 1000;
+    vector<double> normals(nBatch * n);
+    vector<double> deltas(nBatch * n);
     vector<double> cov((n*(n+1))/2, 0.);
-    for (unsigned int iDraw = 0; iDraw < nDraw; ++iDraw) {
-      generate(begin(normal), end(normal), gen);
-      const auto delta = pcov.GetRandomDelta(normal);
-      int k = 0;
-      for (unsigned int i = 0; i < n; ++i) {
-        for (unsigned int j = 0; j <= i; ++j) {
-          cov[k] += delta[i] * delta[j];
-          ++k;
+    for (unsigned int iDraw = 0; iDraw < nDraw; iDraw += nBatch) {
+      generate(begin(normals), end(normals), gen);
+      pcov.GetRandomDeltas(normals.data(), nBatch, deltas.data());
+      for (unsigned int iBatch = 0; iBatch < nBatch; ++iBatch) {
+        const double* const delta = &deltas[iBatch * n];
+        // ... which are identical to single draws
+        if (iDraw == 0) {
+          const vector<double> normal(&normals[iBatch * n],
+                                      &normals[iBatch * n] + n);
+          const auto singleDelta = pcov.GetRandomDelta(normal);
+          for (unsigned int i = 0; i < n; ++i) {
+            if (!CloseTo(singleDelta[i], delta[i], 1e-12)) {
+              cerr << "batched delta " << delta[i] << " != "
+                   << singleDelta[i] << endl;
+              return 3;
+            }
+          }
+        }
+        int k = 0;
+        for (unsigned int i = 0; i < n; ++i) {
+          for (unsigned int j = 0; j <= i; ++j) {
+            cov[k] += delta[i] * delta[j];
+            ++k;
+          }
         }
       }
     }
@@ -0,0 +1,105 @@
+/** @file testUF23Ensemble.cxx
+
+    @brief  reproducibility and statistics of UF23Ensemble
+    @return 0 upon success
+
+*/
+
+#include "../UF23Ensemble.h"
+#include "UF23TestPositions.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+bool
+CloseTo(const double a, const double b, const double relTol = 1e-10) {
+  return std::abs(a - b) <= relTol * std::max(std::abs(a), std::abs(b));
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> testPositions = GetReferencePositions();
+  const vector<double> quantiles = { 0.84, 0.16, 0.5, 0 , 1 };
+  const unsigned int nRealizations = 1000;
+  const unsigned int seed = 42;
+
+  for (const auto model : { UF23Field::base, UF23Field::expX }) {
+    cout << " " << UF23Field::GetModelName(model) << " ..." << flush;
+
+    // same realizations independent of number of threads
+    UF23Ensemble ensemble(model, nRealizations, seed, 1);
+    const UF23Ensemble ensemble4(model, nRealizations, seed, 4);
+    for (unsigned int i = 0; i < nRealizations; ++i) {
+      if (ensemble.GetRealization(i).GetParameters() !=
+          ensemble4.GetRealization(i).GetParameters()) {
+        cerr << "realization " << i << " not reproducible" << endl;
+        return 1;
+      }
+    }
+    if (ensemble.GetRealization(0).GetParameters() ==
+        ensemble.GetRealization(1).GetParameters() ||
+        ensemble.GetRealization(0).GetParameters() ==
+        UF23Ensemble(model, nRealizations, seed + 1).GetRealization(0).GetParameters()) {
+      cerr << "realizations not random" << endl;
+      return 1;
+    }
+
+    // compare to straightforward calculation
+    ensemble.SetNumberOfThreads(3);
+    ensemble.Evaluate(testPositions, quantiles);
+    for (unsigned int j = 0; j < testPositions.size(); ++j) {
+      vector<vector<double>> samples(3);
+      for (unsigned int i = 0; i < nRealizations; ++i) {
+        const Vector3 b = ensemble.GetRealization(i)(testPositions[j]);
+        samples[0].push_back(b.x);
+        samples[1].push_back(b.y);
+        samples[2].push_back(b.z);
+      }
+      for (unsigned int c1 = 0; c1 < 3; ++c1) {
+        double mean1 = 0;
+        for (const double s : samples[c1])
+          mean1 += s / nRealizations;
+        const Vector3& m = ensemble.GetMeans()[j];
+        const double ensembleMean = c1 == 0 ? m.x : (c1 == 1 ? m.y : m.z);
+        if (!CloseTo(mean1, ensembleMean, 1e-9) && abs(mean1) > 1e-12) {
+          cerr << "mean " << ensembleMean << " != " << mean1 << endl;
+          return 2;
+        }
+        for (unsigned int c2 = 0; c2 < 3; ++c2) {
+          double mean2 = 0;
+          for (const double s : samples[c2])
+            mean2 += s / nRealizations;
+          double cov = 0;
+          for (unsigned int i = 0; i < nRealizations; ++i)
+            cov += (samples[c1][i] - mean1) * (samples[c2][i] - mean2);
+          cov /= nRealizations - 1;
+          const double ensembleCov = ensemble.GetCovariances()[j][c1][c2];
+          if (!CloseTo(cov, ensembleCov, 1e-8) && abs(cov) > 1e-20) {
+            cerr << "covariance " << ensembleCov << " != " << cov << endl;
+            return 3;
+          }
+        }
+        vector<double> sorted = samples[c1];
+        sort(sorted.begin(), sorted.end());
+        for (unsigned int iQ = 0; iQ < quantiles.size(); ++iQ) {
+          const double h = (nRealizations - 1) * quantiles[iQ];
+          const unsigned int lo = h;
+          const unsigned int hi = min(lo + 1, nRealizations - 1);
+          const double q = sorted[lo] + (h - lo) * (sorted[hi] - sorted[lo]);
+          const Vector3& eq = ensemble.GetQuantiles(iQ)[j];
+          const double ensembleQ = c1 == 0 ? eq.x : (c1 == 1 ? eq.y : eq.z);
+          if (!CloseTo(q, ensembleQ)) {
+            cerr << "quantile " << quantiles[iQ] << ": "
+                 << ensembleQ << " != " << q << endl;
+            return 4;
+          }
+        }
+      }
+    }
+    cout << " ok" << endl;
+  }
+  cout << " ==> test of UF23Ensemble successful " << endl;
+  return 0;
+}
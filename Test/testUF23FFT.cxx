@@ -0,0 +1,117 @@
+/** @file testUF23FFT.cxx
+
+    @brief  UF23FFT Fourier and cosine transforms compared to the
+            O(n^2) definitions for power-of-two, mixed and prime sizes
+    @return 0 upon success
+
+*/
+
+#include "../UF23FFT.h"
+#include "../UF23Units.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+using namespace std;
+
+typedef UF23FFT::Complex Complex;
+
+// X_k = sum_j x_j exp(-+2 pi i j k / n)
+vector<Complex>
+NaiveFourier(const vector<Complex>& x, const bool inverse)
+{
+  const size_t n = x.size();
+  vector<Complex> result(n, 0.);
+  for (size_t k = 0; k < n; ++k)
+    for (size_t j = 0; j < n; ++j)
+      result[k] += x[j] * polar(1., (inverse ? 2 : -2) * utl::kPi *
+                                double((j * k) % n) / n);
+  return result;
+}
+
+// a_p = sum_q cos(pi p (q + 1/2) / n) a_q and its inverse
+vector<double>
+NaiveCosine(const vector<double>& a, const bool inverse)
+{
+  const size_t n = a.size();
+  vector<double> result(n, 0.);
+  for (size_t p = 0; p < n; ++p)
+    for (size_t q = 0; q < n; ++q) {
+      const double c = cos(utl::kPi * p * (q + 0.5) / n);
+      if (inverse)
+        result[q] += (p ? 2. : 1.) / n * c * a[p];
+      else
+        result[p] += c * a[q];
+    }
+  return result;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  mt19937_64 engine(3);
+  uniform_real_distribution<double> u(-1, 1);
+  // power of two, mixed radix, primes below and above the largest radix
+  const unsigned int sizes[] =
+    { 1, 2, 3, 4, 5, 7, 8, 12, 13, 16, 17, 30, 37, 64, 97, 128, 210, 256,
+      360, 509 };
+  for (const unsigned int n : sizes) {
+    const UF23FFT fft(n);
+    vector<Complex> x(n);
+    for (auto& c : x)
+      c = Complex(u(engine), u(engine));
+    const double tolerance = 1e-13 * n;
+    for (const bool inverse : { false, true }) {
+      vector<Complex> result(x);
+      fft.Transform(result, inverse);
+      const vector<Complex> reference = NaiveFourier(x, inverse);
+      for (size_t k = 0; k < n; ++k) {
+        if (abs(result[k] - reference[k]) > tolerance) {
+          cerr << " n = " << n << ", inverse = " << inverse << ": X_" << k
+               << " = " << result[k] << " != " << reference[k] << endl;
+          return 1;
+        }
+      }
+    }
+
+    // cosine transform of 2 x n x 3 values, i.e. with an odd number of
+    // lines in the inner dimension, along the middle dimension
+    const size_t nOuter = 2;
+    const size_t nInner = 3;
+    vector<double> a(nOuter * n * nInner);
+    for (auto& v : a)
+      v = u(engine);
+    for (const bool inverse : { false, true }) {
+      vector<double> result(a);
+      UF23FFT::CosineTransform(result, nOuter, n, nInner, inverse);
+      for (size_t o = 0; o < nOuter; ++o) {
+        for (size_t i = 0; i < nInner; ++i) {
+          vector<double> line(n);
+          for (size_t q = 0; q < n; ++q)
+            line[q] = a[(o * n + q) * nInner + i];
+          const vector<double> reference = NaiveCosine(line, inverse);
+          for (size_t p = 0; p < n; ++p) {
+            const double value = result[(o * n + p) * nInner + i];
+            if (std::abs(value - reference[p]) > tolerance) {
+              cerr << " n = " << n << ", inverse = " << inverse
+                   << ": cosine transform " << value << " != "
+                   << reference[p] << endl;
+              return 2;
+            }
+          }
+        }
+      }
+    }
+
+    // inverse of the transform
+    vector<double> roundTrip(a);
+    UF23FFT::CosineTransform(roundTrip, nOuter, n, nInner, false);
+    UF23FFT::CosineTransform(roundTrip, nOuter, n, nInner, true);
+    for (size_t i = 0; i < a.size(); ++i)
+      if (std::abs(roundTrip[i] - a[i]) > 1e-14 * n)
+        return 3;
+    cout << " n = " << n << " OK" << endl;
+  }
+
+  cout << " ==> test of UF23FFT successful " << endl;
+  return 0;
+}
@@ -6,6 +6,7 @@
 */
 
 #include "../UF23Field.h"
+#include "UF23TestPositions.h"
 #include <iostream>
 #include <iomanip>
 using namespace std;
@@ -34,11 +35,7 @@ main(const int /*argc*/, const char** /*argv*/)
      UF23Field::cre10, UF23Field::synCG, UF23Field::twistX, UF23Field::nebCor
     };
 
-  const vector<Vector3> testPositions =
-    {
-     {1, 1, 1}, {0, 0, -8}, {0.1, -0.1, -8}, {0.1, 0.1, 0.1}, {-1, 3, 4},
-     {-10, -3, 2}, {-10, -10, 20}, {-4, -2, 1}, {6, 5, -0.1}
-    };
+  const vector<Vector3> testPositions = GetReferencePositions();
 
   const vector<vector<Vector3>> referenceValues = getReferenceValues();
 
@@ -61,9 +58,68 @@ main(const int /*argc*/, const char** /*argv*/)
         return 1;
       }
     }
+
+    // batch evaluation (scalar and vectorized) must give the same results
+    vector<double> x, y, z;
+    for (const auto& p : testPositions) {
+      x.push_back(p.x);
+      y.push_back(p.y);
+      z.push_back(p.z);
+    }
+    const unsigned int n = testPositions.size();
+    for (const bool vectorization : {false, true}) {
+      UF23Field batchField(model);
+      batchField.SetVectorization(vectorization);
+      const auto batchValues = batchField.Evaluate(testPositions);
+      vector<double> bx(n), by(n), bz(n);
+      batchField.Evaluate(x.data(), y.data(), z.data(),
+                          bx.data(), by.data(), bz.data(), n);
+      // n x 3 arrays
+      vector<double> b(3 * n);
+      batchField.Evaluate(&testPositions[0].x, &testPositions[0].y,
+                          &testPositions[0].z, 3,
+                          &b[0], &b[1], &b[2], 3, n);
+      for (unsigned int j = 0; j < n; ++j) {
+        const auto& refVal = referenceValues[i][j];
+        const Vector3 soaVal(bx[j], by[j], bz[j]);
+        const Vector3 stridedVal(b[3*j], b[3*j + 1], b[3*j + 2]);
+        if (!CloseTo(batchValues[j], refVal) || !CloseTo(soaVal, refVal) ||
+            !CloseTo(stridedVal, refVal)) {
+          cerr << "batch evaluation (" << batchValues[j] << "), ("
+               << soaVal << ") or (" << stridedVal << ") not close to ("
+               << refVal << ")"
+               << (vectorization ? " (vectorized)" : "") << endl;
+          return 2;
+        }
+      }
+    }
+
+    // copies are independent of the original
+    UF23Field copiedField = uf23Field;
+    auto parameters = copiedField.GetParameters();
+    parameters[UF23Field::eDiskB1] *= 2;
+    copiedField.SetParameters(parameters);
+    UF23Field assignedField(model == UF23Field::base ?
+                            UF23Field::spur : UF23Field::base);
+    assignedField = uf23Field;
+    for (unsigned int j = 0; j < testPositions.size(); ++j) {
+      const auto& refVal = referenceValues[i][j];
+      if (!CloseTo(uf23Field(testPositions[j]), refVal) ||
+          !CloseTo(assignedField(testPositions[j]), refVal)) {
+        cerr << "copy modified original field" << endl;
+        return 3;
+      }
+    }
+    if (copiedField.GetParameters() != parameters ||
+        uf23Field.GetParameters()[UF23Field::eDiskB1] ==
+        parameters[UF23Field::eDiskB1]) {
+      cerr << "copied parameters not independent" << endl;
+      return 3;
+    }
     cout << " ok" << endl;
   }
-  cout << " ==> test of UF23Field successful " << endl;
+  cout << " ==> test of UF23Field successful (SIMD: "
+       << UF23Field::GetInstructionSet() << ")" << endl;
   return 0;
 }
 
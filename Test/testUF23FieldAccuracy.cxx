@@ -0,0 +1,306 @@
+/** @file testUF23FieldAccuracy.cxx
+
+    @brief  accuracy of the fast evaluation modes (SIMD, float, fast
+            math, tolerance, grid, octree and cursor) compared to the
+            scalar UF23Field::operator() for all models
+    @return 0 upon success
+
+    For each model and position set (random positions in the halo and
+    the disk, and trajectories with steps of 10 pc), the maximum and
+    root mean square of the relative deviation
+
+      |B_mode - B| / (|B| + b0),  b0 = 0.1 microgauss,
+
+    are reported separately for positions within 1 kpc of the z-axis,
+    where the toroidal halo field changes direction and the tabulated
+    modes (grid, octree) cannot be accurate, and the remaining
+    positions. The test fails if the deviation of a mode exceeds its
+    threshold (return value 1 and 2 for the maximum and RMS
+    deviation). The deviations of the modes limited by rounding (SIMD,
+    float, fast math, cursor) depend on the instruction set, their
+    thresholds are upper bounds for all models. The deviations of the
+    other modes are deterministic, their thresholds are kMargin times
+    the values measured for each model (see kMeasured). The time per
+    position of each mode is measured by the benchmark suite (make
+    bench, see Bench/benchUF23Field.cxx).
+
+*/
+
+#include "../UF23Field.h"
+#include "../UF23FieldCursor.h"
+#include "../UF23FieldGrid.h"
+#include "../UF23FieldOctree.h"
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef function<void(const vector<Vector3>&, vector<Vector3>&)> Evaluator;
+
+/// maximum and RMS of the relative deviation
+struct Deviation {
+  double fMax;
+  double fRMS;
+};
+
+/// fast evaluation mode with its thresholds
+struct Mode {
+  string fName;
+  // thresholds for the position sets (random, tracks) and regions
+  // (off-axis, near-axis) at index 2 * set + region
+  array<Deviation, 4> fThresholds;
+  Evaluator fEvaluate;
+};
+
+// thresholds of the modes with deterministic deviations relative to
+// the measured values, at least the rounding threshold of the SIMD mode
+const double kMargin = 1.3;
+const Deviation kRounding = { 1e-12, 1e-14 };
+
+// deviations of these modes measured for each model at index
+// 2 * set + region as in Mode::fThresholds (AVX-512)
+const map<string, array<Deviation, 4>> kMeasured = {
+  { "base/tolerance",
+    { { { 3.67e-3, 2.22e-5 }, { 5.78e-9, 4.19e-10 },
+        { 3.33e-3, 1.06e-4 }, { 4.82e-16, 1.31e-16 } } } },
+  { "base/grid",
+    { { { 1.39e0, 7.48e-2 }, { 1.15e0, 1.09e-1 },
+        { 1.39e0, 6.54e-2 }, { 7.82e-1, 1.95e-1 } } } },
+  { "base/octree",
+    { { { 8.04e-1, 3.79e-2 }, { 9.99e-1, 7.80e-2 },
+        { 8.52e-1, 3.50e-2 }, { 4.49e-1, 9.11e-2 } } } },
+  { "neCL/tolerance",
+    { { { 3.10e-3, 2.53e-5 }, { 1.54e-9, 1.04e-10 },
+        { 3.47e-3, 1.56e-4 }, { 1.75e-8, 2.00e-9 } } } },
+  { "neCL/grid",
+    { { { 3.07e0, 2.51e-1 }, { 1.17e0, 1.68e-1 },
+        { 3.21e0, 1.35e-1 }, { 8.15e-1, 2.01e-1 } } } },
+  { "neCL/octree",
+    { { { 1.75e0, 1.25e-1 }, { 1.05e0, 9.95e-2 },
+        { 1.83e0, 7.26e-2 }, { 4.67e-1, 9.46e-2 } } } },
+  { "expX/tolerance",
+    { { { 3.76e-3, 2.43e-5 }, { 6.27e-10, 4.38e-11 },
+        { 1.33e-4, 3.37e-6 }, { 6.02e-16, 1.63e-16 } } } },
+  { "expX/grid",
+    { { { 1.91e0, 1.24e-1 }, { 4.43e-1, 5.56e-2 },
+        { 1.64e0, 7.86e-2 }, { 7.70e-1, 1.82e-1 } } } },
+  { "expX/octree",
+    { { { 9.79e-1, 5.75e-2 }, { 1.02e0, 7.11e-2 },
+        { 8.43e-1, 3.88e-2 }, { 4.40e-1, 8.86e-2 } } } },
+  { "spur/tolerance",
+    { { { 8.06e-4, 6.80e-6 }, { 3.14e-16, 8.10e-17 },
+        { 3.11e-3, 1.59e-4 }, { 3.47e-16, 8.74e-17 } } } },
+  { "spur/grid",
+    { { { 9.63e-1, 6.18e-2 }, { 1.15e0, 1.11e-1 },
+        { 9.98e-1, 6.45e-2 }, { 9.31e-1, 2.28e-1 } } } },
+  { "spur/octree",
+    { { { 4.40e-1, 3.26e-2 }, { 1.24e0, 9.13e-2 },
+        { 2.92e-1, 3.25e-2 }, { 5.33e-1, 1.08e-1 } } } },
+  { "cre10/tolerance",
+    { { { 3.56e-3, 1.95e-5 }, { 6.89e-9, 5.13e-10 },
+        { 2.10e-3, 6.65e-5 }, { 4.84e-16, 1.46e-16 } } } },
+  { "cre10/grid",
+    { { { 1.47e0, 6.94e-2 }, { 1.15e0, 1.06e-1 },
+        { 1.34e0, 6.37e-2 }, { 5.42e-1, 1.46e-1 } } } },
+  { "cre10/octree",
+    { { { 7.77e-1, 3.65e-2 }, { 6.36e-1, 5.62e-2 },
+        { 8.42e-1, 3.51e-2 }, { 3.13e-1, 6.47e-2 } } } },
+  { "synCG/tolerance",
+    { { { 3.51e-3, 2.76e-5 }, { 3.24e-10, 2.19e-11 },
+        { 3.48e-3, 1.56e-4 }, { 9.02e-9, 1.15e-9 } } } },
+  { "synCG/grid",
+    { { { 2.71e0, 1.92e-1 }, { 1.21e0, 1.60e-1 },
+        { 2.82e0, 1.21e-1 }, { 8.89e-1, 2.18e-1 } } } },
+  { "synCG/octree",
+    { { { 1.20e0, 8.50e-2 }, { 1.17e0, 9.25e-2 },
+        { 1.21e0, 4.59e-2 }, { 5.09e-1, 1.03e-1 } } } },
+  { "twistX/tolerance",
+    { { { 2.78e-3, 1.94e-5 }, { 7.36e-10, 4.99e-11 },
+        { 4.68e-4, 1.12e-5 }, { 4.79e-12, 7.62e-13 } } } },
+  { "twistX/grid",
+    { { { 2.12e0, 9.31e-2 }, { 7.15e-1, 1.18e-1 },
+        { 1.67e0, 1.31e-1 }, { 4.15e-3, 1.24e-3 } } } },
+  { "twistX/octree",
+    { { { 2.04e0, 7.67e-2 }, { 8.00e-1, 1.38e-1 },
+        { 1.20e0, 8.41e-2 }, { 1.56e-2, 8.48e-3 } } } },
+  { "nebCor/tolerance",
+    { { { 2.31e-3, 1.65e-5 }, { 1.98e-8, 1.34e-9 },
+        { 2.47e-3, 8.10e-5 }, { 4.38e-15, 5.60e-16 } } } },
+  { "nebCor/grid",
+    { { { 1.68e0, 6.61e-2 }, { 1.16e0, 1.05e-1 },
+        { 1.37e0, 6.37e-2 }, { 7.45e-1, 1.88e-1 } } } },
+  { "nebCor/octree",
+    { { { 8.57e-1, 3.60e-2 }, { 9.36e-1, 7.27e-2 },
+        { 7.58e-1, 3.47e-2 }, { 4.28e-1, 8.71e-2 } } } }
+};
+
+array<Deviation, 4>
+GetThresholds(const string& model, const string& mode)
+{
+  array<Deviation, 4> thresholds = kMeasured.at(model + "/" + mode);
+  for (auto& t : thresholds) {
+    t.fMax = max(kMargin * t.fMax, kRounding.fMax);
+    t.fRMS = max(kMargin * t.fRMS, kRounding.fRMS);
+  }
+  return thresholds;
+}
+
+// uniform in the halo (30 kpc sphere) and in the disk (|z| < 1 kpc)
+vector<Vector3>
+GetRandomPositions()
+{
+  vector<Vector3> positions;
+  mt19937_64 engine(29);
+  uniform_real_distribution<double> u(-1, 1);
+  while (positions.size() < 50000) {
+    const Vector3 p(30 * u(engine), 30 * u(engine), 30 * u(engine));
+    if (p.Length() < 30)
+      positions.push_back(p);
+  }
+  while (positions.size() < 100000) {
+    const Vector3 p(20 * u(engine), 20 * u(engine), u(engine));
+    if (p.Length() < 20)
+      positions.push_back(p);
+  }
+  return positions;
+}
+
+// rays from the Sun and a helix through the plane, steps of 10 pc
+vector<Vector3>
+GetTrajectoryPositions()
+{
+  vector<Vector3> positions;
+  const Vector3 sun(-8.2, 0, 0.0208);
+  for (unsigned int i = 0; i < 40; ++i) {
+    const double theta = 0.05 + i * 0.075;
+    const double phi = i * 0.7;
+    const Vector3 d(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+    for (unsigned int j = 0; j < 2000; ++j)
+      positions.push_back(sun + d * (0.01 * j));
+  }
+  for (unsigned int j = 0; j < 20000; ++j) {
+    const double t = 0.002 * j;
+    positions.push_back(Vector3(6 * cos(t), 6 * sin(t), 2 - 0.0002 * j));
+  }
+  return positions;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<pair<string, vector<Vector3>>> positionSets =
+    { { "random", GetRandomPositions() },
+      { "tracks", GetTrajectoryPositions() } };
+  const double b0 = 0.1;
+
+  cout << " " << setw(6) << "model" << setw(8) << "set" << setw(10)
+       << "mode" << setw(11) << "max. dev." << setw(10) << "RMS dev."
+       << setw(11) << "near-axis" << setw(10) << "RMS" << endl;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    const UF23Field field(m.first);
+    const string& model = m.second;
+
+    UF23Field fastField(field);
+    fastField.SetFastMath(true);
+    UF23Field tolerantField(field);
+    tolerantField.SetTolerance(1e-3);
+    // 64 MB Cartesian grid and octree of depth 8 (see testUF23FieldGrid
+    // and testUF23FieldOctree)
+    const UF23FieldGrid grid(field, size_t(64) << 20);
+    const UF23FieldOctree octree(field, 0.01, 0.01, 8);
+    UF23FieldCursor cursor(field);
+
+    const auto uniform =
+      [](const double maxDev, const double rmsDev) -> array<Deviation, 4>
+      {
+        const Deviation d{maxDev, rmsDev};
+        return { d, d, d, d };
+      };
+    const vector<Mode> modes = {
+      { "SIMD", uniform(kRounding.fMax, kRounding.fRMS),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        { field.Evaluate(p, b); } },
+      { "float", uniform(2e-4, 5e-6),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        {
+          vector<Vector3f> pf, bf;
+          for (const auto& q : p)
+            pf.push_back(Vector3f(q.x, q.y, q.z));
+          field.Evaluate(pf, bf);
+          b.resize(p.size());
+          for (unsigned int i = 0; i < p.size(); ++i)
+            b[i] = Vector3(bf[i].x, bf[i].y, bf[i].z);
+        } },
+      { "fastMath", uniform(1e-7, 5e-9),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        { fastField.Evaluate(p, b); } },
+      { "tolerance", GetThresholds(model, "tolerance"),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        { tolerantField.Evaluate(p, b); } },
+      { "grid", GetThresholds(model, "grid"),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        {
+          b.resize(p.size());
+          for (unsigned int i = 0; i < p.size(); ++i)
+            b[i] = grid(p[i]);
+        } },
+      { "octree", GetThresholds(model, "octree"),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        {
+          b.resize(p.size());
+          for (unsigned int i = 0; i < p.size(); ++i)
+            b[i] = octree(p[i]);
+        } },
+      { "cursor", uniform(1e-11, 1e-13),
+        [&](const vector<Vector3>& p, vector<Vector3>& b)
+        { cursor.Evaluate(p, b); } }
+    };
+
+    for (unsigned int iSet = 0; iSet < positionSets.size(); ++iSet) {
+      const auto& s = positionSets[iSet];
+      const vector<Vector3>& positions = s.second;
+      vector<Vector3> reference(positions.size());
+      for (unsigned int i = 0; i < positions.size(); ++i)
+        reference[i] = field(positions[i]);
+
+      for (const auto& mode : modes) {
+        vector<Vector3> fields;
+        mode.fEvaluate(positions, fields);
+        // off-axis and near-axis region
+        Deviation dev[2] = { { 0, 0 }, { 0, 0 } };
+        unsigned int n[2] = { 0, 0 };
+        for (unsigned int i = 0; i < positions.size(); ++i) {
+          const Vector3& p = positions[i];
+          const unsigned int region = p.x*p.x + p.y*p.y < 1;
+          const double d = (fields[i] - reference[i]).Length() /
+            (reference[i].Length() + b0);
+          dev[region].fMax = max(dev[region].fMax, d);
+          dev[region].fRMS += d * d;
+          ++n[region];
+        }
+        for (unsigned int r = 0; r < 2; ++r)
+          dev[r].fRMS = n[r] ? sqrt(dev[r].fRMS / n[r]) : 0;
+        cout << " " << setw(6) << model << setw(8) << s.first << setw(10)
+             << mode.fName << scientific << setprecision(2) << setw(11)
+             << dev[0].fMax << setw(10) << dev[0].fRMS << setw(11)
+             << dev[1].fMax << setw(10) << dev[1].fRMS << endl;
+        for (unsigned int r = 0; r < 2; ++r) {
+          const Deviation& t = mode.fThresholds[2 * iSet + r];
+          if (dev[r].fMax > t.fMax)
+            return 1;
+          if (dev[r].fRMS > t.fRMS)
+            return 2;
+        }
+      }
+    }
+  }
+
+  cout << " ==> test of UF23Field accuracy successful " << endl;
+  return 0;
+}
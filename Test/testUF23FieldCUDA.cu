@@ -0,0 +1,120 @@
+/** @file testUF23FieldCUDA.cu
+
+    @brief  UF23FieldCUDA on the GPU compared to UF23Field, built and
+            run by make test if nvcc is found
+    @return 0 upon success (or if there is no CUDA device)
+
+*/
+
+#include "../UF23FieldCUDA.h"
+#include "../UF23Ensemble.h"
+#include <cuda_runtime.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+using namespace std;
+
+// device buffer of n doubles
+class DeviceBuffer {
+public:
+  explicit DeviceBuffer(const size_t n) : fN(n)
+  {
+    if (cudaMalloc(&fData, n * sizeof(double)) != cudaSuccess)
+      throw runtime_error("cudaMalloc failed");
+  }
+  ~DeviceBuffer() { cudaFree(fData); }
+  DeviceBuffer(const DeviceBuffer&) = delete;
+  DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+  double* Get() { return fData; }
+  void CopyFrom(const vector<double>& v)
+  { cudaMemcpy(fData, v.data(), fN * sizeof(double), cudaMemcpyHostToDevice); }
+  vector<double> CopyTo() const
+  {
+    vector<double> v(fN);
+    cudaMemcpy(v.data(), fData, fN * sizeof(double), cudaMemcpyDeviceToHost);
+    return v;
+  }
+
+private:
+  size_t fN;
+  double* fData = nullptr;
+};
+
+// fields of UF23FieldCUDA(fields) compared to the host evaluation
+bool
+Compare(const vector<UF23Field>& fields, const vector<Vector3>& positions)
+{
+  const size_t n = positions.size();
+  vector<double> x(n), y(n), z(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = positions[i].x;
+    y[i] = positions[i].y;
+    z[i] = positions[i].z;
+  }
+  DeviceBuffer dX(n), dY(n), dZ(n);
+  dX.CopyFrom(x);
+  dY.CopyFrom(y);
+  dZ.CopyFrom(z);
+  const size_t nOut = fields.size() * n;
+  DeviceBuffer dBx(nOut), dBy(nOut), dBz(nOut);
+  const UF23FieldCUDA cudaField(fields);
+  cudaField.Evaluate(dX.Get(), dY.Get(), dZ.Get(),
+                     dBx.Get(), dBy.Get(), dBz.Get(), n);
+  const vector<double> bx = dBx.CopyTo();
+  const vector<double> by = dBy.CopyTo();
+  const vector<double> bz = dBz.CopyTo();
+
+  // device math functions differ by a few units in the last place
+  for (size_t k = 0; k < fields.size(); ++k) {
+    for (size_t i = 0; i < n; ++i) {
+      const Vector3 b = fields[k](positions[i]);
+      const size_t j = k * n + i;
+      const Vector3 bDevice(bx[j], by[j], bz[j]);
+      if ((b - bDevice).Length() > 1e-10 * max(1., b.Length())) {
+        cerr << "(" << bDevice << ") != (" << b << ") at ("
+             << positions[i] << "), realization " << k << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  int nDevices = 0;
+  if (cudaGetDeviceCount(&nDevices) != cudaSuccess || nDevices == 0) {
+    cout << " no CUDA device, skipping test of UF23FieldCUDA" << endl;
+    return 0;
+  }
+
+  mt19937_64 engine(5);
+  uniform_real_distribution<double> u(-25, 25);
+  vector<Vector3> positions =
+    { {0, 0, 0}, {0, 0, 1}, {0, 0, -8}, {1e-9, 0, 0.1}, {-8.2, 0, 0.0208},
+      {0.1, 0.1, 0.1}, {20, 20, 20} };
+  for (unsigned int i = 0; i < 10000; ++i)
+    positions.push_back(Vector3(u(engine), u(engine), u(engine) / 5));
+
+  for (const auto& m : UF23Field::GetModelNames()) {
+    cout << " " << m.second << " ..." << flush;
+    if (!Compare(vector<UF23Field>(1, UF23Field(m.first)), positions))
+      return 1;
+    cout << " OK" << endl;
+  }
+
+  // more realizations than fit into constant memory in one launch
+  const UF23Ensemble ensemble(UF23Field::base,
+                              UF23FieldCUDA::kMaxConstantFields + 5);
+  vector<UF23Field> realizations;
+  for (unsigned int i = 0; i < ensemble.GetNumberOfRealizations(); ++i)
+    realizations.push_back(ensemble.GetRealization(i));
+  positions.resize(500);
+  if (!Compare(realizations, positions))
+    return 2;
+
+  cout << " ==> test of UF23FieldCUDA successful " << endl;
+  return 0;
+}
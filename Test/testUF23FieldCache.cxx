@@ -0,0 +1,177 @@
+/** @file testUF23FieldCache.cxx
+
+    @brief  write and map UF23FieldGrid and UF23FieldOctree cache files
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldCache.h"
+#include "../UF23FieldGrid.h"
+#include "../UF23FieldOctree.h"
+#include "UF23TestPositions.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+using namespace std;
+
+// copy of file with the 32-bit value at offset replaced
+void
+Patch(const string& file, const string& patched, const size_t offset,
+      const uint32_t value)
+{
+  ifstream in(file, ios::binary);
+  vector<char> buffer((istreambuf_iterator<char>(in)),
+                      istreambuf_iterator<char>());
+  memcpy(&buffer[offset], &value, sizeof(value));
+  ofstream out(patched, ios::binary | ios::trunc);
+  out.write(buffer.data(), buffer.size());
+}
+
+// true if mapping the file throws a runtime_error
+template<class T>
+bool
+IsRejected(const string& file)
+{
+  try {
+    const T table(file);
+    return false;
+  }
+  catch (const runtime_error&) {
+    return true;
+  }
+}
+
+template<class T>
+bool
+SameValues(const T& a, const T& b, const vector<Vector3>& positions)
+{
+  for (const auto& p : positions) {
+    const Vector3 va = a(p);
+    const Vector3 vb = b(p);
+    if (va.x != vb.x || va.y != vb.y || va.z != vb.z)
+      return false;
+  }
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> testPositions = GetReferencePositions();
+
+  const string gridFile = "testUF23FieldCache.grid";
+  const string treeFile = "testUF23FieldCache.tree";
+
+  UF23Field uf23Field(UF23Field::spur);
+  const UF23FieldGrid grid(uf23Field, 40, 50, 30,
+                           UF23FieldGrid::eCylindrical,
+                           UF23FieldGrid::eTricubic);
+  const UF23FieldOctree tree(uf23Field, 0.05, 0.05, 6);
+  grid.Write(gridFile);
+  tree.Write(treeFile);
+
+  int status = 0;
+  try {
+    const UF23FieldGrid mappedGrid(gridFile);
+    const UF23FieldOctree mappedTree(treeFile);
+    if (!mappedGrid.IsMapped() || !mappedTree.IsMapped() ||
+        mappedGrid.GetGeometry() != grid.GetGeometry() ||
+        mappedGrid.GetInterpolation() != grid.GetInterpolation() ||
+        mappedGrid.GetMemorySize() != grid.GetMemorySize() ||
+        mappedTree.GetMemorySize() != tree.GetMemorySize() ||
+        mappedTree.GetDepth() != tree.GetDepth()) {
+      cerr << "inconsistent header" << endl;
+      status = 1;
+    }
+    else if (!SameValues(grid, mappedGrid, testPositions) ||
+             !SameValues(tree, mappedTree, testPositions)) {
+      cerr << "mapped table differs" << endl;
+      status = 2;
+    }
+    // copies share the mapping
+    const UF23FieldGrid gridCopy = mappedGrid;
+    if (!SameValues(grid, gridCopy, testPositions))
+      status = 3;
+
+    // model and parameters are recorded in the header
+    if (!mappedGrid.Matches(uf23Field) || !mappedTree.Matches(uf23Field) ||
+        mappedGrid.Matches(UF23Field(UF23Field::base)))
+      status = 4;
+    auto parameters = uf23Field.GetParameters();
+    parameters[UF23Field::eDiskB1] *= 1.1;
+    uf23Field.SetParameters(parameters);
+    if (mappedGrid.Matches(uf23Field) || mappedTree.Matches(uf23Field))
+      status = 5;
+  }
+  catch (const exception& e) {
+    cerr << e.what() << endl;
+    status = 6;
+  }
+
+  // concurrent writers of the same file
+  {
+    vector<thread> writers;
+    for (unsigned int i = 0; i < 8; ++i)
+      writers.emplace_back([&grid, &gridFile]() { grid.Write(gridFile); });
+    for (auto& w : writers)
+      w.join();
+    try {
+      const UF23FieldGrid mappedGrid(gridFile);
+      if (!SameValues(grid, mappedGrid, testPositions))
+        status = 9;
+    }
+    catch (const exception& e) {
+      cerr << e.what() << endl;
+      status = 9;
+    }
+  }
+
+  // out-of-range enumerators and tree depth
+  typedef UF23FieldCache::Header Header;
+  const string patchedFile = "testUF23FieldCache.patched";
+  Patch(gridFile, patchedFile, offsetof(Header, fFlags), 2);
+  const bool badGeometry = IsRejected<UF23FieldGrid>(patchedFile);
+  Patch(gridFile, patchedFile, offsetof(Header, fFlags) + 4, 3);
+  const bool badInterpolation = IsRejected<UF23FieldGrid>(patchedFile);
+  Patch(gridFile, patchedFile, offsetof(Header, fModelType), 99);
+  const bool badModel = IsRejected<UF23FieldGrid>(patchedFile);
+  Patch(treeFile, patchedFile, offsetof(Header, fFlags), 99);
+  const bool badDepth = IsRejected<UF23FieldOctree>(patchedFile);
+  remove(patchedFile.c_str());
+  if (!badGeometry || !badInterpolation || !badModel || !badDepth)
+    status = 10;
+
+  // wrong content type
+  try {
+    const UF23FieldOctree wrongType(gridFile);
+    status = 7;
+  }
+  catch (const runtime_error&) { }
+
+  // truncated file
+  {
+    ifstream in(gridFile, ios::binary);
+    vector<char> buffer(1000);
+    in.read(buffer.data(), buffer.size());
+    ofstream out(gridFile, ios::binary | ios::trunc);
+    out.write(buffer.data(), buffer.size());
+  }
+  try {
+    const UF23FieldGrid truncated(gridFile);
+    status = 8;
+  }
+  catch (const runtime_error&) { }
+
+  remove(gridFile.c_str());
+  remove(treeFile.c_str());
+
+  if (status == 0)
+    cout << " UF23FieldCache test successful " << endl;
+  return status;
+}
@@ -0,0 +1,109 @@
+/** @file testUF23FieldCursor.cxx
+
+    @brief  UF23FieldCursor along trajectories compared to
+            UF23Field::operator()
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldCursor.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+// rays from the Sun, a helix around the z-axis through the plane and
+// rays through the Galactic center
+vector<Vector3>
+GetTrajectories()
+{
+  vector<Vector3> positions;
+  const Vector3 sun(-8.2, 0, 0.0208);
+  for (unsigned int i = 0; i < 20; ++i) {
+    const double theta = 0.1 + i * 0.15;
+    const double phi = i * 0.9;
+    const Vector3 d(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+    for (unsigned int j = 0; j < 2000; ++j)
+      positions.push_back(sun + d * (0.01 * j));
+  }
+  for (unsigned int j = 0; j < 20000; ++j) {
+    const double t = 0.002 * j;
+    positions.push_back(Vector3(6 * cos(t), 6 * sin(t), 2 - 0.0002 * j));
+  }
+  for (unsigned int j = 0; j < 4000; ++j) {
+    const double s = -10 + 0.005 * j;
+    positions.push_back(Vector3(s, 0.5 * s, 0.1 * s));
+    positions.push_back(Vector3(0.2 * s, 0, s));
+  }
+  return positions;
+}
+
+// maximum of |B_cursor - B| / (|B| + b0)
+double
+GetMaxDeviation(const vector<Vector3>& fields,
+                const vector<Vector3>& reference)
+{
+  const double b0 = 0.1;
+  double maxDev = 0;
+  for (unsigned int i = 0; i < fields.size(); ++i)
+    maxDev = max(maxDev, (fields[i] - reference[i]).Length() /
+                 (reference[i].Length() + b0));
+  return maxDev;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> trajectories = GetTrajectories();
+  const vector<Vector3> jumps = GetRandomPositions(20000, 19, 20);
+
+  cout << " " << setw(6) << "model" << "  max. deviation (tracks, jumps)"
+       << "  full evaluations  fallbacks (tracks, jumps)" << endl;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    const UF23Field field(m.first);
+    UF23FieldCursor cursor(field);
+    vector<Vector3> reference;
+    for (const auto& p : trajectories)
+      reference.push_back(field(p));
+    vector<Vector3> fields;
+    cursor.Evaluate(trajectories, fields);
+    const double trackDev = GetMaxDeviation(fields, reference);
+    const double fullFraction = cursor.GetFullEvaluationFraction();
+    const double trackFallbacks = cursor.GetFallbackFraction();
+
+    // fall back to operator() for distant positions
+    vector<Vector3> jumpReference;
+    for (const auto& p : jumps)
+      jumpReference.push_back(field(p));
+    cursor.Reset();
+    cursor.Evaluate(jumps, fields);
+    const double jumpDev = GetMaxDeviation(fields, jumpReference);
+    const double jumpFallbacks = cursor.GetFallbackFraction();
+
+    cout << " " << setw(6) << m.second << scientific << setprecision(2)
+         << setw(12) << trackDev << setw(10) << jumpDev << fixed
+         << setw(15) << fullFraction << setw(13) << trackFallbacks
+         << setw(8) << jumpFallbacks << endl;
+    if (trackDev > 1e-11 || jumpDev > 1e-11)
+      return 1;
+    // the two interleaved rays through the Galactic center (12% of the
+    // positions) fall back to operator()
+    if (fullFraction > 0.3 || trackFallbacks > 0.13 || jumpFallbacks < 0.99)
+      return 2;
+  }
+
+  // single positions and beyond the maximum radius
+  const UF23Field spur(UF23Field::spur);
+  UF23FieldCursor cursor(spur);
+  const Vector3 p(-8.2, 0, 0.0208);
+  const Vector3 b = cursor(p);
+  if ((b - spur(p)).Length() > 1e-12 || cursor(Vector3(0, 0, 31)).Length() != 0)
+    return 3;
+  cursor.Reset();
+  if (cursor(p).x != b.x || cursor.GetField().GetModelType() != UF23Field::spur)
+    return 4;
+
+  cout << " ==> test of UF23FieldCursor successful " << endl;
+  return 0;
+}
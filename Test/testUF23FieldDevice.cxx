@@ -0,0 +1,59 @@
+/** @file testUF23FieldDevice.cxx
+
+    @brief  device-callable UF23FieldDevice (compiled for the host)
+            compared to UF23Field
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldDevice.h"
+#include "../UF23Ensemble.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <type_traits>
+using namespace std;
+
+bool
+Compare(const UF23Field& field, const vector<Vector3>& positions)
+{
+  const UF23FieldDevice deviceField(field);
+  for (const auto& pos : positions) {
+    const Vector3 b = field(pos);
+    Vector3 bDevice;
+    deviceField(pos.x, pos.y, pos.z, bDevice.x, bDevice.y, bDevice.z);
+    if ((b - bDevice).Length() > 1e-12 * max(1., b.Length())) {
+      cerr << "(" << bDevice << ") != (" << b << ") at (" << pos << ")"
+           << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // can be copied to constant memory
+  static_assert(std::is_trivially_copyable<UF23FieldDevice>::value &&
+                std::is_trivially_default_constructible<UF23FieldDevice>::value,
+                "UF23FieldDevice is not a plain parameter block");
+
+  const vector<Vector3> positions = GetTestPositions(10000, 5);
+
+  for (const auto& m : UF23Field::GetModelNames()) {
+    cout << " " << m.second << " ..." << flush;
+    if (!Compare(UF23Field(m.first), positions))
+      return 1;
+    cout << " OK" << endl;
+  }
+
+  // parameter realizations
+  UF23Ensemble ensemble(UF23Field::base, 4);
+  for (unsigned int i = 0; i < ensemble.GetNumberOfRealizations(); ++i)
+    if (!Compare(ensemble.GetRealization(i), positions))
+      return 2;
+
+  cout << " ==> test of UF23FieldDevice successful " << endl;
+  return 0;
+}
@@ -0,0 +1,68 @@
+/** @file testUF23FieldFastMath.cxx
+
+    @brief  deviation of the fast-math batch evaluation of UF23Field
+            from the exact result
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<UF23Field::ModelType> models =
+    {
+     UF23Field::base, UF23Field::neCL, UF23Field::expX, UF23Field::spur,
+     UF23Field::cre10, UF23Field::synCG, UF23Field::twistX, UF23Field::nebCor
+    };
+
+  // reference positions of testUF23Field, special and random positions
+  vector<Vector3> positions = GetReferencePositions();
+  const vector<Vector3> others = GetTestPositions(100000, 13);
+  positions.insert(positions.end(), others.begin(), others.end());
+
+  cout << " " << setw(6) << "model" << "  max. deviation (rel., abs.)"
+       << endl;
+  for (const auto model : models) {
+    UF23Field field(model);
+    if (field.GetFastMath())
+      return 1;
+    vector<Vector3> exact;
+    field.Evaluate(positions, exact);
+    field.SetFastMath(true);
+    vector<Vector3> fast;
+    field.Evaluate(positions, fast);
+
+    // maximum of |B_fast - B| / (|B| + b0)
+    const double b0 = 0.1;
+    double maxDev = 0;
+    double maxAbsDev = 0;
+    for (unsigned int i = 0; i < positions.size(); ++i) {
+      const double dev = (fast[i] - exact[i]).Length();
+      maxDev = max(maxDev, dev / (exact[i].Length() + b0));
+      maxAbsDev = max(maxAbsDev, dev);
+    }
+    cout << " " << setw(6) << UF23Field::GetModelName(model)
+         << scientific << setprecision(2) << setw(12) << maxDev
+         << setw(10) << maxAbsDev << endl;
+    if (maxDev > 2e-8)
+      return 2;
+
+    // no effect on the scalar implementation
+    field.SetVectorization(false);
+    const Vector3 scalar = field.Evaluate(positions)[100];
+    const Vector3 reference = field(positions[100]);
+    if (scalar.x != reference.x || scalar.y != reference.y ||
+        scalar.z != reference.z)
+      return 3;
+  }
+
+  cout << " ==> test of UF23FieldFastMath successful " << endl;
+  return 0;
+}
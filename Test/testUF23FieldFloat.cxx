@@ -0,0 +1,82 @@
+/** @file testUF23FieldFloat.cxx
+
+    @brief  deviation of the single precision batch evaluation of
+            UF23Field from the double precision result
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+struct Deviation {
+  double fMaxAbs = 0; // microgauss
+  double fMaxRel = 0; // relative to |B| for |B| > kMinField
+  static constexpr double kMinField = 0.1;
+};
+
+Deviation
+GetDeviation(const UF23Field& field, const vector<Vector3>& positions)
+{
+  const vector<Vector3> bDouble = field.Evaluate(positions);
+  vector<Vector3f> positionsFloat;
+  for (const auto& p : positions)
+    positionsFloat.push_back(Vector3f(p));
+  vector<Vector3f> bFloat;
+  field.Evaluate(positionsFloat, bFloat);
+
+  Deviation dev;
+  for (unsigned int i = 0; i < positions.size(); ++i) {
+    // compare to the double precision field at the rounded position
+    const Vector3 bRef = field(Vector3(positionsFloat[i]));
+    const double absDev = (Vector3(bFloat[i]) - bRef).Length();
+    dev.fMaxAbs = max(dev.fMaxAbs, absDev);
+    if (bRef.Length() > Deviation::kMinField)
+      dev.fMaxRel = max(dev.fMaxRel, absDev / bRef.Length());
+    // double precision batch interface is unaffected
+    if ((bDouble[i] - field(positions[i])).Length() >
+        1e-10 * max(1., bDouble[i].Length()))
+      dev.fMaxAbs = 1e99;
+  }
+  return dev;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<UF23Field::ModelType> models =
+    {
+     UF23Field::base, UF23Field::neCL, UF23Field::expX, UF23Field::spur,
+     UF23Field::cre10, UF23Field::synCG, UF23Field::twistX, UF23Field::nebCor
+    };
+
+  // reference positions of testUF23Field, special and random positions
+  vector<Vector3> positions = GetReferencePositions();
+  const vector<Vector3> others = GetTestPositions(100000, 11);
+  positions.insert(positions.end(), others.begin(), others.end());
+
+  cout << " " << setw(6) << "model" << "  max. abs. dev. (muG)"
+       << "  max. rel. dev." << endl;
+  for (const auto model : models) {
+    UF23Field field(model);
+    const Deviation dev = GetDeviation(field, positions);
+    cout << " " << setw(6) << UF23Field::GetModelName(model)
+         << scientific << setprecision(2)
+         << setw(22) << dev.fMaxAbs << setw(16) << dev.fMaxRel << endl;
+    if (dev.fMaxAbs > 1e-4 || dev.fMaxRel > 1e-4)
+      return 1;
+
+    // scalar fallback: double precision and rounding
+    field.SetVectorization(false);
+    const Deviation devScalar = GetDeviation(field, positions);
+    if (devScalar.fMaxRel > 1e-6)
+      return 2;
+  }
+
+  cout << " ==> test of UF23FieldFloat successful " << endl;
+  return 0;
+}
@@ -0,0 +1,90 @@
+/** @file testUF23FieldGrid.cxx
+
+    @brief  interpolation accuracy of UF23FieldGrid at the reference
+            positions of testUF23Field
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldGrid.h"
+#include "UF23TestPositions.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+using namespace std;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<UF23Field::ModelType> models =
+    {
+     UF23Field::base, UF23Field::expX, UF23Field::spur, UF23Field::twistX
+    };
+
+  const vector<Vector3> testPositions = GetReferencePositions();
+
+  const vector<UF23FieldGrid::EGeometry> geometries =
+    { UF23FieldGrid::eCartesian, UF23FieldGrid::eCylindrical };
+  const vector<UF23FieldGrid::EInterpolation> interpolations =
+    { UF23FieldGrid::eTrilinear, UF23FieldGrid::eTricubic };
+
+  // the interpolation error cannot be controlled close to the z-axis
+  const vector<Vector3> offAxisPositions = GetOffAxisPositions(testPositions);
+
+  // 64 MB table
+  const size_t maxBytes = 64 << 20;
+  // maximum deviation away from the z-axis (microgauss)
+  const double maxAllowedDeviation = 0.25;
+
+  for (const auto model : models) {
+    const UF23Field uf23Field(model);
+    for (const auto geometry : geometries) {
+      for (const auto interpolation : interpolations) {
+        const UF23FieldGrid grid(uf23Field, maxBytes, geometry, interpolation);
+        if (grid.GetMemorySize() > maxBytes) {
+          cerr << "memory size " << grid.GetMemorySize() << " exceeds "
+               << maxBytes << endl;
+          return 1;
+        }
+        double maxRelDeviation;
+        const double maxDeviation =
+          grid.GetMaximumDeviation(uf23Field, testPositions, maxRelDeviation);
+        double maxRelDeviationOffAxis;
+        const double maxDeviationOffAxis =
+          grid.GetMaximumDeviation(uf23Field, offAxisPositions,
+                                   maxRelDeviationOffAxis);
+        cout << " " << setw(6) << UF23Field::GetModelName(model)
+             << (geometry == UF23FieldGrid::eCartesian ?
+                 " Cartesian  " : " cylindrical")
+             << (interpolation == UF23FieldGrid::eTrilinear ?
+                 " trilinear" : " tricubic ")
+             << " " << grid.GetNumberOfGridPoints(0)
+             << "x" << grid.GetNumberOfGridPoints(1)
+             << "x" << grid.GetNumberOfGridPoints(2)
+             << ", " << setprecision(3) << fixed
+             << grid.GetMemorySize() / double(1 << 20) << " MB"
+             << ", max. deviation " << scientific << maxDeviation
+             << " muG (rel. " << maxRelDeviation << "), off-axis "
+             << maxDeviationOffAxis << " muG" << endl;
+        if (maxDeviationOffAxis > maxAllowedDeviation)
+          return 2;
+      }
+    }
+  }
+
+  // outside of the grid
+  const UF23Field uf23Field(UF23Field::base);
+  const UF23FieldGrid grid(uf23Field, 10, 10, 10);
+  if (grid(Vector3(100, 0, 0)).Length() != 0)
+    return 3;
+
+  // too few grid points
+  try {
+    const UF23FieldGrid tooSmall(uf23Field, 1, 10, 10);
+    return 4;
+  }
+  catch (const runtime_error&) { }
+
+  cout << " UF23FieldGrid test successful " << endl;
+  return 0;
+}
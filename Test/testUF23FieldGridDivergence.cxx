@@ -0,0 +1,153 @@
+/** @file testUF23FieldGridDivergence.cxx
+
+    @brief  divergence of the interpolated field of UF23FieldGrid with
+            staggered divergence-free interpolation compared to
+            trilinear interpolation, and its deviation from the model
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldGrid.h"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+using namespace std;
+
+// numerical divergence relative to the largest derivative
+double
+GetRelativeDivergence(const UF23FieldGrid& grid, const Vector3& p)
+{
+  const double h = 1e-5;
+  double jacobian[3][3];
+  for (unsigned int j = 0; j < 3; ++j) {
+    Vector3 dp(0, 0, 0);
+    (j == 0 ? dp.x : j == 1 ? dp.y : dp.z) = h;
+    const Vector3 db = (grid(p + dp) - grid(p - dp)) / (2 * h);
+    jacobian[0][j] = db.x;
+    jacobian[1][j] = db.y;
+    jacobian[2][j] = db.z;
+  }
+  double norm = 1e-3;
+  for (unsigned int i = 0; i < 3; ++i)
+    for (unsigned int j = 0; j < 3; ++j)
+      norm = max(norm, std::abs(jacobian[i][j]));
+  return std::abs(jacobian[0][0] + jacobian[1][1] + jacobian[2][2]) / norm;
+}
+
+// RMS of |B_grid - B| / (|B| + b0)
+double
+GetRMSDeviation(const UF23FieldGrid& grid, const UF23Field& field,
+                const vector<Vector3>& positions)
+{
+  const double b0 = 0.1;
+  double sum = 0;
+  for (const auto& p : positions) {
+    const Vector3 b = field(p);
+    sum += pow((grid(p) - b).Length() / (b.Length() + b0), 2);
+  }
+  return sqrt(sum / positions.size());
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<UF23Field::ModelType> models =
+    { UF23Field::base, UF23Field::expX, UF23Field::spur, UF23Field::twistX };
+  // measured RMS deviation of the divergence-free relative to the
+  // trilinear interpolation for these models, tested with a margin of
+  // 10%: second order as well, but each component is only known on one
+  // set of faces
+  const vector<double> rmsRatios = { 2.15, 2.03, 2.13, 0.94 };
+  const unsigned int n = 121;
+
+  // positions in the halo and the disk, away from the cell faces (where
+  // the tangential components are discontinuous) and the z-axis
+  const double cellSize = 60. / (n - 1);
+  mt19937_64 engine(30);
+  uniform_real_distribution<double> u(-1, 1);
+  vector<Vector3> positions;
+  while (positions.size() < 20000) {
+    const Vector3 p(20 * u(engine), 20 * u(engine),
+                    positions.size() % 2 ? 2 * u(engine) : 15 * u(engine));
+    bool nearFace = false;
+    for (const double c : { p.x, p.y, p.z }) {
+      const double t = (c + 30) / cellSize;
+      nearFace |= std::abs(t - floor(t + 0.5)) < 1e-3;
+    }
+    if (!nearFace && p.x*p.x + p.y*p.y > 1)
+      positions.push_back(p);
+  }
+
+  cout << " " << setw(6) << "model" << "  max. rel. divergence"
+       << " (trilinear, div-free)  RMS deviation (trilinear, div-free)"
+       << endl;
+  for (unsigned int iModel = 0; iModel < models.size(); ++iModel) {
+    const UF23Field::ModelType model = models[iModel];
+    const UF23Field field(model);
+    const UF23FieldGrid trilinear(field, n, n, n);
+    const UF23FieldGrid divFree(field, n, n, n, UF23FieldGrid::eCartesian,
+                                UF23FieldGrid::eDivergenceFree);
+    if (divFree.GetMemorySize() != trilinear.GetMemorySize())
+      return 1;
+
+    double maxDivTrilinear = 0;
+    double maxDivFree = 0;
+    for (const auto& p : positions) {
+      maxDivTrilinear = max(maxDivTrilinear,
+                            GetRelativeDivergence(trilinear, p));
+      maxDivFree = max(maxDivFree, GetRelativeDivergence(divFree, p));
+    }
+    const double rmsTrilinear = GetRMSDeviation(trilinear, field, positions);
+    const double rmsFree = GetRMSDeviation(divFree, field, positions);
+    cout << " " << setw(6) << UF23Field::GetModelName(model) << scientific
+         << setprecision(2) << setw(16) << maxDivTrilinear << setw(10)
+         << maxDivFree << setw(29) << rmsTrilinear << setw(10) << rmsFree
+         << endl;
+    if (maxDivFree > 1e-4 || maxDivFree > 1e-3 * maxDivTrilinear)
+      return 2;
+    if (rmsFree > 1.1 * rmsRatios[iModel] * rmsTrilinear)
+      return 3;
+
+    // zero outside of the sphere as the model
+    if (divFree(Vector3(0, 0, 30.1)).Length() != 0 ||
+        divFree(Vector3(20, 20, 20)).Length() != 0)
+      return 4;
+  }
+
+  // mapped from a file
+  const string gridFile = "testUF23FieldGridDivergence.grid";
+  const UF23Field field(UF23Field::base);
+  const UF23FieldGrid grid(field, 41, 41, 41, UF23FieldGrid::eCartesian,
+                           UF23FieldGrid::eDivergenceFree);
+  grid.Write(gridFile);
+  const UF23FieldGrid mapped(gridFile);
+  remove(gridFile.c_str());
+  if (mapped.GetInterpolation() != UF23FieldGrid::eDivergenceFree ||
+      mapped(positions[0]).x != grid(positions[0]).x ||
+      mapped(positions[1]).z != grid(positions[1]).z)
+    return 5;
+
+  // prime number of cells (Fourier transforms with Bluestein's algorithm)
+  const UF23FieldGrid prime(field, 38, 38, 38, UF23FieldGrid::eCartesian,
+                            UF23FieldGrid::eDivergenceFree);
+  for (unsigned int i = 0; i < 1000; ++i)
+    if (GetRelativeDivergence(prime, positions[i]) > 1e-4)
+      return 6;
+
+  // Cartesian grids only
+  try {
+    const UF23FieldGrid cylindrical(field, 10, 10, 10,
+                                    UF23FieldGrid::eCylindrical,
+                                    UF23FieldGrid::eDivergenceFree);
+    return 7;
+  }
+  catch (const runtime_error&) {
+  }
+
+  cout << " ==> test of UF23FieldGrid divergence-free interpolation "
+       << "successful " << endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+/** @file testUF23FieldInstrumentation.cxx
+
+    @brief  call counters of UF23Field, without instrumentation
+            (default) they are zero, with -DUF23_INSTRUMENTATION they
+            count the calls and early exits of all threads
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include <iostream>
+#include <thread>
+using namespace std;
+
+typedef UF23Field F;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // 100 positions in the disk, 10 beyond the maximum radius, 5 on the z-axis
+  vector<Vector3> positions;
+  for (unsigned int i = 0; i < 100; ++i)
+    positions.push_back(Vector3(-8 + 0.1 * i, 3 - 0.05 * i, 0.1));
+  for (unsigned int i = 0; i < 10; ++i)
+    positions.push_back(Vector3(30, 10, i));
+  for (unsigned int i = 0; i < 5; ++i)
+    positions.push_back(Vector3(0, 0, i + 1));
+  const unsigned long long nInside = 105;
+
+  F::ResetCounters();
+  const F base(F::base);
+  for (const auto& p : positions)
+    base(p);
+
+  if (!F::IsInstrumented()) {
+    for (unsigned int c = 0; c < F::eNComponents; ++c) {
+      const F::Counters n = F::GetCounters(F::EComponent(c));
+      if (n.fCalls != 0 || n.fEarlyExits != 0 || n.fTicks != 0)
+        return 1;
+    }
+    cout << " ==> test of UF23Field instrumentation successful"
+         " (disabled) " << endl;
+    return 0;
+  }
+
+  const F::Counters eval = F::GetCounters(F::eEvaluation);
+  const F::Counters spiral = F::GetCounters(F::eSpiralField);
+  const F::Counters poloidal = F::GetCounters(F::ePoloidalHaloField);
+  if (eval.fCalls != positions.size() ||
+      eval.fEarlyExits != positions.size() - nInside ||
+      F::GetCounters(F::eCylindrical).fCalls != nInside ||
+      spiral.fCalls != nInside || spiral.fEarlyExits != 5 ||
+      F::GetCounters(F::eToroidalHaloField).fCalls != nInside ||
+      poloidal.fCalls != nInside || poloidal.fEarlyExits != 0 ||
+      F::GetCounters(F::eSpurField).fCalls != 0 ||
+      eval.fTicks == 0 || spiral.fTicks > eval.fTicks)
+    return 2;
+
+  // spur: positions of other arm segments exit early
+  F::ResetCounters();
+  const F spur(F::spur);
+  for (const auto& p : positions)
+    spur(p);
+  const F::Counters spurCounters = F::GetCounters(F::eSpurField);
+  if (spurCounters.fCalls != nInside || spurCounters.fEarlyExits < 5 ||
+      spurCounters.fEarlyExits == nInside ||
+      F::GetCounters(F::eSpiralField).fCalls != 0)
+    return 3;
+
+  // twisted halo with nested poloidal halo, no twisting on the z-axis
+  F::ResetCounters();
+  const F twistX(F::twistX);
+  for (const auto& p : positions)
+    twistX(p);
+  const F::Counters twist = F::GetCounters(F::eTwistedHaloField);
+  if (twist.fCalls != nInside || twist.fEarlyExits != 5 ||
+      F::GetCounters(F::ePoloidalHaloField).fCalls != nInside ||
+      F::GetCounters(F::ePoloidalHaloField).fTicks > twist.fTicks)
+    return 4;
+
+  // aggregated over threads
+  F::ResetCounters();
+  const unsigned int nThreads = 4;
+  vector<thread> threads;
+  for (unsigned int i = 0; i < nThreads; ++i)
+    threads.push_back(thread([&base, &positions]() {
+          const F field(base);
+          for (unsigned int j = 0; j < 100; ++j)
+            for (const auto& p : positions)
+              field(p);
+        }));
+  for (auto& t : threads)
+    t.join();
+  if (F::GetCounters(F::eEvaluation).fCalls != nThreads * 100 * positions.size())
+    return 5;
+
+  // vectorized batch, counted once also without vector extensions
+  F::ResetCounters();
+  vector<Vector3> fields;
+  base.Evaluate(positions, fields);
+  const bool vectorized = F::GetInstructionSet() != "scalar";
+  if (F::GetCounters(F::eVectorizedEvaluation).fCalls !=
+      (vectorized ? positions.size() : 0) ||
+      F::GetCounters(F::eEvaluation).fCalls !=
+      (vectorized ? 0 : positions.size()))
+    return 6;
+
+  cout << " ==> test of UF23Field instrumentation successful " << endl;
+  return 0;
+}
@@ -0,0 +1,92 @@
+/** @file testUF23FieldJacobian.cxx
+
+    @brief  derivatives of UF23Field::EvaluateWithJacobian() compared
+            to finite differences
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+// central differences of fourth order
+UF23Field::Matrix3
+GetNumericalJacobian(const UF23Field& field, const Vector3& pos,
+                     const double h)
+{
+  UF23Field::Matrix3 jacobian;
+  for (unsigned int j = 0; j < 3; ++j) {
+    Vector3 dx(0, 0, 0);
+    (j == 0 ? dx.x : j == 1 ? dx.y : dx.z) = h;
+    const Vector3 d =
+      (field(pos - dx * 2) - field(pos - dx) * 8 + field(pos + dx) * 8 -
+       field(pos + dx * 2)) / (12 * h);
+    jacobian[0][j] = d.x;
+    jacobian[1][j] = d.y;
+    jacobian[2][j] = d.z;
+  }
+  return jacobian;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> positions = GetSmoothPositions(2000, 17);
+
+  const double h = 1e-3;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    cout << " " << setw(6) << m.second << " ..." << flush;
+    const UF23Field field(m.first);
+    double maxDev = 0;
+    double maxDiv = 0;
+    for (const auto& pos : positions) {
+      UF23Field::Matrix3 jacobian;
+      const Vector3 b = field.EvaluateWithJacobian(pos, jacobian);
+      const Vector3 bRef = field(pos);
+      if ((b - bRef).Length() > 1e-12 * max(1., bRef.Length()))
+        return 1;
+      const UF23Field::Matrix3 jacobianRef =
+        GetNumericalJacobian(field, pos, h);
+      // relative to the largest derivative
+      double norm = 1e-3;
+      for (unsigned int i = 0; i < 3; ++i)
+        for (unsigned int j = 0; j < 3; ++j)
+          norm = max(norm, std::abs(jacobianRef[i][j]));
+      for (unsigned int i = 0; i < 3; ++i)
+        for (unsigned int j = 0; j < 3; ++j)
+          maxDev = max(maxDev,
+                       std::abs(jacobian[i][j] - jacobianRef[i][j]) / norm);
+      // (for information, the radial transitions of the disk field are
+      // not divergence-free)
+      const double div = jacobian[0][0] + jacobian[1][1] + jacobian[2][2];
+      maxDiv = max(maxDiv, std::abs(div) / norm);
+    }
+    cout << " max. rel. deviation " << scientific << setprecision(2)
+         << maxDev << ", max. rel. divergence " << maxDiv << endl;
+    if (maxDev > 1e-5)
+      return 2;
+  }
+
+  // beyond the maximum radius
+  const UF23Field base(UF23Field::base);
+  UF23Field::Matrix3 jacobian;
+  if (base.EvaluateWithJacobian(Vector3(0, 0, 31), jacobian).Length() != 0 ||
+      jacobian[2][2] != 0)
+    return 3;
+
+  // batch interface
+  vector<Vector3> fields;
+  vector<UF23Field::Matrix3> jacobians;
+  base.EvaluateWithJacobian(positions, fields, jacobians);
+  base.EvaluateWithJacobian(positions[5], jacobian);
+  if (fields.size() != positions.size() || jacobians.size() != fields.size() ||
+      jacobians[5] != jacobian)
+    return 4;
+
+  cout << " ==> test of UF23Field Jacobian successful " << endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+/** @file testUF23FieldOctree.cxx
+
+    @brief  interpolation accuracy and memory footprint of UF23FieldOctree
+            at the reference positions of testUF23Field
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldOctree.h"
+#include "UF23TestPositions.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+using namespace std;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // (the disk field of twistX is discontinuous at z = 0)
+  const vector<UF23Field::ModelType> models =
+    { UF23Field::base, UF23Field::expX, UF23Field::spur };
+
+  const vector<Vector3> testPositions = GetReferencePositions();
+
+  const vector<Vector3> offAxisPositions = GetOffAxisPositions(testPositions);
+
+  const double relTolerance = 0.01;
+  const double absTolerance = 0.01;
+  const unsigned int maxDepth = 8;
+  // maximum deviation away from the z-axis (microgauss)
+  const double maxAllowedDeviation = 0.1;
+
+  for (const auto model : models) {
+    const UF23Field uf23Field(model);
+    const UF23FieldOctree tree(uf23Field, relTolerance, absTolerance,
+                               maxDepth);
+    if (tree.GetDepth() != maxDepth ||
+        tree.GetNumberOfNodes() != 8 * (tree.GetNumberOfNodes() / 8) + 1) {
+      cerr << "inconsistent tree" << endl;
+      return 1;
+    }
+
+    // memory of a uniform grid with the smallest cell size of the tree
+    const double nUniform = (1 << maxDepth) + 1;
+    const double uniformMemorySize = nUniform*nUniform*nUniform * 3*sizeof(float);
+    if (tree.GetMemorySize() > uniformMemorySize / 2) {
+      cerr << "octree needs " << tree.GetMemorySize() << " bytes, "
+           << "uniform grid " << uniformMemorySize << endl;
+      return 2;
+    }
+
+    double maxRelDeviation;
+    const double maxDeviation =
+      tree.GetMaximumDeviation(uf23Field, testPositions, maxRelDeviation);
+    double maxRelDeviationOffAxis;
+    const double maxDeviationOffAxis =
+      tree.GetMaximumDeviation(uf23Field, offAxisPositions,
+                               maxRelDeviationOffAxis);
+    cout << " " << setw(6) << UF23Field::GetModelName(model)
+         << " " << tree.GetNumberOfLeaves() << " leaves, "
+         << setprecision(3) << fixed
+         << tree.GetMemorySize() / double(1 << 20) << " MB (uniform "
+         << uniformMemorySize / double(1 << 20) << " MB)"
+         << ", max. deviation " << scientific << maxDeviation
+         << " muG (rel. " << maxRelDeviation << "), off-axis "
+         << maxDeviationOffAxis << " muG" << endl;
+    if (maxDeviationOffAxis > maxAllowedDeviation)
+      return 3;
+  }
+
+  const UF23Field uf23Field(UF23Field::base);
+
+  // coarse tree has fewer leaves
+  const UF23FieldOctree coarseTree(uf23Field, 10 * relTolerance,
+                                   10 * absTolerance, maxDepth);
+  const UF23FieldOctree tree(uf23Field, relTolerance, absTolerance, maxDepth);
+  if (coarseTree.GetNumberOfLeaves() >= tree.GetNumberOfLeaves())
+    return 4;
+
+  // outside of the tree
+  if (tree(Vector3(100, 0, 0)).Length() != 0)
+    return 5;
+
+  // invalid depth
+  try {
+    const UF23FieldOctree tooDeep(uf23Field, relTolerance, absTolerance, 21);
+    return 6;
+  }
+  catch (const runtime_error&) { }
+
+  cout << " UF23FieldOctree test successful " << endl;
+  return 0;
+}
@@ -0,0 +1,100 @@
+/** @file testUF23FieldParameterGradient.cxx
+
+    @brief  derivatives of UF23Field::EvaluateWithParameterGradient()
+            compared to finite differences of SetParameters()
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+// central differences of fourth order, step h relative to the parameter
+UF23Field::ParameterGradient
+GetNumericalGradient(const UF23Field& field, const Vector3& pos,
+                     const double h)
+{
+  UF23Field::ParameterGradient gradient;
+  const vector<double> par = field.GetParameters();
+  for (unsigned int k = 0; k < UF23Field::eNpar; ++k) {
+    const double dp = h * max(std::abs(par[k]), 1.);
+    Vector3 b[4];
+    const double steps[4] = { -2, -1, 1, 2 };
+    for (unsigned int j = 0; j < 4; ++j) {
+      UF23Field f(field);
+      vector<double> p = par;
+      p[k] += steps[j] * dp;
+      f.SetParameters(p);
+      b[j] = f(pos);
+    }
+    const Vector3 d = (b[0] - b[1] * 8 + b[2] * 8 - b[3]) / (12 * dp);
+    gradient[0][k] = d.x;
+    gradient[1][k] = d.y;
+    gradient[2][k] = d.z;
+  }
+  return gradient;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> positions = GetSmoothPositions(200, 19);
+
+  const double h = 1e-4;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    cout << " " << setw(6) << m.second << " ..." << flush;
+    const UF23Field field(m.first);
+    const vector<double> par = field.GetParameters();
+    double maxDev = 0;
+    for (const auto& pos : positions) {
+      UF23Field::ParameterGradient gradient;
+      const Vector3 b = field.EvaluateWithParameterGradient(pos, gradient);
+      const Vector3 bRef = field(pos);
+      if ((b - bRef).Length() > 1e-12 * max(1., bRef.Length()))
+        return 1;
+      const UF23Field::ParameterGradient gradientRef =
+        GetNumericalGradient(field, pos, h);
+      // change of B for relative changes of the parameters, relative
+      // to the largest change
+      double norm = 1e-3;
+      for (unsigned int i = 0; i < 3; ++i)
+        for (unsigned int k = 0; k < UF23Field::eNpar; ++k)
+          norm = max(norm, std::abs(gradientRef[i][k]) *
+                     max(std::abs(par[k]), 1.));
+      for (unsigned int i = 0; i < 3; ++i)
+        for (unsigned int k = 0; k < UF23Field::eNpar; ++k)
+          maxDev = max(maxDev, std::abs(gradient[i][k] - gradientRef[i][k]) *
+                       max(std::abs(par[k]), 1.) / norm);
+    }
+    cout << " max. rel. deviation " << scientific << setprecision(2)
+         << maxDev << endl;
+    if (maxDev > 1e-5)
+      return 2;
+  }
+
+  // parameters not used by the base model
+  const UF23Field base(UF23Field::base);
+  UF23Field::ParameterGradient gradient;
+  base.EvaluateWithParameterGradient(positions[0], gradient);
+  for (const auto k : { UF23Field::eSpurCenter, UF23Field::eTwistingTime,
+                        UF23Field::ePoloidalXi })
+    for (unsigned int i = 0; i < 3; ++i)
+      if (gradient[i][k] != 0)
+        return 3;
+
+  // batch interface
+  vector<Vector3> fields;
+  vector<UF23Field::ParameterGradient> gradients;
+  base.EvaluateWithParameterGradient(positions, fields, gradients);
+  base.EvaluateWithParameterGradient(positions[5], gradient);
+  if (fields.size() != positions.size() || gradients.size() != fields.size() ||
+      gradients[5] != gradient)
+    return 4;
+
+  cout << " ==> test of UF23Field parameter gradient successful " << endl;
+  return 0;
+}
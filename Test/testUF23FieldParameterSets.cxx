@@ -0,0 +1,100 @@
+/** @file testUF23FieldParameterSets.cxx
+
+    @brief  UF23Field::EvaluateParameterSets() compared to
+            SetParameters() and Evaluate() for each parameter set
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+using namespace std;
+
+bool
+Compare(const UF23Field& field, const vector<double>& parameters,
+        const size_t k, const vector<Vector3>& positions)
+{
+  vector<Vector3> fields;
+  field.EvaluateParameterSets(parameters.data(), k, positions, fields);
+  const size_t n = positions.size();
+  if (fields.size() != k * n)
+    return false;
+  for (size_t j = 0; j < k; ++j) {
+    UF23Field f(field);
+    f.SetParameters(vector<double>(parameters.begin() + j * UF23Field::eNpar,
+                                   parameters.begin() +
+                                   (j + 1) * UF23Field::eNpar));
+    const vector<Vector3> reference = f.Evaluate(positions);
+    for (size_t i = 0; i < n; ++i) {
+      const Vector3& b = fields[j * n + i];
+      if ((b - reference[i]).Length() > 1e-13 * max(1., reference[i].Length())) {
+        cerr << field.GetModelName() << " set " << j << ": (" << b
+             << ") != (" << reference[i] << ") at (" << positions[i] << ")"
+             << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> positions = GetTestPositions(1000, 22);
+  mt19937_64 engine(22);
+  normal_distribution<double> gauss;
+
+  // parameter sets scattered by 1% around the nominal parameters, more
+  // than one chunk
+  const size_t k = UF23Field::kParameterSetChunk + 13;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    cout << " " << m.second << " ..." << flush;
+    UF23Field field(m.first);
+    const vector<double> par = field.GetParameters();
+    vector<double> parameters;
+    for (size_t j = 0; j < k; ++j)
+      for (const double p : par)
+        parameters.push_back(p * (1 + 0.01 * gauss(engine)));
+    if (!Compare(field, parameters, k, positions))
+      return 1;
+    field.SetVectorization(false);
+    if (!Compare(field, parameters, 3, positions))
+      return 2;
+    // cutoffs of the negligible components for each parameter set
+    field.SetVectorization(true);
+    field.SetTolerance(1e-3);
+    if (!Compare(field, parameters, 11, positions))
+      return 2;
+    cout << " OK" << endl;
+  }
+
+  // separate arrays
+  const UF23Field base(UF23Field::base);
+  const vector<double> par = base.GetParameters();
+  vector<double> parameters;
+  for (size_t j = 0; j < 2; ++j)
+    parameters.insert(parameters.end(), par.begin(), par.end());
+  const double x[2] = { -8.2, 1 };
+  const double y[2] = { 0, 2 };
+  const double z[2] = { 0.0208, 3 };
+  double bx[4], by[4], bz[4];
+  base.EvaluateParameterSets(parameters.data(), 2, x, y, z, bx, by, bz, 2);
+  const Vector3 b = base(Vector3(x[1], y[1], z[1]));
+  if (std::abs(bx[3] - b.x) > 1e-13 || std::abs(by[3] - b.y) > 1e-13 ||
+      std::abs(bz[3] - b.z) > 1e-13)
+    return 3;
+  // n x 3 arrays
+  const double xyz[6] = { x[0], y[0], z[0], x[1], y[1], z[1] };
+  double b3[12];
+  base.EvaluateParameterSets(parameters.data(), 2, &xyz[0], &xyz[1], &xyz[2],
+                             3, &b3[0], &b3[1], &b3[2], 3, 2);
+  if (b3[9] != bx[3] || b3[10] != by[3] || b3[11] != bz[3])
+    return 4;
+
+  cout << " ==> test of UF23Field parameter sets successful " << endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+/** @file testUF23FieldSet.cxx
+
+    @brief  fields of UF23FieldSet compared to separate evaluations
+            of UF23Field
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldSet.h"
+#include "UF23TestPositions.h"
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+bool
+Compare(const UF23FieldSet& set, const vector<Vector3>& positions)
+{
+  vector<Vector3> fields;
+  set.Evaluate(positions, fields);
+  const size_t n = positions.size();
+  if (fields.size() != set.GetNumberOfFields() * n)
+    return false;
+  for (unsigned int m = 0; m < set.GetNumberOfFields(); ++m) {
+    const vector<Vector3> reference = set.GetField(m).Evaluate(positions);
+    for (size_t i = 0; i < n; ++i) {
+      const Vector3& b = fields[m * n + i];
+      if ((b - reference[i]).Length() > 1e-13 * max(1., reference[i].Length())) {
+        cerr << set.GetField(m).GetModelName() << ": (" << b << ") != ("
+             << reference[i] << ") at (" << positions[i] << ")" << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> positions = GetTestPositions(10000, 21);
+
+  // all models
+  UF23FieldSet all;
+  if (all.GetNumberOfFields() != 8 || !Compare(all, positions))
+    return 1;
+  all.SetFastMath(true);
+  if (!Compare(all, positions))
+    return 2;
+  all.SetFastMath(false);
+  all.SetVectorization(false);
+  if (!Compare(all, positions))
+    return 3;
+
+  // subset with different maximum radius and modified parameters
+  const UF23FieldSet subset({UF23Field::twistX, UF23Field::base}, 10);
+  if (subset.GetField(0).GetModelType() != UF23Field::twistX ||
+      !Compare(subset, positions))
+    return 4;
+  UF23Field modified(UF23Field::expX);
+  vector<double> par = modified.GetParameters();
+  par[UF23Field::ePoloidalB] *= 2;
+  modified.SetParameters(par);
+  const UF23FieldSet custom({modified, UF23Field(UF23Field::spur, 20)});
+  if (!Compare(custom, positions))
+    return 5;
+
+  // separate arrays
+  const size_t n = positions.size();
+  vector<double> x, y, z;
+  for (const auto& p : positions) {
+    x.push_back(p.x);
+    y.push_back(p.y);
+    z.push_back(p.z);
+  }
+  vector<double> bx(2 * n), by(2 * n), bz(2 * n);
+  subset.Evaluate(x.data(), y.data(), z.data(),
+                  bx.data(), by.data(), bz.data(), n);
+  const Vector3 b = subset.GetField(1)(positions[100]);
+  if (std::abs(bx[n + 100] - b.x) > 1e-13 || std::abs(by[n + 100] - b.y) > 1e-13 ||
+      std::abs(bz[n + 100] - b.z) > 1e-13)
+    return 6;
+
+  // n x 3 arrays, model m at (m * n + i) * 3
+  vector<double> b3(2 * 3 * n);
+  subset.Evaluate(&positions[0].x, &positions[0].y, &positions[0].z, 3,
+                  &b3[0], &b3[1], &b3[2], 3, n);
+  if (b3[3 * (n + 100)] != bx[n + 100] || b3[3 * (n + 100) + 1] != by[n + 100] ||
+      b3[3 * (n + 100) + 2] != bz[n + 100])
+    return 7;
+
+  cout << " ==> test of UF23FieldSet successful " << endl;
+  return 0;
+}
@@ -0,0 +1,82 @@
+/** @file testUF23FieldT.cxx
+
+    @brief  compile-time model kernels of UF23FieldT compared to UF23Field
+    @return 0 upon success
+
+*/
+
+#include "../UF23FieldT.h"
+#include "UF23TestPositions.h"
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+// UF23FieldT<mt> and UF23Field(mt) must agree exactly
+template<UF23Field::ModelType mt>
+bool
+Compare(const vector<Vector3>& positions)
+{
+  cout << " " << UF23Field::GetModelName(mt) << " ..." << flush;
+  const UF23Field uf23Field(mt);
+  const UF23FieldT<mt> uf23FieldT;
+  if (uf23FieldT.GetModelType() != mt)
+    return false;
+  for (const auto& pos : positions) {
+    const Vector3 b = uf23Field(pos);
+    const Vector3 bT = uf23FieldT(pos);
+    if (b.x != bT.x || b.y != bT.y || b.z != bT.z) {
+      cerr << "(" << bT << ") != (" << b << ") at (" << pos << ")" << endl;
+      return false;
+    }
+  }
+
+  // modified parameters
+  UF23Field modified(mt);
+  vector<double> par = modified.GetParameters();
+  par[UF23Field::eDiskH] *= 1.1;
+  par[UF23Field::ePoloidalB] *= 0.9;
+  modified.SetParameters(par);
+  const UF23FieldT<mt> modifiedT(modified);
+  for (const auto& pos : positions) {
+    const Vector3 b = modified(pos);
+    const Vector3 bT = modifiedT(pos);
+    if (b.x != bT.x || b.y != bT.y || b.z != bT.z)
+      return false;
+  }
+  cout << " OK" << endl;
+  return true;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const vector<Vector3> positions = GetTestPositions(10000, 7);
+
+  if (!Compare<UF23Field::base>(positions) ||
+      !Compare<UF23Field::neCL>(positions) ||
+      !Compare<UF23Field::expX>(positions) ||
+      !Compare<UF23Field::spur>(positions) ||
+      !Compare<UF23Field::cre10>(positions) ||
+      !Compare<UF23Field::synCG>(positions) ||
+      !Compare<UF23Field::twistX>(positions) ||
+      !Compare<UF23Field::nebCor>(positions))
+    return 1;
+
+  // a field of another model type is refused
+  try {
+    const UF23FieldT<UF23Field::spur> wrong((UF23Field(UF23Field::base)));
+    return 2;
+  }
+  catch (const std::runtime_error&) {
+  }
+
+  // batch interface is inherited
+  const UF23FieldT<UF23Field::expX> expX;
+  const vector<Vector3> batch = expX.Evaluate(positions);
+  for (unsigned int i = 0; i < positions.size(); ++i)
+    if ((batch[i] - expX(positions[i])).Length() > 1e-8)
+      return 3;
+
+  cout << " ==> test of UF23FieldT successful " << endl;
+  return 0;
+}
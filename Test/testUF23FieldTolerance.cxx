@@ -0,0 +1,115 @@
+/** @file testUF23FieldTolerance.cxx
+
+    @brief  deviation of the field with negligible components skipped
+            (UF23Field::SetTolerance()) from the exact result
+    @return 0 upon success
+
+*/
+
+#include "../UF23Field.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+using namespace std;
+
+// maximum of |B_i - B_i^ref|
+double
+GetMaxDeviation(const vector<Vector3>& fields, const vector<Vector3>& reference)
+{
+  double maxDev = 0;
+  for (unsigned int i = 0; i < fields.size(); ++i)
+    maxDev = max(maxDev, (fields[i] - reference[i]).Length());
+  return maxDev;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // random positions in a halo volume of 30 kpc radius and in the disk
+  vector<Vector3> positions;
+  mt19937_64 engine(26);
+  uniform_real_distribution<double> u(-30, 30);
+  while (positions.size() < 100000) {
+    const Vector3 p(u(engine), u(engine), u(engine));
+    if (p.Length() < 30)
+      positions.push_back(p);
+  }
+  vector<Vector3> allPositions = positions;
+  for (unsigned int i = 0; i < 100000; ++i)
+    allPositions.push_back(Vector3(u(engine), u(engine), u(engine) / 10));
+
+  const double tolerances[] = { 1e-3, 1e-2, 1e-1 };
+  cout << " " << setw(6) << "model" << " tolerance  max. deviation"
+       << " (scalar, SIMD)" << endl;
+  for (const auto& m : UF23Field::GetModelNames()) {
+    UF23Field field(m.first);
+    if (field.GetTolerance() != 0)
+      return 1;
+    vector<Vector3> exactScalar;
+    for (const auto& p : allPositions)
+      exactScalar.push_back(field(p));
+    vector<Vector3> exact;
+    field.Evaluate(allPositions, exact);
+    vector<Vector3> fields;
+
+    for (const double t : tolerances) {
+      field.SetTolerance(t);
+      vector<Vector3> fieldsScalar;
+      for (const auto& p : allPositions)
+        fieldsScalar.push_back(field(p));
+      field.Evaluate(allPositions, fields);
+      const double scalarDev = GetMaxDeviation(fieldsScalar, exactScalar);
+      const double simdDev = GetMaxDeviation(fields, exact);
+
+      cout << " " << setw(6) << m.second << scientific << setprecision(1)
+           << setw(10) << t << setprecision(2) << setw(11) << scalarDev
+           << setw(10) << simdDev << endl;
+      if (scalarDev >= t || simdDev >= t)
+        return 2;
+      // some of the components are skipped
+      if (scalarDev == 0)
+        return 3;
+    }
+
+    // cutoffs follow the parameters
+    vector<double> parameters = field.GetParameters();
+    for (const auto par : { UF23Field::eDiskB1, UF23Field::eDiskB2,
+                            UF23Field::eDiskB3, UF23Field::eToroidalBN,
+                            UF23Field::eToroidalBS })
+      parameters[par] *= 100;
+    field.SetParameters(parameters);
+    field.SetTolerance(0);
+    vector<Vector3> exactStrong;
+    for (const auto& p : allPositions)
+      exactStrong.push_back(field(p));
+    field.SetTolerance(1e-2);
+    fields.clear();
+    for (const auto& p : allPositions)
+      fields.push_back(field(p));
+    if (GetMaxDeviation(fields, exactStrong) >= 1e-2)
+      return 4;
+
+    // no tolerance: identical to the exact field
+    UF23Field exactField(m.first);
+    exactField.SetTolerance(0.1);
+    exactField.SetTolerance(0);
+    for (unsigned int i = 0; i < allPositions.size(); ++i) {
+      const Vector3 b = exactField(allPositions[i]);
+      if (b.x != exactScalar[i].x || b.y != exactScalar[i].y ||
+          b.z != exactScalar[i].z)
+        return 5;
+    }
+  }
+
+  try {
+    UF23Field(UF23Field::base).SetTolerance(-1);
+    return 6;
+  }
+  catch (const runtime_error&) {
+  }
+
+  cout << " ==> test of UF23Field tolerance successful " << endl;
+  return 0;
+}
@@ -0,0 +1,120 @@
+/** @file testUF23LineOfSight.cxx
+
+    @brief  line-of-sight integrals of UF23LineOfSight compared to
+            a point-by-point calculation
+    @return 0 upon success
+
+*/
+
+#include "../UF23LineOfSight.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+bool
+CloseTo(const double a, const double b, const double tol) {
+  return std::abs(a - b) <= tol * std::max(1., std::max(std::abs(a), std::abs(b)));
+}
+
+// thermal electron density (toy model, cm^-3)
+void
+ElectronDensity(const double* /*x*/, const double* /*y*/, const double* z,
+                double* w, const size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    w[i] = 0.03 * exp(-std::abs(z[i]) / 1.);
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // HEALPix pixel centers
+  for (const unsigned int nside : { 1, 2, 4 }) {
+    const auto dirs = UF23LineOfSight::GetHealpixDirections(nside);
+    Vector3 sum(0, 0, 0);
+    for (const auto& d : dirs) {
+      if (!CloseTo(d.Length(), 1, 1e-14))
+        return 1;
+      sum += d;
+    }
+    if (dirs.size() != 12 * nside * nside || sum.Length() > 1e-12)
+      return 1;
+  }
+  const auto nside1 = UF23LineOfSight::GetHealpixDirections(1);
+  if (!CloseTo(nside1[0].z, 2./3, 1e-14) ||
+      !CloseTo(atan2(nside1[0].y, nside1[0].x), M_PI/4, 1e-14) ||
+      !CloseTo(nside1[4].z, 0, 1e-14) || !CloseTo(nside1[11].z, -2./3, 1e-14))
+    return 1;
+
+  const UF23Field uf23Field(UF23Field::base);
+  const Vector3 observer(-8.2, 0, 0.0208);
+  const double step = 0.05;
+  UF23LineOfSight los(uf23Field, observer, step);
+  const auto directions = UF23LineOfSight::GetHealpixDirections(2);
+  const vector<UF23LineOfSight::Projection> projections =
+    {
+     { UF23LineOfSight::eParallel, ElectronDensity },
+     { UF23LineOfSight::eSynchrotronI, nullptr },
+     { UF23LineOfSight::eSynchrotronQ, nullptr },
+     { UF23LineOfSight::eSynchrotronU, nullptr },
+     { UF23LineOfSight::eLength, nullptr }
+    };
+  los.SetNumberOfThreads(1);
+  const auto integrals = los.Integrate(directions, projections);
+  los.SetNumberOfThreads(3);
+  if (los.Integrate(directions, projections) != integrals) {
+    cerr << "result depends on number of threads" << endl;
+    return 2;
+  }
+
+  // point-by-point calculation
+  for (unsigned int iDir = 0; iDir < directions.size(); ++iDir) {
+    const Vector3& d = directions[iDir];
+    double sMin, sMax;
+    if (!los.GetSegment(d, sMin, sMax) || sMin != 0)
+      return 3;
+    const unsigned int nSteps = ceil(sMax / step);
+    const double dl = sMax / nSteps;
+    const double theta = acos(d.z);
+    const double phi = atan2(d.y, d.x);
+    const Vector3 e1(cos(theta)*cos(phi), cos(theta)*sin(phi), -sin(theta));
+    const Vector3 e2(-sin(phi), cos(phi), 0);
+    vector<double> sums(projections.size(), 0);
+    for (unsigned int i = 0; i < nSteps; ++i) {
+      const Vector3 pos = observer + d * ((i + 0.5) * dl);
+      const Vector3 b = uf23Field(pos);
+      double ne;
+      ElectronDensity(&pos.x, &pos.y, &pos.z, &ne, 1);
+      const double b1 = dotprod(b, e1);
+      const double b2 = dotprod(b, e2);
+      sums[0] += ne * dotprod(b, d) * dl;
+      sums[1] += (b1*b1 + b2*b2) * dl;
+      sums[2] += (b1*b1 - b2*b2) * dl;
+      sums[3] += 2*b1*b2 * dl;
+      sums[4] += dl;
+    }
+    for (unsigned int iProj = 0; iProj < projections.size(); ++iProj) {
+      if (!CloseTo(sums[iProj], integrals[iProj][iDir], 1e-9)) {
+        cerr << "direction " << iDir << ", projection " << iProj << ": "
+             << integrals[iProj][iDir] << " != " << sums[iProj] << endl;
+        return 4;
+      }
+    }
+    if (!CloseTo(integrals[4][iDir], sMax, 1e-12) ||
+        pow(integrals[2][iDir], 2) + pow(integrals[3][iDir], 2) >
+        pow(integrals[1][iDir], 2))
+      return 5;
+  }
+
+  // maximum distance
+  const UF23LineOfSight shortLos(uf23Field, observer, step, 5);
+  const auto lengths =
+    shortLos.Integrate(directions, { { UF23LineOfSight::eLength, nullptr } });
+  for (const double l : lengths[0])
+    if (!CloseTo(l, 5, 1e-12))
+      return 6;
+
+  cout << " ==> test of UF23LineOfSight successful " << endl;
+  return 0;
+}
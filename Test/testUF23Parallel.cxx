@@ -0,0 +1,135 @@
+/** @file testUF23Parallel.cxx
+
+    @brief  task distribution of utl::ParallelFor() with work stealing,
+            exceptions and thread pinning
+    @return 0 upon success
+
+*/
+
+#include "../UF23Parallel.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+using namespace std;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const utl::ParallelOptions::EPinning pinnings[] =
+    { utl::ParallelOptions::eNoPinning, utl::ParallelOptions::eCompact,
+      utl::ParallelOptions::eScatter };
+
+  // each task exactly once for very different costs of the tasks
+  for (const auto pinning : pinnings) {
+    for (const unsigned int nThreads : { 1u, 2u, 3u, 8u }) {
+      for (const size_t nTasks : { size_t(0), size_t(1), size_t(5),
+                                   size_t(1000) }) {
+        const utl::ParallelOptions options(nThreads, pinning);
+        const unsigned int n = options.GetNumberOfThreads(nTasks);
+        if (n < 1 || n > nThreads || (nTasks && n > nTasks))
+          return 1;
+        vector<atomic<unsigned int>> calls(nTasks);
+        for (auto& c : calls)
+          c = 0;
+        atomic<bool> badThread(false);
+        volatile double sink = 0;
+        utl::ParallelFor(nTasks, options,
+          [&](const size_t iTask, const unsigned int iThread)
+          {
+            if (iThread >= n)
+              badThread = true;
+            ++calls[iTask];
+            if (iTask % 97 == 0)
+              for (unsigned int i = 0; i < 100000; ++i)
+                sink = sink + 1;
+          });
+        if (badThread)
+          return 2;
+        for (const auto& c : calls)
+          if (c != 1)
+            return 3;
+      }
+    }
+  }
+
+  // the owner of task 0 is blocked until all other tasks are done,
+  // i.e. the rest of its range has to be taken by the second thread
+  {
+    const size_t nTasks = 100;
+    atomic<size_t> done(0);
+    atomic<bool> timeout(false);
+    set<unsigned int> threadsOfRange;
+    utl::ParallelFor(nTasks, 2,
+      [&](const size_t iTask, const unsigned int iThread)
+      {
+        if (iTask == 0) {
+          const auto start = chrono::steady_clock::now();
+          while (done < nTasks - 1 && !timeout) {
+            this_thread::yield();
+            timeout = chrono::steady_clock::now() - start > chrono::seconds(20);
+          }
+        }
+        else {
+          if (iTask == 1)
+            threadsOfRange.insert(iThread);
+          ++done;
+        }
+      });
+    if (timeout || threadsOfRange.count(1) != 1)
+      return 4;
+  }
+
+  // exceptions are rethrown in the calling thread
+  for (const unsigned int nThreads : { 1u, 4u }) {
+    atomic<size_t> nCalls(0);
+    try {
+      utl::ParallelFor(100000, nThreads,
+        [&](const size_t iTask, const unsigned int)
+        {
+          ++nCalls;
+          if (iTask == 37)
+            throw runtime_error("task 37");
+        });
+      return 5;
+    }
+    catch (const runtime_error&) {
+    }
+    // further tasks are not started
+    if (nCalls == 100000)
+      return 6;
+  }
+
+  // pinning to the CPUs of the process, restored affinity of the caller
+  for (const auto pinning : pinnings) {
+    const vector<int> cpus = utl::GetWorkerCPUs(5, pinning);
+    if (pinning == utl::ParallelOptions::eNoPinning && !cpus.empty())
+      return 7;
+#ifdef __linux__
+    cpu_set_t before;
+    CPU_ZERO(&before);
+    sched_getaffinity(0, sizeof(before), &before);
+    if (pinning != utl::ParallelOptions::eNoPinning && cpus.size() != 5)
+      return 8;
+    for (const int cpu : cpus)
+      if (!CPU_ISSET(cpu, &before))
+        return 9;
+    utl::ParallelFor(10, utl::ParallelOptions(3, pinning),
+                     [](const size_t, const unsigned int) {});
+    cpu_set_t after;
+    CPU_ZERO(&after);
+    sched_getaffinity(0, sizeof(after), &after);
+    if (!CPU_EQUAL(&before, &after))
+      return 10;
+#endif
+  }
+
+  cout << " ==> test of UF23Parallel successful " << endl;
+  return 0;
+}
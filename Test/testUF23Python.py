@@ -0,0 +1,98 @@
+"""@file testUF23Python.py
+
+   @brief  Python module uf23 (make python) compared to the scalar
+           evaluation, run by make test if pybind11 and NumPy are found
+   @return 0 upon success
+"""
+
+import os
+import pickle
+import sys
+
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                os.pardir))
+import uf23
+
+
+def max_deviation(b, reference):
+    """maximum of |b - reference| / (|reference| + 0.1 microgauss)"""
+    return np.max(np.linalg.norm(b - reference, axis=-1) /
+                  (np.linalg.norm(reference, axis=-1) + 0.1))
+
+
+def main():
+    rng = np.random.default_rng(7)
+    n = 1000
+    positions = rng.uniform(-20, 20, size=(n, 3))
+    positions[:, 2] /= 5
+
+    for name in uf23.UF23Field.model_names():
+        field = uf23.UF23Field(name)
+        reference = np.array([field(*p) for p in positions])
+
+        # (n, 3) and x, y, z layouts, out=
+        if max_deviation(field.evaluate(positions), reference) > 1e-10:
+            print(name, ": evaluate(positions) deviates")
+            return 1
+        bxyz = field.evaluate(positions[:, 0].copy(), positions[:, 1].copy(),
+                              positions[:, 2].copy())
+        if bxyz.shape != (3, n) or max_deviation(bxyz.T, reference) > 1e-10:
+            print(name, ": evaluate(x, y, z) deviates")
+            return 1
+        out = np.empty((n, 3))
+        field.evaluate(positions, out=out)
+        if max_deviation(out, reference) > 1e-10:
+            print(name, ": evaluate(out=) deviates")
+            return 1
+
+        # single precision
+        bFloat = field.evaluate(positions.astype(np.float32))
+        if bFloat.dtype != np.float32 or \
+           max_deviation(bFloat.astype(np.float64), reference) > 1e-4:
+            print(name, ": float32 evaluation deviates")
+            return 2
+
+        # pickling keeps parameters and switches
+        field.fast_math = True
+        copy = pickle.loads(pickle.dumps(field))
+        if copy.model_name != name or not copy.fast_math or \
+           copy.get_parameters() != field.get_parameters():
+            print(name, ": pickling failed")
+            return 3
+        print(" {} ... OK".format(name))
+
+    # parameter sets sampled from the covariance matrix
+    field = uf23.UF23Field("base")
+    covariance = uf23.ParameterCovariance("base")
+    normal = rng.standard_normal((5, covariance.dimension))
+    parameters = covariance.sample_parameters(field, normal)
+    b = field.evaluate_parameter_sets(parameters, positions)
+    if b.shape != (5, n, 3):
+        return 4
+    for k in range(5):
+        realization = uf23.UF23Field("base")
+        realization.set_parameters(list(parameters[k]))
+        if max_deviation(b[k], realization.evaluate(positions)) > 1e-10:
+            print("evaluate_parameter_sets deviates for set", k)
+            return 4
+
+    # several models in one pass
+    models = [uf23.UF23Field.base, uf23.UF23Field.expX, uf23.UF23Field.spur]
+    fieldSet = uf23.UF23FieldSet(models)
+    bSet = fieldSet.evaluate(positions)
+    if len(fieldSet) != 3 or bSet.shape != (3, n, 3):
+        return 5
+    for m, model in enumerate(models):
+        if max_deviation(bSet[m], uf23.UF23Field(model).evaluate(positions)) \
+           > 1e-10:
+            print("UF23FieldSet deviates for model", m)
+            return 5
+
+    print(" ==> test of uf23 Python module successful ")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,108 @@
+/** @file testUF23RealizationBank.cxx
+
+    @brief  realization banks drawn, written and mapped from a file
+            compared to the realizations of UF23Ensemble
+    @return 0 upon success
+
+*/
+
+#include "../UF23RealizationBank.h"
+#include "../UF23Ensemble.h"
+#include "../UF23FieldGrid.h"
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  const string bankFile = "testUF23RealizationBank.bank";
+  const unsigned int nRealizations = 150;
+  const unsigned int seed = 27;
+  const vector<Vector3> positions =
+    { {-8.2, 0, 0.0208}, {1, 3, 2}, {4, -2, -1} };
+
+  for (const auto& m : UF23Field::GetModelNames()) {
+    const UF23RealizationBank bank(m.first, nRealizations, seed, 1);
+    const UF23RealizationBank bank4(m.first, nRealizations, seed, 4);
+    const UF23Ensemble ensemble(m.first, nRealizations, seed, 1);
+    if (bank.GetNumberOfRealizations() != nRealizations || bank.IsMapped())
+      return 1;
+
+    // reproducible independent of the number of threads, identical to
+    // the realizations of the ensemble
+    for (unsigned int i = 0; i < nRealizations; ++i) {
+      const vector<double> p = ensemble.GetRealization(i).GetParameters();
+      const vector<double> pBank = bank.GetRealization(i).GetParameters();
+      for (unsigned int j = 0; j < UF23Field::eNpar; ++j)
+        if (bank.GetParameters(i)[j] != bank4.GetParameters(i)[j] ||
+            p[j] != pBank[j])
+          return 2;
+    }
+
+    // mapped from a file
+    bank.Write(bankFile);
+    const UF23RealizationBank mapped(bankFile);
+    if (!mapped.IsMapped() || mapped.GetModelType() != m.first ||
+        mapped.GetSeed() != seed ||
+        mapped.GetNumberOfRealizations() != nRealizations ||
+        !mapped.Matches(UF23Field(m.first)))
+      return 3;
+    for (unsigned int i = 0; i < nRealizations * UF23Field::eNpar; ++i)
+      if (mapped.GetParameters()[i] != bank.GetParameters()[i])
+        return 4;
+
+    // ensemble of mapped realizations
+    UF23Ensemble mappedEnsemble(mapped, 1);
+    UF23Ensemble drawnEnsemble(m.first, nRealizations, seed, 1);
+    mappedEnsemble.Evaluate(positions);
+    drawnEnsemble.Evaluate(positions);
+    for (unsigned int i = 0; i < positions.size(); ++i)
+      if (mappedEnsemble.GetMeans()[i].x != drawnEnsemble.GetMeans()[i].x ||
+          mappedEnsemble.GetMeans()[i].z != drawnEnsemble.GetMeans()[i].z)
+        return 5;
+
+    // realizations for EvaluateParameterSets()
+    const UF23Field field(m.first);
+    vector<Vector3> fields;
+    field.EvaluateParameterSets(mapped.GetParameters(), nRealizations,
+                                positions, fields);
+    for (unsigned int i = 0; i < nRealizations; i += 10) {
+      const UF23Field realization = mapped.GetRealization(i);
+      for (unsigned int j = 0; j < positions.size(); ++j)
+        if ((fields[i * positions.size() + j] -
+             realization(positions[j])).Length() > 1e-8)
+          return 6;
+    }
+    cout << " " << m.second << " ... ok" << endl;
+  }
+
+  // other models, parameters and content types
+  const UF23RealizationBank mapped(bankFile);
+  UF23Field field(mapped.GetModelType());
+  vector<double> p = field.GetParameters();
+  p[UF23Field::eDiskB1] *= 2;
+  field.SetParameters(p);
+  if (mapped.Matches(UF23Field(UF23Field::base)) || mapped.Matches(field))
+    return 7;
+  bool thrown = false;
+  try {
+    const UF23RealizationBank missing("/nonexistent.bank");
+  }
+  catch (const runtime_error&) {
+    thrown = true;
+  }
+  try {
+    const UF23FieldGrid grid(bankFile);
+    thrown = false;
+  }
+  catch (const runtime_error&) {
+  }
+  remove(bankFile.c_str());
+  if (!thrown)
+    return 8;
+
+  cout << " ==> test of UF23RealizationBank successful " << endl;
+  return 0;
+}
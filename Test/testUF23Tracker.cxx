@@ -0,0 +1,128 @@
+/** @file testUF23Tracker.cxx
+
+    @brief  trajectories of UF23Tracker compared to a point-by-point
+            Runge-Kutta integration
+    @return 0 upon success
+
+*/
+
+#include "../UF23Tracker.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+// direction at the exit of the field sphere with classical fixed-step RK4
+Vector3
+PropagateRK4(const UF23Field& field, Vector3 x, Vector3 u, const double rigidity,
+             const double step)
+{
+  const double k = 1 / (UF23Tracker::GetLarmorRadiusConstant() * rigidity);
+  auto du = [&](const Vector3& pos, const Vector3& dir)
+    { return crossprod(dir, field(pos)) * k; };
+  while (x.SquaredLength() <= field.GetMaximumSquaredRadius()) {
+    const Vector3 kx1 = u;
+    const Vector3 ku1 = du(x, u);
+    const Vector3 kx2 = u + ku1 * (step / 2);
+    const Vector3 ku2 = du(x + kx1 * (step / 2), kx2);
+    const Vector3 kx3 = u + ku2 * (step / 2);
+    const Vector3 ku3 = du(x + kx2 * (step / 2), kx3);
+    const Vector3 kx4 = u + ku3 * step;
+    const Vector3 ku4 = du(x + kx3 * step, kx4);
+    x += (kx1 + kx2 * 2 + kx3 * 2 + kx4) * (step / 6);
+    u += (ku1 + ku2 * 2 + ku3 * 2 + ku4) * (step / 6);
+    u = u / u.Length();
+  }
+  return u;
+}
+
+int
+main(const int /*argc*/, const char** /*argv*/)
+{
+  // r_L = 1.081 kpc for 1 EV in 1 muG
+  if (std::abs(UF23Tracker::GetLarmorRadiusConstant() - 1.0810) > 1e-4)
+    return 1;
+
+  const UF23Field uf23Field(UF23Field::base);
+  const Vector3 observer(-8.2, 0, 0.0208);
+
+  // backtracking of anti-particles from the observer
+  UF23Tracker::Particles particles;
+  // (avoid the discontinuity of the toroidal halo at the z-axis)
+  const unsigned int nDir = 20;
+  for (const double rigidity : { 5., 20., 100. }) {
+    for (unsigned int i = 0; i < nDir; ++i) {
+      const double cosTheta = 0.8 * (1 - 2 * (i + 0.5) / nDir);
+      const double sinTheta = sqrt(1 - cosTheta * cosTheta);
+      const double phi = 2.4 * i;
+      particles.Add(observer,
+                    Vector3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta),
+                    -rigidity);
+    }
+  }
+  // one particle outside of the field
+  particles.Add(Vector3(0, 0, 31), Vector3(0, 0, 1), 1);
+  const unsigned int n = particles.Size();
+
+  UF23Tracker cashKarp(uf23Field, UF23Tracker::eCashKarp, 0.2, 1e-9);
+  UF23Tracker::Particles result = particles;
+  cashKarp.SetNumberOfThreads(1);
+  cashKarp.Propagate(result);
+  UF23Tracker::Particles result3 = particles;
+  cashKarp.SetNumberOfThreads(3);
+  cashKarp.Propagate(result3);
+  if (result.fX != result3.fX || result.fUz != result3.fUz ||
+      result.fLength != result3.fLength) {
+    cerr << "result depends on number of threads" << endl;
+    return 2;
+  }
+  if (result.fStatus[n - 1] != UF23Tracker::eEscaped ||
+      result.fLength[n - 1] != 0)
+    return 3;
+
+  UF23Tracker boris(uf23Field, UF23Tracker::eBoris, 0.002);
+  UF23Tracker::Particles resultBoris = particles;
+  boris.Propagate(resultBoris);
+
+  double maxDevCK = 0;
+  double maxDevBoris = 0;
+  for (unsigned int i = 0; i < n - 1; ++i) {
+    if (result.fStatus[i] != UF23Tracker::eEscaped ||
+        resultBoris.fStatus[i] != UF23Tracker::eEscaped)
+      return 4;
+    const Vector3 u = result.GetDirection(i);
+    const Vector3 uBoris = resultBoris.GetDirection(i);
+    if (std::abs(u.Length() - 1) > 1e-12 ||
+        std::abs(uBoris.Length() - 1) > 1e-12 ||
+        result.GetPosition(i).SquaredLength() <=
+        uf23Field.GetMaximumSquaredRadius())
+      return 5;
+    const Vector3 uRef =
+      PropagateRK4(uf23Field, particles.GetPosition(i),
+                   particles.GetDirection(i), particles.fRigidity[i], 0.004);
+    maxDevCK = std::max(maxDevCK, (u - uRef).Length());
+    maxDevBoris = std::max(maxDevBoris, (uBoris - uRef).Length());
+  }
+  cout << " max. deflection difference (rad): Cash-Karp "
+       << scientific << setprecision(2) << maxDevCK
+       << ", Boris " << maxDevBoris << endl;
+  if (maxDevCK > 1e-4 || maxDevBoris > 1e-4)
+    return 6;
+
+  // low rigidity: stops at the maximum path length
+  const double maxLength = 10;
+  UF23Tracker shortTracker(uf23Field, UF23Tracker::eCashKarp, 0.2, 1e-6,
+                           maxLength);
+  UF23Tracker::Particles trapped;
+  for (unsigned int i = 0; i < 10; ++i)
+    trapped.Add(Vector3(-5, 0, 0), Vector3(cos(i), sin(i), 0), 0.001);
+  shortTracker.Propagate(trapped);
+  for (unsigned int i = 0; i < trapped.Size(); ++i)
+    if (trapped.fStatus[i] != UF23Tracker::eMaxLength ||
+        std::abs(trapped.fLength[i] - maxLength) > 1e-9 ||
+        std::abs(trapped.GetDirection(i).Length() - 1) > 1e-12)
+      return 7;
+
+  cout << " ==> test of UF23Tracker successful " << endl;
+  return 0;
+}
@@ -0,0 +1,320 @@
+#ifndef _UF23Anchored_h_
+#define _UF23Anchored_h_
+/**
+ @file UF23Anchored.h
+ @brief elementary functions evaluated relative to nearby arguments
+
+ utl::anchored::Scalar is a double whose log, pow, sin, cos and atan2
+ are calculated by the Context of the current evaluation (see
+ UF23FieldCursor). The Context stores the argument and result of
+ each call ("anchor") in a slot given by the order of the calls
+ within one evaluation. If the next evaluation calls the function of
+ the same slot with an argument close to the anchor, the result is
+ calculated from the stored one with a short series in the offset,
+ e.g. x^p = x0^p (1 + (x - x0)/x0)^p, otherwise in full with the
+ standard math library and the anchor is moved to the new argument.
+ exp is not anchored, since the standard exp is as fast as the series.
+
+ As for utl::ad::Dual, a function template written for double
+ arguments is evaluated with anchored functions when called with
+ Scalar arguments, and the math functions must be called unqualified.
+ The results do not depend on the history of the anchors: the series
+ are truncated far below the double precision (relative offsets up to
+ kMaxOffset = 1/64), i.e. they deviate from the standard math library
+ by a few units in the last place.
+ */
+
+#include <cmath>
+#include <limits>
+
+namespace utl {
+  namespace anchored {
+
+    class Scalar {
+    public:
+      Scalar(const double v = 0) : fV(v) {}
+      double GetValue() const { return fV; }
+
+      Scalar& operator+=(const Scalar& b) { fV += b.fV; return *this; }
+      Scalar& operator-=(const Scalar& b) { fV -= b.fV; return *this; }
+      Scalar& operator*=(const Scalar& b) { fV *= b.fV; return *this; }
+      Scalar& operator/=(const Scalar& b) { fV /= b.fV; return *this; }
+      Scalar operator-() const { return Scalar(-fV); }
+
+    private:
+      double fV;
+    };
+
+    // arithmetic and comparisons of Scalar and double operands
+#define UF23_ANCHORED_OPERATOR(op)                                      \
+    inline Scalar operator op(const Scalar& a, const Scalar& b)         \
+    { return Scalar(a.GetValue() op b.GetValue()); }                    \
+    inline Scalar operator op(const Scalar& a, const double b)          \
+    { return Scalar(a.GetValue() op b); }                               \
+    inline Scalar operator op(const double a, const Scalar& b)          \
+    { return Scalar(a op b.GetValue()); }
+    UF23_ANCHORED_OPERATOR(+)
+    UF23_ANCHORED_OPERATOR(-)
+    UF23_ANCHORED_OPERATOR(*)
+    UF23_ANCHORED_OPERATOR(/)
+#undef UF23_ANCHORED_OPERATOR
+
+#define UF23_ANCHORED_COMPARISON(op)                                    \
+    inline bool operator op(const Scalar& a, const Scalar& b)           \
+    { return a.GetValue() op b.GetValue(); }                            \
+    inline bool operator op(const Scalar& a, const double b)            \
+    { return a.GetValue() op b; }                                       \
+    inline bool operator op(const double a, const Scalar& b)            \
+    { return a op b.GetValue(); }
+    UF23_ANCHORED_COMPARISON(<)
+    UF23_ANCHORED_COMPARISON(>)
+    UF23_ANCHORED_COMPARISON(<=)
+    UF23_ANCHORED_COMPARISON(>=)
+    UF23_ANCHORED_COMPARISON(==)
+    UF23_ANCHORED_COMPARISON(!=)
+#undef UF23_ANCHORED_COMPARISON
+
+    /// maximum (relative) offset from the anchor
+    const double kMaxOffset = 1. / 64;
+
+    /// anchors of the elementary functions of one cursor
+    class Context {
+    public:
+      /// slots per function, further calls are evaluated in full
+      static const unsigned int kNSlots = 16;
+
+      /// start of an evaluation, slots are assigned in the order of calls
+      void Begin() { fILog = fIPow = fISin = fICos = fIAtan2 = 0; }
+      /// invalidate all anchors
+      void Reset() { *this = Context(); }
+
+      /// number of function calls and of calls evaluated in full
+      unsigned long long GetNumberOfCalls() const { return fNCalls; }
+      unsigned long long GetNumberOfUpdates() const { return fNUpdates; }
+
+      double
+      Log(const double x)
+      {
+        ++fNCalls;
+        if (fILog == kNSlots)
+          return Full(std::log(x));
+        LogSlot& s = fLog[fILog++];
+        const double u = (x - s.fX) * s.fInvX;
+        if (std::abs(u) < kMaxOffset)
+          return s.fValue + Log1pSeries(u);
+        s.fX = x;
+        s.fInvX = 1 / x;
+        s.fValue = std::log(x);
+        return Full(s.fValue);
+      }
+
+      double
+      Pow(const double x, const double p)
+      {
+        // exact for the small integer powers of the field components
+        if (p == 2)
+          return x*x;
+        ++fNCalls;
+        if (fIPow == kNSlots || !(std::abs(p) <= kMaxExponent))
+          return Full(std::pow(x, p));
+        PowSlot& s = fPow[fIPow++];
+        const double u = (x - s.fX) * s.fInvX;
+        if (p == s.fP && std::abs(u) < kMaxOffset) {
+          // binomial series of (1 + u)^p
+          return s.fValue * PowSeries(s.fCoefficients, u);
+        }
+        s.fX = x;
+        s.fInvX = 1 / x;
+        s.fValue = std::pow(x, p);
+        if (p != s.fP) {
+          s.fP = p;
+          s.fCoefficients[0] = 1;
+          for (unsigned int k = 1; k <= kPowDegree; ++k)
+            s.fCoefficients[k] = s.fCoefficients[k-1] * (p - (k - 1)) / k;
+        }
+        return Full(s.fValue);
+      }
+
+      double
+      Sin(const double x)
+      {
+        ++fNCalls;
+        if (fISin == kNSlots)
+          return Full(std::sin(x));
+        TrigSlot& s = fSin[fISin++];
+        const double d = x - s.fX;
+        if (std::abs(d) < kMaxOffset)
+          return s.fSin * CosSeries(d) + s.fCos * SinSeries(d);
+        s.fX = x;
+        s.fSin = std::sin(x);
+        s.fCos = std::cos(x);
+        return Full(s.fSin);
+      }
+
+      double
+      Cos(const double x)
+      {
+        ++fNCalls;
+        if (fICos == kNSlots)
+          return Full(std::cos(x));
+        TrigSlot& s = fCos[fICos++];
+        const double d = x - s.fX;
+        if (std::abs(d) < kMaxOffset)
+          return s.fCos * CosSeries(d) - s.fSin * SinSeries(d);
+        s.fX = x;
+        s.fSin = std::sin(x);
+        s.fCos = std::cos(x);
+        return Full(s.fCos);
+      }
+
+      double
+      Atan2(const double y, const double x)
+      {
+        ++fNCalls;
+        if (fIAtan2 == kNSlots)
+          return Full(std::atan2(y, x));
+        Atan2Slot& s = fAtan2[fIAtan2++];
+        // tangent of the angle between (x, y) and the anchor
+        const double cross = s.fX * y - s.fY * x;
+        const double dot = s.fX * x + s.fY * y;
+        if (dot > 0 && std::abs(cross) < kMaxOffset * dot) {
+          const double phi = s.fValue + AtanSeries(cross / dot);
+          // range of atan2
+          return phi > kPi ? phi - 2*kPi : phi < -kPi ? phi + 2*kPi : phi;
+        }
+        s.fX = x;
+        s.fY = y;
+        s.fValue = std::atan2(y, x);
+        return Full(s.fValue);
+      }
+
+    private:
+      static constexpr double kPi = 3.14159265358979323846;
+      static const unsigned int kPowDegree = 8;
+      // larger exponents are evaluated in full
+      static constexpr double kMaxExponent = 8;
+
+      // Taylor series up to the first term below 1e-17 at kMaxOffset,
+      // evaluated with Estrin's scheme for a short dependency chain
+      static double
+      Log1pSeries(const double u)
+      {
+        const double u2 = u*u;
+        return u*((1 - u*(1./2)) + u2*(1./3 - u*(1./4)) +
+          u2*u2*((1./5 - u*(1./6)) + u2*(1./7 - u*(1./8))));
+      }
+      /// sum of c[k] u^k for k = 0 ... kPowDegree = 8
+      static double
+      PowSeries(const double* const c, const double u)
+      {
+        const double u2 = u*u;
+        const double u4 = u2*u2;
+        return (c[0] + c[1]*u) + u2*(c[2] + c[3]*u) +
+          u4*((c[4] + c[5]*u) + u2*(c[6] + c[7]*u)) + u4*u4*c[8];
+      }
+      static double
+      AtanSeries(const double t)
+      {
+        const double t2 = t*t;
+        return t*((1 - t2*(1./3)) + t2*t2*(1./5 - t2*(1./7)));
+      }
+      static double
+      SinSeries(const double d)
+      {
+        const double d2 = d*d;
+        return d*((1 - d2*(1./6)) + d2*d2*(1./120 - d2*(1./5040)));
+      }
+      static double
+      CosSeries(const double d)
+      {
+        const double d2 = d*d;
+        return (1 - d2*(1./2)) + d2*d2*(1./24 - d2*(1./720));
+      }
+
+      double Full(const double v) { ++fNUpdates; return v; }
+
+      // initial anchors are NaN, i.e. the first call is evaluated in full
+      struct LogSlot {
+        double fX = std::numeric_limits<double>::quiet_NaN();
+        double fInvX = 0;
+        double fValue = 0;
+      };
+      struct PowSlot {
+        double fX = std::numeric_limits<double>::quiet_NaN();
+        double fInvX = 0;
+        double fP = std::numeric_limits<double>::quiet_NaN();
+        double fValue = 0;
+        double fCoefficients[kPowDegree + 1] = { 0 };
+      };
+      struct TrigSlot {
+        double fX = std::numeric_limits<double>::quiet_NaN();
+        double fSin = 0;
+        double fCos = 1;
+      };
+      struct Atan2Slot {
+        double fX = 0;
+        double fY = 0;
+        double fValue = 0;
+      };
+
+      unsigned int fILog = 0;
+      unsigned int fIPow = 0;
+      unsigned int fISin = 0;
+      unsigned int fICos = 0;
+      unsigned int fIAtan2 = 0;
+      unsigned long long fNCalls = 0;
+      unsigned long long fNUpdates = 0;
+      LogSlot fLog[kNSlots];
+      PowSlot fPow[kNSlots];
+      TrigSlot fSin[kNSlots];
+      TrigSlot fCos[kNSlots];
+      Atan2Slot fAtan2[kNSlots];
+    };
+
+    /// context of the evaluation in this thread (see ContextScope)
+    inline Context*&
+    CurrentContext()
+    {
+      static thread_local Context* context = nullptr;
+      return context;
+    }
+
+    /// sets the context of this thread for the lifetime of the scope
+    class ContextScope {
+    public:
+      explicit ContextScope(Context& context) :
+        fPrevious(CurrentContext())
+      {
+        context.Begin();
+        CurrentContext() = &context;
+      }
+      ~ContextScope() { CurrentContext() = fPrevious; }
+      ContextScope(const ContextScope&) = delete;
+      ContextScope& operator=(const ContextScope&) = delete;
+    private:
+      Context* fPrevious;
+    };
+
+    // as fast as the series (and exact), not anchored
+    inline Scalar exp(const Scalar& x)
+    { return std::exp(x.GetValue()); }
+    inline Scalar log(const Scalar& x)
+    { return CurrentContext()->Log(x.GetValue()); }
+    inline Scalar pow(const Scalar& x, const double p)
+    { return CurrentContext()->Pow(x.GetValue(), p); }
+    inline Scalar sin(const Scalar& x)
+    { return CurrentContext()->Sin(x.GetValue()); }
+    inline Scalar cos(const Scalar& x)
+    { return CurrentContext()->Cos(x.GetValue()); }
+    inline Scalar atan2(const Scalar& y, const Scalar& x)
+    { return CurrentContext()->Atan2(y.GetValue(), x.GetValue()); }
+    inline Scalar sqrt(const Scalar& x)
+    { return std::sqrt(x.GetValue()); }
+    inline Scalar fabs(const Scalar& x)
+    { return std::abs(x.GetValue()); }
+  }
+
+  /// value of an anchored scalar
+  inline double Value(const anchored::Scalar& x) { return x.GetValue(); }
+}
+#endif
@@ -0,0 +1,199 @@
+#ifndef _UF23Dual_h_
+#define _UF23Dual_h_
+/**
+ @file UF23Dual.h
+ @brief dual numbers for forward-mode automatic differentiation
+
+ utl::ad::Dual<N> holds a value and its partial derivatives with
+ respect to N independent variables. With the overloaded arithmetic
+ operators and math functions, a function template written for double
+ arguments calculates the value and gradient in one pass when called
+ with Dual arguments (see UF23Field::EvaluateWithJacobian()).
+
+ The math functions are found by argument-dependent lookup, i.e. they
+ must be called unqualified (e.g. exp(x), not std::exp(x)). The
+ derivatives of functions with a singular derivative (sqrt, pow,
+ atan2 at the origin) are zero for variables with zero tangent, and
+ the derivative of x^p with respect to p is zero for x <= 0.
+ */
+
+#include <cmath>
+
+namespace utl {
+  namespace ad {
+
+    template<unsigned int N>
+    class Dual {
+    public:
+      /// constant (zero derivatives)
+      Dual(const double v = 0) : fV(v) { for (auto& d : fD) d = 0; }
+      /// independent variable i with derivative scale (e.g. unit)
+      static Dual Variable(const double v, const unsigned int i,
+                           const double scale = 1)
+      { Dual x(v); x.fD[i] = scale; return x; }
+
+      double GetValue() const { return fV; }
+      double GetDerivative(const unsigned int i) const { return fD[i]; }
+
+      /// chain rule, f(x) with f'(x) = df
+      Dual Apply(const double f, const double df) const
+      {
+        Dual r(f);
+        for (unsigned int i = 0; i < N; ++i)
+          r.fD[i] = fD[i] == 0 ? 0 : df * fD[i];
+        return r;
+      }
+
+      Dual& operator+=(const Dual& b)
+      { fV += b.fV; for (unsigned int i = 0; i < N; ++i) fD[i] += b.fD[i]; return *this; }
+      Dual& operator-=(const Dual& b)
+      { fV -= b.fV; for (unsigned int i = 0; i < N; ++i) fD[i] -= b.fD[i]; return *this; }
+      Dual& operator*=(const Dual& b)
+      {
+        for (unsigned int i = 0; i < N; ++i)
+          fD[i] = fD[i] * b.fV + fV * b.fD[i];
+        fV *= b.fV;
+        return *this;
+      }
+      Dual& operator/=(const Dual& b)
+      {
+        const double inv = 1 / b.fV;
+        fV *= inv;
+        for (unsigned int i = 0; i < N; ++i)
+          fD[i] = (fD[i] - fV * b.fD[i]) * inv;
+        return *this;
+      }
+      Dual& operator+=(const double b) { fV += b; return *this; }
+      Dual& operator-=(const double b) { fV -= b; return *this; }
+      Dual& operator*=(const double b)
+      { fV *= b; for (auto& d : fD) d *= b; return *this; }
+      Dual& operator/=(const double b) { return *this *= 1 / b; }
+
+      Dual operator-() const { Dual r(*this); r *= -1.; return r; }
+
+    private:
+      double fV;
+      double fD[N];
+    };
+
+    template<unsigned int N>
+    inline Dual<N> operator+(Dual<N> a, const Dual<N>& b) { return a += b; }
+    template<unsigned int N>
+    inline Dual<N> operator-(Dual<N> a, const Dual<N>& b) { return a -= b; }
+    template<unsigned int N>
+    inline Dual<N> operator*(Dual<N> a, const Dual<N>& b) { return a *= b; }
+    template<unsigned int N>
+    inline Dual<N> operator/(Dual<N> a, const Dual<N>& b) { return a /= b; }
+
+    template<unsigned int N>
+    inline Dual<N> operator+(Dual<N> a, const double b) { return a += b; }
+    template<unsigned int N>
+    inline Dual<N> operator-(Dual<N> a, const double b) { return a -= b; }
+    template<unsigned int N>
+    inline Dual<N> operator*(Dual<N> a, const double b) { return a *= b; }
+    template<unsigned int N>
+    inline Dual<N> operator/(Dual<N> a, const double b) { return a /= b; }
+
+    template<unsigned int N>
+    inline Dual<N> operator+(const double a, Dual<N> b) { return b += a; }
+    template<unsigned int N>
+    inline Dual<N> operator-(const double a, const Dual<N>& b) { return -b + a; }
+    template<unsigned int N>
+    inline Dual<N> operator*(const double a, Dual<N> b) { return b *= a; }
+    template<unsigned int N>
+    inline Dual<N> operator/(const double a, const Dual<N>& b)
+    { return b.Apply(a / b.GetValue(), -a / (b.GetValue() * b.GetValue())); }
+
+    // comparisons of values
+#define UF23_DUAL_COMPARISON(op)                                        \
+    template<unsigned int N>                                            \
+    inline bool operator op(const Dual<N>& a, const Dual<N>& b)         \
+    { return a.GetValue() op b.GetValue(); }                            \
+    template<unsigned int N>                                            \
+    inline bool operator op(const Dual<N>& a, const double b)           \
+    { return a.GetValue() op b; }                                       \
+    template<unsigned int N>                                            \
+    inline bool operator op(const double a, const Dual<N>& b)           \
+    { return a op b.GetValue(); }
+    UF23_DUAL_COMPARISON(<)
+    UF23_DUAL_COMPARISON(>)
+    UF23_DUAL_COMPARISON(<=)
+    UF23_DUAL_COMPARISON(>=)
+    UF23_DUAL_COMPARISON(==)
+    UF23_DUAL_COMPARISON(!=)
+#undef UF23_DUAL_COMPARISON
+
+    template<unsigned int N>
+    inline Dual<N> exp(const Dual<N>& x)
+    { const double e = std::exp(x.GetValue()); return x.Apply(e, e); }
+
+    template<unsigned int N>
+    inline Dual<N> log(const Dual<N>& x)
+    { return x.Apply(std::log(x.GetValue()), 1 / x.GetValue()); }
+
+    template<unsigned int N>
+    inline Dual<N> sqrt(const Dual<N>& x)
+    {
+      const double s = std::sqrt(x.GetValue());
+      return x.Apply(s, 0.5 / s);
+    }
+
+    template<unsigned int N>
+    inline Dual<N> pow(const Dual<N>& x, const double p)
+    {
+      const double v = x.GetValue();
+      return x.Apply(std::pow(v, p), p * std::pow(v, p - 1));
+    }
+
+    // d x^p = p x^(p-1) dx + x^p log(x) dp
+    template<unsigned int N>
+    inline Dual<N> pow(const Dual<N>& x, const Dual<N>& p)
+    {
+      const double v = x.GetValue();
+      const double pv = p.GetValue();
+      const double f = std::pow(v, pv);
+      Dual<N> r = x.Apply(f, pv * std::pow(v, pv - 1));
+      if (v > 0)
+        r += p.Apply(0, f * std::log(v));
+      return r;
+    }
+
+    template<unsigned int N>
+    inline Dual<N> sin(const Dual<N>& x)
+    { return x.Apply(std::sin(x.GetValue()), std::cos(x.GetValue())); }
+
+    template<unsigned int N>
+    inline Dual<N> cos(const Dual<N>& x)
+    { return x.Apply(std::cos(x.GetValue()), -std::sin(x.GetValue())); }
+
+    template<unsigned int N>
+    inline Dual<N> tan(const Dual<N>& x)
+    {
+      const double t = std::tan(x.GetValue());
+      return x.Apply(t, 1 + t*t);
+    }
+
+    template<unsigned int N>
+    inline Dual<N> fabs(const Dual<N>& x)
+    { return x < 0 ? -x : x; }
+
+    // d atan2(y, x) = (x dy - y dx) / (x^2 + y^2)
+    template<unsigned int N>
+    inline Dual<N> atan2(const Dual<N>& y, const Dual<N>& x)
+    {
+      const double xv = x.GetValue();
+      const double yv = y.GetValue();
+      const double r2 = xv*xv + yv*yv;
+      if (r2 == 0)
+        return Dual<N>(std::atan2(yv, xv));
+      const Dual<N> a = (x * yv - y * xv) * (-1 / r2);
+      return a + (std::atan2(yv, xv) - a.GetValue());
+    }
+  }
+
+  /// value of a double or dual number
+  inline double Value(const double x) { return x; }
+  template<unsigned int N>
+  inline double Value(const ad::Dual<N>& x) { return x.GetValue(); }
+}
+#endif
@@ -0,0 +1,169 @@
+#include "UF23Ensemble.h"
+#include "UF23FieldSet.h"
+#include "UF23Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+  // approximate size of the per-thread sample buffer in Evaluate()
+  const std::size_t kBufferBytes = 16 << 20;
+
+}
+
+UF23Ensemble::UF23Ensemble(const UF23Field::ModelType mt,
+                           const unsigned int nRealizations,
+                           const unsigned int seed,
+                           const unsigned int nThreads,
+                           const double maxRadiusInKpc) :
+  UF23Ensemble(UF23RealizationBank(mt, nRealizations, seed, nThreads),
+               nThreads, maxRadiusInKpc)
+{
+}
+
+UF23Ensemble::UF23Ensemble(const UF23RealizationBank& bank,
+                           const unsigned int nThreads,
+                           const double maxRadiusInKpc) :
+  fParallelOptions(nThreads),
+  fCentralField(bank.GetModelType(), maxRadiusInKpc),
+  fRealizations(bank.GetNumberOfRealizations(), fCentralField)
+{
+  if (!bank.Matches(fCentralField))
+    throw std::runtime_error("UF23Ensemble: realization bank of other "
+                             "nominal parameters");
+
+  // work buffers of each thread
+  const std::size_t nRealizations = fRealizations.size();
+  const std::size_t nBlocks = (nRealizations + kBlockSize - 1) / kBlockSize;
+  const unsigned int n = fParallelOptions.GetNumberOfThreads(nBlocks);
+  std::vector<std::vector<double>> parameters(n,
+    std::vector<double>(UF23Field::eNpar));
+  utl::ParallelFor(nBlocks, fParallelOptions,
+    [&](const std::size_t iBlock, const unsigned int iThread)
+    {
+      std::vector<double>& p = parameters[iThread];
+      const std::size_t first = iBlock * kBlockSize;
+      const std::size_t last = std::min(first + kBlockSize, nRealizations);
+      for (std::size_t iReal = first; iReal < last; ++iReal) {
+        std::copy(bank.GetParameters(iReal),
+                  bank.GetParameters(iReal) + UF23Field::eNpar, p.begin());
+        fRealizations[iReal].SetParameters(p);
+      }
+    });
+}
+
+void
+UF23Ensemble::Evaluate(const std::vector<Vector3>& posInKpc,
+                       const std::vector<double>& quantiles)
+{
+  for (const double q : quantiles)
+    if (!(q >= 0 && q <= 1))
+      throw std::runtime_error("UF23Ensemble: invalid quantile "
+                               + std::to_string(q));
+
+  const std::size_t nPos = posInKpc.size();
+  const std::size_t nReal = fRealizations.size();
+  const unsigned int nQ = quantiles.size();
+  fMeans.assign(nPos, Vector3(0, 0, 0));
+  fCovariances.assign(nPos, Matrix3());
+  fQuantileProbabilities = quantiles;
+  fQuantiles.assign(nQ, std::vector<Vector3>(nPos, Vector3(0, 0, 0)));
+  if (nPos == 0 || nReal == 0)
+    return;
+
+  // quantiles in increasing order for successive partitioning
+  std::vector<unsigned int> quantileOrder(nQ);
+  std::iota(quantileOrder.begin(), quantileOrder.end(), 0);
+  std::sort(quantileOrder.begin(), quantileOrder.end(),
+            [&quantiles](const unsigned int a, const unsigned int b)
+            { return quantiles[a] < quantiles[b]; });
+
+  // positions per block such that all samples of a block fit the buffer
+  const std::size_t blockSize =
+    std::max<std::size_t>(8, std::min<std::size_t>(1024,
+      kBufferBytes / (3 * nReal * sizeof(double))));
+  const std::size_t nBlocks = (nPos + blockSize - 1) / blockSize;
+
+  // work buffers of each thread
+  struct Buffer {
+    std::vector<double> fX, fY, fZ, fBx, fBy, fBz;
+    // samples[(component * blockSize + position) * nReal + realization]
+    std::vector<double> fSamples;
+  };
+  const unsigned int nThreads = fParallelOptions.GetNumberOfThreads(nBlocks);
+  std::vector<Buffer> buffers(nThreads);
+  for (auto& b : buffers) {
+    for (auto v : { &b.fX, &b.fY, &b.fZ })
+      v->resize(blockSize);
+    for (auto v : { &b.fBx, &b.fBy, &b.fBz })
+      v->resize(nReal * blockSize);
+    b.fSamples.resize(3 * blockSize * nReal);
+  }
+  // all realizations in one pass over each block of positions
+  const UF23FieldSet realizations(fRealizations);
+
+  utl::ParallelFor(nBlocks, fParallelOptions,
+    [&](const std::size_t iBlock, const unsigned int iThread)
+    {
+      Buffer& b = buffers[iThread];
+      const std::size_t first = iBlock * blockSize;
+      const std::size_t n = std::min(blockSize, nPos - first);
+      for (std::size_t i = 0; i < n; ++i) {
+        b.fX[i] = posInKpc[first + i].x;
+        b.fY[i] = posInKpc[first + i].y;
+        b.fZ[i] = posInKpc[first + i].z;
+      }
+
+      realizations.Evaluate(b.fX.data(), b.fY.data(), b.fZ.data(),
+                            b.fBx.data(), b.fBy.data(), b.fBz.data(), n);
+      for (std::size_t iReal = 0; iReal < nReal; ++iReal) {
+        double* const s = &b.fSamples[iReal];
+        for (std::size_t i = 0; i < n; ++i) {
+          s[i * nReal] = b.fBx[iReal * n + i];
+          s[(blockSize + i) * nReal] = b.fBy[iReal * n + i];
+          s[(2 * blockSize + i) * nReal] = b.fBz[iReal * n + i];
+        }
+      }
+
+      for (std::size_t i = 0; i < n; ++i) {
+        double* const v[3] = { &b.fSamples[i * nReal],
+                               &b.fSamples[(blockSize + i) * nReal],
+                               &b.fSamples[(2 * blockSize + i) * nReal] };
+        // mean and covariance (two-pass)
+        double mean[3];
+        for (unsigned int c = 0; c < 3; ++c)
+          mean[c] = std::accumulate(v[c], v[c] + nReal, 0.) / nReal;
+        Matrix3& cov = fCovariances[first + i];
+        for (unsigned int c1 = 0; c1 < 3; ++c1) {
+          for (unsigned int c2 = 0; c2 <= c1; ++c2) {
+            double sum = 0;
+            for (std::size_t k = 0; k < nReal; ++k)
+              sum += (v[c1][k] - mean[c1]) * (v[c2][k] - mean[c2]);
+            cov[c1][c2] = cov[c2][c1] = nReal > 1 ? sum / (nReal - 1) : 0;
+          }
+        }
+        fMeans[first + i] = Vector3(mean[0], mean[1], mean[2]);
+
+        // quantiles, reorders the samples
+        for (unsigned int c = 0; c < 3; ++c) {
+          std::size_t start = 0;
+          for (const unsigned int iQ : quantileOrder) {
+            const double h = (nReal - 1) * quantiles[iQ];
+            const std::size_t lo = std::min<std::size_t>(h, nReal - 1);
+            std::nth_element(v[c] + start, v[c] + lo, v[c] + nReal);
+            start = lo;
+            const double vLo = v[c][lo];
+            const double vHi = lo + 1 < nReal ?
+              *std::min_element(v[c] + lo + 1, v[c] + nReal) : vLo;
+            const double value = vLo + (h - lo) * (vHi - vLo);
+            Vector3& result = fQuantiles[iQ][first + i];
+            (c == 0 ? result.x : (c == 1 ? result.y : result.z)) = value;
+          }
+        }
+      }
+    });
+}
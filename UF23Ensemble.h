@@ -0,0 +1,116 @@
+#ifndef _UF23Ensemble_h_
+#define _UF23Ensemble_h_
+/**
+ @class UF23Ensemble
+ @brief ensemble of UF23 fields sampled from the parameter uncertainties
+
+ Draws N realizations of the model parameters distributed according
+ to the covariance matrix of ParameterCovariance and evaluates the
+ mean, covariance and quantiles of the field over the ensemble at a
+ set of positions.
+
+ Realizations are drawn in blocks of kBlockSize, each block with its
+ own random number stream seeded from (seed, block index), i.e. the
+ ensemble is reproducible for a given seed independent of the number
+ of threads (see UF23RealizationBank, an ensemble can be constructed
+ from the realizations of a bank mapped from a file). The
+ realizations are stored as UF23Field copies and the evaluation runs
+ in parallel over blocks of positions, such that no heap allocation
+ is done per realization. All realizations of a block are evaluated
+ in one pass with UF23FieldSet.
+
+ */
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "UF23Field.h"
+#include "UF23Parallel.h"
+#include "UF23RealizationBank.h"
+#include "Vector3.h"
+
+class UF23Ensemble {
+public:
+  /// number of realizations per random number stream
+  static const unsigned int kBlockSize = UF23RealizationBank::kBlockSize;
+
+  /// covariance matrix of field components (microgauss^2)
+  typedef std::array<std::array<double, 3>, 3> Matrix3;
+
+public:
+  /**
+     @brief constructor
+     @param mt model type
+     @param nRealizations number of parameter realizations
+     @param seed seed of random number streams
+     @param nThreads number of threads (0: all hardware threads)
+     @param maxRadiusInKpc maximum radius of field in kpc
+  */
+  UF23Ensemble(const UF23Field::ModelType mt,
+               const unsigned int nRealizations,
+               const unsigned int seed = 123,
+               const unsigned int nThreads = 0,
+               const double maxRadiusInKpc = 30);
+  /**
+     @brief constructor
+     @param bank parameter realizations of the nominal model
+     @param nThreads number of threads (0: all hardware threads)
+     @param maxRadiusInKpc maximum radius of field in kpc
+  */
+  UF23Ensemble(const UF23RealizationBank& bank,
+               const unsigned int nThreads = 0,
+               const double maxRadiusInKpc = 30);
+  /// no default constructor
+  UF23Ensemble() = delete;
+
+  /// field with the nominal parameters
+  const UF23Field& GetCentralField() const { return fCentralField; }
+  unsigned int GetNumberOfRealizations() const { return fRealizations.size(); }
+  /// field of realization i
+  const UF23Field& GetRealization(const unsigned int i) const
+  { return fRealizations[i]; }
+
+  /// set number of threads (0: all hardware threads)
+  void SetNumberOfThreads(const unsigned int n)
+  { fParallelOptions.fNThreads = n; }
+  /// set number of threads and their pinning to CPUs
+  void SetParallelOptions(const utl::ParallelOptions& options)
+  { fParallelOptions = options; }
+  const utl::ParallelOptions& GetParallelOptions() const
+  { return fParallelOptions; }
+
+  /**
+     @brief ensemble statistics of the field at given positions
+     @param posInKpc positions with components given in kpc
+     @param quantiles probabilities of quantiles to be calculated
+            (linear interpolation between order statistics)
+
+     Results are available with GetMeans(), GetCovariances() and
+     GetQuantiles().
+  */
+  void Evaluate(const std::vector<Vector3>& posInKpc,
+                const std::vector<double>& quantiles =
+                std::vector<double>{0.16, 0.5, 0.84});
+
+  /// ensemble mean of the field at each position (microgauss)
+  const std::vector<Vector3>& GetMeans() const { return fMeans; }
+  /// ensemble covariance of the field components at each position
+  const std::vector<Matrix3>& GetCovariances() const { return fCovariances; }
+  /// probabilities of quantiles given in Evaluate()
+  const std::vector<double>& GetQuantileProbabilities() const
+  { return fQuantileProbabilities; }
+  /// quantile iQ of the field components at each position (microgauss)
+  const std::vector<Vector3>& GetQuantiles(const unsigned int iQ) const
+  { return fQuantiles.at(iQ); }
+
+private:
+  utl::ParallelOptions fParallelOptions;
+  UF23Field fCentralField;
+  std::vector<UF23Field> fRealizations;
+
+  std::vector<Vector3> fMeans;
+  std::vector<Matrix3> fCovariances;
+  std::vector<double> fQuantileProbabilities;
+  std::vector<std::vector<Vector3>> fQuantiles;
+};
+#endif
@@ -0,0 +1,199 @@
+#include "UF23FFT.h"
+#include "UF23Units.h"
+
+#include <stdexcept>
+
+namespace {
+
+  typedef UF23FFT::Complex Complex;
+
+  // product without the checks for infinities of std::complex
+  inline
+  Complex
+  Multiply(const Complex& a, const Complex& b)
+  {
+    return Complex(a.real() * b.real() - a.imag() * b.imag(),
+                   a.real() * b.imag() + a.imag() * b.real());
+  }
+
+}
+
+UF23FFT::UF23FFT(const std::size_t n) :
+  fN(n)
+{
+  if (n == 0)
+    throw std::runtime_error("UF23FFT: length 0");
+  // radix 4 first, then the prime factors
+  std::size_t m = n;
+  for (; m % 4 == 0; m /= 4)
+    fFactors.push_back(4);
+  for (std::size_t p = 2; p * p <= m; ++p)
+    for (; m % p == 0; m /= p)
+      fFactors.push_back(p);
+  if (m > 1)
+    fFactors.push_back(m);
+  if (!fFactors.empty() && fFactors.back() > kMaxRadix) {
+    fFactors.clear();
+    std::size_t nConvolution = 1;
+    while (nConvolution < 2 * n - 1)
+      nConvolution *= 2;
+    fConvolution.reset(new UF23FFT(nConvolution));
+    // b_j = exp(i pi j^2 / n), Fourier transform of b_j for
+    // j = -(n-1) ... n-1 in wrap-around order
+    fChirp.resize(n);
+    for (std::size_t j = 0; j < n; ++j)
+      fChirp[j] = std::polar(1., utl::kPi * double((j * j) % (2 * n)) / n);
+    fChirpSpectrum.assign(nConvolution, 0.);
+    fChirpSpectrum[0] = fChirp[0];
+    for (std::size_t j = 1; j < n; ++j)
+      fChirpSpectrum[j] = fChirpSpectrum[nConvolution - j] = fChirp[j];
+    fConvolution->Transform(fChirpSpectrum, false);
+  }
+  else {
+    fRoots.resize(n);
+    for (std::size_t j = 0; j < n; ++j)
+      fRoots[j] = std::polar(1., -2 * utl::kPi * double(j) / n);
+  }
+}
+
+void
+UF23FFT::Transform(std::vector<Complex>& x, const bool inverse)
+  const
+{
+  if (x.size() != fN)
+    throw std::runtime_error("UF23FFT: wrong number of values");
+  if (inverse)
+    for (auto& c : x)
+      c = std::conj(c);
+  if (fConvolution) {
+    // X_k = conj(b_k) sum_j x_j conj(b_j) b_(k-j)
+    const std::size_t nConvolution = fChirpSpectrum.size();
+    std::vector<Complex> a(nConvolution, 0.);
+    for (std::size_t j = 0; j < fN; ++j)
+      a[j] = Multiply(x[j], std::conj(fChirp[j]));
+    fConvolution->Transform(a, false);
+    for (std::size_t j = 0; j < nConvolution; ++j)
+      a[j] = Multiply(a[j], fChirpSpectrum[j]);
+    fConvolution->Transform(a, true);
+    for (std::size_t k = 0; k < fN; ++k)
+      x[k] = Multiply(std::conj(fChirp[k]), a[k]) / double(nConvolution);
+  }
+  else if (fN > 1) {
+    const std::vector<Complex> in(x);
+    Recurse(in.data(), 1, x.data(), fN, 0);
+  }
+  if (inverse)
+    for (auto& c : x)
+      c = std::conj(c);
+}
+
+// transform of n values of in with stride to out (decimation in time)
+void
+UF23FFT::Recurse(const Complex* const in, const std::size_t stride,
+                 Complex* const out, const std::size_t n,
+                 const unsigned int iFactor)
+  const
+{
+  if (n == 1) {
+    *out = *in;
+    return;
+  }
+  const std::size_t p = fFactors[iFactor];
+  const std::size_t m = n / p;
+  for (std::size_t r = 0; r < p; ++r)
+    Recurse(in + r * stride, stride * p, out + r * m, m, iFactor + 1);
+  // X_(k + q m) = sum_r w_n^(r k) w_p^(r q) Y_r,k
+  const std::size_t rootStride = fN / n;
+  Complex t[kMaxRadix];
+  for (std::size_t k = 0; k < m; ++k) {
+    t[0] = out[k];
+    for (std::size_t r = 1; r < p; ++r)
+      t[r] = Multiply(out[r * m + k], fRoots[r * k * rootStride]);
+    if (p == 2) {
+      out[k] = t[0] + t[1];
+      out[k + m] = t[0] - t[1];
+    }
+    else if (p == 4) {
+      // w_4 = -i
+      const Complex a = t[0] + t[2];
+      const Complex b = t[0] - t[2];
+      const Complex c = t[1] + t[3];
+      const Complex d = t[1] - t[3];
+      const Complex minusID(d.imag(), -d.real());
+      out[k] = a + c;
+      out[k + m] = b + minusID;
+      out[k + 2 * m] = a - c;
+      out[k + 3 * m] = b - minusID;
+    }
+    else {
+      for (std::size_t q = 0; q < p; ++q) {
+        Complex sum = t[0];
+        std::size_t rq = 0;
+        for (std::size_t r = 1; r < p; ++r) {
+          rq += q;
+          if (rq >= p)
+            rq -= p;
+          sum += Multiply(t[r], fRoots[rq * m * rootStride]);
+        }
+        out[k + q * m] = sum;
+      }
+    }
+  }
+}
+
+void
+UF23FFT::CosineTransform(std::vector<double>& a, const std::size_t nOuter,
+                         const unsigned int n, const std::size_t nInner,
+                         const bool inverse)
+{
+  if (a.size() < nOuter * n * nInner)
+    throw std::runtime_error("UF23FFT: array too small");
+  const UF23FFT fft(n);
+  // exp(-i pi p / (2n))
+  std::vector<Complex> shift(n);
+  for (unsigned int p = 0; p < n; ++p)
+    shift[p] = std::polar(1., -utl::kPi * p / (2 * n));
+  // even elements in the first half, odd ones reversed in the second
+  std::vector<unsigned int> order(n);
+  for (unsigned int q = 0; q < n; ++q)
+    order[q] = q % 2 ? n - 1 - q / 2 : q / 2;
+
+  std::vector<Complex> z(n);
+  for (std::size_t o = 0; o < nOuter; ++o) {
+    for (std::size_t i = 0; i < nInner; i += 2) {
+      // lines i and i+1 as real and imaginary part
+      double* const line0 = &a[o * n * nInner + i];
+      double* const line1 = i + 1 < nInner ? line0 + 1 : nullptr;
+      if (!inverse) {
+        for (unsigned int q = 0; q < n; ++q)
+          z[order[q]] = Complex(line0[q * nInner],
+                                line1 ? line1[q * nInner] : 0.);
+        fft.Transform(z, false);
+        for (unsigned int p = 0; p < n; ++p) {
+          const Complex zp = z[p];
+          const Complex zm = std::conj(z[p ? n - p : 0]);
+          line0[p * nInner] = Multiply(shift[p], zp + zm).real() / 2;
+          if (line1)
+            line1[p * nInner] = Multiply(shift[p], zp - zm).imag() / 2;
+        }
+      }
+      else {
+        for (unsigned int p = 0; p < n; ++p) {
+          // spectra exp(i pi p / (2n)) (x_p - i x_(n-p)) of the lines
+          // as real and imaginary part
+          const double x0 = line0[p * nInner];
+          const double xm0 = p ? line0[(n - p) * nInner] : 0.;
+          const double x1 = line1 ? line1[p * nInner] : 0.;
+          const double xm1 = line1 && p ? line1[(n - p) * nInner] : 0.;
+          z[p] = Multiply(std::conj(shift[p]), Complex(x0 + xm1, x1 - xm0));
+        }
+        fft.Transform(z, true);
+        for (unsigned int q = 0; q < n; ++q) {
+          line0[q * nInner] = std::real(z[order[q]]) / n;
+          if (line1)
+            line1[q * nInner] = std::imag(z[order[q]]) / n;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef _UF23FFT_h_
+#define _UF23FFT_h_
+/**
+ @class UF23FFT
+ @brief discrete Fourier and cosine transforms of arbitrary length
+
+ Fourier transform X_k = sum_j x_j exp(-2 pi i j k / n) of length n,
+ mixed radix (Cooley-Tukey) for prime factors up to 16 and Bluestein's
+ algorithm (convolution with a chirp of power-of-two length)
+ otherwise, i.e. O(n log n) for all n. Used by UF23FieldGrid for the
+ cosine transforms of the Poisson projection of the divergence-free
+ interpolation, see Test/testUF23FFT.cxx for the comparison to the
+ O(n^2) definitions.
+
+ */
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class UF23FFT {
+public:
+  typedef std::complex<double> Complex;
+
+  /// transform of length n > 0
+  explicit UF23FFT(const std::size_t n);
+  UF23FFT() = delete;
+
+  std::size_t GetSize() const { return fN; }
+
+  /**
+     @brief Fourier transform in place
+     @param x n complex values
+     @param inverse if true, exp(+2 pi i j k / n) (not divided by n)
+  */
+  void Transform(std::vector<Complex>& x, const bool inverse) const;
+
+  /**
+     @brief cosine transform along the middle dimension of an array
+     @param a array a[nOuter][n][nInner]
+     @param nOuter,n,nInner dimensions of a
+     @param inverse if false, a_p = sum_q cos(pi p (q + 1/2) / n) a_q
+            (DCT-II), else its inverse a_q = sum_p w_p cos(pi p (q +
+            1/2) / n) a_p with w_0 = 1/n and w_p = 2/n
+
+     Both with one Fourier transform of length n for two lines
+     (Makhoul 1980, IEEE Trans. ASSP 28, 27).
+  */
+  static void CosineTransform(std::vector<double>& a,
+                              const std::size_t nOuter,
+                              const unsigned int n,
+                              const std::size_t nInner,
+                              const bool inverse);
+
+private:
+  void Recurse(const Complex* const in, const std::size_t stride,
+               Complex* const out, const std::size_t n,
+               const unsigned int iFactor) const;
+
+  static const std::size_t kMaxRadix = 16;
+  std::size_t fN;
+  std::vector<std::size_t> fFactors;
+  std::vector<Complex> fRoots;
+  // Bluestein's algorithm
+  std::unique_ptr<const UF23FFT> fConvolution;
+  std::vector<Complex> fChirp;
+  std::vector<Complex> fChirpSpectrum;
+};
+#endif
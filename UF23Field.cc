@@ -1,9 +1,25 @@
 #include "UF23Field.h"
+#include "UF23Units.h"
+#include "UF23Dual.h"
+#include "UF23Anchored.h"
 
+#include <algorithm>
+#include <atomic>
 #include <exception>
 #include <limits>
 #include <string>
 #include <cmath>
+#include <type_traits>
+#ifdef UF23_INSTRUMENTATION
+# if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+# else
+#  include <chrono>
+# endif
+#endif
+
+static_assert(std::is_trivially_copyable<UF23Field>::value,
+              "UF23Field must be trivially copyable");
 
 // local helper functions and constants
 namespace utl {
@@ -16,42 +32,90 @@ namespace utl {
                    v[2]);
   }
 
-  template<typename T>
-  Vector3 CartToCyl(const T v, const double cosPhi, const double sinPhi)
+  // logistic sigmoid function, invW = 1/width
+  template<typename T, typename U, typename V>
+  inline
+  T
+  Sigmoid(const T x, const U x0, const V invW)
   {
-    return Vector3(v[0] * cosPhi + v[1] * sinPhi,
-                   -v[0] * sinPhi + v[1] * cosPhi,
-                   v[2]);
+    return 1 / (1 + exp(-(x-x0)*invW));
   }
 
-  // logistic sigmoid function
+  // angle between v0 = (cos(phi0), sin(phi0)) and v1 = (cos(phi1), sin(phi1)),
+  // i.e. |phi1 - phi0| reduced to [0, pi]
+  template<typename U, typename T>
   inline
-  double
-  Sigmoid(const double x, const double x0, const double w)
+  T
+  DeltaPhi(const U phi0, const T phi1)
   {
-    return 1 / (1 + exp(-(x-x0)/w));
+    const T d = phi1 - phi0;
+    return fabs(d - kTwoPi * std::round(Value(d) / kTwoPi));
   }
 
-  // angle between v0 = (cos(phi0), sin(phi0)) and v1 = (cos(phi1), sin(phi1))
+  // units of the parameters of GetParameters() (see below)
+  extern const std::vector<double> unitConv;
+}
+
+// counters of the instrumentation, relaxed atomic increments can be
+// aggregated from any number of threads
+namespace {
+  struct AtomicCounters {
+    std::atomic<unsigned long long> fCalls;
+    std::atomic<unsigned long long> fEarlyExits;
+    std::atomic<unsigned long long> fTicks;
+  };
+  AtomicCounters gCounters[UF23Field::eNComponents];
+
+#ifdef UF23_INSTRUMENTATION
   inline
-  double
-  DeltaPhi(const double phi0, const double phi1)
+  unsigned long long
+  GetTicks()
   {
-    return acos(cos(phi1)*cos(phi0) + sin(phi1)*sin(phi0));
+# if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+# else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+      (std::chrono::steady_clock::now().time_since_epoch()).count();
+# endif
   }
 
-  const double kPi = 3.1415926535897932384626;
-  const double kTwoPi = 2*kPi;
-  const double degree = kPi/180.;
-  const double kpc = 1;
-  const double microgauss = 1;
-  const double megayear = 1;
-  const double Gpc = 1e6*kpc;
-  const double pc = 1e-3*kpc;
-  const double second  = megayear / (1e6*60*60*24*365.25);
-  const double kilometer = kpc / 3.0856775807e+16;
+  // counts n calls and the ticks until the end of the scope, unless
+  // discarded before
+  class InstrumentationScope {
+  public:
+    explicit InstrumentationScope(const UF23Field::EComponent c,
+                                  const unsigned long long n = 1) :
+      fCounters(gCounters[c]), fN(n), fStart(GetTicks()) {}
+    ~InstrumentationScope()
+    {
+      if (!fN)
+        return;
+      fCounters.fCalls.fetch_add(fN, std::memory_order_relaxed);
+      fCounters.fTicks.fetch_add(GetTicks() - fStart,
+                                 std::memory_order_relaxed);
+    }
+    void Discard() { fN = 0; }
+  private:
+    AtomicCounters& fCounters;
+    unsigned long long fN;
+    const unsigned long long fStart;
+  };
+#endif
 }
 
+#ifdef UF23_INSTRUMENTATION
+# define UF23_INSTRUMENT(c) InstrumentationScope uf23Scope(UF23Field::c)
+# define UF23_INSTRUMENT_N(c, n) InstrumentationScope uf23Scope(UF23Field::c, n)
+# define UF23_INSTRUMENT_DISCARD() uf23Scope.Discard()
+# define UF23_EARLY_EXIT(c)                                             \
+  gCounters[UF23Field::c].fEarlyExits.fetch_add(1, std::memory_order_relaxed)
+#else
+# define UF23_INSTRUMENT(c)
+# define UF23_INSTRUMENT_N(c, n)
+# define UF23_INSTRUMENT_DISCARD() ((void) 0)
+# define UF23_EARLY_EXIT(c) ((void) 0)
+#endif
+
 // initialization of static members
 const std::map<UF23Field::ModelType, std::string> UF23Field::fModelNames =
   { {base, "base"},
@@ -65,6 +129,130 @@ const std::map<UF23Field::ModelType, std::string> UF23Field::fModelNames =
   };
 
 
+double UF23Field::* const UF23Field::fParameterPointers[UF23Field::eNpar] =
+  {
+   &UF23Field::fDiskB1,       //eDiskB1
+   &UF23Field::fDiskB2,       //eDiskB2
+   &UF23Field::fDiskB3,       //eDiskB3
+   &UF23Field::fDiskH,        //eDiskH
+   &UF23Field::fDiskPhase1,   //eDiskPhase1
+   &UF23Field::fDiskPhase2,   //eDiskPhase2
+   &UF23Field::fDiskPhase3,   //eDiskPhase3
+   &UF23Field::fDiskPitch,    //eDiskPitch
+   &UF23Field::fDiskW,        //eDiskW
+   &UF23Field::fPoloidalA,    //ePoloidalA
+   &UF23Field::fPoloidalB,    //ePoloidalB
+   &UF23Field::fPoloidalP,    //ePoloidalP
+   &UF23Field::fPoloidalR,    //ePoloidalR
+   &UF23Field::fPoloidalW,    //ePoloidalW
+   &UF23Field::fPoloidalZ,    //ePoloidalZ
+   &UF23Field::fPoloidalXi,   //ePoloidalXi
+   &UF23Field::fSpurCenter,   //eSpurCenter
+   &UF23Field::fSpurLength,   //eSpurLength
+   &UF23Field::fSpurWidth,    //eSpurWidth
+   &UF23Field::fStriation,    //eStriation
+   &UF23Field::fToroidalBN,   //eToroidalBN
+   &UF23Field::fToroidalBS,   //eToroidalBS
+   &UF23Field::fToroidalR,    //eToroidalR
+   &UF23Field::fToroidalW,    //eToroidalW
+   &UF23Field::fToroidalZ,    //eToroidalZ
+   &UF23Field::fTwistingTime //eTwistingTime
+  };
+
+/*
+  Copy of the model parameters and derived parameters with the member
+  names of UF23Field, i.e. it can be passed as parameters p to the
+  component functions. With dual numbers as T, the field components
+  are differentiated with respect to the parameters.
+*/
+template<typename T>
+struct UF23Field::ParameterSet {
+  explicit ParameterSet(const UF23Field& field)
+  {
+    for (unsigned int i = 0; i < eNpar; ++i)
+      this->*fParameterPointers[i] = field.*UF23Field::fParameterPointers[i];
+    CalculateDerivedParameters(*this);
+  }
+
+  T fDiskB1;
+  T fDiskB2;
+  T fDiskB3;
+  T fDiskH;
+  T fDiskPhase1;
+  T fDiskPhase2;
+  T fDiskPhase3;
+  T fDiskPitch;
+  T fDiskW;
+  T fPoloidalA;
+  T fPoloidalB;
+  T fPoloidalP;
+  T fPoloidalR;
+  T fPoloidalW;
+  T fPoloidalZ;
+  T fPoloidalXi;
+  T fSpurCenter;
+  T fSpurLength;
+  T fSpurWidth;
+  T fStriation;
+  T fToroidalBN;
+  T fToroidalBS;
+  T fToroidalR;
+  T fToroidalW;
+  T fToroidalZ;
+  T fTwistingTime;
+  static T ParameterSet::* const fParameterPointers[eNpar];
+
+  T fSinPitch;
+  T fCosPitch;
+  T fTanPitch;
+  T fInvTanPitch;
+  T fCosDiskPhase[3];
+  T fSinDiskPhase[3];
+  T fInvDiskW;
+  T fInvSpurWidth;
+  T fInvToroidalW;
+  T fInvToroidalZ;
+  T fInvPoloidalR;
+  T fInvPoloidalW;
+  T fPoloidalC;
+  T fPoloidalA0p;
+  T fInvPoloidalP;
+  T fPoloidalPMinus1;
+  T fPoloidalPMinus2;
+};
+
+template<typename T>
+T UF23Field::ParameterSet<T>::* const
+UF23Field::ParameterSet<T>::fParameterPointers[UF23Field::eNpar] =
+  {
+   &UF23Field::ParameterSet<T>::fDiskB1,
+   &UF23Field::ParameterSet<T>::fDiskB2,
+   &UF23Field::ParameterSet<T>::fDiskB3,
+   &UF23Field::ParameterSet<T>::fDiskH,
+   &UF23Field::ParameterSet<T>::fDiskPhase1,
+   &UF23Field::ParameterSet<T>::fDiskPhase2,
+   &UF23Field::ParameterSet<T>::fDiskPhase3,
+   &UF23Field::ParameterSet<T>::fDiskPitch,
+   &UF23Field::ParameterSet<T>::fDiskW,
+   &UF23Field::ParameterSet<T>::fPoloidalA,
+   &UF23Field::ParameterSet<T>::fPoloidalB,
+   &UF23Field::ParameterSet<T>::fPoloidalP,
+   &UF23Field::ParameterSet<T>::fPoloidalR,
+   &UF23Field::ParameterSet<T>::fPoloidalW,
+   &UF23Field::ParameterSet<T>::fPoloidalZ,
+   &UF23Field::ParameterSet<T>::fPoloidalXi,
+   &UF23Field::ParameterSet<T>::fSpurCenter,
+   &UF23Field::ParameterSet<T>::fSpurLength,
+   &UF23Field::ParameterSet<T>::fSpurWidth,
+   &UF23Field::ParameterSet<T>::fStriation,
+   &UF23Field::ParameterSet<T>::fToroidalBN,
+   &UF23Field::ParameterSet<T>::fToroidalBS,
+   &UF23Field::ParameterSet<T>::fToroidalR,
+   &UF23Field::ParameterSet<T>::fToroidalW,
+   &UF23Field::ParameterSet<T>::fToroidalZ,
+   &UF23Field::ParameterSet<T>::fTwistingTime
+  };
+
 UF23Field::UF23Field(const ModelType mt, const double maxRadiusInKpc) :
   fModelType(mt),
   fMaxRadiusSquared(pow(maxRadiusInKpc*utl::kpc, 2))
@@ -270,10 +458,136 @@ UF23Field::UF23Field(const ModelType mt, const double maxRadiusInKpc) :
   }
   }
 
-  fSinPitch = sin(fDiskPitch);
-  fCosPitch = cos(fDiskPitch);
-  fTanPitch = tan(fDiskPitch);
+  UpdateDerivedParameters();
+}
+
+void
+UF23Field::UpdateDerivedParameters()
+{
+  CalculateDerivedParameters(*this);
+  UpdateCutoffs();
+}
+
+namespace {
+  /*
+    cutoffs of the envelopes of the transitions a (1 - Sigmoid(x, x0, 1/w))
+    < a exp(-(x - x0)/w) and a Sigmoid(x, x0, 1/w) < a exp((x - x0)/w),
+    i.e. x above (below) which they are smaller than t (no cutoff for t = 0)
+  */
+  double
+  GetUpperCutoff(const double a, const double x0, const double w,
+                 const double t)
+  {
+    return t > 0 ? x0 + w * std::log(a / t) :
+      std::numeric_limits<double>::infinity();
+  }
+
+  double
+  GetLowerCutoff(const double a, const double x0, const double w,
+                 const double t)
+  {
+    return t > 0 ? x0 - w * std::log(a / t) :
+      -std::numeric_limits<double>::infinity();
+  }
+
+  // squared cutoff radius, -1 if all radii are beyond the cutoff
+  double
+  Squared(const double r)
+  {
+    return r < 0 ? -1 : r*r;
+  }
+}
 
+void
+UF23Field::UpdateCutoffs()
+{
+  using namespace utl;
+  const double inf = std::numeric_limits<double>::infinity();
+  // at most two components are skipped (disk and toroidal halo)
+  const double t = fTolerance * microgauss / 2;
+
+  // -- disk, upper bound without the vertical transition of Eq. (13)
+  double bDisk = 0;
+  if (fModelType == spur) {
+    // see AddSpurField(), the spur is only evaluated if r is closer
+    // to the arm i = 0 than to the adjacent ones, i.e. r > rMin
+    const double rRef = 8.2*kpc;
+    const double wS = 5*degree;
+    const double absTan = std::abs(fTanPitch);
+    const double maxDeltaPhi =
+      std::max(std::abs(fDiskPhase1), std::abs(kTwoPi - fDiskPhase1));
+    const double rMin = rRef * std::exp(-maxDeltaPhi * absTan) *
+      (1 + std::exp(-kTwoPi * absTan)) / 2;
+    bDisk = std::abs(fDiskB1) * rRef / rMin;
+    fSpurCutoffPhi = GetUpperCutoff(bDisk, fSpurLength, wS, t);
+    fSpiralCutoffR2Inner = -inf;
+    fSpiralCutoffR2Outer = inf;
+  }
+  else {
+    // see AddSpiralField(), with (1 - exp(-r^2)) / r < 0.639
+    const double rRef = 5*kpc;
+    const double rInner = 5*kpc;
+    const double wInner = 0.5*kpc;
+    const double rOuter = 20*kpc;
+    const double wOuter = 0.5*kpc;
+    const double b =
+      std::abs(fDiskB1) + std::abs(fDiskB2) + std::abs(fDiskB3);
+    bDisk = b * rRef * 0.639;
+    fSpiralCutoffR2Inner =
+      Squared(GetLowerCutoff(bDisk, rInner, wInner, t));
+    // rRef / r < rRef / rOuter beyond the outer transition
+    fSpiralCutoffR2Outer =
+      Squared(std::max(rOuter,
+                       GetUpperCutoff(b * rRef / rOuter, rOuter, wOuter, t)));
+    fSpurCutoffPhi = inf;
+  }
+  fDiskCutoffZ = GetUpperCutoff(bDisk, fDiskH, fDiskW, t);
+
+  // -- toroidal halo, Eq. (21)
+  const double b0 = std::max(std::abs(fToroidalBN), std::abs(fToroidalBS));
+  fToroidalCutoffR2 =
+    Squared(GetUpperCutoff(b0, fToroidalR, fToroidalW, t));
+  fToroidalCutoffZ = GetUpperCutoff(b0, 0, fToroidalZ, t);
+  fToroidalCutoffZInner = GetLowerCutoff(b0, fDiskH, fDiskW, t);
+}
+
+void
+UF23Field::SetTolerance(const double toleranceInMicrogauss)
+{
+  if (!(toleranceInMicrogauss >= 0))
+    throw std::runtime_error("UF23Field: invalid tolerance");
+  fTolerance = toleranceInMicrogauss;
+  UpdateCutoffs();
+}
+
+template<typename P>
+void
+UF23Field::CalculateDerivedParameters(P& p)
+{
+  p.fSinPitch = sin(p.fDiskPitch);
+  p.fCosPitch = cos(p.fDiskPitch);
+  p.fTanPitch = tan(p.fDiskPitch);
+  p.fInvTanPitch = 1 / p.fTanPitch;
+
+  typedef decltype(p.fDiskPhase1) T;
+  const T phases[3] = {p.fDiskPhase1, p.fDiskPhase2, p.fDiskPhase3};
+  for (unsigned int i = 0; i < 3; ++i) {
+    p.fCosDiskPhase[i] = cos((i+1) * phases[i]);
+    p.fSinDiskPhase[i] = sin((i+1) * phases[i]);
+  }
+
+  p.fInvDiskW = 1 / p.fDiskW;
+  p.fInvSpurWidth = 1 / p.fSpurWidth;
+  p.fInvToroidalW = 1 / p.fToroidalW;
+  p.fInvToroidalZ = 1 / p.fToroidalZ;
+  p.fInvPoloidalR = 1 / p.fPoloidalR;
+  p.fInvPoloidalW = 1 / p.fPoloidalW;
+
+  p.fPoloidalC = pow(p.fPoloidalA/p.fPoloidalZ, p.fPoloidalP);
+  p.fPoloidalA0p = pow(p.fPoloidalA, p.fPoloidalP);
+  p.fInvPoloidalP = 1 / p.fPoloidalP;
+  p.fPoloidalPMinus1 = p.fPoloidalP - 1;
+  p.fPoloidalPMinus2 = p.fPoloidalP - 2;
 }
 
 Vector3
@@ -281,57 +595,462 @@ UF23Field::operator()(const Vector3& posInKpc)
   const
 {
   const auto pos = posInKpc * utl::kpc;
-  if (pos.SquaredLength() > fMaxRadiusSquared)
+  switch (fModelType) {
+  case spur:
+    return EvaluateKernel<true, false, false>(pos.x, pos.y, pos.z);
+  case twistX:
+    return EvaluateKernel<false, true, false>(pos.x, pos.y, pos.z);
+  case expX:
+    return EvaluateKernel<false, false, true>(pos.x, pos.y, pos.z);
+  default:
+    return EvaluateKernel<false, false, false>(pos.x, pos.y, pos.z);
+  }
+}
+
+template<bool isSpur, bool isTwistX, bool isExpX>
+Vector3
+UF23Field::EvaluateKernel(const double x, const double y, const double z)
+  const
+{
+  UF23_INSTRUMENT(eEvaluation);
+  if (x*x + y*y + z*z > fMaxRadiusSquared) {
+    UF23_EARLY_EXIT(eEvaluation);
     return Vector3(0, 0, 0);
-  else {
-    const auto diskField = GetDiskField(pos);
-    const auto haloField = GetHaloField(pos);
-    return (diskField + haloField) / utl::microgauss;
   }
+
+  // components above the cutoffs of SetTolerance()
+  if (fTolerance > 0)
+    return EvaluateSignificantComponents<isSpur, isTwistX, isExpX>(x, y, z);
+
+  // single pass over all components sharing the cylindrical
+  // coordinates, accumulating (B_r, B_phi, B_z)
+  const Cylindrical c = GetCylindrical(*this, x, y, z);
+  double bCyl[3] = { 0, 0, 0 };
+  AddFieldComponents<isSpur, isTwistX, isExpX>(*this, c, bCyl);
+  return utl::CylToCart(bCyl, c.fCosPhi, c.fSinPhi) / utl::microgauss;
 }
 
+template<bool isSpur, bool isTwistX, bool isExpX>
 Vector3
-UF23Field::GetDiskField(const Vector3& pos)
+UF23Field::EvaluateSignificantComponents(const double x, const double y,
+                                         const double z)
+  const
+{
+  // as GetCylindrical(), but the azimuth and the disk transition only
+  // if needed
+  Cylindrical c;
+  c.fR2 = x*x + y*y;
+  c.fR = std::sqrt(c.fR2);
+  const bool offAxis = c.fR > std::numeric_limits<double>::min();
+  c.fCosPhi = offAxis ? x / c.fR : 1;
+  c.fSinPhi = offAxis ? y / c.fR : 0;
+  c.fZ = z;
+  c.fAbsZ = std::abs(z);
+  const bool isDisk = isSpur ? c.fAbsZ <= fDiskCutoffZ :
+    !IsSpiralFieldNegligible(c.fR2, c.fAbsZ);
+  const bool isToroidal =
+    !isTwistX && !IsToroidalHaloFieldNegligible(c.fR2, c.fAbsZ);
+  c.fPhi = isDisk ? std::atan2(y, x) : 0;
+  c.fDiskSigmoid = isDisk || isToroidal ?
+    utl::Sigmoid(c.fAbsZ, fDiskH, fInvDiskW) : 0;
+
+  // same order of the components as in AddFieldComponents()
+  double bCyl[3] = { 0, 0, 0 };
+  if (isSpur) {
+    if (isDisk && !IsSpurFieldNegligible(c))
+      AddSpurField(*this, c, bCyl);
+  }
+  else if (isDisk)
+    AddSpiralField(*this, c, bCyl);
+  if (isTwistX)
+    AddTwistedHaloField(*this, c, bCyl);
+  else {
+    if (isToroidal)
+      AddToroidalHaloField(*this, c, bCyl);
+    AddPoloidalHaloField<isExpX>(*this, c, bCyl);
+  }
+  return utl::CylToCart(bCyl, c.fCosPhi, c.fSinPhi) / utl::microgauss;
+}
+
+bool
+UF23Field::IsSpurFieldNegligible(const Cylindrical& c)
   const
 {
-  if (fModelType == spur)
-    return GetSpurField(pos.x, pos.y, pos.z);
+  return c.fAbsZ > fDiskCutoffZ ||
+    utl::DeltaPhi(fSpurCenter, c.fPhi) > fSpurCutoffPhi;
+}
+
+template<bool isSpur, bool isTwistX, bool isExpX, typename T, typename P>
+void
+UF23Field::AddFieldComponents(const P& p, const CylindricalT<T>& c, T bCyl[3])
+{
+  if (isSpur)
+    AddSpurField(p, c, bCyl);
   else
-    return GetSpiralField(pos.x, pos.y, pos.z);
+    AddSpiralField(p, c, bCyl);
+  if (isTwistX)
+    AddTwistedHaloField(p, c, bCyl);
+  else {
+    AddToroidalHaloField(p, c, bCyl);
+    AddPoloidalHaloField<isExpX>(p, c, bCyl);
+  }
 }
 
+// kernels of all model types (used by UF23FieldT)
+template Vector3
+UF23Field::EvaluateKernel<false, false, false>(double, double, double) const;
+template Vector3
+UF23Field::EvaluateKernel<true, false, false>(double, double, double) const;
+template Vector3
+UF23Field::EvaluateKernel<false, true, false>(double, double, double) const;
+template Vector3
+UF23Field::EvaluateKernel<false, false, true>(double, double, double) const;
 
 Vector3
-UF23Field::GetHaloField(const Vector3& pos)
+UF23Field::EvaluateWithJacobian(const Vector3& posInKpc, Matrix3& jacobian)
   const
 {
-  if (fModelType == twistX)
-    return GetTwistedHaloField(pos.x, pos.y, pos.z);
-  else
-    return
-      GetToroidalHaloField(pos.x, pos.y, pos.z) +
-      GetPoloidalHaloField(pos.x, pos.y, pos.z);
+  switch (fModelType) {
+  case spur:
+    return EvaluateJacobianKernel<true, false, false>(posInKpc, jacobian);
+  case twistX:
+    return EvaluateJacobianKernel<false, true, false>(posInKpc, jacobian);
+  case expX:
+    return EvaluateJacobianKernel<false, false, true>(posInKpc, jacobian);
+  default:
+    return EvaluateJacobianKernel<false, false, false>(posInKpc, jacobian);
+  }
 }
 
+void
+UF23Field::EvaluateWithJacobian(const std::vector<Vector3>& posInKpc,
+                                std::vector<Vector3>& fieldInMicrogauss,
+                                std::vector<Matrix3>& jacobian)
+  const
+{
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(n);
+  jacobian.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    fieldInMicrogauss[i] = EvaluateWithJacobian(posInKpc[i], jacobian[i]);
+}
 
+template<bool isSpur, bool isTwistX, bool isExpX>
 Vector3
-UF23Field::GetTwistedHaloField(const double x, const double y, const double z)
+UF23Field::EvaluateJacobianKernel(const Vector3& posInKpc, Matrix3& jacobian)
+  const
+{
+  for (auto& row : jacobian)
+    row.fill(0);
+  const Vector3 pos = posInKpc * utl::kpc;
+  if (pos.SquaredLength() > fMaxRadiusSquared)
+    return Vector3(0, 0, 0);
+
+  // position as independent variables, derivatives with respect to kpc
+  typedef utl::ad::Dual<3> Dual;
+  const Dual x = Dual::Variable(pos.x, 0, utl::kpc);
+  const Dual y = Dual::Variable(pos.y, 1, utl::kpc);
+  const Dual z = Dual::Variable(pos.z, 2, utl::kpc);
+
+  const CylindricalT<Dual> c = GetCylindrical(*this, x, y, z);
+  Dual bCyl[3] = { 0, 0, 0 };
+  AddFieldComponents<isSpur, isTwistX, isExpX>(*this, c, bCyl);
+  const Dual b[3] = {
+    bCyl[0] * c.fCosPhi - bCyl[1] * c.fSinPhi,
+    bCyl[0] * c.fSinPhi + bCyl[1] * c.fCosPhi,
+    bCyl[2]
+  };
+  for (unsigned int i = 0; i < 3; ++i)
+    for (unsigned int j = 0; j < 3; ++j)
+      jacobian[i][j] = b[i].GetDerivative(j) / utl::microgauss;
+  return Vector3(b[0].GetValue(), b[1].GetValue(), b[2].GetValue()) /
+    utl::microgauss;
+}
+
+Vector3
+UF23Field::EvaluateWithParameterGradient(const Vector3& posInKpc,
+                                         ParameterGradient& gradient)
+  const
+{
+  Vector3 fieldInMicrogauss;
+  EvaluateParameterGradient(&posInKpc, &fieldInMicrogauss, &gradient, 1);
+  return fieldInMicrogauss;
+}
+
+void
+UF23Field::EvaluateWithParameterGradient(const std::vector<Vector3>& posInKpc,
+                                         std::vector<Vector3>& fieldInMicrogauss,
+                                         std::vector<ParameterGradient>& gradient)
+  const
+{
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(n);
+  gradient.resize(n);
+  EvaluateParameterGradient(posInKpc.data(), fieldInMicrogauss.data(),
+                            gradient.data(), n);
+}
+
+void
+UF23Field::EvaluateParameterGradient(const Vector3* posInKpc,
+                                     Vector3* fieldInMicrogauss,
+                                     ParameterGradient* gradient,
+                                     const std::size_t n)
+  const
+{
+  if (n == 0)
+    return;
+
+  // parameters as independent variables, derivatives with respect to
+  // the units of GetParameters()
+  typedef utl::ad::Dual<eNpar> Dual;
+  ParameterSet<Dual> p(*this);
+  for (unsigned int i = 0; i < eNpar; ++i)
+    p.*p.fParameterPointers[i] =
+      Dual::Variable(this->*fParameterPointers[i], i, utl::unitConv[i]);
+  // as in SetParameters()
+  if (fModelType == expX)
+    p.fPoloidalZ = p.fPoloidalA * tan(p.fPoloidalXi);
+  CalculateDerivedParameters(p);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (fModelType) {
+    case spur:
+      fieldInMicrogauss[i] =
+        EvaluateParameterGradientKernel<true, false, false>(p, posInKpc[i],
+                                                            gradient[i]);
+      break;
+    case twistX:
+      fieldInMicrogauss[i] =
+        EvaluateParameterGradientKernel<false, true, false>(p, posInKpc[i],
+                                                            gradient[i]);
+      break;
+    case expX:
+      fieldInMicrogauss[i] =
+        EvaluateParameterGradientKernel<false, false, true>(p, posInKpc[i],
+                                                            gradient[i]);
+      break;
+    default:
+      fieldInMicrogauss[i] =
+        EvaluateParameterGradientKernel<false, false, false>(p, posInKpc[i],
+                                                             gradient[i]);
+      break;
+    }
+  }
+}
+
+template<bool isSpur, bool isTwistX, bool isExpX, typename P>
+Vector3
+UF23Field::EvaluateParameterGradientKernel(const P& p,
+                                           const Vector3& posInKpc,
+                                           ParameterGradient& gradient)
+  const
+{
+  for (auto& row : gradient)
+    row.fill(0);
+  const Vector3 pos = posInKpc * utl::kpc;
+  if (pos.SquaredLength() > fMaxRadiusSquared)
+    return Vector3(0, 0, 0);
+
+  // position as constants
+  typedef decltype(p.fDiskB1) Dual;
+  const CylindricalT<Dual> c =
+    GetCylindrical(p, Dual(pos.x), Dual(pos.y), Dual(pos.z));
+  Dual bCyl[3] = { 0, 0, 0 };
+  AddFieldComponents<isSpur, isTwistX, isExpX>(p, c, bCyl);
+  const Dual b[3] = {
+    bCyl[0] * c.fCosPhi - bCyl[1] * c.fSinPhi,
+    bCyl[0] * c.fSinPhi + bCyl[1] * c.fCosPhi,
+    bCyl[2]
+  };
+  for (unsigned int i = 0; i < 3; ++i)
+    for (unsigned int k = 0; k < eNpar; ++k)
+      gradient[i][k] = b[i].GetDerivative(k) / utl::microgauss;
+  return Vector3(b[0].GetValue(), b[1].GetValue(), b[2].GetValue()) /
+    utl::microgauss;
+}
+
+void
+UF23Field::Evaluate(const double* x, const double* y, const double* z,
+                    double* bx, double* by, double* bz,
+                    const std::size_t n)
+  const
+{
+  EvaluateStrided(x, y, z, 1, bx, by, bz, 1, n);
+}
+
+void
+UF23Field::Evaluate(const double* x, const double* y, const double* z,
+                    const std::size_t inStride,
+                    double* bx, double* by, double* bz,
+                    const std::size_t outStride,
+                    const std::size_t n)
+  const
+{
+  EvaluateStrided(x, y, z, inStride, bx, by, bz, outStride, n);
+}
+
+void
+UF23Field::Evaluate(const std::vector<Vector3>& posInKpc,
+                    std::vector<Vector3>& fieldInMicrogauss)
+  const
+{
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(n);
+  if (n == 0)
+    return;
+  // Vector3 is a plain struct of three doubles, i.e. the components
+  // can be accessed directly with a stride of three
+  static_assert(sizeof(Vector3) == 3*sizeof(double),
+                "unexpected memory layout of Vector3");
+  const Vector3* const pos = posInKpc.data();
+  Vector3* const field = fieldInMicrogauss.data();
+  EvaluateStrided(&pos->x, &pos->y, &pos->z, 3,
+                  &field->x, &field->y, &field->z, 3, n);
+}
+
+std::vector<Vector3>
+UF23Field::Evaluate(const std::vector<Vector3>& posInKpc)
+  const
+{
+  std::vector<Vector3> fieldInMicrogauss;
+  Evaluate(posInKpc, fieldInMicrogauss);
+  return fieldInMicrogauss;
+}
+
+void
+UF23Field::Evaluate(const float* x, const float* y, const float* z,
+                    float* bx, float* by, float* bz,
+                    const std::size_t n)
+  const
+{
+  EvaluateStrided(x, y, z, 1, bx, by, bz, 1, n);
+}
+
+void
+UF23Field::Evaluate(const float* x, const float* y, const float* z,
+                    const std::size_t inStride,
+                    float* bx, float* by, float* bz,
+                    const std::size_t outStride,
+                    const std::size_t n)
+  const
+{
+  EvaluateStrided(x, y, z, inStride, bx, by, bz, outStride, n);
+}
+
+void
+UF23Field::Evaluate(const std::vector<Vector3f>& posInKpc,
+                    std::vector<Vector3f>& fieldInMicrogauss)
   const
 {
-  const double r = sqrt(x*x + y*y);
-  const double cosPhi = r > std::numeric_limits<double>::min() ? x / r : 1;
-  const double sinPhi = r > std::numeric_limits<double>::min() ? y / r : 0;
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(n);
+  if (n == 0)
+    return;
+  static_assert(sizeof(Vector3f) == 3*sizeof(float),
+                "unexpected memory layout of Vector3f");
+  const Vector3f* const pos = posInKpc.data();
+  Vector3f* const field = fieldInMicrogauss.data();
+  EvaluateStrided(&pos->x, &pos->y, &pos->z, 3,
+                  &field->x, &field->y, &field->z, 3, n);
+}
 
-  const Vector3 bXCart = GetPoloidalHaloField(x, y, z);
-  const double bXCartTmp[3] = {bXCart.x, bXCart.y, bXCart.z};
-  const Vector3 bXCyl = utl::CartToCyl(bXCartTmp, cosPhi, sinPhi);
+template<typename T>
+void
+UF23Field::EvaluateStrided(const T* x, const T* y, const T* z,
+                           const std::size_t inStride,
+                           T* bx, T* by, T* bz,
+                           const std::size_t outStride,
+                           const std::size_t n)
+  const
+{
+  if (fVectorization) {
+    UF23_INSTRUMENT_N(eVectorizedEvaluation, n);
+    if (EvaluateVectorized(x, y, z, inStride, bx, by, bz, outStride, n))
+      return;
+    // no vector extensions, counted by the scalar evaluation below
+    UF23_INSTRUMENT_DISCARD();
+  }
 
-  const double bZ = bXCyl.z;
-  const double bR = bXCyl.x;
+  // dispatch model type once per batch
+  switch (fModelType) {
+  case spur:
+    EvaluateBatch<true, false, false>(x, y, z, inStride,
+                                      bx, by, bz, outStride, n);
+    break;
+  case twistX:
+    EvaluateBatch<false, true, false>(x, y, z, inStride,
+                                      bx, by, bz, outStride, n);
+    break;
+  case expX:
+    EvaluateBatch<false, false, true>(x, y, z, inStride,
+                                      bx, by, bz, outStride, n);
+    break;
+  default:
+    EvaluateBatch<false, false, false>(x, y, z, inStride,
+                                       bx, by, bz, outStride, n);
+    break;
+  }
+}
 
-  double bPhi = 0;
+// used by UF23FieldSet
+template void
+UF23Field::EvaluateStrided(const double*, const double*, const double*,
+                           const std::size_t, double*, double*, double*,
+                           const std::size_t, const std::size_t) const;
 
-  if (fTwistingTime != 0 && r != 0) {
+template<bool isSpur, bool isTwistX, bool isExpX, typename T>
+void
+UF23Field::EvaluateBatch(const T* x, const T* y, const T* z,
+                         const std::size_t inStride,
+                         T* bx, T* by, T* bz,
+                         const std::size_t outStride,
+                         const std::size_t n)
+  const
+{
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::size_t iIn = i * inStride;
+    const std::size_t iOut = i * outStride;
+    const Vector3 b =
+      EvaluateKernel<isSpur, isTwistX, isExpX>(x[iIn] * utl::kpc,
+                                               y[iIn] * utl::kpc,
+                                               z[iIn] * utl::kpc);
+    bx[iOut] = b.x;
+    by[iOut] = b.y;
+    bz[iOut] = b.z;
+  }
+}
+
+template<typename T, typename P>
+UF23Field::CylindricalT<T>
+UF23Field::GetCylindrical(const P& p, const T x, const T y, const T z)
+{
+  UF23_INSTRUMENT(eCylindrical);
+  CylindricalT<T> c;
+  c.fR2 = x*x + y*y;
+  c.fR = sqrt(c.fR2);
+  const bool offAxis = c.fR > std::numeric_limits<double>::min();
+  c.fCosPhi = offAxis ? x / c.fR : 1;
+  c.fSinPhi = offAxis ? y / c.fR : 0;
+  c.fPhi = atan2(y, x);
+  c.fZ = z;
+  c.fAbsZ = fabs(z);
+  // Eq. (13), transition between disk and halo
+  c.fDiskSigmoid = utl::Sigmoid(c.fAbsZ, p.fDiskH, p.fInvDiskW);
+  return c;
+}
+
+template<typename T, typename P>
+void
+UF23Field::AddTwistedHaloField(const P& p, const CylindricalT<T>& c, T bCyl[3])
+{
+  UF23_INSTRUMENT(eTwistedHaloField);
+  T bR, bZ;
+  GetPoloidalHaloField<false>(p, c, bR, bZ);
+
+  T bPhi = 0;
+
+  const T r = c.fR;
+  if (p.fTwistingTime != 0 && r != 0) {
     // radial rotation curve parameters (fit to Reid et al 2014)
     const double v0 = -240 * utl::kilometer/utl::second;
     const double r0 = 1.6 * utl::kpc;
@@ -339,61 +1058,70 @@ UF23Field::GetTwistedHaloField(const double x, const double y, const double z)
     const double z0 = 10 * utl::kpc;
 
     // Eq.(43)
-    const double fr = 1 - exp(-r/r0);
+    const T fr = 1 - exp(-r/r0);
     // Eq.(44)
-    const double t0 = exp(2*std::abs(z)/z0);
-    const double gz = 2 / (1 + t0);
+    const T t0 = exp(2*c.fAbsZ/z0);
+    const T gz = 2 / (1 + t0);
 
     // Eq. (46)
-    const double signZ = z < 0 ? -1 : 1;
-    const double deltaZ =  -signZ * v0 * fr / z0  * t0 * pow(gz, 2);
+    const double signZ = c.fZ < 0 ? -1 : 1;
+    const T deltaZ =  -signZ * v0 * fr / z0  * t0 * pow(gz, 2);
     // Eq. (47)
-    const double deltaR = v0 * ((1-fr)/r0 - fr/r) * gz;
+    const T deltaR = v0 * ((1-fr)/r0 - fr/r) * gz;
 
     // Eq.(45)
-    bPhi = (bZ * deltaZ + bR * deltaR) * fTwistingTime;
+    bPhi = (bZ * deltaZ + bR * deltaR) * p.fTwistingTime;
 
   }
-  const double bCylX[3] = {bR, bPhi , bZ};
-  return utl::CylToCart(bCylX, cosPhi, sinPhi);
+  else
+    UF23_EARLY_EXIT(eTwistedHaloField);
+  bCyl[0] += bR;
+  bCyl[1] += bPhi;
+  bCyl[2] += bZ;
 }
 
-Vector3
-UF23Field::GetToroidalHaloField(const double x, const double y, const double z)
-  const
+template<typename T, typename P>
+void
+UF23Field::AddToroidalHaloField(const P& p, const CylindricalT<T>& c,
+                                T bCyl[3])
 {
-  const double r2 = x*x + y*y;
-  const double r = sqrt(r2);
-  const double absZ = std::abs(z);
-
-  const double b0 = z >= 0 ? fToroidalBN : fToroidalBS;
-  const double rh = fToroidalR;
-  const double z0 = fToroidalZ;
-  const double fwh = fToroidalW;
-  const double sigmoidR = utl::Sigmoid(r, rh, fwh);
-  const double sigmoidZ = utl::Sigmoid(absZ, fDiskH, fDiskW);
+  UF23_INSTRUMENT(eToroidalHaloField);
+  const auto b0 = c.fZ >= 0 ? p.fToroidalBN : p.fToroidalBS;
+  const auto rh = p.fToroidalR;
+  const T sigmoidR = utl::Sigmoid(c.fR, rh, p.fInvToroidalW);
+  const T sigmoidZ = c.fDiskSigmoid;
 
   // Eq. (21)
-  const double bPhi = b0 * (1. - sigmoidR) * sigmoidZ * exp(-absZ/z0);
+  const T bPhi =
+    b0 * (1. - sigmoidR) * sigmoidZ * exp(-c.fAbsZ*p.fInvToroidalZ);
 
-  const double bCyl[3] = {0, bPhi, 0};
-  const double cosPhi = r > std::numeric_limits<double>::min() ? x / r : 1;
-  const double sinPhi = r > std::numeric_limits<double>::min() ? y / r : 0;
-  return utl::CylToCart(bCyl, cosPhi, sinPhi);
+  bCyl[1] += bPhi;
 }
 
-Vector3
-UF23Field::GetPoloidalHaloField(const double x, const double y, const double z)
-  const
+template<bool isExpX, typename T, typename P>
+void
+UF23Field::AddPoloidalHaloField(const P& p, const CylindricalT<T>& c,
+                                T bCyl[3])
+{
+  T bR, bZ;
+  GetPoloidalHaloField<isExpX>(p, c, bR, bZ);
+  bCyl[0] += bR;
+  bCyl[2] += bZ;
+}
+
+template<bool isExpX, typename T, typename P>
+void
+UF23Field::GetPoloidalHaloField(const P& p, const CylindricalT<T>& cyl,
+                                T& bR, T& bZ)
 {
-  const double r2 = x*x + y*y;
-  const double r = sqrt(r2);
+  UF23_INSTRUMENT(ePoloidalHaloField);
+  const T r = cyl.fR;
 
-  const double c = pow(fPoloidalA/fPoloidalZ, fPoloidalP);
-  const double a0p = pow(fPoloidalA, fPoloidalP);
-  const double rp = pow(r, fPoloidalP);
-  const double abszp = pow(std::abs(z), fPoloidalP);
-  const double cabszp = c*abszp;
+  const auto c = p.fPoloidalC;
+  const auto a0p = p.fPoloidalA0p;
+  const T rp = pow(r, p.fPoloidalP);
+  const T abszp = pow(cyl.fAbsZ, p.fPoloidalP);
+  const T cabszp = c*abszp;
 
   /*
     since $\sqrt{a^2 + b} - a$ is numerical unstable for $b\ll a$,
@@ -401,113 +1129,106 @@ UF23Field::GetPoloidalHaloField(const double x, const double y, const double z)
     + b} + a} = \frac{b}{\sqrt{a^2 + b} + a}$}
   */
 
-  const double t0 = a0p + cabszp - rp;
-  const double t1 = sqrt(pow(t0, 2) + 4*a0p*rp);
-  const double ap = 2*a0p*rp / (t1  + t0);
+  const T t0 = a0p + cabszp - rp;
+  const T t1 = sqrt(pow(t0, 2) + 4*a0p*rp);
+  const T ap = 2*a0p*rp / (t1  + t0);
 
-  double a = 0;
+  T a = 0;
   if (ap < 0) {
     if (r > std::numeric_limits<double>::min()) {
       // this should never happen
-      throw std::runtime_error("ap = " + std::to_string(ap));
+      throw std::runtime_error("ap = " + std::to_string(utl::Value(ap)));
     }
     else
       a = 0;
   }
   else
-    a = pow(ap, 1/fPoloidalP);
+    a = pow(ap, p.fInvPoloidalP);
 
   // Eq.(29) and Eq.(32)
-  const double radialDependence =
-    fModelType == expX ?
-    exp(-a/fPoloidalR) :
-    1 - utl::Sigmoid(a, fPoloidalR, fPoloidalW);
+  const T radialDependence =
+    isExpX ?
+    exp(-a*p.fInvPoloidalR) :
+    1 - utl::Sigmoid(a, p.fPoloidalR, p.fInvPoloidalW);
 
   // Eq.(28)
-  const double Bzz = fPoloidalB * radialDependence;
+  const T Bzz = p.fPoloidalB * radialDependence;
 
   // (r/a)
-  const double rOverA =  1 / pow(2*a0p / (t1  + t0), 1/fPoloidalP);
+  const T rOverA =  1 / pow(2*a0p / (t1  + t0), p.fInvPoloidalP);
 
   // Eq.(35) for p=n
-  const double signZ = z < 0 ? -1 : 1;
-  const double Br =
-    Bzz * c * a / rOverA * signZ * pow(std::abs(z), fPoloidalP - 1) / t1;
+  const double signZ = cyl.fZ < 0 ? -1 : 1;
+  const T Br =
+    Bzz * c * a / rOverA * signZ * pow(cyl.fAbsZ, p.fPoloidalPMinus1) / t1;
 
   // Eq.(36) for p=n
-  const double Bz = Bzz * pow(rOverA, fPoloidalP-2) * (ap + a0p) / t1;
-
-  if (r < std::numeric_limits<double>::min())
-    return Vector3(0, 0, Bz);
-  else {
-    const double bCylX[3] = {Br, 0 , Bz};
-    const double cosPhi =  x / r;
-    const double sinPhi =  y / r;
-    return utl::CylToCart(bCylX, cosPhi, sinPhi);
-  }
+  bZ = Bzz * pow(rOverA, p.fPoloidalPMinus2) * (ap + a0p) / t1;
+  // no radial component on the z-axis
+  bR = r < std::numeric_limits<double>::min() ? T(0) : Br;
 }
 
-Vector3
-UF23Field::GetSpurField(const double x, const double y, const double z)
-  const
+template<typename T, typename P>
+void
+UF23Field::AddSpurField(const P& p, const CylindricalT<T>& c, T bCyl[3])
 {
   // reference approximately at solar radius
   const double rRef = 8.2*utl::kpc;
 
-  // cylindrical coordinates
-  const double r2 = x*x + y*y;
-  const double r = sqrt(r2);
-  if (r < std::numeric_limits<double>::min())
-    return Vector3(0, 0, 0);
+  UF23_INSTRUMENT(eSpurField);
+  const T r = c.fR;
+  if (r < std::numeric_limits<double>::min()) {
+    UF23_EARLY_EXIT(eSpurField);
+    return;
+  }
 
-  double phi = atan2(y, x);
+  T phi = c.fPhi;
   if (phi < 0)
     phi += utl::kTwoPi;
 
-  const double phiRef = fDiskPhase1;
+  const auto phiRef = p.fDiskPhase1;
   int iBest = -2;
   double bestDist = -1;
   for (int i = -1; i <= 1; ++i) {
-    const double pphi = phi - phiRef + i*utl::kTwoPi;
-    const double rr = rRef*exp(pphi * fTanPitch);
-    if (bestDist < 0 || std::abs(r-rr) < bestDist) {
-      bestDist =  std::abs(r-rr);
+    // (T instead of double for the anchored exp of UF23FieldCursor)
+    const T pphi = phi - phiRef + i*utl::kTwoPi;
+    const double rr = rRef*utl::Value(exp(pphi * p.fTanPitch));
+    const double dist = std::abs(utl::Value(r) - rr);
+    if (bestDist < 0 || dist < bestDist) {
+      bestDist = dist;
       iBest = i;
     }
   }
   if (iBest == 0) {
-    const double phi0 = phi - log(r/rRef) / fTanPitch;
+    const T phi0 = phi - log(r/rRef) * p.fInvTanPitch;
 
     // Eq. (16)
-    const double deltaPhi0 = utl::DeltaPhi(phiRef, phi0);
-    const double delta = deltaPhi0 / fSpurWidth;
-    const double B = fDiskB1 * exp(-0.5*pow(delta, 2));
+    const T deltaPhi0 = utl::DeltaPhi(phiRef, phi0);
+    const T delta = deltaPhi0 * p.fInvSpurWidth;
+    const T B = p.fDiskB1 * exp(-0.5*pow(delta, 2));
 
     // Eq. (18)
     const double wS = 5*utl::degree;
-    const double phiC = fSpurCenter;
-    const double deltaPhiC = utl::DeltaPhi(phiC, phi);
-    const double lC = fSpurLength;
-    const double gS = 1 - utl::Sigmoid(std::abs(deltaPhiC), lC, wS);
+    const auto phiC = p.fSpurCenter;
+    const T deltaPhiC = utl::DeltaPhi(phiC, phi);
+    const auto lC = p.fSpurLength;
+    const T gS = 1 - utl::Sigmoid(fabs(deltaPhiC), lC, 1/wS);
 
     // Eq. (13)
-    const double hd = 1 - utl::Sigmoid(std::abs(z), fDiskH, fDiskW);
+    const T hd = 1 - c.fDiskSigmoid;
 
     // Eq. (17)
-    const double bS = rRef/r * B * hd * gS;
-    const double bCyl[3] = {bS * fSinPitch, bS * fCosPitch, 0};
-    const double cosPhi = x / r;
-    const double sinPhi = y / r;
-    return utl::CylToCart(bCyl, cosPhi, sinPhi);
+    const T bS = rRef/r * B * hd * gS;
+    bCyl[0] += bS * p.fSinPitch;
+    bCyl[1] += bS * p.fCosPitch;
   }
   else
-    return Vector3(0, 0, 0);
-
+    UF23_EARLY_EXIT(eSpurField);
 }
 
-Vector3
-UF23Field::GetSpiralField(const double x, const double y, const double z)
-  const
+template<typename T, typename P>
+void
+UF23Field::AddSpiralField(const P& p, const CylindricalT<T>& c, T bCyl[3])
 {
   // reference radius
   const double rRef = 5*utl::kpc;
@@ -518,44 +1239,84 @@ UF23Field::GetSpiralField(const double x, const double y, const double z)
   const double rOuter = 20*utl::kpc;
   const double wOuter = 0.5*utl::kpc;
 
-  // cylindrical coordinates
-  const double r2 = x*x + y*y;
-  if (r2 == 0)
-    return Vector3(0, 0, 0);
-  const double r = sqrt(r2);
-  const double phi = atan2(y, x);
+  UF23_INSTRUMENT(eSpiralField);
+  const T r2 = c.fR2;
+  if (r2 == 0) {
+    UF23_EARLY_EXIT(eSpiralField);
+    return;
+  }
+  const T r = c.fR;
 
   // Eq.(13)
-  const double hdz = 1 - utl::Sigmoid(std::abs(z), fDiskH, fDiskW);
+  const T hdz = 1 - c.fDiskSigmoid;
 
   // Eq.(14) times rRef divided by r
-  const double rFacI = utl::Sigmoid(r, rInner, wInner);
-  const double rFacO = 1 - utl::Sigmoid(r, rOuter, wOuter);
+  const T rFacI = utl::Sigmoid(r, rInner, 1/wInner);
+  const T rFacO = 1 - utl::Sigmoid(r, rOuter, 1/wOuter);
   // (using lim r--> 0 (1-exp(-r^2))/r --> r - r^3/2 + ...)
-  const double rFac =  r > 1e-5*utl::pc ? (1-exp(-r*r)) / r : r * (1 - r2/2);
-  const double gdrTimesRrefByR = rRef * rFac * rFacO * rFacI;
+  const T rFac =  r > 1e-5*utl::pc ? (1-exp(-r*r)) / r : r * (1 - r2/2);
+  const T gdrTimesRrefByR = rRef * rFac * rFacO * rFacI;
 
   // Eq. (12)
-  const double phi0 = phi - log(r/rRef) / fTanPitch;
-
-  // Eq. (10)
-  const double b =
-    fDiskB1 * cos(1 * (phi0 - fDiskPhase1)) +
-    fDiskB2 * cos(2 * (phi0 - fDiskPhase2)) +
-    fDiskB3 * cos(3 * (phi0 - fDiskPhase3));
+  const T phi0 = c.fPhi - log(r/rRef) * p.fInvTanPitch;
+
+  // Eq. (10), using cos(k(phi0 - phik)) =
+  // cos(k phi0) cos(k phik) + sin(k phi0) sin(k phik)
+  const T c1 = cos(phi0);
+  const T s1 = sin(phi0);
+  const T c2 = c1*c1 - s1*s1;
+  const T s2 = 2*s1*c1;
+  const T c3 = c2*c1 - s2*s1;
+  const T s3 = s2*c1 + c2*s1;
+  const T b =
+    p.fDiskB1 * (c1 * p.fCosDiskPhase[0] + s1 * p.fSinDiskPhase[0]) +
+    p.fDiskB2 * (c2 * p.fCosDiskPhase[1] + s2 * p.fSinDiskPhase[1]) +
+    p.fDiskB3 * (c3 * p.fCosDiskPhase[2] + s3 * p.fSinDiskPhase[2]);
 
   // Eq. (11)
-  const double fac = hdz * gdrTimesRrefByR;
-  const double bCyl[3] =
-    { b * fac * fSinPitch,
-      b * fac * fCosPitch,
-      0};
-
-  const double cosPhi = x / r;
-  const double sinPhi = y / r;
-  return utl::CylToCart(bCyl, cosPhi, sinPhi);
+  const T fac = hdz * gdrTimesRrefByR;
+  bCyl[0] += b * fac * p.fSinPitch;
+  bCyl[1] += b * fac * p.fCosPitch;
 }
 
+// components used by the vectorized implementation and UF23FieldComponents
+template UF23Field::Cylindrical
+UF23Field::GetCylindrical(const UF23Field&, double, double, double);
+template void
+UF23Field::AddSpurField(const UF23Field&, const Cylindrical&, double*);
+template void
+UF23Field::AddSpiralField(const UF23Field&, const Cylindrical&, double*);
+template void
+UF23Field::AddToroidalHaloField(const UF23Field&, const Cylindrical&, double*);
+template void
+UF23Field::AddPoloidalHaloField<false>(const UF23Field&, const Cylindrical&,
+                                       double*);
+template void
+UF23Field::AddPoloidalHaloField<true>(const UF23Field&, const Cylindrical&,
+                                      double*);
+template void
+UF23Field::AddTwistedHaloField(const UF23Field&, const Cylindrical&, double*);
+
+// components with anchored elementary functions (used by UF23FieldCursor)
+template UF23Field::CylindricalT<utl::anchored::Scalar>
+UF23Field::GetCylindrical(const UF23Field&, utl::anchored::Scalar,
+                          utl::anchored::Scalar, utl::anchored::Scalar);
+template void
+UF23Field::AddFieldComponents<false, false, false>
+(const UF23Field&, const CylindricalT<utl::anchored::Scalar>&,
+ utl::anchored::Scalar*);
+template void
+UF23Field::AddFieldComponents<true, false, false>
+(const UF23Field&, const CylindricalT<utl::anchored::Scalar>&,
+ utl::anchored::Scalar*);
+template void
+UF23Field::AddFieldComponents<false, true, false>
+(const UF23Field&, const CylindricalT<utl::anchored::Scalar>&,
+ utl::anchored::Scalar*);
+template void
+UF23Field::AddFieldComponents<false, false, true>
+(const UF23Field&, const CylindricalT<utl::anchored::Scalar>&,
+ utl::anchored::Scalar*);
 
 namespace utl {
   const std::vector<double> unitConv =
@@ -589,6 +1350,25 @@ namespace utl {
     };
 }
 
+UF23Field::Counters
+UF23Field::GetCounters(const EComponent c)
+{
+  if (c < 0 || c >= eNComponents)
+    throw std::runtime_error("UF23Field: invalid component");
+  const AtomicCounters& a = gCounters[c];
+  return Counters{ a.fCalls.load(), a.fEarlyExits.load(), a.fTicks.load() };
+}
+
+void
+UF23Field::ResetCounters()
+{
+  for (auto& a : gCounters) {
+    a.fCalls = 0;
+    a.fEarlyExits = 0;
+    a.fTicks = 0;
+  }
+}
+
 std::vector<double>
 UF23Field::GetParameters()
   const
@@ -599,7 +1379,7 @@ UF23Field::GetParameters()
 
   std::vector<double> retVec;
   for (unsigned int i = 0; i < eNpar; ++i)
-    retVec.push_back(fParameters[i] / unitConv[i]);
+    retVec.push_back(this->*fParameterPointers[i] / unitConv[i]);
   return retVec;
 }
 
@@ -613,15 +1393,97 @@ UF23Field::SetParameters(const std::vector<double>& newpar)
   if (unitConv.size() != eNpar)
     throw std::runtime_error("invalid unit vector");
 
+  SetParameterValues(newpar.data());
+}
+
+void
+UF23Field::SetParameterValues(const double* newpar)
+{
+  using namespace utl;
   for (unsigned int i = 0; i < eNpar; ++i)
-    fParameters[i] = newpar[i] * unitConv[i];
+    this->*fParameterPointers[i] = newpar[i] * unitConv[i];
 
-  fSinPitch = sin(fDiskPitch);
-  fCosPitch = cos(fDiskPitch);
-  fTanPitch = tan(fDiskPitch);
   if (fModelType == expX)
     fPoloidalZ     =  fPoloidalA*tan(fPoloidalXi);
+  UpdateDerivedParameters();
+}
+
+void
+UF23Field::EvaluateParameterSets(const double* parameters, const std::size_t k,
+                                 const std::vector<Vector3>& posInKpc,
+                                 std::vector<Vector3>& fieldInMicrogauss)
+  const
+{
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(k * n);
+  if (n == 0)
+    return;
+  const Vector3* const pos = posInKpc.data();
+  Vector3* const field = fieldInMicrogauss.data();
+  EvaluateParameterSetsStrided(parameters, k, &pos->x, &pos->y, &pos->z, 3,
+                               &field->x, &field->y, &field->z, 3, n);
+}
+
+void
+UF23Field::EvaluateParameterSets(const double* parameters, const std::size_t k,
+                                 const double* x, const double* y,
+                                 const double* z,
+                                 double* bx, double* by, double* bz,
+                                 const std::size_t n)
+  const
+{
+  EvaluateParameterSetsStrided(parameters, k, x, y, z, 1, bx, by, bz, 1, n);
+}
+
+void
+UF23Field::EvaluateParameterSets(const double* parameters, const std::size_t k,
+                                 const double* x, const double* y,
+                                 const double* z,
+                                 const std::size_t inStride,
+                                 double* bx, double* by, double* bz,
+                                 const std::size_t outStride,
+                                 const std::size_t n)
+  const
+{
+  EvaluateParameterSetsStrided(parameters, k, x, y, z, inStride,
+                               bx, by, bz, outStride, n);
+}
 
+void
+UF23Field::EvaluateParameterSetsStrided(const double* parameters,
+                                        const std::size_t k,
+                                        const double* x, const double* y,
+                                        const double* z,
+                                        const std::size_t inStride,
+                                        double* bx, double* by, double* bz,
+                                        const std::size_t outStride,
+                                        const std::size_t n)
+  const
+{
+  if (k == 0 || n == 0)
+    return;
+  if (utl::unitConv.size() != eNpar)
+    throw std::runtime_error("invalid unit vector");
+
+  // parameter sets in chunks sharing the geometry of the positions
+  std::vector<UF23Field> fields(std::min<std::size_t>(k, kParameterSetChunk),
+                                *this);
+  for (std::size_t first = 0; first < k; first += kParameterSetChunk) {
+    const unsigned int nFields =
+      std::min<std::size_t>(k - first, kParameterSetChunk);
+    SetParameterSets(parameters + first * eNpar, nFields, fields.data());
+    const std::size_t offset = first * n * outStride;
+    if (fVectorization &&
+        EvaluateVectorized(fields.data(), nFields, fFastMath, x, y, z,
+                           inStride, bx + offset, by + offset, bz + offset,
+                           outStride, n))
+      continue;
+    for (unsigned int j = 0; j < nFields; ++j) {
+      const std::size_t o = offset + j * n * outStride;
+      fields[j].EvaluateStrided(x, y, z, inStride, bx + o, by + o, bz + o,
+                                outStride, n);
+    }
+  }
 }
 
 double
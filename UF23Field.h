@@ -11,8 +11,19 @@
  at the origin, the x-axis pointing in the opposite direction of the
  Sun, and the z-axis pointing towards Galactic North.
 
+ UF23Field is a trivially copyable value type: copies (and
+ assignments) are independent instances with their own parameters.
+ The const member functions (operator(), Evaluate(), GetParameters())
+ do not modify any state and can be called concurrently on the same
+ instance from any number of threads. SetParameters(),
+ SetVectorization(), SetFastMath() and SetTolerance() must not be
+ called while other threads use the same instance, i.e. use one copy
+ per thread for parameter scans.
+
  */
 
+#include <array>
+#include <cstddef>
 #include <vector>
 #include <map>
 #include <string>
@@ -38,6 +49,18 @@ public:
   { return fModelNames; }
   const std::string& GetModelName() const
   { return fModelNames.at(fModelType); }
+  ModelType GetModelType() const { return fModelType; }
+
+  /// field components of each model type, known at compile time
+  template<ModelType mt>
+  struct ModelTraits {
+    /// disk with spur instead of the spiral arms
+    static constexpr bool kSpur = mt == spur;
+    /// twisted halo instead of the toroidal and poloidal halo
+    static constexpr bool kTwistX = mt == twistX;
+    /// exponential instead of sigmoid radial profile of the poloidal halo
+    static constexpr bool kExpX = mt == expX;
+  };
 
   /// model parameters, see Table 3 of UF23 paper
   enum EPar {
@@ -86,72 +109,576 @@ public:
   */
   Vector3 operator()(const Vector3& posInKpc) const;
 
+  /**
+     @brief calculate coherent magnetic field at many positions
+     @param x x-components of n positions given in kpc
+     @param y y-components of n positions given in kpc
+     @param z z-components of n positions given in kpc
+     @param bx output x-components of n field values in microgauss
+     @param by output y-components of n field values in microgauss
+     @param bz output z-components of n field values in microgauss
+     @param n number of positions
+
+     The model type is dispatched only once per call, i.e. this is
+     considerably faster than calling operator() for each position.
+  */
+  void Evaluate(const double* x, const double* y, const double* z,
+                double* bx, double* by, double* bz,
+                const std::size_t n) const;
+  /**
+     @brief calculate coherent magnetic field at many strided positions
+     @param x x-component of the first position given in kpc
+     @param y y-component of the first position given in kpc
+     @param z z-component of the first position given in kpc
+     @param inStride distance between the components of consecutive
+            positions, e.g. 3 for n x 3 arrays of positions
+     @param bx output x-component of the first field value in microgauss
+     @param by output y-component of the first field value in microgauss
+     @param bz output z-component of the first field value in microgauss
+     @param outStride distance between the components of consecutive
+            field values
+     @param n number of positions
+
+     Evaluates arrays of another layout in place, e.g. NumPy arrays
+     of shape (n, 3) with Evaluate(p, p + 1, p + 2, 3, b, b + 1, b + 2,
+     3, n).
+  */
+  void Evaluate(const double* x, const double* y, const double* z,
+                const std::size_t inStride,
+                double* bx, double* by, double* bz,
+                const std::size_t outStride,
+                const std::size_t n) const;
+  /**
+     @brief calculate coherent magnetic field at many positions
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output coherent field values in microgauss
+            (resized to the number of positions)
+  */
+  void Evaluate(const std::vector<Vector3>& posInKpc,
+                std::vector<Vector3>& fieldInMicrogauss) const;
+  /**
+     @brief calculate coherent magnetic field at many positions
+     @param posInKpc positions with components given in kpc
+     @return coherent field values in microgauss
+  */
+  std::vector<Vector3> Evaluate(const std::vector<Vector3>& posInKpc) const;
+
+  /// 3x3 matrix, e.g. the Jacobian J[i][j] = dB_i/dx_j
+  typedef std::array<std::array<double, 3>, 3> Matrix3;
+  /**
+     @brief calculate coherent magnetic field and its spatial derivatives
+     @param posInKpc position with components given in kpc
+     @param jacobian output derivatives dB_i/dx_j in microgauss/kpc
+     @return coherent field in microgauss
+
+     The derivatives of all components are calculated analytically in
+     one pass with forward-mode automatic differentiation (dual
+     numbers, see UF23Dual.h), at about 3-4 times the cost of
+     operator(). The field is not differentiable where it is
+     discontinuous, i.e. at the maximum radius, across the z-axis
+     (toroidal halo) and across the Galactic plane (sign of the
+     halo fields), where the one-sided derivatives are returned.
+  */
+  Vector3 EvaluateWithJacobian(const Vector3& posInKpc,
+                               Matrix3& jacobian) const;
+  /**
+     @brief calculate coherent magnetic field and its spatial
+            derivatives at many positions
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output coherent field values in microgauss
+     @param jacobian output derivatives dB_i/dx_j in microgauss/kpc
+  */
+  void EvaluateWithJacobian(const std::vector<Vector3>& posInKpc,
+                            std::vector<Vector3>& fieldInMicrogauss,
+                            std::vector<Matrix3>& jacobian) const;
+
+  /// derivatives G[i][k] = dB_i/dp_k with respect to the parameters
+  typedef std::array<std::array<double, eNpar>, 3> ParameterGradient;
+  /**
+     @brief calculate coherent magnetic field and its derivatives with
+            respect to the model parameters
+     @param posInKpc position with components given in kpc
+     @param gradient output derivatives dB_i/dp_k in microgauss per
+            unit of parameter k as given by GetParameters()
+     @return coherent field in microgauss
+
+     All eNpar derivatives are calculated in one pass with
+     forward-mode automatic differentiation instead of eNpar+1 field
+     evaluations with modified parameters, at about 10-20 times the
+     cost of operator(). Parameters not used by the model have zero
+     derivatives; for expX, poloidal z is given by a and xi and its
+     derivative is zero, too.
+  */
+  Vector3 EvaluateWithParameterGradient(const Vector3& posInKpc,
+                                        ParameterGradient& gradient) const;
+  /**
+     @brief calculate coherent magnetic field and its parameter
+            derivatives at many positions
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output coherent field values in microgauss
+     @param gradient output derivatives dB_i/dp_k (see above)
+  */
+  void
+  EvaluateWithParameterGradient(const std::vector<Vector3>& posInKpc,
+                                std::vector<Vector3>& fieldInMicrogauss,
+                                std::vector<ParameterGradient>& gradient)
+    const;
+
+  /**
+     @brief calculate coherent magnetic field at many positions in
+            single precision
+     @param x x-components of n positions given in kpc
+     @param y y-components of n positions given in kpc
+     @param z z-components of n positions given in kpc
+     @param bx output x-components of n field values in microgauss
+     @param by output y-components of n field values in microgauss
+     @param bz output z-components of n field values in microgauss
+     @param n number of positions
+
+     The SIMD kernels use single precision arithmetic with twice the
+     number of lanes of the double precision kernels, except for the
+     numerically sensitive poloidal halo field and the spur, which are
+     calculated in double precision. The deviation from the double
+     precision result is below 1e-5 microgauss, i.e. about 1e-6 of the
+     typical field strength (see Test/testUF23FieldFloat.cxx). Without
+     vectorization, the field is calculated in double precision and
+     rounded.
+  */
+  void Evaluate(const float* x, const float* y, const float* z,
+                float* bx, float* by, float* bz,
+                const std::size_t n) const;
+  /// single precision evaluation with arbitrary strides (see above)
+  void Evaluate(const float* x, const float* y, const float* z,
+                const std::size_t inStride,
+                float* bx, float* by, float* bz,
+                const std::size_t outStride,
+                const std::size_t n) const;
+  /**
+     @brief calculate coherent magnetic field at many positions in
+            single precision
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output coherent field values in microgauss
+            (resized to the number of positions)
+  */
+  void Evaluate(const std::vector<Vector3f>& posInKpc,
+                std::vector<Vector3f>& fieldInMicrogauss) const;
+
+  /**
+     @brief enable or disable the vectorized batch evaluation
+     @param v if true (default), Evaluate() uses SIMD kernels for the
+            instruction set given by GetInstructionSet(), otherwise
+            the scalar implementation of operator() is used
+  */
+  void SetVectorization(const bool v) { fVectorization = v; }
+  /// true if batch evaluation is vectorized
+  bool GetVectorization() const { return fVectorization; }
+  /**
+     @brief enable or disable fast approximate math in batch evaluation
+     @param f if true, the vectorized double precision Evaluate() uses
+            lower-order polynomial approximations of exp, log, pow,
+            atan2, sin and cos with a maximum relative error of 7e-10
+            for atan2, 6e-11 + p * 2e-12 for pow(x, p) and 7e-11 for
+            the others (default: false)
+
+     The resulting field deviates from the exact one by less than
+     1e-8 * (|B| + 0.1 microgauss), see Test/testUF23FieldFastMath.cxx,
+     for about 30% less evaluation time (except for the spur, which is
+     not vectorized, see EvaluateFastMath/ of make bench). operator()
+     and the scalar batch evaluation always use the standard math
+     library.
+  */
+  void SetFastMath(const bool f) { fFastMath = f; }
+  /// true if vectorized batch evaluation uses fast approximate math
+  bool GetFastMath() const { return fFastMath; }
+  /**
+     @brief skip field components that are negligible at a position
+     @param toleranceInMicrogauss maximum deviation of the field in
+            microgauss (default: 0, i.e. all components are evaluated)
+     The disk field (spiral arms or spur) and the toroidal halo field
+     are bounded by the exponential envelopes of their vertical,
+     radial and (spur) azimuthal transitions. For a tolerance t > 0,
+     the cutoffs beyond which an envelope is below t/2 are derived
+     from the parameters (and updated by SetParameters()) and
+     operator() and Evaluate() skip the component beyond a cutoff,
+     e.g. the spiral field at |z| > h + w ln(2 B_max / t), i.e. the
+     field deviates by less than t. The poloidal and twisted halo
+     fields are always evaluated. The SIMD kernels skip a component
+     only if it is negligible at all positions of a block.
+  */
+  void SetTolerance(const double toleranceInMicrogauss);
+  /// maximum deviation of skipped components in microgauss
+  double GetTolerance() const { return fTolerance; }
+  /// instruction set of SIMD kernels selected at runtime for this CPU
+  static const std::string& GetInstructionSet();
+
+  /// instrumented functions (see GetCounters())
+  enum EComponent {
+    eEvaluation,           ///< scalar evaluation (early exit: max. radius)
+    eVectorizedEvaluation, ///< positions of the SIMD kernels
+    eCylindrical,          ///< cylindrical coordinates
+    eSpiralField,          ///< early exit: r = 0
+    eSpurField,            ///< early exit: r = 0 or other arm (iBest != 0)
+    eToroidalHaloField,
+    ePoloidalHaloField,
+    eTwistedHaloField,     ///< early exit: no twisting (t = 0 or r = 0)
+    eNComponents
+  };
+  /// number of calls and early exits and time stamp counter ticks
+  struct Counters {
+    unsigned long long fCalls;
+    unsigned long long fEarlyExits;
+    unsigned long long fTicks;
+  };
+  /// true if compiled with -DUF23_INSTRUMENTATION
+  static constexpr bool IsInstrumented()
+  {
+#ifdef UF23_INSTRUMENTATION
+    return true;
+#else
+    return false;
+#endif
+  }
+  /**
+     @brief counters of an instrumented function
+     @param c function (see EComponent)
+     @return counters accumulated by all instances and threads since
+             the start of the program or the last ResetCounters()
+
+     The counters are only incremented if compiled with
+     -DUF23_INSTRUMENTATION (e.g. make UF23_INSTRUMENTATION=1),
+     otherwise the instrumentation has no cost and the counters are
+     zero. The ticks of nested functions are included in the outer
+     ones (e.g. the poloidal halo in the twisted halo). The SIMD
+     kernels only count the number of positions and the ticks per
+     batch.
+  */
+  static Counters GetCounters(const EComponent c);
+  /// reset all counters to zero
+  static void ResetCounters();
+
   /// get parameter vector (units: kpc, microgauss, degree, Myr)
   std::vector<double> GetParameters() const;
 
   /// overwrite default model parameters (units: kpc, microgauss, degree, Myr)
   void SetParameters(const std::vector<double>& newpar);
 
+  /**
+     @brief calculate the field for k parameter sets at many positions
+     @param parameters k x eNpar matrix, row j is a parameter vector
+            of this model type as in SetParameters()
+     @param k number of parameter sets
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output k x n field values in microgauss,
+            parameter set j at position i at j * n + i (resized to k * n)
+
+     Equivalent to k calls of SetParameters() and Evaluate() on
+     copies of this field, but without allocations per parameter set,
+     with the derived parameters of all sets calculated in one
+     vectorized pass over the parameter matrix and with the
+     position-dependent terms calculated only once for each chunk of
+     kParameterSetChunk parameter sets (see UF23FieldSet). The cost per
+     parameter set is at most that of SetParameters() and Evaluate(),
+     also for few positions (compare EvaluateParameterSets/ and
+     SetParametersEvaluate/ of make bench).
+  */
+  void EvaluateParameterSets(const double* parameters, const std::size_t k,
+                             const std::vector<Vector3>& posInKpc,
+                             std::vector<Vector3>& fieldInMicrogauss) const;
+  /**
+     @brief calculate the field for k parameter sets at many positions
+     @param parameters k x eNpar parameter matrix (see above)
+     @param k number of parameter sets
+     @param x x-components of n positions given in kpc
+     @param y y-components of n positions given in kpc
+     @param z z-components of n positions given in kpc
+     @param bx output x-components of k x n field values in microgauss
+     @param by output y-components of k x n field values in microgauss
+     @param bz output z-components of k x n field values in microgauss
+     @param n number of positions
+  */
+  void EvaluateParameterSets(const double* parameters, const std::size_t k,
+                             const double* x, const double* y,
+                             const double* z,
+                             double* bx, double* by, double* bz,
+                             const std::size_t n) const;
+  /**
+     @brief calculate the field for k parameter sets at many strided
+            positions
+     @param parameters k x eNpar parameter matrix (see above)
+     @param k number of parameter sets
+     @param x x-component of the first position given in kpc
+     @param y y-component of the first position given in kpc
+     @param z z-component of the first position given in kpc
+     @param inStride distance between the components of consecutive
+            positions
+     @param bx output x-component of the first field value in
+            microgauss, parameter set j at position i at
+            (j * n + i) * outStride
+     @param by output y-component (see bx)
+     @param bz output z-component (see bx)
+     @param outStride distance between the components of consecutive
+            field values
+     @param n number of positions
+  */
+  void EvaluateParameterSets(const double* parameters, const std::size_t k,
+                             const double* x, const double* y,
+                             const double* z,
+                             const std::size_t inStride,
+                             double* bx, double* by, double* bz,
+                             const std::size_t outStride,
+                             const std::size_t n) const;
+  /// number of parameter sets evaluated together
+  static const unsigned int kParameterSetChunk = 64;
+
   /// maximum squared radius of field model
   double GetMaximumSquaredRadius() const;
 
+protected:
+
+  /**
+     @brief field of the given components at one position
+     @param x x-component of position in internal units
+     @param y y-component of position in internal units
+     @param z z-component of position in internal units
+     @return field (zero beyond the maximum radius) in microgauss
+
+     All model-dependent branches are resolved at compile time (see
+     ModelTraits and UF23FieldT).
+  */
+  template<bool isSpur, bool isTwistX, bool isExpX>
+  Vector3 EvaluateKernel(const double x, const double y, const double z) const;
+
 private:
 
   /// model type given in constructor
-  const ModelType fModelType;
+  ModelType fModelType;
   /// maximum galacto-centric radius beyond which B=0
-  const double fMaxRadiusSquared;
-
-  // parameters are stored in array
-  double fParameters[eNpar] = { 0 };
-  // references to parameters for convience
-  double& fDiskB1       = fParameters[eDiskB1];
-  double& fDiskB2       = fParameters[eDiskB2];
-  double& fDiskB3       = fParameters[eDiskB3];
-  double& fDiskH        = fParameters[eDiskH];
-  double& fDiskPhase1   = fParameters[eDiskPhase1];
-  double& fDiskPhase2   = fParameters[eDiskPhase2];
-  double& fDiskPhase3   = fParameters[eDiskPhase3];
-  double& fDiskPitch    = fParameters[eDiskPitch];
-  double& fDiskW        = fParameters[eDiskW];
-  double& fPoloidalA    = fParameters[ePoloidalA];
-  double& fPoloidalB    = fParameters[ePoloidalB];
-  double& fPoloidalP    = fParameters[ePoloidalP];
-  double& fPoloidalR    = fParameters[ePoloidalR];
-  double& fPoloidalW    = fParameters[ePoloidalW];
-  double& fPoloidalZ    = fParameters[ePoloidalZ];
-  double& fPoloidalXi = fParameters[ePoloidalXi];
-  double& fSpurCenter   = fParameters[eSpurCenter];
-  double& fSpurLength   = fParameters[eSpurLength];
-  double& fSpurWidth    = fParameters[eSpurWidth];
-  double& fStriation    = fParameters[eStriation];
-  double& fToroidalBN   = fParameters[eToroidalBN];
-  double& fToroidalBS   = fParameters[eToroidalBS];
-  double& fToroidalR    = fParameters[eToroidalR];
-  double& fToroidalW    = fParameters[eToroidalW];
-  double& fToroidalZ    = fParameters[eToroidalZ];
-  double& fTwistingTime = fParameters[eTwistingTime];
+  double fMaxRadiusSquared;
+
+  // model parameters (see EPar)
+  double fDiskB1       = 0;
+  double fDiskB2       = 0;
+  double fDiskB3       = 0;
+  double fDiskH        = 0;
+  double fDiskPhase1   = 0;
+  double fDiskPhase2   = 0;
+  double fDiskPhase3   = 0;
+  double fDiskPitch    = 0;
+  double fDiskW        = 0;
+  double fPoloidalA    = 0;
+  double fPoloidalB    = 0;
+  double fPoloidalP    = 0;
+  double fPoloidalR    = 0;
+  double fPoloidalW    = 0;
+  double fPoloidalZ    = 0;
+  double fPoloidalXi   = 0;
+  double fSpurCenter   = 0;
+  double fSpurLength   = 0;
+  double fSpurWidth    = 0;
+  double fStriation    = 0;
+  double fToroidalBN   = 0;
+  double fToroidalBS   = 0;
+  double fToroidalR    = 0;
+  double fToroidalW    = 0;
+  double fToroidalZ    = 0;
+  double fTwistingTime = 0;
+  /// pointers to parameter members in the order of EPar
+  static double UF23Field::* const fParameterPointers[eNpar];
+
+  /// use SIMD kernels in batch evaluation
+  bool fVectorization = true;
+  /// use fast approximations in the SIMD kernels
+  bool fFastMath = false;
+  /// tolerance of negligible components in microgauss
+  double fTolerance = 0;
 
   // some pre-calculated derived parameter values
+  // -- disk pitch angle
   double fSinPitch  = 0;
   double fCosPitch  = 0;
   double fTanPitch  = 0;
+  double fInvTanPitch = 0;
+  // -- cos(k*phase_k) and sin(k*phase_k) of the spiral arms, k=1,2,3
+  double fCosDiskPhase[3] = { 0 };
+  double fSinDiskPhase[3] = { 0 };
+  // -- inverse widths and scale heights
+  double fInvDiskW      = 0;
+  double fInvSpurWidth  = 0;
+  double fInvToroidalW  = 0;
+  double fInvToroidalZ  = 0;
+  double fInvPoloidalR  = 0;
+  double fInvPoloidalW  = 0;
+  // -- powers of the poloidal field, c = (a/z)^p and a^p, Eq.(34)
+  double fPoloidalC       = 0;
+  double fPoloidalA0p     = 0;
+  double fInvPoloidalP    = 0;
+  double fPoloidalPMinus1 = 0;
+  double fPoloidalPMinus2 = 0;
+  // -- cutoffs of the negligible components (see SetTolerance()),
+  //    (r^2 and |z| beyond the cutoffs, infinite for no tolerance)
+  double fDiskCutoffZ         = 0;
+  double fSpiralCutoffR2Inner = 0;
+  double fSpiralCutoffR2Outer = 0;
+  double fSpurCutoffPhi       = 0;
+  double fToroidalCutoffR2    = 0;
+  double fToroidalCutoffZ     = 0;
+  double fToroidalCutoffZInner = 0;
 
-  /// major field components
-  Vector3 GetDiskField(const Vector3& pos) const;
-  Vector3 GetHaloField(const Vector3& pos) const;
+  /// set eNpar parameters given in the units of GetParameters()
+  void SetParameterValues(const double* newpar);
+  /// calculate derived parameter values after changing fParameters
+  void UpdateDerivedParameters();
+  /// cutoffs of the negligible components for the tolerance
+  void UpdateCutoffs();
+  /// derived parameter values of UF23Field or ParameterSet
+  template<typename P>
+  static void CalculateDerivedParameters(P& p);
+  /// model and derived parameters of scalar type T (see UF23Field.cc)
+  template<typename T>
+  struct ParameterSet;
 
-  /// sub-components depending on model type
+  /**
+     set the parameters of nFields copies of this field to the rows
+     of an nFields x eNpar matrix (units of GetParameters()) in one
+     pass over the matrix, vectorized over the rows (see
+     UF23FieldSIMD.cc), the cutoffs are only updated for a tolerance
+  */
+  void SetParameterSets(const double* parameters, const unsigned int nFields,
+                        UF23Field* fields) const;
+  /// EvaluateParameterSets() with arbitrary stride
+  void EvaluateParameterSetsStrided(const double* parameters,
+                                    const std::size_t k,
+                                    const double* x, const double* y,
+                                    const double* z,
+                                    const std::size_t inStride,
+                                    double* bx, double* by, double* bz,
+                                    const std::size_t outStride,
+                                    const std::size_t n) const;
+  /// batch evaluation for positions and fields with arbitrary stride
+  template<typename T>
+  void EvaluateStrided(const T* x, const T* y, const T* z,
+                       const std::size_t inStride,
+                       T* bx, T* by, T* bz,
+                       const std::size_t outStride,
+                       const std::size_t n) const;
+  /// vectorized batch evaluation (see UF23FieldSIMD.cc), false if n/a
+  bool EvaluateVectorized(const double* x, const double* y, const double* z,
+                          const std::size_t inStride,
+                          double* bx, double* by, double* bz,
+                          const std::size_t outStride,
+                          const std::size_t n) const;
+  bool EvaluateVectorized(const float* x, const float* y, const float* z,
+                          const std::size_t inStride,
+                          float* bx, float* by, float* bz,
+                          const std::size_t outStride,
+                          const std::size_t n) const;
+  /// vectorized batch evaluation of nFields fields (see UF23FieldSet)
+  static bool EvaluateVectorized(const UF23Field* fields,
+                                 const unsigned int nFields,
+                                 const bool fastMath,
+                                 const double* x, const double* y,
+                                 const double* z,
+                                 const std::size_t inStride,
+                                 double* bx, double* by, double* bz,
+                                 const std::size_t outStride,
+                                 const std::size_t n);
+  friend class UF23FieldSIMD;
+  friend class UF23FieldDevice;
+  friend class UF23FieldComponents;
+  friend class UF23FieldSet;
+  friend class UF23FieldCursor;
+  /// scalar loop over positions for the given field components
+  template<bool isSpur, bool isTwistX, bool isExpX, typename T>
+  void EvaluateBatch(const T* x, const T* y, const T* z,
+                     const std::size_t inStride,
+                     T* bx, T* by, T* bz,
+                     const std::size_t outStride,
+                     const std::size_t n) const;
+
+  /// cylindrical coordinates and terms shared by the field components
+  template<typename T>
+  struct CylindricalT {
+    T fR;
+    T fR2;
+    T fPhi;
+    T fCosPhi;  ///< 1 on the z-axis
+    T fSinPhi;  ///< 0 on the z-axis
+    T fZ;
+    T fAbsZ;
+    /// Sigmoid(|z|, h_disk, w_disk) of Eq. (13)
+    T fDiskSigmoid;
+  };
+  typedef CylindricalT<double> Cylindrical;
+  template<typename T, typename P>
+  static CylindricalT<T> GetCylindrical(const P& p,
+                                        const T x, const T y, const T z);
+
+  /// field of the components above the cutoffs of SetTolerance()
+  template<bool isSpur, bool isTwistX, bool isExpX>
+  Vector3 EvaluateSignificantComponents(const double x, const double y,
+                                        const double z) const;
+  /// true if a component is below the cutoffs of SetTolerance()
+  bool IsSpiralFieldNegligible(const double r2, const double absZ) const
+  {
+    return absZ > fDiskCutoffZ ||
+      r2 < fSpiralCutoffR2Inner || r2 > fSpiralCutoffR2Outer;
+  }
+  bool IsSpurFieldNegligible(const Cylindrical& c) const;
+  bool IsToroidalHaloFieldNegligible(const double r2, const double absZ)
+    const
+  {
+    return r2 > fToroidalCutoffR2 ||
+      absZ > fToroidalCutoffZ || absZ < fToroidalCutoffZInner;
+  }
+
+  /*
+    The component functions are templates of the scalar type T, which
+    is double, or a dual number of UF23Dual.h to calculate derivatives,
+    and of the type P of the parameters p, which is UF23Field or a set
+    of parameters with dual numbers (with the same member names).
+  */
+  /// all components of the model type, added to bCyl = (B_r, B_phi, B_z)
+  template<bool isSpur, bool isTwistX, bool isExpX, typename T, typename P>
+  static void AddFieldComponents(const P& p, const CylindricalT<T>& c,
+                                 T bCyl[3]);
+  /// sub-components depending on model type, added to bCyl
   /// -- Sec. 5.2.2
-  Vector3 GetSpiralField(const double x, const double y, const double z) const;
+  template<typename T, typename P>
+  static void AddSpiralField(const P& p, const CylindricalT<T>& c, T bCyl[3]);
   /// -- Sec. 5.2.3
-  Vector3 GetSpurField(const double x, const double y, const double z) const;
+  template<typename T, typename P>
+  static void AddSpurField(const P& p, const CylindricalT<T>& c, T bCyl[3]);
   /// -- Sec. 5.3.1
-  Vector3 GetToroidalHaloField(const double x, const double y, const double z) const;
-  /// -- Sec. 5.3.2
-  Vector3 GetPoloidalHaloField(const double x, const double y, const double z) const;
+  template<typename T, typename P>
+  static void AddToroidalHaloField(const P& p, const CylindricalT<T>& c,
+                                   T bCyl[3]);
+  /// -- Sec. 5.3.2, exponential radial dependence for expX
+  template<bool isExpX, typename T, typename P>
+  static void AddPoloidalHaloField(const P& p, const CylindricalT<T>& c,
+                                   T bCyl[3]);
+  template<bool isExpX, typename T, typename P>
+  static void GetPoloidalHaloField(const P& p, const CylindricalT<T>& c,
+                                   T& bR, T& bZ);
   /// -- Sec. 5.3.3
-  Vector3 GetTwistedHaloField(const double x, const double y, const double z) const;
+  template<typename T, typename P>
+  static void AddTwistedHaloField(const P& p, const CylindricalT<T>& c,
+                                  T bCyl[3]);
+
+  /// field and Jacobian with dual numbers
+  template<bool isSpur, bool isTwistX, bool isExpX>
+  Vector3 EvaluateJacobianKernel(const Vector3& posInKpc,
+                                 Matrix3& jacobian) const;
+
+  /// field and parameter gradient of n positions
+  void EvaluateParameterGradient(const Vector3* posInKpc,
+                                 Vector3* fieldInMicrogauss,
+                                 ParameterGradient* gradient,
+                                 const std::size_t n) const;
+  /// field and parameter gradient with dual numbers
+  template<bool isSpur, bool isTwistX, bool isExpX, typename P>
+  Vector3 EvaluateParameterGradientKernel(const P& p,
+                                          const Vector3& posInKpc,
+                                          ParameterGradient& gradient) const;
 
   static const std::map<ModelType, std::string> fModelNames;
 };
@@ -0,0 +1,78 @@
+#include "UF23FieldCUDA.h"
+#include "UF23Ensemble.h"
+#include <cuda_runtime.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+  // parameter blocks of the realizations of the current launch
+  __constant__ UF23FieldDevice gFields[UF23FieldCUDA::kMaxConstantFields];
+
+  const unsigned int kThreadsPerBlock = 256;
+
+  // blockIdx.y: realization, blockIdx.x * blockDim.x + threadIdx.x: position
+  __global__
+  void
+  EvaluateKernel(const double* x, const double* y, const double* z,
+                 double* bx, double* by, double* bz, const std::size_t n)
+  {
+    const UF23FieldDevice& field = gFields[blockIdx.y];
+    const std::size_t offset = blockIdx.y * n;
+    for (std::size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < n;
+         i += std::size_t(gridDim.x) * blockDim.x)
+      field(x[i], y[i], z[i], bx[offset + i], by[offset + i], bz[offset + i]);
+  }
+
+  void
+  Check(const cudaError_t status, const char* what)
+  {
+    if (status != cudaSuccess)
+      throw std::runtime_error(std::string("UF23FieldCUDA: ") + what + ": "
+                               + cudaGetErrorString(status));
+  }
+}
+
+UF23FieldCUDA::UF23FieldCUDA(const UF23Field& field) :
+  fFields(1, UF23FieldDevice(field))
+{
+}
+
+UF23FieldCUDA::UF23FieldCUDA(const UF23Ensemble& ensemble)
+{
+  for (unsigned int i = 0; i < ensemble.GetNumberOfRealizations(); ++i)
+    fFields.push_back(UF23FieldDevice(ensemble.GetRealization(i)));
+}
+
+UF23FieldCUDA::UF23FieldCUDA(const std::vector<UF23Field>& fields)
+{
+  for (const auto& f : fields)
+    fFields.push_back(UF23FieldDevice(f));
+}
+
+void
+UF23FieldCUDA::Evaluate(const double* x, const double* y, const double* z,
+                        double* bx, double* by, double* bz,
+                        const std::size_t n)
+  const
+{
+  if (n == 0)
+    return;
+  const unsigned int nBlocks =
+    std::min<std::size_t>((n + kThreadsPerBlock - 1) / kThreadsPerBlock, 4096);
+  // realizations in chunks fitting into constant memory
+  for (std::size_t first = 0; first < fFields.size();
+       first += kMaxConstantFields) {
+    const unsigned int nFields =
+      std::min<std::size_t>(fFields.size() - first, kMaxConstantFields);
+    Check(cudaMemcpyToSymbol(gFields, &fFields[first],
+                             nFields * sizeof(UF23FieldDevice)),
+          "cudaMemcpyToSymbol");
+    const std::size_t offset = first * n;
+    EvaluateKernel<<<dim3(nBlocks, nFields), kThreadsPerBlock>>>
+      (x, y, z, bx + offset, by + offset, bz + offset, n);
+    Check(cudaGetLastError(), "kernel launch");
+    Check(cudaDeviceSynchronize(), "kernel execution");
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef _UF23FieldCUDA_h_
+#define _UF23FieldCUDA_h_
+/**
+ @class UF23FieldCUDA
+ @brief evaluation of UF23Field for device buffers of positions (CUDA)
+
+ Host interface to a CUDA kernel evaluating one or many parameter
+ realizations of a UF23 model. The parameter blocks (UF23FieldDevice)
+ are placed in constant memory, positions and fields are device
+ buffers, i.e. no data is transferred between host and device except
+ the parameters:
+
+   const UF23FieldCUDA cudaField(uf23Field);
+   cudaField.Evaluate(dX, dY, dZ, dBx, dBy, dBz, n);
+
+ In the ensemble mode (e.g. the realizations of UF23Ensemble drawn
+ with ParameterCovariance) each thread block handles the positions of
+ one realization, the fields of realization k are written to
+ dB[k*n, (k+1)*n).
+
+ Not part of the default build since it requires the CUDA toolkit,
+ type `make cuda` to compile UF23FieldCUDA.o and link it to the
+ application with -lcudart. For device code of other GPU applications
+ use UF23FieldDevice directly.
+
+ */
+
+#include <cstddef>
+#include <vector>
+#include "UF23FieldDevice.h"
+
+class UF23Ensemble;
+
+class UF23FieldCUDA {
+public:
+  /// single field
+  explicit UF23FieldCUDA(const UF23Field& field);
+  /// all realizations of an ensemble
+  explicit UF23FieldCUDA(const UF23Ensemble& ensemble);
+  /// realizations given explicitly
+  explicit UF23FieldCUDA(const std::vector<UF23Field>& fields);
+  /// no default constructor
+  UF23FieldCUDA() = delete;
+
+  unsigned int GetNumberOfRealizations() const { return fFields.size(); }
+  /// parameter block of realization i for device code
+  const UF23FieldDevice& GetDeviceField(const unsigned int i) const
+  { return fFields.at(i); }
+
+  /**
+     @brief calculate coherent magnetic field at many positions
+     @param x,y,z device pointers to n position components in kpc
+     @param bx,by,bz device pointers to GetNumberOfRealizations()*n
+            output field components in microgauss
+     @param n number of positions
+
+     Synchronous, throws std::runtime_error for CUDA errors.
+  */
+  void Evaluate(const double* x, const double* y, const double* z,
+                double* bx, double* by, double* bz,
+                const std::size_t n) const;
+
+  /// maximum number of realizations in constant memory per kernel launch
+  static const unsigned int kMaxConstantFields = 128;
+
+private:
+  std::vector<UF23FieldDevice> fFields;
+};
+#endif
@@ -0,0 +1,193 @@
+#include "UF23FieldCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+  const char kMagic[8] = { 'U', 'F', '2', '3', 'G', 'M', 'F', 0 };
+  const std::uint32_t kByteOrder = 0x01020304u;
+
+  std::size_t
+  Align(const std::size_t offset)
+  {
+    const std::size_t a = UF23FieldCache::kAlignment;
+    return (offset + a - 1) / a * a;
+  }
+
+  // write all size bytes to fd, false upon error
+  bool
+  WriteAll(const int fd, const void* const data, std::size_t size)
+  {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+      const ssize_t n = write(fd, p, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  bool
+  IsModelType(const std::int32_t modelType)
+  {
+    for (const auto& m : UF23Field::GetModelNames())
+      if (m.first == modelType)
+        return true;
+    return false;
+  }
+
+  std::string
+  SystemError(const std::string& what, const std::string& filename)
+  {
+    return "UF23FieldCache: " + what + " " + filename + " ("
+      + std::strerror(errno) + ")";
+  }
+
+}
+
+UF23FieldCache::UF23FieldCache(const std::string& filename,
+                               const EContent content) :
+  fFilename(filename)
+{
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(SystemError("cannot open", filename));
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error(SystemError("cannot stat", filename));
+  }
+  fMappingSize = st.st_size;
+  if (fMappingSize < sizeof(Header)) {
+    close(fd);
+    throw std::runtime_error("UF23FieldCache: " + filename + " too short");
+  }
+  fMapping = mmap(nullptr, fMappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (fMapping == MAP_FAILED) {
+    fMapping = nullptr;
+    throw std::runtime_error(SystemError("cannot map", filename));
+  }
+  fHeader = static_cast<const Header*>(fMapping);
+
+  std::string error;
+  if (std::memcmp(fHeader->fMagic, kMagic, sizeof(kMagic)) != 0)
+    error = "not a UF23 field cache";
+  else if (fHeader->fByteOrder != kByteOrder)
+    error = "incompatible byte order";
+  else if (fHeader->fVersion != kVersion)
+    error = "version " + std::to_string(fHeader->fVersion) + " != "
+      + std::to_string(kVersion);
+  else if (fHeader->fContent != std::uint32_t(content))
+    error = "unexpected content type " + std::to_string(fHeader->fContent);
+  else if (fHeader->fNParameters != UF23Field::eNpar ||
+           fHeader->fNArrays > kMaxArrays)
+    error = "corrupt header";
+  else if (!IsModelType(fHeader->fModelType))
+    error = "invalid model type " + std::to_string(fHeader->fModelType);
+  else {
+    for (unsigned int i = 0; i < fHeader->fNArrays; ++i)
+      if (fHeader->fArrayOffsets[i] + fHeader->fArraySizes[i] > fMappingSize)
+        error = "truncated file";
+  }
+  if (!error.empty()) {
+    munmap(fMapping, fMappingSize);
+    throw std::runtime_error("UF23FieldCache: " + filename + ": " + error);
+  }
+}
+
+UF23FieldCache::~UF23FieldCache()
+{
+  if (fMapping)
+    munmap(fMapping, fMappingSize);
+}
+
+const void*
+UF23FieldCache::GetArray(const unsigned int i)
+  const
+{
+  if (i >= fHeader->fNArrays)
+    throw std::runtime_error("UF23FieldCache: no array " + std::to_string(i)
+                             + " in " + fFilename);
+  return static_cast<const char*>(fMapping) + fHeader->fArrayOffsets[i];
+}
+
+UF23FieldCache::Header
+UF23FieldCache::MakeHeader(const EContent content,
+                           const UF23Field::ModelType modelType,
+                           const std::vector<double>& parameters,
+                           const double maxRadius)
+{
+  if (parameters.size() != UF23Field::eNpar)
+    throw std::runtime_error("UF23FieldCache: wrong number of parameters");
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.fMagic, kMagic, sizeof(kMagic));
+  header.fByteOrder = kByteOrder;
+  header.fVersion = kVersion;
+  header.fContent = content;
+  header.fModelType = modelType;
+  header.fNParameters = UF23Field::eNpar;
+  for (unsigned int i = 0; i < UF23Field::eNpar; ++i)
+    header.fParameters[i] = parameters[i];
+  header.fMaxRadius = maxRadius;
+  return header;
+}
+
+void
+UF23FieldCache::Write(const std::string& filename,
+                      Header header,
+                      const std::vector<Array>& arrays)
+{
+  if (arrays.size() > kMaxArrays)
+    throw std::runtime_error("UF23FieldCache: too many arrays");
+
+  header.fNArrays = arrays.size();
+  std::size_t offset = Align(sizeof(Header));
+  for (unsigned int i = 0; i < arrays.size(); ++i) {
+    header.fArrayOffsets[i] = offset;
+    header.fArraySizes[i] = arrays[i].fSize;
+    offset = Align(offset + arrays[i].fSize);
+  }
+
+  // temporary file in the same directory for atomic rename, created
+  // exclusively by mkstemp, i.e. unique also for several threads and
+  // for hosts sharing the directory
+  std::string tmpFilename = filename + ".tmp.XXXXXX";
+  const int fd = mkstemp(&tmpFilename[0]);
+  if (fd < 0)
+    throw std::runtime_error(SystemError("cannot create", tmpFilename));
+  // mkstemp creates the file readable by the owner only
+  bool ok = fchmod(fd, 0644) == 0;
+  const char zeros[kAlignment] = { 0 };
+  ok = ok && WriteAll(fd, &header, sizeof(header));
+  std::size_t position = sizeof(header);
+  for (unsigned int i = 0; i < arrays.size(); ++i) {
+    ok = ok && WriteAll(fd, zeros, header.fArrayOffsets[i] - position) &&
+      WriteAll(fd, arrays[i].fData, arrays[i].fSize);
+    position = header.fArrayOffsets[i] + arrays[i].fSize;
+  }
+  ok = close(fd) == 0 && ok;
+  if (!ok) {
+    std::remove(tmpFilename.c_str());
+    throw std::runtime_error(SystemError("cannot write", tmpFilename));
+  }
+  if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+    std::remove(tmpFilename.c_str());
+    throw std::runtime_error(SystemError("cannot rename to", filename));
+  }
+}
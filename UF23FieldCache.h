@@ -0,0 +1,127 @@
+#ifndef _UF23FieldCache_h_
+#define _UF23FieldCache_h_
+/**
+ @class UF23FieldCache
+ @brief memory-mapped binary file of a tabulated UF23 field
+
+ File format (version 1, native byte order):
+
+   Header      fixed-size record, see below
+   arrays      up to kMaxArrays arrays, each aligned to kAlignment bytes
+               at the offsets given in the header
+
+ The header records the content type (UF23FieldGrid, UF23FieldOctree
+ or UF23RealizationBank), the model type, the full parameter vector of
+ UF23Field::GetParameters(), the maximum radius and the geometry of
+ the table (number of realizations and seed of a bank). A file is
+ opened read-only with mmap, i.e. all processes on a node reading the
+ same file share one copy in the page cache.
+
+ Files are written to a temporary file which is renamed when complete,
+ i.e. concurrent readers never see a partially written file. The
+ temporary file is created with mkstemp in the directory of the file,
+ i.e. concurrent writers (threads or hosts sharing the directory) do
+ not overwrite each other, the last rename wins.
+
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "UF23Field.h"
+
+class UF23FieldCache {
+public:
+  /// tabulated field type
+  enum EContent {
+    eGrid = 1,
+    eOctree = 2,
+    eRealizations = 3
+  };
+
+  static const std::uint32_t kVersion = 1;
+  static const unsigned int kMaxArrays = 4;
+  static const std::size_t kAlignment = 64;
+
+  /// file header, geometry fields are interpreted by the content type
+  struct Header {
+    char fMagic[8];
+    /// 0x01020304 in the byte order of the writer
+    std::uint32_t fByteOrder;
+    std::uint32_t fVersion;
+    std::uint32_t fContent;
+    std::int32_t fModelType;
+    std::uint32_t fNParameters;
+    std::uint32_t fNArrays;
+    double fParameters[UF23Field::eNpar];
+    double fMaxRadius;
+    /// grid: geometry, interpolation; octree: depth, unused
+    std::uint32_t fFlags[2];
+    /// grid: number of points per dimension
+    std::uint32_t fN[3];
+    std::uint32_t fPadding;
+    /// grid: lower edge and spacing per dimension; octree: half size
+    double fMin[3];
+    double fDelta[3];
+    /// offset from start of file and size of each array in bytes
+    std::uint64_t fArrayOffsets[kMaxArrays];
+    std::uint64_t fArraySizes[kMaxArrays];
+  };
+
+  /// memory block to be written to file
+  struct Array {
+    const void* fData;
+    std::size_t fSize;
+  };
+
+public:
+  /**
+     @brief map a cache file into memory
+     @param filename name of file written with Write()
+     @param content expected content type
+  */
+  UF23FieldCache(const std::string& filename, const EContent content);
+  ~UF23FieldCache();
+  UF23FieldCache() = delete;
+  UF23FieldCache(const UF23FieldCache&) = delete;
+  UF23FieldCache& operator=(const UF23FieldCache&) = delete;
+
+  /// header with model type, parameters and geometry
+  const Header& GetHeader() const { return *fHeader; }
+
+  /// pointer to array i in the mapped file
+  const void* GetArray(const unsigned int i) const;
+  /// size of array i in bytes
+  std::size_t GetArraySize(const unsigned int i) const
+  { return fHeader->fArraySizes[i]; }
+
+  /**
+     @brief header with magic number, version, model type and parameters
+     @param content content type
+     @param modelType model type of tabulated field
+     @param parameters parameters of tabulated field (GetParameters())
+     @param maxRadius maximum radius of tabulated field in kpc
+  */
+  static Header MakeHeader(const EContent content,
+                           const UF23Field::ModelType modelType,
+                           const std::vector<double>& parameters,
+                           const double maxRadius);
+
+  /**
+     @brief write header and arrays to file
+     @param filename name of file
+     @param header header (offsets and sizes are filled in)
+     @param arrays blocks of memory to be written after the header
+  */
+  static void Write(const std::string& filename,
+                    Header header,
+                    const std::vector<Array>& arrays);
+
+private:
+  std::string fFilename;
+  void* fMapping = nullptr;
+  std::size_t fMappingSize = 0;
+  const Header* fHeader = nullptr;
+};
+#endif
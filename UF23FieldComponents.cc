@@ -0,0 +1,48 @@
+#include "UF23FieldComponents.h"
+#include "UF23Units.h"
+
+#include <stdexcept>
+
+double
+UF23FieldComponents::Evaluate(const UF23Field& field,
+                              const UF23Field::EComponent component,
+                              const Vector3* posInKpc,
+                              const std::size_t n)
+{
+  if (component < UF23Field::eCylindrical ||
+      component >= UF23Field::eNComponents)
+    throw std::runtime_error("UF23FieldComponents: not a field component");
+  const bool isExpX = field.GetModelType() == UF23Field::expX;
+  double sum = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Vector3 q = posInKpc[i] * utl::kpc;
+    const UF23Field::Cylindrical cyl =
+      UF23Field::GetCylindrical(field, q.x, q.y, q.z);
+    double bCyl[3] = { 0, 0, 0 };
+    switch (component) {
+    case UF23Field::eSpiralField:
+      UF23Field::AddSpiralField(field, cyl, bCyl);
+      break;
+    case UF23Field::eSpurField:
+      UF23Field::AddSpurField(field, cyl, bCyl);
+      break;
+    case UF23Field::eToroidalHaloField:
+      UF23Field::AddToroidalHaloField(field, cyl, bCyl);
+      break;
+    case UF23Field::ePoloidalHaloField:
+      if (isExpX)
+        UF23Field::AddPoloidalHaloField<true>(field, cyl, bCyl);
+      else
+        UF23Field::AddPoloidalHaloField<false>(field, cyl, bCyl);
+      break;
+    case UF23Field::eTwistedHaloField:
+      UF23Field::AddTwistedHaloField(field, cyl, bCyl);
+      break;
+    default:
+      bCyl[0] = cyl.fDiskSigmoid;
+      break;
+    }
+    sum += bCyl[0] + bCyl[1] + bCyl[2];
+  }
+  return sum;
+}
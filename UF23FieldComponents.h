@@ -0,0 +1,39 @@
+#ifndef _UF23FieldComponents_h_
+#define _UF23FieldComponents_h_
+/**
+ @class UF23FieldComponents
+ @brief internal access to the individual field components of UF23Field
+
+ Not part of the public interface of UF23Field: evaluates one field
+ component (see UF23Field::EComponent) without the others, e.g. to
+ benchmark them (see Bench/benchUF23Field.cxx). The components are
+ calculated as in the scalar UF23Field::operator(), including the
+ cylindrical coordinates, but without the cutoffs of SetTolerance().
+
+ */
+
+#include <cstddef>
+#include "UF23Field.h"
+#include "Vector3.h"
+
+class UF23FieldComponents {
+public:
+  /**
+     @brief one field component at n positions
+     @param field field model and parameters
+     @param component eCylindrical (the cylindrical coordinates and the
+            vertical disk transition of Eq. (13)), eSpiralField,
+            eSpurField, eToroidalHaloField, ePoloidalHaloField (with
+            the radial dependence of the model type) or
+            eTwistedHaloField
+     @param posInKpc positions with components given in kpc
+     @param n number of positions
+     @return sum of B_r + B_phi + B_z (microgauss) over the positions,
+             or of the disk transition for eCylindrical
+  */
+  static double Evaluate(const UF23Field& field,
+                         const UF23Field::EComponent component,
+                         const Vector3* posInKpc,
+                         const std::size_t n);
+};
+#endif
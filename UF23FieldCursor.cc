@@ -0,0 +1,101 @@
+#include "UF23FieldCursor.h"
+#include "UF23Units.h"
+
+
+UF23FieldCursor::UF23FieldCursor(const UF23Field& field) :
+  fField(field)
+{
+  Reset();
+}
+
+void
+UF23FieldCursor::Reset()
+{
+  fContext.Reset();
+  fLastPosition[0] = fLastPosition[1] = fLastPosition[2] = 0;
+  fLastRhoSquared = 0;
+  fNEvaluations = 0;
+  fNFallbacks = 0;
+}
+
+Vector3
+UF23FieldCursor::operator()(const Vector3& posInKpc)
+{
+  const auto pos = posInKpc * utl::kpc;
+  const double dx = pos.x - fLastPosition[0];
+  const double dy = pos.y - fLastPosition[1];
+  const double dz = pos.z - fLastPosition[2];
+  const double stepSquared = dx*dx + dy*dy + dz*dz;
+  const bool isFar =
+    !(stepSquared < utl::anchored::kMaxOffset * utl::anchored::kMaxOffset *
+      fLastRhoSquared);
+  fLastPosition[0] = pos.x;
+  fLastPosition[1] = pos.y;
+  fLastPosition[2] = pos.z;
+  fLastRhoSquared = pos.x*pos.x + pos.y*pos.y;
+  ++fNEvaluations;
+
+  // the anchors would be out of range for (almost) all functions
+  if (isFar) {
+    ++fNFallbacks;
+    return fField(posInKpc);
+  }
+
+  switch (fField.GetModelType()) {
+  case UF23Field::spur:
+    return EvaluateKernel<true, false, false>(pos.x, pos.y, pos.z);
+  case UF23Field::twistX:
+    return EvaluateKernel<false, true, false>(pos.x, pos.y, pos.z);
+  case UF23Field::expX:
+    return EvaluateKernel<false, false, true>(pos.x, pos.y, pos.z);
+  default:
+    return EvaluateKernel<false, false, false>(pos.x, pos.y, pos.z);
+  }
+}
+
+void
+UF23FieldCursor::Evaluate(const std::vector<Vector3>& posInKpc,
+                          std::vector<Vector3>& fieldInMicrogauss)
+{
+  fieldInMicrogauss.resize(posInKpc.size());
+  for (std::size_t i = 0; i < posInKpc.size(); ++i)
+    fieldInMicrogauss[i] = (*this)(posInKpc[i]);
+}
+
+double
+UF23FieldCursor::GetFullEvaluationFraction()
+  const
+{
+  const unsigned long long n = fContext.GetNumberOfCalls();
+  return n ? double(fContext.GetNumberOfUpdates()) / n : 0;
+}
+
+double
+UF23FieldCursor::GetFallbackFraction()
+  const
+{
+  return fNEvaluations ? double(fNFallbacks) / fNEvaluations : 0;
+}
+
+template<bool isSpur, bool isTwistX, bool isExpX>
+Vector3
+UF23FieldCursor::EvaluateKernel(const double x, const double y,
+                                const double z)
+{
+  if (x*x + y*y + z*z > fField.fMaxRadiusSquared)
+    return Vector3(0, 0, 0);
+
+  // same components as UF23Field::operator(), with anchored functions
+  typedef utl::anchored::Scalar Scalar;
+  const utl::anchored::ContextScope scope(fContext);
+  const UF23Field::CylindricalT<Scalar> c =
+    UF23Field::GetCylindrical(fField, Scalar(x), Scalar(y), Scalar(z));
+  Scalar bCyl[3] = { 0, 0, 0 };
+  UF23Field::AddFieldComponents<isSpur, isTwistX, isExpX>(fField, c, bCyl);
+  const double br = bCyl[0].GetValue();
+  const double bPhi = bCyl[1].GetValue();
+  const double cosPhi = c.fCosPhi.GetValue();
+  const double sinPhi = c.fSinPhi.GetValue();
+  return Vector3(br * cosPhi - bPhi * sinPhi, br * sinPhi + bPhi * cosPhi,
+                 bCyl[2].GetValue()) / utl::microgauss;
+}
@@ -0,0 +1,78 @@
+#ifndef _UF23FieldCursor_h_
+#define _UF23FieldCursor_h_
+/**
+ @class UF23FieldCursor
+ @brief evaluation of a UF23 field along a trajectory
+
+ Consecutive positions of a particle track or of a ray are close to
+ each other, i.e. the expensive elementary functions of the field
+ components (atan2 of the azimuth, log and sin/cos of the spiral
+ phase, the powers of the poloidal halo) are called with nearly the
+ same arguments as for the previous position. The cursor keeps the
+ last argument and result of each call as an anchor and calculates
+ the new result from the offset to the anchor with a short series
+ (see UF23Anchored.h), which is cheaper than the standard math
+ library. A call with a (relative) offset larger than 1/64 is
+ evaluated in full and moves the anchor. A step from the previous
+ position longer than 1/64 of its distance to the z-axis, e.g. a jump
+ to a distant position, skips the anchors altogether and is evaluated
+ with UF23Field::operator(): positions in random order are therefore
+ not slower than with UF23Field::operator() (up to 1.4 times slower
+ without this fallback), but not faster either.
+
+ The result deviates from UF23Field::operator() by a few units in the
+ last place, independent of the previous positions (see
+ Test/testUF23FieldCursor.cxx). A cursor is stateful: use one cursor
+ per thread and trajectory. For many trajectories, the batch
+ evaluation of UF23Field (e.g. in UF23Tracker and UF23LineOfSight) is
+ faster.
+
+ */
+
+#include <vector>
+#include "UF23Field.h"
+#include "UF23Anchored.h"
+#include "Vector3.h"
+
+class UF23FieldCursor {
+public:
+  /// cursor of a copy of field
+  explicit UF23FieldCursor(const UF23Field& field);
+  UF23FieldCursor() = delete;
+
+  /// field in microgauss at posInKpc, preferably close to the last one
+  Vector3 operator()(const Vector3& posInKpc);
+
+  /**
+     @brief field along a trajectory
+     @param posInKpc consecutive positions of a trajectory in kpc
+     @param fieldInMicrogauss output field values in microgauss
+            (resized to the number of positions)
+  */
+  void Evaluate(const std::vector<Vector3>& posInKpc,
+                std::vector<Vector3>& fieldInMicrogauss);
+
+  /// forget the anchors and the previous position (not needed for
+  /// correct results)
+  void Reset();
+
+  const UF23Field& GetField() const { return fField; }
+  /// fraction of elementary function calls evaluated in full
+  double GetFullEvaluationFraction() const;
+  /// fraction of positions evaluated with UF23Field::operator()
+  double GetFallbackFraction() const;
+
+private:
+  template<bool isSpur, bool isTwistX, bool isExpX>
+  Vector3 EvaluateKernel(const double x, const double y, const double z);
+
+  UF23Field fField;
+  utl::anchored::Context fContext;
+  // previous position (internal units) and its squared distance to
+  // the z-axis
+  double fLastPosition[3];
+  double fLastRhoSquared;
+  unsigned long long fNEvaluations;
+  unsigned long long fNFallbacks;
+};
+#endif
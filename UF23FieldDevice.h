@@ -0,0 +1,394 @@
+#ifndef _UF23FieldDevice_h_
+#define _UF23FieldDevice_h_
+/**
+ @class UF23FieldDevice
+ @brief device-callable version of UF23Field (e.g. for CUDA kernels)
+
+ A plain block of the model parameters of a UF23Field (including the
+ pre-calculated derived values) with an inline field evaluation that
+ uses only the C math library. Compiled by nvcc, the evaluation is a
+ __host__ __device__ function, i.e. it can be called from the kernels
+ of other GPU applications (e.g. cosmic-ray tracking) with the
+ parameter block in constant or global memory:
+
+   __constant__ UF23FieldDevice gField;   // cudaMemcpyToSymbol(...)
+   __global__ void step(...) { ... gField(x, y, z, bx, by, bz); ... }
+
+ Compiled by a host compiler it is an ordinary inline function, which
+ is tested against UF23Field in Test/testUF23FieldDevice.cxx. See
+ UF23FieldCUDA for the evaluation of device buffers of positions.
+
+ */
+
+#include <cmath>
+#include "UF23Field.h"
+#include "UF23Units.h"
+
+#ifdef __CUDACC__
+#define UF23_HOST_DEVICE __host__ __device__
+#else
+#define UF23_HOST_DEVICE
+#endif
+
+class UF23FieldDevice {
+public:
+  /// parameter block of a UF23Field (host only)
+  explicit UF23FieldDevice(const UF23Field& field);
+  /// trivial default constructor (for variables in device memory)
+  UF23FieldDevice() = default;
+
+  /**
+     @brief calculate coherent magnetic field at a given position
+     @param x,y,z position with components given in kpc
+     @param bx,by,bz output coherent field in microgauss
+            (zero beyond the maximum radius)
+  */
+  UF23_HOST_DEVICE inline
+  void operator()(const double x, const double y, const double z,
+                  double& bx, double& by, double& bz) const;
+
+private:
+  /// cylindrical coordinates, see UF23Field::Cylindrical
+  struct Cylindrical {
+    double fR;
+    double fPhi;
+    double fCosPhi;
+    double fSinPhi;
+    double fZ;
+    double fAbsZ;
+    double fDiskSigmoid;
+  };
+
+  UF23_HOST_DEVICE static inline
+  double Sigmoid(const double x, const double x0, const double invW)
+  { return 1 / (1 + exp(-(x-x0)*invW)); }
+
+  UF23_HOST_DEVICE static inline
+  double DeltaPhi(const double phi0, const double phi1, const double twoPi)
+  { const double d = phi1 - phi0; return fabs(d - twoPi * round(d / twoPi)); }
+
+  UF23_HOST_DEVICE inline
+  void AddSpiralField(const Cylindrical& c, double bCyl[3]) const;
+  UF23_HOST_DEVICE inline
+  void AddSpurField(const Cylindrical& c, double bCyl[3]) const;
+  UF23_HOST_DEVICE inline
+  void AddToroidalHaloField(const Cylindrical& c, double bCyl[3]) const;
+  UF23_HOST_DEVICE inline
+  void GetPoloidalHaloField(const Cylindrical& c, double& bR, double& bZ) const;
+  UF23_HOST_DEVICE inline
+  void AddTwistedHaloField(const Cylindrical& c, double bCyl[3]) const;
+
+  // field components of the model type (see UF23Field::ModelTraits)
+  bool fSpur;
+  bool fTwistX;
+  bool fExpX;
+
+  // parameters and derived values (internal units, see UF23Field)
+  double fMaxRadiusSquared;
+  double fDiskB[3];
+  double fDiskH;
+  double fInvDiskW;
+  double fDiskPhase1;
+  double fSinPitch;
+  double fCosPitch;
+  double fTanPitch;
+  double fInvTanPitch;
+  double fCosDiskPhase[3];
+  double fSinDiskPhase[3];
+  double fPoloidalB;
+  double fPoloidalP;
+  double fPoloidalR;
+  double fInvPoloidalR;
+  double fInvPoloidalW;
+  double fPoloidalC;
+  double fPoloidalA0p;
+  double fInvPoloidalP;
+  double fPoloidalPMinus1;
+  double fPoloidalPMinus2;
+  double fSpurCenter;
+  double fSpurLength;
+  double fInvSpurWidth;
+  double fToroidalBN;
+  double fToroidalBS;
+  double fToroidalR;
+  double fInvToroidalW;
+  double fInvToroidalZ;
+  double fTwistingTime;
+  // constants in internal units
+  double fTwoPi;
+  double fSpurTransition;    ///< 5 degree, Eq. (18)
+  double fRotationVelocity;  ///< -240 km/s, Eq. (45)
+};
+
+inline
+UF23FieldDevice::UF23FieldDevice(const UF23Field& f) :
+  fSpur(f.fModelType == UF23Field::spur),
+  fTwistX(f.fModelType == UF23Field::twistX),
+  fExpX(f.fModelType == UF23Field::expX),
+  fMaxRadiusSquared(f.fMaxRadiusSquared),
+  fDiskB{f.fDiskB1, f.fDiskB2, f.fDiskB3},
+  fDiskH(f.fDiskH),
+  fInvDiskW(f.fInvDiskW),
+  fDiskPhase1(f.fDiskPhase1),
+  fSinPitch(f.fSinPitch),
+  fCosPitch(f.fCosPitch),
+  fTanPitch(f.fTanPitch),
+  fInvTanPitch(f.fInvTanPitch),
+  fCosDiskPhase{f.fCosDiskPhase[0], f.fCosDiskPhase[1], f.fCosDiskPhase[2]},
+  fSinDiskPhase{f.fSinDiskPhase[0], f.fSinDiskPhase[1], f.fSinDiskPhase[2]},
+  fPoloidalB(f.fPoloidalB),
+  fPoloidalP(f.fPoloidalP),
+  fPoloidalR(f.fPoloidalR),
+  fInvPoloidalR(f.fInvPoloidalR),
+  fInvPoloidalW(f.fInvPoloidalW),
+  fPoloidalC(f.fPoloidalC),
+  fPoloidalA0p(f.fPoloidalA0p),
+  fInvPoloidalP(f.fInvPoloidalP),
+  fPoloidalPMinus1(f.fPoloidalPMinus1),
+  fPoloidalPMinus2(f.fPoloidalPMinus2),
+  fSpurCenter(f.fSpurCenter),
+  fSpurLength(f.fSpurLength),
+  fInvSpurWidth(f.fInvSpurWidth),
+  fToroidalBN(f.fToroidalBN),
+  fToroidalBS(f.fToroidalBS),
+  fToroidalR(f.fToroidalR),
+  fInvToroidalW(f.fInvToroidalW),
+  fInvToroidalZ(f.fInvToroidalZ),
+  fTwistingTime(f.fTwistingTime),
+  fTwoPi(utl::kTwoPi),
+  fSpurTransition(5*utl::degree),
+  fRotationVelocity(-240 * utl::kilometer/utl::second)
+{
+}
+
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::operator()(const double x, const double y, const double z,
+                            double& bx, double& by, double& bz)
+  const
+{
+  // (the internal units of UF23Field are kpc and microgauss, i.e. no
+  // conversions are needed here and in the component functions)
+  bx = by = bz = 0;
+  if (x*x + y*y + z*z > fMaxRadiusSquared)
+    return;
+
+  Cylindrical c;
+  c.fR = sqrt(x*x + y*y);
+  const bool offAxis = c.fR > 0;
+  c.fCosPhi = offAxis ? x / c.fR : 1;
+  c.fSinPhi = offAxis ? y / c.fR : 0;
+  c.fPhi = atan2(y, x);
+  c.fZ = z;
+  c.fAbsZ = fabs(z);
+  // Eq. (13)
+  c.fDiskSigmoid = Sigmoid(c.fAbsZ, fDiskH, fInvDiskW);
+
+  double bCyl[3] = { 0, 0, 0 };
+  if (fSpur)
+    AddSpurField(c, bCyl);
+  else
+    AddSpiralField(c, bCyl);
+  if (fTwistX)
+    AddTwistedHaloField(c, bCyl);
+  else {
+    AddToroidalHaloField(c, bCyl);
+    double bR, bZ;
+    GetPoloidalHaloField(c, bR, bZ);
+    bCyl[0] += bR;
+    bCyl[2] += bZ;
+  }
+
+  bx = bCyl[0] * c.fCosPhi - bCyl[1] * c.fSinPhi;
+  by = bCyl[0] * c.fSinPhi + bCyl[1] * c.fCosPhi;
+  bz = bCyl[2];
+}
+
+// -- Sec. 5.2.2, see UF23Field::AddSpiralField()
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::AddSpiralField(const Cylindrical& c, double bCyl[3])
+  const
+{
+  const double rRef = 5;
+  const double rInner = 5;
+  const double wInner = 0.5;
+  const double rOuter = 20;
+  const double wOuter = 0.5;
+
+  const double r = c.fR;
+  if (r == 0)
+    return;
+  const double r2 = r*r;
+
+  // Eq.(13)
+  const double hdz = 1 - c.fDiskSigmoid;
+
+  // Eq.(14) times rRef divided by r
+  const double rFacI = Sigmoid(r, rInner, 1/wInner);
+  const double rFacO = 1 - Sigmoid(r, rOuter, 1/wOuter);
+  const double rFac = r > 1e-8 ? (1-exp(-r2)) / r : r * (1 - r2/2);
+  const double gdrTimesRrefByR = rRef * rFac * rFacO * rFacI;
+
+  // Eq. (12)
+  const double phi0 = c.fPhi - log(r/rRef) * fInvTanPitch;
+
+  // Eq. (10)
+  const double c1 = cos(phi0);
+  const double s1 = sin(phi0);
+  const double c2 = c1*c1 - s1*s1;
+  const double s2 = 2*s1*c1;
+  const double c3 = c2*c1 - s2*s1;
+  const double s3 = s2*c1 + c2*s1;
+  const double b =
+    fDiskB[0] * (c1 * fCosDiskPhase[0] + s1 * fSinDiskPhase[0]) +
+    fDiskB[1] * (c2 * fCosDiskPhase[1] + s2 * fSinDiskPhase[1]) +
+    fDiskB[2] * (c3 * fCosDiskPhase[2] + s3 * fSinDiskPhase[2]);
+
+  // Eq. (11)
+  const double fac = hdz * gdrTimesRrefByR;
+  bCyl[0] += b * fac * fSinPitch;
+  bCyl[1] += b * fac * fCosPitch;
+}
+
+// -- Sec. 5.2.3, see UF23Field::AddSpurField()
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::AddSpurField(const Cylindrical& c, double bCyl[3])
+  const
+{
+  const double rRef = 8.2;
+
+  const double r = c.fR;
+  if (r == 0)
+    return;
+
+  double phi = c.fPhi;
+  if (phi < 0)
+    phi += fTwoPi;
+
+  const double phiRef = fDiskPhase1;
+  int iBest = -2;
+  double bestDist = -1;
+  for (int i = -1; i <= 1; ++i) {
+    const double pphi = phi - phiRef + i*fTwoPi;
+    const double rr = rRef*exp(pphi * fTanPitch);
+    if (bestDist < 0 || fabs(r-rr) < bestDist) {
+      bestDist = fabs(r-rr);
+      iBest = i;
+    }
+  }
+  if (iBest != 0)
+    return;
+
+  const double phi0 = phi - log(r/rRef) * fInvTanPitch;
+
+  // Eq. (16)
+  const double delta = DeltaPhi(phiRef, phi0, fTwoPi) * fInvSpurWidth;
+  const double B = fDiskB[0] * exp(-0.5*delta*delta);
+
+  // Eq. (18)
+  const double deltaPhiC = DeltaPhi(fSpurCenter, phi, fTwoPi);
+  const double gS =
+    1 - Sigmoid(fabs(deltaPhiC), fSpurLength, 1/fSpurTransition);
+
+  // Eq. (13)
+  const double hd = 1 - c.fDiskSigmoid;
+
+  // Eq. (17)
+  const double bS = rRef/r * B * hd * gS;
+  bCyl[0] += bS * fSinPitch;
+  bCyl[1] += bS * fCosPitch;
+}
+
+// -- Sec. 5.3.1, see UF23Field::AddToroidalHaloField()
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::AddToroidalHaloField(const Cylindrical& c, double bCyl[3])
+  const
+{
+  const double b0 = c.fZ >= 0 ? fToroidalBN : fToroidalBS;
+  const double sigmoidR = Sigmoid(c.fR, fToroidalR, fInvToroidalW);
+  // Eq. (21)
+  bCyl[1] +=
+    b0 * (1 - sigmoidR) * c.fDiskSigmoid * exp(-c.fAbsZ*fInvToroidalZ);
+}
+
+// -- Sec. 5.3.2, see UF23Field::GetPoloidalHaloField()
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::GetPoloidalHaloField(const Cylindrical& cyl,
+                                      double& bR, double& bZ)
+  const
+{
+  const double r = cyl.fR;
+  const double c = fPoloidalC;
+  const double a0p = fPoloidalA0p;
+  const double rp = pow(r, fPoloidalP);
+  const double abszp = pow(cyl.fAbsZ, fPoloidalP);
+
+  // stabilized sqrt(a^2 + b) - a
+  const double t0 = a0p + c*abszp - rp;
+  const double t1 = sqrt(t0*t0 + 4*a0p*rp);
+  const double ap = 2*a0p*rp / (t1  + t0);
+  // (ap < 0 does not happen off the z-axis, no exceptions on devices)
+  const double a = ap < 0 ? 0 : pow(ap, fInvPoloidalP);
+
+  // Eq.(29) and Eq.(32)
+  const double radialDependence =
+    fExpX ?
+    exp(-a*fInvPoloidalR) :
+    1 - Sigmoid(a, fPoloidalR, fInvPoloidalW);
+
+  // Eq.(28)
+  const double Bzz = fPoloidalB * radialDependence;
+
+  // (r/a)
+  const double rOverA = 1 / pow(2*a0p / (t1  + t0), fInvPoloidalP);
+
+  // Eq.(35) for p=n
+  const double signZ = cyl.fZ < 0 ? -1 : 1;
+  const double Br =
+    Bzz * c * a / rOverA * signZ * pow(cyl.fAbsZ, fPoloidalPMinus1) / t1;
+
+  // Eq.(36) for p=n
+  bZ = Bzz * pow(rOverA, fPoloidalPMinus2) * (ap + a0p) / t1;
+  bR = r > 0 ? Br : 0;
+}
+
+// -- Sec. 5.3.3, see UF23Field::AddTwistedHaloField()
+UF23_HOST_DEVICE inline
+void
+UF23FieldDevice::AddTwistedHaloField(const Cylindrical& c, double bCyl[3])
+  const
+{
+  double bR, bZ;
+  GetPoloidalHaloField(c, bR, bZ);
+
+  double bPhi = 0;
+  const double r = c.fR;
+  if (fTwistingTime != 0 && r != 0) {
+    const double v0 = fRotationVelocity;
+    const double r0 = 1.6;
+    const double z0 = 10;
+
+    // Eq.(43)
+    const double fr = 1 - exp(-r/r0);
+    // Eq.(44)
+    const double t0 = exp(2*c.fAbsZ/z0);
+    const double gz = 2 / (1 + t0);
+
+    // Eq. (46)
+    const double signZ = c.fZ < 0 ? -1 : 1;
+    const double deltaZ = -signZ * v0 * fr / z0 * t0 * gz * gz;
+    // Eq. (47)
+    const double deltaR = v0 * ((1-fr)/r0 - fr/r) * gz;
+
+    // Eq.(45)
+    bPhi = (bZ * deltaZ + bR * deltaR) * fTwistingTime;
+  }
+  bCyl[0] += bR;
+  bCyl[1] += bPhi;
+  bCyl[2] += bZ;
+}
+#endif
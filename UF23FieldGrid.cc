@@ -0,0 +1,561 @@
+#include "UF23FieldGrid.h"
+#include "UF23FFT.h"
+#include "UF23FieldCache.h"
+#include "UF23TableDeviation.h"
+#include "UF23Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+  // Catmull-Rom weights for the grid points at -1, 0, 1, 2
+  inline
+  void
+  CubicWeights(const double t, double w[4])
+  {
+    const double t2 = t*t;
+    const double t3 = t2*t;
+    w[0] = 0.5 * (-t3 + 2*t2 - t);
+    w[1] = 0.5 * (3*t3 - 5*t2 + 2);
+    w[2] = 0.5 * (-3*t3 + 4*t2 + t);
+    w[3] = 0.5 * (t3 - t2);
+  }
+
+  // enumerator read from a file, at most maxValue
+  std::uint32_t
+  CheckFlag(const std::uint32_t flag, const std::uint32_t maxValue,
+            const std::string& what, const std::string& filename)
+  {
+    if (flag > maxValue)
+      throw std::runtime_error("UF23FieldGrid: invalid " + what + " "
+                               + std::to_string(flag) + " in " + filename);
+    return flag;
+  }
+
+}
+
+UF23FieldGrid::UF23FieldGrid(const UF23Field& field,
+                             const unsigned int n1,
+                             const unsigned int n2,
+                             const unsigned int n3,
+                             const EGeometry geometry,
+                             const EInterpolation interpolation) :
+  fGeometry(geometry),
+  fInterpolation(interpolation),
+  fModelType(field.GetModelType()),
+  fParameters(field.GetParameters())
+{
+  SetGrid(sqrt(field.GetMaximumSquaredRadius()), n1, n2, n3);
+  Fill(field);
+}
+
+UF23FieldGrid::UF23FieldGrid(const UF23Field& field,
+                             const std::size_t maxBytes,
+                             const EGeometry geometry,
+                             const EInterpolation interpolation) :
+  fGeometry(geometry),
+  fInterpolation(interpolation),
+  fModelType(field.GetModelType()),
+  fParameters(field.GetParameters())
+{
+  const double bytesPerPoint = 3 * sizeof(float);
+  const double nPoints = maxBytes / bytesPerPoint;
+  const double maxRadius = sqrt(field.GetMaximumSquaredRadius());
+  if (fGeometry == eCartesian) {
+    // n^3 points in a cube of length 2R
+    const unsigned int n = cbrt(nPoints);
+    SetGrid(maxRadius, n, n, n);
+  }
+  else {
+    // spacing d in r and z, and d at r = R/2 in phi:
+    // n_r * n_phi * n_z = (R/d) * (pi*R/d) * (2*R/d)
+    const double rOverD = cbrt(nPoints / (2*utl::kPi));
+    const unsigned int nR = rOverD;
+    const unsigned int nPhi = utl::kPi * rOverD;
+    const unsigned int nZ = 2 * rOverD;
+    SetGrid(maxRadius, nR, nPhi, nZ);
+  }
+  Fill(field);
+}
+
+UF23FieldGrid::UF23FieldGrid(const std::string& filename) :
+  fCache(std::make_shared<UF23FieldCache>(filename, UF23FieldCache::eGrid)),
+  fGeometry(EGeometry(CheckFlag(fCache->GetHeader().fFlags[0], eCylindrical,
+                                "geometry", filename))),
+  fInterpolation(EInterpolation(CheckFlag(fCache->GetHeader().fFlags[1],
+                                          eDivergenceFree, "interpolation",
+                                          filename)))
+{
+  const UF23FieldCache::Header& header = fCache->GetHeader();
+  fModelType = UF23Field::ModelType(header.fModelType);
+  fParameters.assign(header.fParameters,
+                     header.fParameters + UF23Field::eNpar);
+  if (!(header.fMaxRadius > 0) || !std::isfinite(header.fMaxRadius))
+    throw std::runtime_error("UF23FieldGrid: invalid maximum radius in "
+                             + filename);
+  SetGrid(header.fMaxRadius, header.fN[0], header.fN[1], header.fN[2]);
+  fNValues = 3 * std::size_t(fN[0]) * fN[1] * fN[2];
+  if (fCache->GetArraySize(0) != fNValues * sizeof(float))
+    throw std::runtime_error("UF23FieldGrid: inconsistent table size in "
+                             + filename);
+  fMappedData = static_cast<const float*>(fCache->GetArray(0));
+}
+
+void
+UF23FieldGrid::Write(const std::string& filename)
+  const
+{
+  UF23FieldCache::Header header =
+    UF23FieldCache::MakeHeader(UF23FieldCache::eGrid, fModelType, fParameters,
+                               sqrt(fMaxRadiusSquared));
+  header.fFlags[0] = fGeometry;
+  header.fFlags[1] = fInterpolation;
+  for (unsigned int i = 0; i < 3; ++i) {
+    header.fN[i] = fN[i];
+    header.fMin[i] = fMin[i];
+    header.fDelta[i] = fDelta[i];
+  }
+  UF23FieldCache::Write(filename, header,
+                        { { GetData(), fNValues * sizeof(float) } });
+}
+
+bool
+UF23FieldGrid::Matches(const UF23Field& field)
+  const
+{
+  const double maxRadiusSquared = field.GetMaximumSquaredRadius();
+  return
+    fModelType == field.GetModelType() &&
+    fParameters == field.GetParameters() &&
+    std::abs(fMaxRadiusSquared - maxRadiusSquared) <= 1e-12 * maxRadiusSquared;
+}
+
+void
+UF23FieldGrid::SetGrid(const double maxRadius,
+                       const unsigned int n1,
+                       const unsigned int n2,
+                       const unsigned int n3)
+{
+  if (fInterpolation == eDivergenceFree && fGeometry != eCartesian)
+    throw std::runtime_error("UF23FieldGrid: divergence-free interpolation "
+                             "needs a Cartesian grid");
+  if (n1 < 2 || n2 < 2 || n3 < 2)
+    throw std::runtime_error("UF23FieldGrid: need at least two grid points "
+                             "per dimension, got " + std::to_string(n1) +
+                             ", " + std::to_string(n2) + ", " +
+                             std::to_string(n3));
+
+  fMaxRadiusSquared = maxRadius * maxRadius;
+  fN[0] = n1;
+  fN[1] = n2;
+  fN[2] = n3;
+  if (fGeometry == eCartesian) {
+    for (unsigned int i = 0; i < 3; ++i) {
+      fMin[i] = -maxRadius;
+      fDelta[i] = 2 * maxRadius / (fN[i] - 1);
+    }
+  }
+  else {
+    fMin[0] = 0;
+    fDelta[0] = maxRadius / (fN[0] - 1);
+    // phi is periodic, i.e. no grid point at 2pi
+    fMin[1] = 0;
+    fDelta[1] = utl::kTwoPi / fN[1];
+    fMin[2] = -maxRadius;
+    fDelta[2] = 2 * maxRadius / (fN[2] - 1);
+  }
+  for (unsigned int i = 0; i < 3; ++i)
+    fInvDelta[i] = 1 / fDelta[i];
+}
+
+void
+UF23FieldGrid::Fill(const UF23Field& field)
+{
+  if (fInterpolation == eDivergenceFree) {
+    FillFaces(field);
+    Project();
+    return;
+  }
+
+  fNValues = 3 * std::size_t(fN[0]) * fN[1] * fN[2];
+  fData.resize(fNValues);
+
+  // evaluate one row of grid points along z at a time
+  const unsigned int nZ = fN[2];
+  std::vector<double> x(nZ), y(nZ), z(nZ), bx(nZ), by(nZ), bz(nZ);
+  for (unsigned int k = 0; k < nZ; ++k)
+    z[k] = fMin[2] + k * fDelta[2];
+
+  for (unsigned int i = 0; i < fN[0]; ++i) {
+    for (unsigned int j = 0; j < fN[1]; ++j) {
+      double xx, yy;
+      if (fGeometry == eCartesian) {
+        xx = fMin[0] + i * fDelta[0];
+        yy = fMin[1] + j * fDelta[1];
+      }
+      else {
+        const double r = fMin[0] + i * fDelta[0];
+        const double phi = fMin[1] + j * fDelta[1];
+        xx = r * cos(phi);
+        yy = r * sin(phi);
+      }
+      std::fill(x.begin(), x.end(), xx);
+      std::fill(y.begin(), y.end(), yy);
+      field.Evaluate(x.data(), y.data(), z.data(),
+                     bx.data(), by.data(), bz.data(), nZ);
+      float* const row = &fData[GetOffset(i, j, 0)];
+      for (unsigned int k = 0; k < nZ; ++k) {
+        row[3*k] = bx[k];
+        row[3*k+1] = by[k];
+        row[3*k+2] = bz[k];
+      }
+    }
+  }
+}
+
+void
+UF23FieldGrid::FillFaces(const UF23Field& field)
+{
+  fNValues = 3 * std::size_t(fN[0]) * fN[1] * fN[2];
+  fData.assign(fNValues, 0);
+
+  // the model is cut off at the maximum radius, i.e. its normal
+  // component jumps on the sphere. Sample the field without cut-off
+  // on the whole cube, otherwise Project() would spread the surface
+  // divergence of the cut-off into the interior of the sphere.
+  UF23Field uncut(fModelType, sqrt(3 * fMaxRadiusSquared) * 1.01);
+  uncut.SetParameters(fParameters);
+  uncut.SetVectorization(field.GetVectorization());
+
+  // component d at the centers of the d-faces (grid points in d, cell
+  // centers in the other dimensions)
+  const auto isFace =
+    [this](const unsigned int d, const unsigned int i[3])
+    {
+      for (unsigned int e = 0; e < 3; ++e)
+        if (e != d && i[e] + 1 >= fN[e])
+          return false;
+      return true;
+    };
+
+  // evaluate one row of faces along z at a time
+  const unsigned int nZ = fN[2];
+  std::vector<double> x(nZ), y(nZ), z(nZ), bx(nZ), by(nZ), bz(nZ);
+  const double* const b[3] = { bx.data(), by.data(), bz.data() };
+  for (unsigned int d = 0; d < 3; ++d) {
+    double offset[3] = { 0.5, 0.5, 0.5 };
+    offset[d] = 0;
+    for (unsigned int k = 0; k < nZ; ++k)
+      z[k] = fMin[2] + (k + offset[2]) * fDelta[2];
+    for (unsigned int i = 0; i < fN[0]; ++i) {
+      for (unsigned int j = 0; j < fN[1]; ++j) {
+        std::fill(x.begin(), x.end(), fMin[0] + (i + offset[0]) * fDelta[0]);
+        std::fill(y.begin(), y.end(), fMin[1] + (j + offset[1]) * fDelta[1]);
+        uncut.Evaluate(x.data(), y.data(), z.data(),
+                       bx.data(), by.data(), bz.data(), nZ);
+        for (unsigned int k = 0; k < nZ; ++k) {
+          const unsigned int index[3] = { i, j, k };
+          if (isFace(d, index))
+            fData[GetOffset(i, j, k) + d] = b[d][k];
+        }
+      }
+    }
+  }
+}
+
+void
+UF23FieldGrid::Project()
+{
+  const unsigned int n[3] = { fN[0] - 1, fN[1] - 1, fN[2] - 1 };
+
+  // the net flux through the faces of the cube needs to vanish for
+  // the Poisson equation to have a solution, subtract the (small)
+  // imbalance of the sampled field uniformly from the boundary faces
+  double flux = 0;
+  double totalArea = 0;
+  for (unsigned int pass = 0; pass < 2; ++pass) {
+    for (unsigned int d = 0; d < 3; ++d) {
+      const unsigned int e1 = (d + 1) % 3;
+      const unsigned int e2 = (d + 2) % 3;
+      const double area = fDelta[e1] * fDelta[e2];
+      for (const unsigned int side : { 0u, n[d] }) {
+        const double sign = side ? 1 : -1;
+        unsigned int index[3];
+        index[d] = side;
+        for (index[e1] = 0; index[e1] < n[e1]; ++index[e1]) {
+          for (index[e2] = 0; index[e2] < n[e2]; ++index[e2]) {
+            float& b = fData[GetOffset(index[0], index[1], index[2]) + d];
+            if (pass == 0) {
+              flux += sign * area * b;
+              totalArea += area;
+            }
+            else
+              b -= sign * flux / totalArea;
+          }
+        }
+      }
+    }
+  }
+
+  // discrete divergence of each cell
+  std::vector<double> phi(n[0] * std::size_t(n[1]) * n[2]);
+  for (unsigned int i = 0; i < n[0]; ++i) {
+    for (unsigned int j = 0; j < n[1]; ++j) {
+      for (unsigned int k = 0; k < n[2]; ++k) {
+        const std::size_t offset = GetOffset(i, j, k);
+        phi[(std::size_t(i) * n[1] + j) * n[2] + k] =
+          (fData[GetOffset(i + 1, j, k)] - fData[offset]) * fInvDelta[0] +
+          (fData[GetOffset(i, j + 1, k) + 1] - fData[offset + 1]) *
+          fInvDelta[1] +
+          (fData[GetOffset(i, j, k + 1) + 2] - fData[offset + 2]) *
+          fInvDelta[2];
+      }
+    }
+  }
+
+  // Laplace(phi) = div with zero normal gradient on the faces of the
+  // cube (the boundary faces are kept), diagonal in the cosine basis,
+  // the constant mode vanishes since the net flux through the cube is
+  // zero
+  UF23FFT::CosineTransform(phi, 1, n[0], std::size_t(n[1]) * n[2], false);
+  UF23FFT::CosineTransform(phi, n[0], n[1], n[2], false);
+  UF23FFT::CosineTransform(phi, std::size_t(n[0]) * n[1], n[2], 1, false);
+  // eigenvalues (2 sin(pi p / (2n)) / delta)^2 of -Laplace per dimension
+  std::vector<double> lambda[3];
+  for (unsigned int d = 0; d < 3; ++d)
+    for (unsigned int p = 0; p < n[d]; ++p)
+      lambda[d].push_back(pow(2 * sin(utl::kPi * p / (2 * n[d])) *
+                              fInvDelta[d], 2));
+  for (unsigned int i = 0; i < n[0]; ++i) {
+    for (unsigned int j = 0; j < n[1]; ++j) {
+      for (unsigned int k = 0; k < n[2]; ++k) {
+        const double l = lambda[0][i] + lambda[1][j] + lambda[2][k];
+        double& p = phi[(std::size_t(i) * n[1] + j) * n[2] + k];
+        p = l > 0 ? -p / l : 0;
+      }
+    }
+  }
+  UF23FFT::CosineTransform(phi, 1, n[0], std::size_t(n[1]) * n[2], true);
+  UF23FFT::CosineTransform(phi, n[0], n[1], n[2], true);
+  UF23FFT::CosineTransform(phi, std::size_t(n[0]) * n[1], n[2], 1, true);
+
+  // subtract the gradient of phi at the interior faces
+  for (unsigned int i = 0; i < n[0]; ++i) {
+    for (unsigned int j = 0; j < n[1]; ++j) {
+      for (unsigned int k = 0; k < n[2]; ++k) {
+        const std::size_t c = (std::size_t(i) * n[1] + j) * n[2] + k;
+        float* const v = &fData[GetOffset(i, j, k)];
+        if (i > 0)
+          v[0] -= (phi[c] - phi[c - std::size_t(n[1]) * n[2]]) * fInvDelta[0];
+        if (j > 0)
+          v[1] -= (phi[c] - phi[c - n[2]]) * fInvDelta[1];
+        if (k > 0)
+          v[2] -= (phi[c] - phi[c - 1]) * fInvDelta[2];
+      }
+    }
+  }
+}
+
+Vector3
+UF23FieldGrid::operator()(const Vector3& posInKpc)
+  const
+{
+  if (posInKpc.SquaredLength() > fMaxRadiusSquared)
+    return Vector3(0, 0, 0);
+
+  double u[3];
+  GetGridCoordinates(posInKpc, u);
+  if (fInterpolation == eTrilinear)
+    return InterpolateTrilinear(u);
+  else if (fInterpolation == eTricubic)
+    return InterpolateTricubic(u);
+  else
+    return InterpolateDivergenceFree(u);
+}
+
+void
+UF23FieldGrid::GetGridCoordinates(const Vector3& pos, double u[3])
+  const
+{
+  if (fGeometry == eCartesian) {
+    u[0] = (pos.x - fMin[0]) * fInvDelta[0];
+    u[1] = (pos.y - fMin[1]) * fInvDelta[1];
+  }
+  else {
+    const double r = sqrt(pos.x*pos.x + pos.y*pos.y);
+    double phi = atan2(pos.y, pos.x);
+    if (phi < 0)
+      phi += utl::kTwoPi;
+    u[0] = (r - fMin[0]) * fInvDelta[0];
+    u[1] = (phi - fMin[1]) * fInvDelta[1];
+  }
+  u[2] = (pos.z - fMin[2]) * fInvDelta[2];
+}
+
+unsigned int
+UF23FieldGrid::GetIndex(const unsigned int dim, const int i)
+  const
+{
+  const int n = fN[dim];
+  if (IsPeriodic(dim))
+    return ((i % n) + n) % n;
+  else
+    return std::min(std::max(i, 0), n - 1);
+}
+
+int
+UF23FieldGrid::GetLowerIndex(const unsigned int dim, const double u)
+  const
+{
+  const int i = floor(u);
+  if (IsPeriodic(dim))
+    return i;
+  else
+    // cell needs to be inside of the grid
+    return std::min(std::max(i, 0), int(fN[dim]) - 2);
+}
+
+Vector3
+UF23FieldGrid::InterpolateTrilinear(const double u[3])
+  const
+{
+  int i0[3];
+  double t[3];
+  for (unsigned int d = 0; d < 3; ++d) {
+    i0[d] = GetLowerIndex(d, u[d]);
+    t[d] = std::min(std::max(u[d] - i0[d], 0.), 1.);
+  }
+
+  const float* const data = GetData();
+  double b[3] = { 0, 0, 0 };
+  for (unsigned int a = 0; a < 2; ++a) {
+    const unsigned int ia = GetIndex(0, i0[0] + a);
+    const double wa = a ? t[0] : 1 - t[0];
+    for (unsigned int c = 0; c < 2; ++c) {
+      const unsigned int ic = GetIndex(1, i0[1] + c);
+      const double wac = wa * (c ? t[1] : 1 - t[1]);
+      for (unsigned int e = 0; e < 2; ++e) {
+        const unsigned int ie = GetIndex(2, i0[2] + e);
+        const double w = wac * (e ? t[2] : 1 - t[2]);
+        const float* const v = &data[GetOffset(ia, ic, ie)];
+        b[0] += w * v[0];
+        b[1] += w * v[1];
+        b[2] += w * v[2];
+      }
+    }
+  }
+  return Vector3(b[0], b[1], b[2]);
+}
+
+Vector3
+UF23FieldGrid::InterpolateTricubic(const double u[3])
+  const
+{
+  int i0[3];
+  double w[3][4];
+  for (unsigned int d = 0; d < 3; ++d) {
+    i0[d] = GetLowerIndex(d, u[d]);
+    CubicWeights(std::min(std::max(u[d] - i0[d], 0.), 1.), w[d]);
+  }
+
+  const float* const data = GetData();
+  double b[3] = { 0, 0, 0 };
+  for (int a = 0; a < 4; ++a) {
+    const unsigned int ia = GetIndex(0, i0[0] + a - 1);
+    for (int c = 0; c < 4; ++c) {
+      const unsigned int ic = GetIndex(1, i0[1] + c - 1);
+      const double wac = w[0][a] * w[1][c];
+      for (int e = 0; e < 4; ++e) {
+        const unsigned int ie = GetIndex(2, i0[2] + e - 1);
+        const double ww = wac * w[2][e];
+        const float* const v = &data[GetOffset(ia, ic, ie)];
+        b[0] += ww * v[0];
+        b[1] += ww * v[1];
+        b[2] += ww * v[2];
+      }
+    }
+  }
+  return Vector3(b[0], b[1], b[2]);
+}
+
+double
+UF23FieldGrid::GetFaceSlope(const unsigned int d, const unsigned int e,
+                            const int i[3])
+  const
+{
+  // central difference of the faces of the neighbouring cells along e,
+  // one-sided at the first and last cell
+  const int lower = std::max(i[e] - 1, 0);
+  const int upper = std::min(i[e] + 1, int(fN[e]) - 2);
+  if (upper <= lower)
+    return 0;
+  int iLower[3] = { i[0], i[1], i[2] };
+  int iUpper[3] = { i[0], i[1], i[2] };
+  iLower[e] = lower;
+  iUpper[e] = upper;
+  const float* const data = GetData();
+  return (data[GetOffset(iUpper[0], iUpper[1], iUpper[2]) + d] -
+          data[GetOffset(iLower[0], iLower[1], iLower[2]) + d]) /
+    (upper - lower);
+}
+
+Vector3
+UF23FieldGrid::InterpolateDivergenceFree(const double u[3])
+  const
+{
+  // cell and local coordinates in [-1/2, 1/2]
+  int c[3];
+  double x[3];
+  for (unsigned int d = 0; d < 3; ++d) {
+    c[d] = GetLowerIndex(d, u[d]);
+    x[d] = std::min(std::max(u[d] - c[d], 0.), 1.) - 0.5;
+  }
+
+  // normal component at the lower and upper d-face of the cell and its
+  // slopes (per cell) along the other dimensions
+  const float* const data = GetData();
+  double b[3][2];
+  double s[3][2][3];
+  for (unsigned int d = 0; d < 3; ++d) {
+    for (unsigned int side = 0; side < 2; ++side) {
+      int f[3] = { c[0], c[1], c[2] };
+      f[d] += side;
+      b[d][side] = data[GetOffset(f[0], f[1], f[2]) + d];
+      for (unsigned int e = 0; e < 3; ++e)
+        s[d][side][e] = e == d ? 0 : GetFaceSlope(d, e, f);
+    }
+  }
+
+  // quadratic reconstruction of Balsara (2001): linear in the normal
+  // direction between the faces, the curvature along d follows from
+  // div(B) = 0 for the terms linear in x_d
+  double field[3];
+  for (unsigned int d = 0; d < 3; ++d) {
+    double curvature = 0;
+    for (unsigned int e = 0; e < 3; ++e)
+      if (e != d)
+        curvature -= 0.5 * (s[e][1][d] - s[e][0][d]) * fDelta[d] / fDelta[e];
+    double bd =
+      0.5 * (b[d][0] + b[d][1]) - 0.25 * curvature +
+      (b[d][1] - b[d][0]) * x[d] + curvature * x[d] * x[d];
+    for (unsigned int e = 0; e < 3; ++e)
+      if (e != d)
+        bd += (0.5 * (s[d][0][e] + s[d][1][e]) +
+               (s[d][1][e] - s[d][0][e]) * x[d]) * x[e];
+    field[d] = bd;
+  }
+  return Vector3(field[0], field[1], field[2]);
+}
+
+double
+UF23FieldGrid::GetMaximumDeviation(const UF23Field& field,
+                                   const std::vector<Vector3>& positionsInKpc,
+                                   double& maxRelDeviation)
+  const
+{
+  return utl::GetMaximumDeviation(*this, field, positionsInKpc,
+                                  maxRelDeviation);
+}
@@ -0,0 +1,195 @@
+#ifndef _UF23FieldGrid_h_
+#define _UF23FieldGrid_h_
+/**
+ @class UF23FieldGrid
+ @brief tabulated UF23 field with interpolation
+
+ Samples a UF23Field on a regular Cartesian or cylindrical grid
+ covering the sphere of radius sqrt(GetMaximumSquaredRadius()) and
+ returns interpolated field values. The field components are stored
+ in single precision, i.e. the memory footprint is 12 bytes per grid
+ point.
+
+ On the cylindrical grid (r, phi, z) the field is stored in Cartesian
+ components to avoid the coordinate singularity at r = 0, phi is
+ periodic on [0, 2pi).
+
+ With eDivergenceFree (Cartesian grids only) the table holds the
+ normal field component at the center of each cell face (staggered
+ grid) instead of the field at the grid points, sampled without the
+ cut-off at the maximum radius on the whole cube enclosing the field
+ sphere. After sampling, the discrete divergence of each cell is
+ removed by subtracting the gradient of the solution of a Poisson
+ equation (solved with cosine transforms, normal component on the
+ faces of the cube kept), and the field is interpolated with the
+ divergence-free quadratic reconstruction of Balsara (2001,
+ J. Comput. Phys. 174, 614) from the face values and their
+ transverse slopes. The interpolated field is thus divergence-free
+ within each cell and its normal component is continuous across cell
+ faces (up to single precision rounding), i.e. field lines neither
+ start nor end inside the sphere. As for the model, the field is
+ zero outside of the sphere. Since each component is only known on
+ one set of faces, the RMS deviation from the model is about twice
+ that of the trilinear interpolation for the same memory (0.9 to 2.2
+ times for the models in Test/testUF23FieldGridDivergence.cxx).
+
+ */
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "UF23Field.h"
+#include "Vector3.h"
+
+class UF23FieldCache;
+
+class UF23FieldGrid {
+public:
+  /// grid geometry
+  enum EGeometry {
+    eCartesian,   ///< x, y, z
+    eCylindrical  ///< r, phi, z
+  };
+
+  /// interpolation method
+  enum EInterpolation {
+    eTrilinear,  ///< 8 grid points, continuous
+    eTricubic,   ///< 64 grid points (Catmull-Rom), continuous derivatives
+    /// staggered face values, divergence-free (Cartesian grids only),
+    /// about twice the deviation from the model of eTrilinear for the
+    /// same memory
+    eDivergenceFree
+  };
+
+public:
+  /**
+     @brief constructor
+     @param field UF23 field to be tabulated
+     @param n1 number of grid points in x (Cartesian) or r (cylindrical)
+     @param n2 number of grid points in y (Cartesian) or phi (cylindrical)
+     @param n3 number of grid points in z
+     @param geometry Cartesian or cylindrical grid
+     @param interpolation trilinear, tricubic or divergence-free
+            interpolation (Cartesian grids only)
+  */
+  UF23FieldGrid(const UF23Field& field,
+                const unsigned int n1,
+                const unsigned int n2,
+                const unsigned int n3,
+                const EGeometry geometry = eCartesian,
+                const EInterpolation interpolation = eTrilinear);
+  /**
+     @brief constructor for a given memory budget
+     @param field UF23 field to be tabulated
+     @param maxBytes maximum size of the table in bytes, the grid points
+            are chosen to have approximately equidistant spacing
+     @param geometry Cartesian or cylindrical grid
+     @param interpolation trilinear, tricubic or divergence-free
+            interpolation (Cartesian grids only)
+  */
+  UF23FieldGrid(const UF23Field& field,
+                const std::size_t maxBytes,
+                const EGeometry geometry = eCartesian,
+                const EInterpolation interpolation = eTrilinear);
+  /**
+     @brief constructor mapping a table written with Write()
+     @param filename name of cache file
+
+     The table is mapped read-only into memory and shared between
+     all processes reading the same file.
+  */
+  explicit UF23FieldGrid(const std::string& filename);
+  /// no default constructor
+  UF23FieldGrid() = delete;
+
+  /**
+     @brief interpolated coherent magnetic field at a given position
+     @param posInKpc position with components given in kpc
+     @return coherent field in microgauss
+  */
+  Vector3 operator()(const Vector3& posInKpc) const;
+
+  /**
+     @brief maximum deviation from the analytic field model
+     @param field UF23 field used to build the grid
+     @param positionsInKpc positions to test (kpc)
+     @param maxRelDeviation output: maximum of |B_grid - B| / |B|
+            for positions with |B| > 0
+     @return maximum of |B_grid - B| in microgauss
+  */
+  double GetMaximumDeviation(const UF23Field& field,
+                             const std::vector<Vector3>& positionsInKpc,
+                             double& maxRelDeviation) const;
+
+  /// write table to a cache file (see UF23FieldCache)
+  void Write(const std::string& filename) const;
+
+  /// true if the table was built from a field with the same model and parameters
+  bool Matches(const UF23Field& field) const;
+
+  EGeometry GetGeometry() const { return fGeometry; }
+  EInterpolation GetInterpolation() const { return fInterpolation; }
+  /// number of grid points in dimension i = 0, 1, 2
+  unsigned int GetNumberOfGridPoints(const unsigned int i) const
+  { return fN[i]; }
+  /// grid spacing in dimension i = 0, 1, 2 (kpc or radian)
+  double GetGridSpacing(const unsigned int i) const
+  { return fDelta[i]; }
+  /// size of the table in bytes
+  std::size_t GetMemorySize() const
+  { return fNValues * sizeof(float); }
+  /// true if the table is mapped from a cache file
+  bool IsMapped() const { return bool(fCache); }
+
+private:
+  void Fill(const UF23Field& field);
+  /// sample the normal components at the face centers (eDivergenceFree)
+  void FillFaces(const UF23Field& field);
+  /// remove the discrete divergence of the face values
+  void Project();
+  void SetGrid(const double maxRadius,
+               const unsigned int n1,
+               const unsigned int n2,
+               const unsigned int n3);
+  /// grid coordinates of a position (kpc)
+  void GetGridCoordinates(const Vector3& pos, double u[3]) const;
+  Vector3 InterpolateTrilinear(const double u[3]) const;
+  Vector3 InterpolateTricubic(const double u[3]) const;
+  Vector3 InterpolateDivergenceFree(const double u[3]) const;
+  /// slope per cell of component d along dimension e at face index i
+  double GetFaceSlope(const unsigned int d, const unsigned int e,
+                      const int i[3]) const;
+  /// phi is periodic on the cylindrical grid
+  bool IsPeriodic(const unsigned int dim) const
+  { return fGeometry == eCylindrical && dim == 1; }
+  /// index of grid point in each dimension (clamped or periodic)
+  unsigned int GetIndex(const unsigned int dim, const int i) const;
+  /// lower grid point of cell containing grid coordinate u
+  int GetLowerIndex(const unsigned int dim, const double u) const;
+  std::size_t GetOffset(const unsigned int i, const unsigned int j,
+                        const unsigned int k) const
+  { return 3 * ((std::size_t(i) * fN[1] + j) * fN[2] + k); }
+  /// field components in memory or in the mapped file
+  const float* GetData() const
+  { return fCache ? fMappedData : fData.data(); }
+
+  std::shared_ptr<const UF23FieldCache> fCache;
+  const EGeometry fGeometry;
+  const EInterpolation fInterpolation;
+  double fMaxRadiusSquared = 0;
+  unsigned int fN[3] = { 0 };
+  double fMin[3] = { 0 };
+  double fDelta[3] = { 0 };
+  double fInvDelta[3] = { 0 };
+  /// model and parameters of the tabulated field
+  UF23Field::ModelType fModelType = UF23Field::base;
+  std::vector<double> fParameters;
+  /// field components (x, y, z) for each grid point, or for
+  /// eDivergenceFree the normal components at the lower x-, y- and
+  /// z-faces of the cell with lower corner (i, j, k)
+  std::vector<float> fData;
+  const float* fMappedData = nullptr;
+  std::size_t fNValues = 0;
+};
+#endif
@@ -0,0 +1,347 @@
+#include "UF23FieldOctree.h"
+#include "UF23FieldCache.h"
+#include "UF23TableDeviation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+  // maximum number of cells refined at once (limits temporary memory)
+  const std::size_t kChunkSize = 1 << 16;
+
+  // lower corner of a cell in units of the smallest cell
+  struct Cell {
+    std::uint32_t fNode;
+    std::uint32_t fI[3];
+  };
+
+  inline
+  std::uint64_t
+  VertexKey(const std::uint64_t i, const std::uint64_t j, const std::uint64_t k)
+  {
+    return (i << 42) | (j << 21) | k;
+  }
+
+  /*
+    Checks the trilinear interpolation between the corners of a cell
+    at the edge, face and cell centers. The 3x3x3 vertices are indexed
+    by 9*a + 3*b + c with a, b, c = 0, 1, 2 along x, y, z.
+  */
+  bool
+  NeedsRefinement(const std::uint32_t* const vertices,
+                  const std::vector<float>& vertexData,
+                  const double relTolerance,
+                  const double absTolerance)
+  {
+    for (unsigned int a = 0; a < 3; ++a) {
+      for (unsigned int b = 0; b < 3; ++b) {
+        for (unsigned int c = 0; c < 3; ++c) {
+          if (a != 1 && b != 1 && c != 1)
+            continue;
+          double interpolated[3] = { 0, 0, 0 };
+          unsigned int n = 0;
+          for (unsigned int ca = (a == 1 ? 0 : a); ca <= (a == 1 ? 2 : a); ca += 2)
+            for (unsigned int cb = (b == 1 ? 0 : b); cb <= (b == 1 ? 2 : b); cb += 2)
+              for (unsigned int cc = (c == 1 ? 0 : c); cc <= (c == 1 ? 2 : c); cc += 2) {
+                const float* const v = &vertexData[3*vertices[9*ca + 3*cb + cc]];
+                for (unsigned int d = 0; d < 3; ++d)
+                  interpolated[d] += v[d];
+                ++n;
+              }
+          const float* const v = &vertexData[3*vertices[9*a + 3*b + c]];
+          double deviation2 = 0;
+          double field2 = 0;
+          for (unsigned int d = 0; d < 3; ++d) {
+            const double diff = interpolated[d] / n - v[d];
+            deviation2 += diff * diff;
+            field2 += double(v[d]) * v[d];
+          }
+          const double tolerance = absTolerance + relTolerance * sqrt(field2);
+          if (deviation2 > tolerance * tolerance)
+            return true;
+        }
+      }
+    }
+    return false;
+  }
+
+}
+
+UF23FieldOctree::UF23FieldOctree(const UF23Field& field,
+                                 const double relTolerance,
+                                 const double absTolerance,
+                                 const unsigned int maxDepth,
+                                 const unsigned int minDepth) :
+  fModelType(field.GetModelType()),
+  fParameters(field.GetParameters())
+{
+  if (maxDepth > 20)
+    throw std::runtime_error("UF23FieldOctree: maximum depth "
+                             + std::to_string(maxDepth) + " > 20");
+  if (minDepth > maxDepth)
+    throw std::runtime_error("UF23FieldOctree: minimum depth "
+                             + std::to_string(minDepth) + " > maximum depth "
+                             + std::to_string(maxDepth));
+  fMaxRadiusSquared = field.GetMaximumSquaredRadius();
+  fHalfSize = sqrt(fMaxRadiusSquared);
+  Build(field, relTolerance, absTolerance, maxDepth, minDepth);
+}
+
+UF23FieldOctree::UF23FieldOctree(const std::string& filename) :
+  fCache(std::make_shared<UF23FieldCache>(filename, UF23FieldCache::eOctree))
+{
+  const UF23FieldCache::Header& header = fCache->GetHeader();
+  fModelType = UF23Field::ModelType(header.fModelType);
+  fParameters.assign(header.fParameters,
+                     header.fParameters + UF23Field::eNpar);
+  fMaxRadiusSquared = header.fMaxRadius * header.fMaxRadius;
+  fHalfSize = header.fMin[0];
+  fDepth = header.fFlags[0];
+  if (fDepth > 20 || !(fHalfSize > 0) || !std::isfinite(fHalfSize))
+    throw std::runtime_error("UF23FieldOctree: invalid depth "
+                             + std::to_string(fDepth) + " or half size "
+                             + std::to_string(fHalfSize) + " in " + filename);
+  if (!(fMaxRadiusSquared > 0) || !std::isfinite(fMaxRadiusSquared))
+    throw std::runtime_error("UF23FieldOctree: invalid maximum radius in "
+                             + filename);
+  fNNodes = fCache->GetArraySize(0) / sizeof(std::uint32_t);
+  fNLeaves = fCache->GetArraySize(1) / (8 * sizeof(std::uint32_t));
+  fNVertices = fCache->GetArraySize(2) / (3 * sizeof(float));
+  if (fNNodes == 0 || fNLeaves == 0)
+    throw std::runtime_error("UF23FieldOctree: empty tree in " + filename);
+  fMappedArrays.fNodes =
+    static_cast<const std::uint32_t*>(fCache->GetArray(0));
+  fMappedArrays.fLeafVertices =
+    static_cast<const std::uint32_t*>(fCache->GetArray(1));
+  fMappedArrays.fVertexData = static_cast<const float*>(fCache->GetArray(2));
+}
+
+void
+UF23FieldOctree::Write(const std::string& filename)
+  const
+{
+  UF23FieldCache::Header header =
+    UF23FieldCache::MakeHeader(UF23FieldCache::eOctree, fModelType,
+                               fParameters, sqrt(fMaxRadiusSquared));
+  header.fFlags[0] = fDepth;
+  header.fMin[0] = fHalfSize;
+  const Arrays arrays = GetArrays();
+  UF23FieldCache::Write(filename, header,
+                        { { arrays.fNodes, fNNodes * sizeof(std::uint32_t) },
+                          { arrays.fLeafVertices,
+                            8 * fNLeaves * sizeof(std::uint32_t) },
+                          { arrays.fVertexData,
+                            3 * fNVertices * sizeof(float) } });
+}
+
+bool
+UF23FieldOctree::Matches(const UF23Field& field)
+  const
+{
+  const double maxRadiusSquared = field.GetMaximumSquaredRadius();
+  return
+    fModelType == field.GetModelType() &&
+    fParameters == field.GetParameters() &&
+    std::abs(fMaxRadiusSquared - maxRadiusSquared) <= 1e-12 * maxRadiusSquared;
+}
+
+void
+UF23FieldOctree::Build(const UF23Field& field,
+                       const double relTolerance,
+                       const double absTolerance,
+                       const unsigned int maxDepth,
+                       const unsigned int minDepth)
+{
+  const std::uint32_t nMax = 1u << maxDepth;
+  const double unit = 2 * fHalfSize / nMax;
+
+  // all evaluated vertices, pending vertices are evaluated in batches
+  std::unordered_map<std::uint64_t, std::uint32_t> vertexIndices;
+  std::vector<float> vertexData;
+  std::vector<double> x, y, z, bx, by, bz;
+  auto getVertex =
+    [&](const std::uint32_t i, const std::uint32_t j, const std::uint32_t k)
+    {
+      const auto inserted =
+        vertexIndices.emplace(VertexKey(i, j, k), vertexIndices.size());
+      if (inserted.second) {
+        x.push_back(-fHalfSize + i * unit);
+        y.push_back(-fHalfSize + j * unit);
+        z.push_back(-fHalfSize + k * unit);
+      }
+      return inserted.first->second;
+    };
+  auto evaluatePending =
+    [&]()
+    {
+      const std::size_t n = x.size();
+      bx.resize(n);
+      by.resize(n);
+      bz.resize(n);
+      field.Evaluate(x.data(), y.data(), z.data(),
+                     bx.data(), by.data(), bz.data(), n);
+      for (std::size_t i = 0; i < n; ++i) {
+        vertexData.push_back(bx[i]);
+        vertexData.push_back(by[i]);
+        vertexData.push_back(bz[i]);
+      }
+      x.clear();
+      y.clear();
+      z.clear();
+    };
+
+  fNodes.assign(1, 0);
+  fLeafVertices.clear();
+  fDepth = 0;
+  std::vector<Cell> cells(1, Cell{0, {0, 0, 0}});
+  for (unsigned int corner = 0; corner < 8; ++corner)
+    getVertex((corner >> 2) * nMax, ((corner >> 1) & 1) * nMax,
+              (corner & 1) * nMax);
+  evaluatePending();
+
+  std::vector<std::uint32_t> vertices;
+  std::vector<Cell> nextCells;
+  for (unsigned int depth = 0; !cells.empty(); ++depth) {
+    const std::uint32_t size = nMax >> depth;
+    const std::uint32_t half = size / 2;
+    const bool canRefine = depth < maxDepth;
+    nextCells.clear();
+    for (std::size_t first = 0; first < cells.size(); first += kChunkSize) {
+      const std::size_t last = std::min(first + kChunkSize, cells.size());
+
+      // 3x3x3 vertices of each cell, i.e. the corners of its children
+      if (canRefine) {
+        vertices.resize(27 * (last - first));
+        for (std::size_t iCell = first; iCell < last; ++iCell) {
+          const std::uint32_t* const i0 = cells[iCell].fI;
+          std::uint32_t* const v = &vertices[27 * (iCell - first)];
+          for (unsigned int a = 0; a < 3; ++a)
+            for (unsigned int b = 0; b < 3; ++b)
+              for (unsigned int c = 0; c < 3; ++c)
+                v[9*a + 3*b + c] =
+                  getVertex(i0[0] + a*half, i0[1] + b*half, i0[2] + c*half);
+        }
+        evaluatePending();
+      }
+
+      for (std::size_t iCell = first; iCell < last; ++iCell) {
+        const Cell& cell = cells[iCell];
+        const std::uint32_t* const v =
+          canRefine ? &vertices[27 * (iCell - first)] : nullptr;
+        const bool refine = canRefine &&
+          (depth < minDepth ||
+           NeedsRefinement(v, vertexData, relTolerance, absTolerance));
+        if (refine) {
+          if (fNodes.size() + 8 >= kLeaf)
+            throw std::runtime_error("UF23FieldOctree: too many nodes");
+          fNodes[cell.fNode] = fNodes.size();
+          for (unsigned int child = 0; child < 8; ++child) {
+            const std::uint32_t a = child >> 2;
+            const std::uint32_t b = (child >> 1) & 1;
+            const std::uint32_t c = child & 1;
+            Cell childCell =
+              { std::uint32_t(fNodes.size()),
+                { cell.fI[0] + a*half, cell.fI[1] + b*half,
+                  cell.fI[2] + c*half } };
+            nextCells.push_back(childCell);
+            fNodes.push_back(0);
+          }
+        }
+        else {
+          fNodes[cell.fNode] = kLeaf | (fLeafVertices.size() / 8);
+          for (unsigned int corner = 0; corner < 8; ++corner) {
+            const std::uint32_t a = corner >> 2;
+            const std::uint32_t b = (corner >> 1) & 1;
+            const std::uint32_t c = corner & 1;
+            // corners of deepest cells were created by their parents
+            fLeafVertices.push_back(canRefine ?
+                                    v[18*a + 6*b + 2*c] :
+                                    getVertex(cell.fI[0] + a*size,
+                                              cell.fI[1] + b*size,
+                                              cell.fI[2] + c*size));
+          }
+          fDepth = std::max(fDepth, depth);
+        }
+      }
+    }
+    cells.swap(nextCells);
+  }
+
+  // keep only vertices referenced by leaves
+  const std::uint32_t kUnused = std::numeric_limits<std::uint32_t>::max();
+  std::vector<std::uint32_t> newIndices(vertexData.size() / 3, kUnused);
+  fVertexData.clear();
+  for (auto& index : fLeafVertices) {
+    if (newIndices[index] == kUnused) {
+      newIndices[index] = fVertexData.size() / 3;
+      fVertexData.insert(fVertexData.end(), &vertexData[3*index],
+                         &vertexData[3*index] + 3);
+    }
+    index = newIndices[index];
+  }
+  fNodes.shrink_to_fit();
+  fLeafVertices.shrink_to_fit();
+  fVertexData.shrink_to_fit();
+  fNNodes = fNodes.size();
+  fNLeaves = fLeafVertices.size() / 8;
+  fNVertices = fVertexData.size() / 3;
+}
+
+Vector3
+UF23FieldOctree::operator()(const Vector3& posInKpc)
+  const
+{
+  if (posInKpc.SquaredLength() > fMaxRadiusSquared)
+    return Vector3(0, 0, 0);
+
+  // position in units of the root cell
+  const double invSize = 0.5 / fHalfSize;
+  double u[3] = { (posInKpc.x + fHalfSize) * invSize,
+                  (posInKpc.y + fHalfSize) * invSize,
+                  (posInKpc.z + fHalfSize) * invSize };
+  for (unsigned int d = 0; d < 3; ++d)
+    u[d] = std::min(std::max(u[d], 0.), 1.);
+
+  const Arrays arrays = GetArrays();
+  std::uint32_t node = arrays.fNodes[0];
+  while (!(node & kLeaf)) {
+    unsigned int child = 0;
+    for (unsigned int d = 0; d < 3; ++d) {
+      u[d] *= 2;
+      const unsigned int upper = u[d] >= 1;
+      u[d] -= upper;
+      child = (child << 1) | upper;
+    }
+    node = arrays.fNodes[node + child];
+  }
+
+  const std::uint32_t* const vertices =
+    &arrays.fLeafVertices[8 * (node & ~kLeaf)];
+  double b[3] = { 0, 0, 0 };
+  for (unsigned int corner = 0; corner < 8; ++corner) {
+    const double w =
+      (corner & 4 ? u[0] : 1 - u[0]) *
+      (corner & 2 ? u[1] : 1 - u[1]) *
+      (corner & 1 ? u[2] : 1 - u[2]);
+    const float* const v = &arrays.fVertexData[3 * vertices[corner]];
+    b[0] += w * v[0];
+    b[1] += w * v[1];
+    b[2] += w * v[2];
+  }
+  return Vector3(b[0], b[1], b[2]);
+}
+
+double
+UF23FieldOctree::GetMaximumDeviation(const UF23Field& field,
+                                     const std::vector<Vector3>& positionsInKpc,
+                                     double& maxRelDeviation)
+  const
+{
+  return utl::GetMaximumDeviation(*this, field, positionsInKpc,
+                                  maxRelDeviation);
+}
@@ -0,0 +1,150 @@
+#ifndef _UF23FieldOctree_h_
+#define _UF23FieldOctree_h_
+/**
+ @class UF23FieldOctree
+ @brief adaptively tabulated UF23 field
+
+ Samples a UF23Field on an octree covering the cube enclosing the
+ sphere of radius sqrt(GetMaximumSquaredRadius()). Starting from a
+ uniform tree of depth minDepth, a cell is split into eight children
+ if trilinear interpolation between its corners deviates from the
+ field model at any of the 19 edge, face and cell centers by more than
+
+   absTolerance + relTolerance * |B|,
+
+ until maxDepth is reached. The sampled edge, face and cell centers
+ are reused as the corners of the children.
+
+ The tree is stored as a flat array of nodes in breadth-first order,
+ the eight children of a node are contiguous. Each leaf refers to its
+ eight corners in an array of (shared) vertices which hold the field
+ components in single precision.
+
+ Note that the interpolated field is not continuous across leaves of
+ different depth. Discontinuities of the model itself (the toroidal
+ halo at the z-axis, the disk of twistX at z = 0) are refined down to
+ maxDepth.
+
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "UF23Field.h"
+#include "Vector3.h"
+
+class UF23FieldCache;
+
+class UF23FieldOctree {
+public:
+  /**
+     @brief constructor
+     @param field UF23 field to be tabulated
+     @param relTolerance relative interpolation tolerance
+     @param absTolerance absolute interpolation tolerance in microgauss
+     @param maxDepth maximum depth of the tree (at most 20)
+     @param minDepth depth of initial uniform tree
+  */
+  UF23FieldOctree(const UF23Field& field,
+                  const double relTolerance,
+                  const double absTolerance,
+                  const unsigned int maxDepth = 12,
+                  const unsigned int minDepth = 4);
+  /**
+     @brief constructor mapping a tree written with Write()
+     @param filename name of cache file
+
+     The tree is mapped read-only into memory and shared between
+     all processes reading the same file.
+  */
+  explicit UF23FieldOctree(const std::string& filename);
+  /// no default constructor
+  UF23FieldOctree() = delete;
+
+  /**
+     @brief interpolated coherent magnetic field at a given position
+     @param posInKpc position with components given in kpc
+     @return coherent field in microgauss
+  */
+  Vector3 operator()(const Vector3& posInKpc) const;
+
+  /**
+     @brief maximum deviation from the analytic field model
+     @param field UF23 field used to build the tree
+     @param positionsInKpc positions to test (kpc)
+     @param maxRelDeviation output: maximum of |B_tree - B| / |B|
+            for positions with |B| > 0
+     @return maximum of |B_tree - B| in microgauss
+  */
+  double GetMaximumDeviation(const UF23Field& field,
+                             const std::vector<Vector3>& positionsInKpc,
+                             double& maxRelDeviation) const;
+
+  /// write tree to a cache file (see UF23FieldCache)
+  void Write(const std::string& filename) const;
+
+  /// true if the tree was built from a field with the same model and parameters
+  bool Matches(const UF23Field& field) const;
+
+  std::size_t GetNumberOfNodes() const { return fNNodes; }
+  std::size_t GetNumberOfLeaves() const { return fNLeaves; }
+  std::size_t GetNumberOfVertices() const { return fNVertices; }
+  /// depth of deepest leaf
+  unsigned int GetDepth() const { return fDepth; }
+  /// size of smallest cell in kpc
+  double GetMinimumCellSize() const
+  { return 2 * fHalfSize / (1u << fDepth); }
+  /// size of the tree in bytes
+  std::size_t GetMemorySize() const
+  {
+    return
+      (fNNodes + 8 * fNLeaves) * sizeof(std::uint32_t) +
+      3 * fNVertices * sizeof(float);
+  }
+  /// true if the tree is mapped from a cache file
+  bool IsMapped() const { return bool(fCache); }
+
+private:
+  void Build(const UF23Field& field,
+             const double relTolerance,
+             const double absTolerance,
+             const unsigned int maxDepth,
+             const unsigned int minDepth);
+
+  /// flag marking a leaf in fNodes
+  static const std::uint32_t kLeaf = 0x80000000u;
+
+  /// arrays in memory or in the mapped file
+  struct Arrays {
+    const std::uint32_t* fNodes;
+    const std::uint32_t* fLeafVertices;
+    const float* fVertexData;
+  };
+  Arrays GetArrays() const
+  {
+    return fCache ? fMappedArrays :
+      Arrays{ fNodes.data(), fLeafVertices.data(), fVertexData.data() };
+  }
+
+  std::shared_ptr<const UF23FieldCache> fCache;
+  Arrays fMappedArrays = { nullptr, nullptr, nullptr };
+  std::size_t fNNodes = 0;
+  std::size_t fNLeaves = 0;
+  std::size_t fNVertices = 0;
+
+  /// model and parameters of the tabulated field
+  UF23Field::ModelType fModelType = UF23Field::base;
+  std::vector<double> fParameters;
+  double fMaxRadiusSquared = 0;
+  double fHalfSize = 0;
+  unsigned int fDepth = 0;
+  /// first child of internal node or kLeaf | leaf index
+  std::vector<std::uint32_t> fNodes;
+  /// eight vertex indices per leaf
+  std::vector<std::uint32_t> fLeafVertices;
+  /// field components (x, y, z) for each vertex
+  std::vector<float> fVertexData;
+};
+#endif
@@ -0,0 +1,1621 @@
+/**
+  @file UF23FieldSIMD.cc
+
+  @brief vectorized implementation of the UF23Field batch evaluation
+
+  The field components are evaluated for blocks of kLanes positions at
+  a time using the vector extensions of GCC and clang. All branches of
+  the scalar implementation are replaced by per-lane selections and the
+  transcendental functions are implemented with the polynomial and
+  rational approximations of the Cephes library using only arithmetic
+  and bit operations. The same code is compiled for several instruction
+  sets and the best one supported by the CPU is selected at runtime.
+  Other compilers use the scalar implementation.
+*/
+
+#include "UF23Field.h"
+#include "UF23Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__GNUC__)
+#define UF23_VECTOR_EXTENSIONS
+#endif
+
+#if defined(UF23_VECTOR_EXTENSIONS) && (defined(__x86_64__) || defined(__i386__))
+#define UF23_X86_DISPATCH
+#endif
+
+#ifdef UF23_VECTOR_EXTENSIONS
+
+#define UF23_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+  // number of positions evaluated simultaneously
+  const unsigned int kLanes = 8;
+
+  // branch-free math functions for vectors of kLanes doubles
+  namespace vmath {
+
+    typedef double VDouble __attribute__((vector_size(kLanes*sizeof(double))));
+    typedef uint64_t VBits __attribute__((vector_size(kLanes*sizeof(double))));
+    typedef decltype(VDouble() < VDouble()) VMask;
+
+    // 1.5 * 2^52, to round to integer and to extract the integer bits
+    const double kMagic = 6755399441055744.0;
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Broadcast(const double x)
+    {
+      return VDouble() + x;
+    }
+
+    UF23_ALWAYS_INLINE
+    VBits
+    AsBits(const VDouble x)
+    {
+      VBits u;
+      std::memcpy(&u, &x, sizeof(u));
+      return u;
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    AsDouble(const VBits u)
+    {
+      VDouble x;
+      std::memcpy(&x, &u, sizeof(x));
+      return x;
+    }
+
+    // c ? a : b for each lane
+    UF23_ALWAYS_INLINE
+    VDouble
+    Select(const VMask c, const VDouble a, const VDouble b)
+    {
+      const VBits m = (VBits) c;
+      return AsDouble((AsBits(a) & m) | (AsBits(b) & ~m));
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Select(const VMask c, const VDouble a, const double b)
+    {
+      return Select(c, a, Broadcast(b));
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Select(const VMask c, const double a, const VDouble b)
+    {
+      return Select(c, Broadcast(a), b);
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Select(const VMask c, const double a, const double b)
+    {
+      return Select(c, Broadcast(a), Broadcast(b));
+    }
+
+    UF23_ALWAYS_INLINE
+    bool
+    Any(const VMask c)
+    {
+      bool any = false;
+      for (unsigned int l = 0; l < kLanes; ++l)
+        any |= c[l] != 0;
+      return any;
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Abs(const VDouble x)
+    {
+      return AsDouble(AsBits(x) & 0x7FFFFFFFFFFFFFFFULL);
+    }
+
+    UF23_ALWAYS_INLINE
+    VDouble
+    Sqrt(const VDouble x)
+    {
+      VDouble s;
+      for (unsigned int l = 0; l < kLanes; ++l)
+        s[l] = std::sqrt(x[l]);
+      return s;
+    }
+
+    // exp(x), relative accuracy ~1e-16, 0 for x < -708 and inf for x > 709
+    UF23_ALWAYS_INLINE
+    VDouble
+    Exp(const VDouble x)
+    {
+      const double kLog2e = 1.4426950408889634073599;
+      const double kLn2Hi = 6.93145751953125e-1;
+      const double kLn2Lo = 1.42860682030941723212e-6;
+      const double xMin = -708;
+      const double xMax = 709;
+      const VDouble xc = Select(x < xMin, xMin, Select(x > xMax, xMax, x));
+
+      // exp(x) = 2^n exp(r), |r| < ln(2)/2
+      const VDouble t = xc * kLog2e + kMagic;
+      const VDouble n = t - kMagic;
+      const VDouble r = (xc - n * kLn2Hi) - n * kLn2Lo;
+
+      // Pade approximation exp(r) = 1 + 2r P(r^2) / (Q(r^2) - r P(r^2))
+      const VDouble rr = r * r;
+      const VDouble p =
+        r * ((1.26177193074810590878e-4 * rr +
+              3.02994407707441961300e-2) * rr +
+             9.99999999999999999910e-1);
+      const VDouble q =
+        ((3.00198505138664455042e-6 * rr +
+          2.52448340349684104192e-3) * rr +
+         2.27265548208155028766e-1) * rr +
+        2.00000000000000000009e0;
+      const VDouble er = 1 + 2 * p / (q - p);
+
+      // 2^n from the integer bits of t
+      const VDouble scale = AsDouble((AsBits(t) + 1023) << 52);
+      return Select(x < xMin, 0,
+                    Select(x > xMax, std::numeric_limits<double>::infinity(),
+                           er * scale));
+    }
+
+    // natural logarithm, relative accuracy ~1e-16 for normalized x >= 0
+    UF23_ALWAYS_INLINE
+    VDouble
+    Log(const VDouble x)
+    {
+      const double kSqrtHalf = 0.70710678118654752440;
+      // x = m * 2^e, 0.5 <= m < 1
+      const VBits bits = AsBits(x);
+      const VDouble m =
+        AsDouble((bits & 0x000FFFFFFFFFFFFFULL) | 0x3FE0000000000000ULL);
+      const VDouble eBiased =
+        AsDouble((bits >> 52) | 0x4330000000000000ULL) - 4503599627370496.0;
+      const VMask small = m < kSqrtHalf;
+      const VDouble e = eBiased - 1022 - Select(small, 1, 0);
+
+      // log(1+y) = y - y^2/2 + y^3 P(y) / Q(y)
+      const VDouble y = Select(small, 2 * m - 1, m - 1);
+      const VDouble z = y * y;
+      const VDouble p =
+        ((((1.01875663804580931796e-4 * y +
+            4.97494994976747001425e-1) * y +
+           4.70579119878881725854e0) * y +
+          1.44989225341610930846e1) * y +
+         1.79368678507819816313e1) * y +
+        7.70838733755885391666e0;
+      const VDouble q =
+        ((((y + 1.12873587189167450590e1) * y +
+           4.52279145837532221105e1) * y +
+          8.29875266912776603211e1) * y +
+         7.11544750618563894466e1) * y +
+        2.31251620126765340583e1;
+      VDouble w = y * (z * p / q);
+      w -= e * 2.121944400546905827679e-4;
+      w -= 0.5 * z;
+      const VDouble l = (y + w) + e * 0.693359375;
+
+      const double inf = std::numeric_limits<double>::infinity();
+      return
+        Select(x == 0, -inf,
+               Select(x < 0, std::numeric_limits<double>::quiet_NaN(),
+                      Select(x == inf, inf, l)));
+    }
+
+    // x^p for x >= 0 and p > 0
+    UF23_ALWAYS_INLINE
+    VDouble
+    Pow(const VDouble x, const double p)
+    {
+      return Select(x == 0, 0, Exp(p * Log(x)));
+    }
+
+    // arc tangent, relative accuracy ~1e-16
+    UF23_ALWAYS_INLINE
+    VDouble
+    Atan(const VDouble x)
+    {
+      const double kTan3PiBy8 = 2.41421356237309504880;
+      const double kMoreBits = 6.123233995736765886130e-17;
+      const double kPiBy2 = 1.57079632679489661923;
+      const double kPiBy4 = 0.78539816339744830962;
+      const VDouble absX = Abs(x);
+      const VMask large = absX > kTan3PiBy8;
+      const VMask medium = ~large & (absX > 0.66);
+      const VDouble xr =
+        Select(large, -1 / absX, Select(medium, (absX - 1) / (absX + 1), absX));
+      const VDouble y0 = Select(large, kPiBy2, Select(medium, kPiBy4, 0));
+      const VDouble more =
+        Select(large, kMoreBits, Select(medium, 0.5 * kMoreBits, 0));
+      const VDouble z = xr * xr;
+      const VDouble p =
+        (((-8.750608600031904122785e-1 * z -
+           1.615753718733365076637e1) * z -
+          7.500855792314704667340e1) * z -
+         1.228866684490136173410e2) * z -
+        6.485021904942025371773e1;
+      const VDouble q =
+        ((((z + 2.485846490142306297962e1) * z +
+           1.650270098316988542046e2) * z +
+          4.328810604912902668951e2) * z +
+         4.853903996359136964868e2) * z +
+        1.945506571482613964425e2;
+      const VDouble a = y0 + ((xr * (z * p / q) + xr) + more);
+      return Select(x < 0, -a, a);
+    }
+
+    // atan2(y, x) for (x, y) != (0, 0)
+    UF23_ALWAYS_INLINE
+    VDouble
+    Atan2(const VDouble y, const VDouble x)
+    {
+      const double kPi = 3.14159265358979323846;
+      const VDouble offset = Select(x < 0, Select(y < 0, -kPi, kPi), 0);
+      return offset + Atan(y / x);
+    }
+
+    // sin(x) and cos(x), relative accuracy ~1e-16 for |x| < 1e5
+    UF23_ALWAYS_INLINE
+    void
+    SinCos(const VDouble x, VDouble& s, VDouble& c)
+    {
+      const double k2ByPi = 6.36619772367581382433e-01;
+      const double kPiBy2Hi = 1.57079632673412561417e+00;
+      const double kPiBy2Mid = 6.07710050630396597660e-11;
+      const double kPiBy2Lo = 2.02226624879595063154e-21;
+      // x = n pi/2 + r, |r| <= pi/4
+      const VDouble t = x * k2ByPi + kMagic;
+      const VDouble n = t - kMagic;
+      const VDouble r = ((x - n * kPiBy2Hi) - n * kPiBy2Mid) - n * kPiBy2Lo;
+      const VBits quadrant = AsBits(t) & 3;
+
+      const VDouble z = r * r;
+      const VDouble sr =
+        r + r * z *
+        (((((1.58962301576546568060e-10 * z -
+             2.50507477628578072866e-8) * z +
+            2.75573136213857245213e-6) * z -
+           1.98412698295895385996e-4) * z +
+          8.33333333332211858878e-3) * z -
+         1.66666666666666307295e-1);
+      const VDouble cr =
+        1 - 0.5 * z + z * z *
+        (((((-1.13585365213876817300e-11 * z +
+             2.08757008419747316778e-9) * z -
+            2.75573141792967388112e-7) * z +
+           2.48015872888517045348e-5) * z -
+          1.38888888888730564116e-3) * z +
+         4.16666666666665929218e-2);
+
+      const VMask swap = (quadrant & 1) != 0;
+      const VDouble sAbs = Select(swap, cr, sr);
+      const VDouble cAbs = Select(swap, sr, cr);
+      s = Select((quadrant & 2) != 0, -sAbs, sAbs);
+      c = Select(((quadrant + 1) & 2) != 0, -cAbs, cAbs);
+    }
+
+    // logistic sigmoid function, invW = 1/width
+    UF23_ALWAYS_INLINE
+    VDouble
+    Sigmoid(const VDouble x, const double x0, const double invW)
+    {
+      return 1 / (1 + Exp(-(x-x0)*invW));
+    }
+
+    /*
+      fast approximations for the opt-in fast-math mode (see
+      UF23Field::SetFastMath()) with the same range reductions, but
+      near-minimax polynomials of lower degree (Chebyshev
+      interpolation) and fewer divisions, maximum relative errors
+      between 5e-12 (log) and 7e-10 (atan2) as given for each function
+    */
+
+    // exp(x), relative accuracy 6e-11
+    UF23_ALWAYS_INLINE
+    VDouble
+    FastExp(const VDouble x)
+    {
+      const double kLog2e = 1.4426950408889634073599;
+      const double kLn2Hi = 6.93145751953125e-1;
+      const double kLn2Lo = 1.42860682030941723212e-6;
+      const double xMin = -708;
+      const double xMax = 709;
+      const VDouble xc = Select(x < xMin, xMin, Select(x > xMax, xMax, x));
+      const VDouble t = xc * kLog2e + kMagic;
+      const VDouble n = t - kMagic;
+      const VDouble r = (xc - n * kLn2Hi) - n * kLn2Lo;
+      const VDouble er =
+        ((((((1.99075681955973138e-4 * r +
+              1.39485782858919617e-3) * r +
+             8.33328354216651343e-3) * r +
+            4.16662183200124450e-2) * r +
+           1.66666667862782447e-1) * r +
+          5.00000010772882808e-1) * r +
+         9.99999999995516364e-1) * r +
+        9.99999999959562125e-1;
+      const VDouble scale = AsDouble((AsBits(t) + 1023) << 52);
+      return Select(x < xMin, 0,
+                    Select(x > xMax, std::numeric_limits<double>::infinity(),
+                           er * scale));
+    }
+
+    // natural logarithm for normalized x > 0, relative accuracy 5e-12
+    // (absolute 2e-12), log(m) = 2 atanh(s) with s = (m-1)/(m+1)
+    UF23_ALWAYS_INLINE
+    VDouble
+    FastLog(const VDouble x)
+    {
+      const double kSqrtHalf = 0.70710678118654752440;
+      const double kLn2 = 0.69314718055994530942;
+      const VBits bits = AsBits(x);
+      const VDouble m =
+        AsDouble((bits & 0x000FFFFFFFFFFFFFULL) | 0x3FE0000000000000ULL);
+      const VDouble eBiased =
+        AsDouble((bits >> 52) | 0x4330000000000000ULL) - 4503599627370496.0;
+      const VMask small = m < kSqrtHalf;
+      const VDouble e = eBiased - 1022 - Select(small, 1, 0);
+      const VDouble mm = Select(small, 2 * m, m);
+      const VDouble s = (mm - 1) / (mm + 1);
+      const VDouble z = s * s;
+      const VDouble h =
+        (((1.18081786941532027e-1 * z +
+           1.42675255775043142e-1) * z +
+          2.00001923348363586e-1) * z +
+         3.33333326237555017e-1) * z +
+        1.00000000000417932e+0;
+      return e * kLn2 + 2 * s * h;
+    }
+
+    // x^p for x >= 0 and p > 0, relative accuracy 6e-11 + p * 2e-12
+    // (exp and the absolute error of log)
+    UF23_ALWAYS_INLINE
+    VDouble
+    FastPow(const VDouble x, const double p)
+    {
+      return Select(x == 0, 0, FastExp(p * FastLog(x)));
+    }
+
+    // atan2(y, x) for (x, y) != (0, 0), relative accuracy 7e-10
+    // (absolute 3e-10)
+    UF23_ALWAYS_INLINE
+    VDouble
+    FastAtan2(const VDouble y, const VDouble x)
+    {
+      const double kPi = 3.14159265358979323846;
+      const double kPiBy2 = 1.57079632679489661923;
+      const double kPiBy4 = 0.78539816339744830962;
+      const double kTanPiBy8 = 0.41421356237309504880;
+      const double kTan3PiBy8 = 2.41421356237309504880;
+      // |y/x| reduced to [0, tan(pi/8)] with one division
+      const VDouble ax = Abs(x);
+      const VDouble ay = Abs(y);
+      const VMask large = ay > kTan3PiBy8 * ax;
+      const VMask medium = ~large & (ay > kTanPiBy8 * ax);
+      const VDouble num = Select(large, -ax, Select(medium, ay - ax, ay));
+      const VDouble den = Select(large, ay, Select(medium, ay + ax, ax));
+      const VDouble xr = num / den;
+      const VDouble y0 = Select(large, kPiBy2, Select(medium, kPiBy4, 0));
+      const VDouble z = xr * xr;
+      const VDouble p =
+        ((((-6.02630534756608827e-2 * z +
+            1.05698288573178895e-1) * z -
+           1.42395326773739561e-1) * z +
+          1.99981830415804585e-1) * z -
+         3.33333068930602439e-1) * z +
+        9.99999999371228521e-1;
+      // angle in [0, pi/2] of (|x|, |y|), then the quadrant of (x, y)
+      const VDouble a = y0 + xr * p;
+      const VDouble aq = Select(x < 0, kPi - a, a);
+      return Select(y < 0, -aq, aq);
+    }
+
+    // sin(x) and cos(x), relative accuracy 7e-11 for |x| < 1e5
+    UF23_ALWAYS_INLINE
+    void
+    FastSinCos(const VDouble x, VDouble& s, VDouble& c)
+    {
+      const double k2ByPi = 6.36619772367581382433e-01;
+      const double kPiBy2Hi = 1.57079632673412561417e+00;
+      const double kPiBy2Mid = 6.07710050630396597660e-11;
+      const double kPiBy2Lo = 2.02226624879595063154e-21;
+      const VDouble t = x * k2ByPi + kMagic;
+      const VDouble n = t - kMagic;
+      const VDouble r = ((x - n * kPiBy2Hi) - n * kPiBy2Mid) - n * kPiBy2Lo;
+      const VBits quadrant = AsBits(t) & 3;
+
+      const VDouble z = r * r;
+      const VDouble sr =
+        r * ((((2.71734555797729835e-6 * z -
+                1.98392021950510915e-4) * z +
+               8.33332878238200563e-3) * z -
+              1.66666666315899381e-1) * z +
+             9.99999999995672684e-1);
+      const VDouble cr =
+        (((2.43798311194099121e-5 * z -
+           1.38866179979785427e-3) * z +
+          4.16666166924646031e-2) * z -
+         4.99999996148566439e-1) * z +
+        9.99999999952489116e-1;
+
+      const VMask swap = (quadrant & 1) != 0;
+      const VDouble sAbs = Select(swap, cr, sr);
+      const VDouble cAbs = Select(swap, sr, cr);
+      s = Select((quadrant & 2) != 0, -sAbs, sAbs);
+      c = Select(((quadrant + 1) & 2) != 0, -cAbs, cAbs);
+    }
+
+    /*
+      single precision with the same vector size, i.e. twice the number
+      of lanes, using the approximations of the float versions of the
+      Cephes functions (relative accuracy ~1e-7)
+    */
+    const unsigned int kLanesFloat = kLanes * sizeof(double) / sizeof(float);
+    typedef float VFloat __attribute__((vector_size(kLanes*sizeof(double))));
+    typedef uint32_t VBitsFloat __attribute__((vector_size(kLanes*sizeof(double))));
+    typedef decltype(VFloat() < VFloat()) VMaskFloat;
+
+    // 1.5 * 2^23, to round to integer and to extract the integer bits
+    const float kMagicFloat = 12582912.0f;
+
+    UF23_ALWAYS_INLINE
+    VBitsFloat
+    AsBits(const VFloat x)
+    {
+      VBitsFloat u;
+      std::memcpy(&u, &x, sizeof(u));
+      return u;
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    AsFloat(const VBitsFloat u)
+    {
+      VFloat x;
+      std::memcpy(&x, &u, sizeof(x));
+      return x;
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Select(const VMaskFloat c, const VFloat a, const VFloat b)
+    {
+      const VBitsFloat m = (VBitsFloat) c;
+      return AsFloat((AsBits(a) & m) | (AsBits(b) & ~m));
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Select(const VMaskFloat c, const VFloat a, const float b)
+    {
+      return Select(c, a, VFloat() + b);
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Select(const VMaskFloat c, const float a, const VFloat b)
+    {
+      return Select(c, VFloat() + a, b);
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Select(const VMaskFloat c, const float a, const float b)
+    {
+      return Select(c, VFloat() + a, VFloat() + b);
+    }
+
+    UF23_ALWAYS_INLINE
+    bool
+    Any(const VMaskFloat c)
+    {
+      bool any = false;
+      for (unsigned int l = 0; l < kLanesFloat; ++l)
+        any |= c[l] != 0;
+      return any;
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Abs(const VFloat x)
+    {
+      return AsFloat(AsBits(x) & 0x7FFFFFFFU);
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Sqrt(const VFloat x)
+    {
+      VFloat s;
+      for (unsigned int l = 0; l < kLanesFloat; ++l)
+        s[l] = std::sqrt(x[l]);
+      return s;
+    }
+
+    // exp(x), 0 for x < -87.3 and inf for x > 88.3
+    UF23_ALWAYS_INLINE
+    VFloat
+    Exp(const VFloat x)
+    {
+      const float kLog2e = 1.44269504088896341f;
+      const float kLn2Hi = 0.693359375f;
+      const float kLn2Lo = -2.12194440e-4f;
+      const float xMin = -87.3f;
+      const float xMax = 88.3f;
+      const VFloat xc = Select(x < xMin, xMin, Select(x > xMax, xMax, x));
+
+      // exp(x) = 2^n exp(r), |r| < ln(2)/2
+      const VFloat t = xc * kLog2e + kMagicFloat;
+      const VFloat n = t - kMagicFloat;
+      const VFloat r = (xc - n * kLn2Hi) - n * kLn2Lo;
+
+      const VFloat rr = r * r;
+      const VFloat er =
+        (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r +
+            8.3334519073e-3f) * r + 4.1665795894e-2f) * r +
+          1.6666665459e-1f) * r + 5.0000001201e-1f) * rr + r + 1;
+
+      // 2^n from the integer bits of t
+      const VFloat scale = AsFloat((AsBits(t) + 127) << 23);
+      return Select(x < xMin, 0.f,
+                    Select(x > xMax, std::numeric_limits<float>::infinity(),
+                           er * scale));
+    }
+
+    // natural logarithm for normalized x >= 0
+    UF23_ALWAYS_INLINE
+    VFloat
+    Log(const VFloat x)
+    {
+      const float kSqrtHalf = 0.70710678118654752440f;
+      // x = m * 2^e, 0.5 <= m < 1
+      const VBitsFloat bits = AsBits(x);
+      const VFloat m = AsFloat((bits & 0x007FFFFFU) | 0x3F000000U);
+      const VFloat eBiased = AsFloat((bits >> 23) | 0x4B000000U) - 8388608.0f;
+      const VMaskFloat small = m < kSqrtHalf;
+      const VFloat e = eBiased - 126 - Select(small, 1.f, 0.f);
+
+      // log(1+y) = y - y^2/2 + y^3 P(y)
+      const VFloat y = Select(small, 2 * m - 1, m - 1);
+      const VFloat z = y * y;
+      const VFloat p =
+        ((((((((7.0376836292e-2f * y - 1.1514610310e-1f) * y +
+               1.1676998740e-1f) * y - 1.2420140846e-1f) * y +
+             1.4249322787e-1f) * y - 1.6668057665e-1f) * y +
+           2.0000714765e-1f) * y - 2.4999993993e-1f) * y +
+         3.3333331174e-1f) * y * z;
+      const VFloat w = p - e * 2.12194440e-4f - 0.5f * z;
+      const VFloat l = (y + w) + e * 0.693359375f;
+
+      const float inf = std::numeric_limits<float>::infinity();
+      return
+        Select(x == 0, -inf,
+               Select(x < 0, std::numeric_limits<float>::quiet_NaN(),
+                      Select(x == inf, inf, l)));
+    }
+
+    // x^p for x >= 0 and p > 0
+    UF23_ALWAYS_INLINE
+    VFloat
+    Pow(const VFloat x, const float p)
+    {
+      return Select(x == 0, 0.f, Exp(p * Log(x)));
+    }
+
+    // arc tangent
+    UF23_ALWAYS_INLINE
+    VFloat
+    Atan(const VFloat x)
+    {
+      const float kTan3PiBy8 = 2.414213562373095f;
+      const float kTanPiBy8 = 0.4142135623730950f;
+      const float kPiBy2 = 1.57079632679489661923f;
+      const float kPiBy4 = 0.78539816339744830962f;
+      const VFloat absX = Abs(x);
+      const VMaskFloat large = absX > kTan3PiBy8;
+      const VMaskFloat medium = ~large & (absX > kTanPiBy8);
+      const VFloat xr =
+        Select(large, -1 / absX, Select(medium, (absX - 1) / (absX + 1), absX));
+      const VFloat y0 = Select(large, kPiBy2, Select(medium, kPiBy4, 0.f));
+      const VFloat z = xr * xr;
+      const VFloat a =
+        y0 + (((8.05374449538e-2f * z - 1.38776856032e-1f) * z +
+               1.99777106478e-1f) * z - 3.33329491539e-1f) * z * xr + xr;
+      return Select(x < 0, -a, a);
+    }
+
+    // atan2(y, x) for (x, y) != (0, 0)
+    UF23_ALWAYS_INLINE
+    VFloat
+    Atan2(const VFloat y, const VFloat x)
+    {
+      const float kPi = 3.14159265358979323846f;
+      const VFloat offset = Select(x < 0, Select(y < 0, -kPi, kPi), 0.f);
+      return offset + Atan(y / x);
+    }
+
+    // sin(x) and cos(x) for |x| < 1e3
+    UF23_ALWAYS_INLINE
+    void
+    SinCos(const VFloat x, VFloat& s, VFloat& c)
+    {
+      const float k2ByPi = 6.36619772367581382433e-01f;
+      const float kPiBy2Hi = 1.5703125f;
+      const float kPiBy2Mid = 4.837512969970703125e-4f;
+      const float kPiBy2Lo = 7.54978995489188216e-8f;
+      // x = n pi/2 + r, |r| <= pi/4
+      const VFloat t = x * k2ByPi + kMagicFloat;
+      const VFloat n = t - kMagicFloat;
+      const VFloat r = ((x - n * kPiBy2Hi) - n * kPiBy2Mid) - n * kPiBy2Lo;
+      const VBitsFloat quadrant = AsBits(t) & 3;
+
+      const VFloat z = r * r;
+      const VFloat sr =
+        ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z -
+         1.6666654611e-1f) * z * r + r;
+      const VFloat cr =
+        ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z +
+         4.166664568298827e-2f) * z * z - 0.5f * z + 1;
+
+      const VMaskFloat swap = (quadrant & 1) != 0;
+      const VFloat sAbs = Select(swap, cr, sr);
+      const VFloat cAbs = Select(swap, sr, cr);
+      s = Select((quadrant & 2) != 0, -sAbs, sAbs);
+      c = Select(((quadrant + 1) & 2) != 0, -cAbs, cAbs);
+    }
+
+    UF23_ALWAYS_INLINE
+    VFloat
+    Sigmoid(const VFloat x, const float x0, const float invW)
+    {
+      return 1 / (1 + Exp(-(x-x0)*invW));
+    }
+
+    // (1 - exp(-r^2)) / r, see UF23Field::AddSpiralField()
+    UF23_ALWAYS_INLINE
+    VDouble
+    RadialFactor(const VDouble r, const VDouble r2)
+    {
+      return Select(r > 1e-5*utl::pc, (1-Exp(-r2)) / r, r * (1 - r2/2));
+    }
+
+    // (series expansion to avoid the cancellation in 1 - exp(-r^2))
+    UF23_ALWAYS_INLINE
+    VFloat
+    RadialFactor(const VFloat r, const VFloat r2)
+    {
+      return Select(r2 > 0.01f, (1-Exp(-r2)) / r,
+                    r * (1 - r2 * (0.5f - r2 * (1.f/6 - r2 * (1.f/24)))));
+    }
+  }
+}
+
+namespace {
+
+  // vector types for double and single precision arithmetic
+  template<typename T>
+  struct VTypes;
+
+  template<>
+  struct VTypes<double> {
+    typedef vmath::VDouble V;
+    typedef vmath::VMask M;
+    static const unsigned int kLanes = ::kLanes;
+  };
+
+  template<>
+  struct VTypes<float> {
+    typedef vmath::VFloat V;
+    typedef vmath::VMaskFloat M;
+    static const unsigned int kLanes = vmath::kLanesFloat;
+  };
+}
+
+namespace {
+
+  // transcendental functions of the kernels, the fast approximations
+  // are used for double precision in the fast-math mode
+  template<bool isFast>
+  struct VMath {
+    template<typename V>
+    static UF23_ALWAYS_INLINE V Exp(const V x) { return vmath::Exp(x); }
+    template<typename V>
+    static UF23_ALWAYS_INLINE V Log(const V x) { return vmath::Log(x); }
+    template<typename V, typename T>
+    static UF23_ALWAYS_INLINE V Pow(const V x, const T p)
+    { return vmath::Pow(x, p); }
+    template<typename V>
+    static UF23_ALWAYS_INLINE V Atan2(const V y, const V x)
+    { return vmath::Atan2(y, x); }
+    template<typename V>
+    static UF23_ALWAYS_INLINE void SinCos(const V x, V& s, V& c)
+    { vmath::SinCos(x, s, c); }
+    template<typename V, typename T>
+    static UF23_ALWAYS_INLINE V Sigmoid(const V x, const T x0, const T invW)
+    { return vmath::Sigmoid(x, x0, invW); }
+    template<typename V>
+    static UF23_ALWAYS_INLINE V RadialFactor(const V r, const V r2)
+    { return vmath::RadialFactor(r, r2); }
+  };
+
+  template<>
+  struct VMath<true> {
+    typedef vmath::VDouble VDouble;
+    static UF23_ALWAYS_INLINE VDouble Exp(const VDouble x)
+    { return vmath::FastExp(x); }
+    static UF23_ALWAYS_INLINE VDouble Log(const VDouble x)
+    { return vmath::FastLog(x); }
+    static UF23_ALWAYS_INLINE VDouble Pow(const VDouble x, const double p)
+    { return vmath::FastPow(x, p); }
+    static UF23_ALWAYS_INLINE VDouble Atan2(const VDouble y, const VDouble x)
+    { return vmath::FastAtan2(y, x); }
+    static UF23_ALWAYS_INLINE void SinCos(const VDouble x, VDouble& s, VDouble& c)
+    { vmath::FastSinCos(x, s, c); }
+    static UF23_ALWAYS_INLINE
+    VDouble Sigmoid(const VDouble x, const double x0, const double invW)
+    { return 1 / (1 + vmath::FastExp(-(x-x0)*invW)); }
+    // (series expansion for small r, where 1 - exp(-r^2) cancels)
+    static UF23_ALWAYS_INLINE
+    VDouble RadialFactor(const VDouble r, const VDouble r2)
+    {
+      return vmath::Select(r2 > 0.01, (1-vmath::FastExp(-r2)) / r,
+                           r * (1 - r2 * (0.5 - r2 * (1./6 - r2 * (1./24)))));
+    }
+  };
+}
+
+/*
+  kernels with access to the parameters of UF23Field, the fields are
+  accumulated in cylindrical components (B_r, B_phi, B_z)
+*/
+class UF23FieldSIMD {
+public:
+  typedef vmath::VDouble VDouble;
+  typedef vmath::VMask VMask;
+
+  template<typename T, bool isFast, bool isSpur, bool isTwistX, bool isExpX>
+  static UF23_ALWAYS_INLINE
+  void
+  EvaluateBlocks(const UF23Field& f,
+                 const T* x, const T* y, const T* z,
+                 const std::size_t inStride,
+                 T* bx, T* by, T* bz,
+                 const std::size_t outStride,
+                 const std::size_t n)
+  {
+    typedef typename VTypes<T>::V V;
+    const unsigned int lanes = VTypes<T>::kLanes;
+    const T maxRadiusSquared = f.fMaxRadiusSquared;
+    for (std::size_t iStart = 0; iStart < n; iStart += lanes) {
+      const unsigned int nLanes =
+        n - iStart < lanes ? n - iStart : lanes;
+
+      // gather positions of this block (unused lanes at origin)
+      V px = V();
+      V py = V();
+      V pz = V();
+      for (unsigned int l = 0; l < nLanes; ++l) {
+        const std::size_t i = (iStart + l) * inStride;
+        px[l] = x[i] * T(utl::kpc);
+        py[l] = y[i] * T(utl::kpc);
+        pz[l] = z[i] * T(utl::kpc);
+      }
+
+      V fx = V();
+      V fy = V();
+      V fz = V();
+      if (vmath::Any(px*px + py*py + pz*pz <= maxRadiusSquared)) {
+        // terms of the spiral field only if needed (see SetTolerance())
+        Cylindrical<T> c =
+          !isSpur && IsSpiralFieldNegligible<T>(f, px*px + py*py,
+                                                vmath::Abs(pz)) ?
+          GetCylindrical<isFast, false>(px, py, pz) :
+          GetCylindrical<isFast, !isSpur>(px, py, pz);
+        ModelField<T, isFast, isSpur, isTwistX, isExpX>(f, c, px, py, pz,
+                                                        nLanes, fx, fy, fz);
+      }
+
+      // scatter fields of this block
+      for (unsigned int l = 0; l < nLanes; ++l) {
+        const std::size_t i = (iStart + l) * outStride;
+        bx[i] = fx[l];
+        by[i] = fy[l];
+        bz[i] = fz[l];
+      }
+    }
+  }
+
+  /*
+    fields of nFields models, output of model m at (m*n + i)*outStride:
+    the geometry of each block of positions is calculated only once
+  */
+  template<bool isFast>
+  static UF23_ALWAYS_INLINE
+  void
+  EvaluateBlocks(const UF23Field* const fields, const unsigned int nFields,
+                 const double* x, const double* y, const double* z,
+                 const std::size_t inStride,
+                 double* bx, double* by, double* bz,
+                 const std::size_t outStride,
+                 const std::size_t n)
+  {
+    double maxRadiusSquared = 0;
+    for (unsigned int m = 0; m < nFields; ++m)
+      maxRadiusSquared =
+        std::max(maxRadiusSquared, fields[m].fMaxRadiusSquared);
+    for (std::size_t iStart = 0; iStart < n; iStart += kLanes) {
+      const unsigned int nLanes =
+        n - iStart < kLanes ? n - iStart : kLanes;
+
+      VDouble px = VDouble();
+      VDouble py = VDouble();
+      VDouble pz = VDouble();
+      for (unsigned int l = 0; l < nLanes; ++l) {
+        const std::size_t i = (iStart + l) * inStride;
+        px[l] = x[i] * utl::kpc;
+        py[l] = y[i] * utl::kpc;
+        pz[l] = z[i] * utl::kpc;
+      }
+
+      const bool anyInside =
+        vmath::Any(px*px + py*py + pz*pz <= maxRadiusSquared);
+      Cylindrical<double> c;
+      if (anyInside)
+        c = GetCylindrical<isFast, true>(px, py, pz);
+      for (unsigned int m = 0; m < nFields; ++m) {
+        const UF23Field& f = fields[m];
+        VDouble fx = VDouble();
+        VDouble fy = VDouble();
+        VDouble fz = VDouble();
+        if (anyInside) {
+          switch (f.fModelType) {
+          case UF23Field::spur:
+            ModelField<double, isFast, true, false, false>
+              (f, c, px, py, pz, nLanes, fx, fy, fz);
+            break;
+          case UF23Field::twistX:
+            ModelField<double, isFast, false, true, false>
+              (f, c, px, py, pz, nLanes, fx, fy, fz);
+            break;
+          case UF23Field::expX:
+            ModelField<double, isFast, false, false, true>
+              (f, c, px, py, pz, nLanes, fx, fy, fz);
+            break;
+          default:
+            ModelField<double, isFast, false, false, false>
+              (f, c, px, py, pz, nLanes, fx, fy, fz);
+            break;
+          }
+        }
+        for (unsigned int l = 0; l < nLanes; ++l) {
+          const std::size_t i = (m * n + iStart + l) * outStride;
+          bx[i] = fx[l];
+          by[i] = fy[l];
+          bz[i] = fz[l];
+        }
+      }
+    }
+  }
+
+private:
+
+  // cylindrical coordinates and terms shared by the field components,
+  // see UF23Field::Cylindrical
+  template<typename T>
+  struct Cylindrical {
+    typedef typename VTypes<T>::V V;
+    V fR2;
+    V fR;
+    typename VTypes<T>::M fOffAxis;
+    /// r off the z-axis, 1 on the z-axis
+    V fRSafe;
+    V fCosPhi;
+    V fSinPhi;
+    V fZ;
+    V fAbsZ;
+    /// terms of the spiral field: azimuth (0 on the z-axis),
+    /// log(r/rRef) and radial dependence g(r) rRef/r, Eq.(14)
+    V fPhi;
+    V fLogR;
+    V fSpiralRadial;
+    /// depends on the model, see SetDiskSigmoid()
+    V fDiskSigmoid;
+  };
+
+  // position-dependent terms, those of the spiral field only if isSpiral
+  template<bool isFast, bool isSpiral, typename V>
+  static UF23_ALWAYS_INLINE
+  Cylindrical<typename std::remove_reference<decltype(V()[0])>::type>
+  GetCylindrical(const V x, const V y, const V z)
+  {
+    typedef VMath<isFast> Math;
+    typedef typename std::remove_reference<decltype(V()[0])>::type T;
+    using vmath::Select;
+    Cylindrical<T> c;
+    c.fR2 = x*x + y*y;
+    c.fR = vmath::Sqrt(c.fR2);
+    c.fOffAxis = c.fR > std::numeric_limits<T>::min();
+    c.fRSafe = Select(c.fOffAxis, c.fR, T(1));
+    c.fCosPhi = Select(c.fOffAxis, x / c.fRSafe, T(1));
+    c.fSinPhi = Select(c.fOffAxis, y / c.fRSafe, T(0));
+    c.fZ = z;
+    c.fAbsZ = vmath::Abs(z);
+    if (isSpiral) {
+      const T rRef = 5*utl::kpc;
+      const T rInner = 5*utl::kpc;
+      const T wInner = 0.5*utl::kpc;
+      const T rOuter = 20*utl::kpc;
+      const T wOuter = 0.5*utl::kpc;
+      // field is zero on the z-axis (masked lanes)
+      const V r = c.fRSafe;
+      c.fPhi = Math::Atan2(Select(c.fOffAxis, y, T(0)),
+                           Select(c.fOffAxis, x, T(1)));
+      c.fLogR = Math::Log(r / rRef);
+      // Eq.(14) times rRef divided by r
+      const V rFacI = Math::Sigmoid(r, rInner, 1/wInner);
+      const V rFacO = 1 - Math::Sigmoid(r, rOuter, 1/wOuter);
+      const V rFac = Math::RadialFactor(r, c.fR2);
+      c.fSpiralRadial = rRef * rFac * rFacO * rFacI;
+    }
+    return c;
+  }
+
+  // true if a component is negligible for all lanes, see
+  // UF23Field::IsSpiralFieldNegligible()
+  template<typename T>
+  static UF23_ALWAYS_INLINE
+  bool
+  IsSpiralFieldNegligible(const UF23Field& f, const typename VTypes<T>::V r2,
+                          const typename VTypes<T>::V absZ)
+  {
+    return !vmath::Any((absZ <= T(f.fDiskCutoffZ)) &
+                       (r2 >= T(f.fSpiralCutoffR2Inner)) &
+                       (r2 <= T(f.fSpiralCutoffR2Outer)));
+  }
+
+  template<typename T>
+  static UF23_ALWAYS_INLINE
+  bool
+  IsToroidalHaloFieldNegligible(const UF23Field& f,
+                                const typename VTypes<T>::V r2,
+                                const typename VTypes<T>::V absZ)
+  {
+    return !vmath::Any((r2 <= T(f.fToroidalCutoffR2)) &
+                       (absZ <= T(f.fToroidalCutoffZ)) &
+                       (absZ >= T(f.fToroidalCutoffZInner)));
+  }
+
+  // Eq.(13)
+  template<bool isFast, typename T>
+  static UF23_ALWAYS_INLINE
+  void
+  SetDiskSigmoid(const UF23Field& f, Cylindrical<T>& c)
+  {
+    c.fDiskSigmoid =
+      VMath<isFast>::Sigmoid(c.fAbsZ, T(f.fDiskH), T(f.fInvDiskW));
+  }
+
+  // all components of a model for the positions (px, py, pz) in c
+  template<typename T, bool isFast, bool isSpur, bool isTwistX, bool isExpX>
+  static UF23_ALWAYS_INLINE
+  void
+  ModelField(const UF23Field& f, Cylindrical<T>& c,
+             const typename VTypes<T>::V px, const typename VTypes<T>::V py,
+             const typename VTypes<T>::V pz, const unsigned int nLanes,
+             typename VTypes<T>::V& fx, typename VTypes<T>::V& fy,
+             typename VTypes<T>::V& fz)
+  {
+    typedef typename VTypes<T>::V V;
+    typedef typename VTypes<T>::M M;
+    const M inside = c.fR2 + c.fZ*c.fZ <= T(f.fMaxRadiusSquared);
+    if (!vmath::Any(inside))
+      return;
+
+    // components above the cutoffs of SetTolerance() (all by default)
+    const bool isSpiral =
+      !isSpur && !IsSpiralFieldNegligible<T>(f, c.fR2, c.fAbsZ);
+    const bool isToroidal =
+      !isTwistX && !IsToroidalHaloFieldNegligible<T>(f, c.fR2, c.fAbsZ);
+
+    // single pass over all components sharing the cylindrical
+    // coordinates, accumulating (B_r, B_phi, B_z)
+    if (isSpiral || isToroidal)
+      SetDiskSigmoid<isFast>(f, c);
+    V bR = V();
+    V bPhi = V();
+    V bZ = V();
+    if (isSpur) {
+      // no vectorized version of the spur
+      for (unsigned int l = 0; l < nLanes; ++l) {
+        if (std::abs(pz[l]) > f.fDiskCutoffZ)
+          continue;
+        double bCyl[3] = { 0, 0, 0 };
+        const double pl[3] = { px[l], py[l], pz[l] };
+        const UF23Field::Cylindrical cyl =
+          UF23Field::GetCylindrical(f, pl[0], pl[1], pl[2]);
+        if (!f.IsSpurFieldNegligible(cyl))
+          UF23Field::AddSpurField(f, cyl, bCyl);
+        bR[l] = bCyl[0];
+        bPhi[l] = bCyl[1];
+      }
+    }
+    else if (isSpiral)
+      SpiralField<isFast>(f, c, bR, bPhi);
+
+    if (isTwistX)
+      TwistedHaloField<isFast>(f, c, bR, bPhi, bZ);
+    else {
+      if (isToroidal)
+        ToroidalHaloField<isFast>(f, c, bPhi);
+      PoloidalHaloField<isFast, isExpX>(f, c, bR, bZ);
+    }
+
+    const V bxx = bR * c.fCosPhi - bPhi * c.fSinPhi;
+    const V byy = bR * c.fSinPhi + bPhi * c.fCosPhi;
+    const T invMicrogauss = 1 / utl::microgauss;
+    fx = vmath::Select(inside, bxx * invMicrogauss, T(0));
+    fy = vmath::Select(inside, byy * invMicrogauss, T(0));
+    fz = vmath::Select(inside, bZ * invMicrogauss, T(0));
+  }
+
+  // -- Sec. 5.2.2, see UF23Field::AddSpiralField()
+  template<bool isFast, typename T, typename V>
+  static UF23_ALWAYS_INLINE
+  void
+  SpiralField(const UF23Field& f, const Cylindrical<T>& c, V& bR, V& bPhi)
+  {
+    typedef VMath<isFast> Math;
+    using vmath::Select;
+    // Eq.(13)
+    const V hdz = 1 - c.fDiskSigmoid;
+
+    // Eq. (12)
+    const V phi0 = c.fPhi - c.fLogR * T(f.fInvTanPitch);
+
+    // Eq. (10), using cos(k(phi0 - phik)) =
+    // cos(k phi0) cos(k phik) + sin(k phi0) sin(k phik)
+    V s1, c1;
+    Math::SinCos(phi0, s1, c1);
+    const V c2 = c1*c1 - s1*s1;
+    const V s2 = 2*s1*c1;
+    const V c3 = c2*c1 - s2*s1;
+    const V s3 = s2*c1 + c2*s1;
+    const V b =
+      T(f.fDiskB1) * (c1 * T(f.fCosDiskPhase[0]) + s1 * T(f.fSinDiskPhase[0])) +
+      T(f.fDiskB2) * (c2 * T(f.fCosDiskPhase[1]) + s2 * T(f.fSinDiskPhase[1])) +
+      T(f.fDiskB3) * (c3 * T(f.fCosDiskPhase[2]) + s3 * T(f.fSinDiskPhase[2]));
+
+    // Eq. (11)
+    const V fac = Select(c.fOffAxis, hdz * c.fSpiralRadial, T(0));
+    bR += b * fac * T(f.fSinPitch);
+    bPhi += b * fac * T(f.fCosPitch);
+  }
+
+  // -- Sec. 5.3.1, see UF23Field::AddToroidalHaloField()
+  template<bool isFast, typename T, typename V>
+  static UF23_ALWAYS_INLINE
+  void
+  ToroidalHaloField(const UF23Field& f, const Cylindrical<T>& c, V& bPhi)
+  {
+    typedef VMath<isFast> Math;
+    const V b0 =
+      vmath::Select(c.fZ >= 0, T(f.fToroidalBN), T(f.fToroidalBS));
+    const V sigmoidR =
+      Math::Sigmoid(c.fR, T(f.fToroidalR), T(f.fInvToroidalW));
+
+    // Eq. (21)
+    bPhi += b0 * (1 - sigmoidR) * c.fDiskSigmoid *
+      Math::Exp(-c.fAbsZ * T(f.fInvToroidalZ));
+  }
+
+  // -- Sec. 5.3.2, see UF23Field::GetPoloidalHaloField()
+  template<bool isFast, bool isExpX>
+  static UF23_ALWAYS_INLINE
+  void
+  PoloidalHaloField(const UF23Field& f, const Cylindrical<double>& cyl,
+                    VDouble& bR, VDouble& bZ)
+  {
+    typedef VMath<isFast> Math;
+    using vmath::Select;
+    const double p = f.fPoloidalP;
+    const double c = f.fPoloidalC;
+    const double a0p = f.fPoloidalA0p;
+
+    const VDouble rp = Math::Pow(cyl.fR, p);
+    const VDouble abszp = Math::Pow(cyl.fAbsZ, p);
+    const VDouble cabszp = c*abszp;
+
+    // stabilized sqrt(a^2 + b) - a, see UF23Field::GetPoloidalHaloField()
+    const VDouble t0 = a0p + cabszp - rp;
+    const VDouble t1 = vmath::Sqrt(t0*t0 + 4*a0p*rp);
+    const VDouble ap = 2*a0p*rp / (t1  + t0);
+
+    if (vmath::Any((ap < 0) & cyl.fOffAxis)) {
+      // this should never happen
+      throw std::runtime_error("invalid poloidal field, ap < 0");
+    }
+    const VDouble a =
+      Select(ap < 0, 0,
+             Math::Pow(Select(ap < 0, 0, ap), f.fInvPoloidalP));
+
+    // Eq.(29) and Eq.(32)
+    const VDouble radialDependence =
+      isExpX ?
+      Math::Exp(-a*f.fInvPoloidalR) :
+      1 - Math::Sigmoid(a, f.fPoloidalR, f.fInvPoloidalW);
+
+    // Eq.(28)
+    const VDouble Bzz = f.fPoloidalB * radialDependence;
+
+    // (r/a)
+    const VDouble rOverA =
+      1 / Math::Pow(2*a0p / (t1  + t0), f.fInvPoloidalP);
+
+    // Eq.(35) for p=n
+    const VDouble signZ = Select(cyl.fZ < 0, -1, 1);
+    const VDouble Br =
+      Bzz * c * a / rOverA * signZ *
+      Math::Pow(cyl.fAbsZ, f.fPoloidalPMinus1) / t1;
+
+    // Eq.(36) for p=n
+    bZ += Bzz * Math::Pow(rOverA, f.fPoloidalPMinus2) * (ap + a0p) / t1;
+    bR += Select(cyl.fOffAxis, Br, 0);
+  }
+
+  // -- Sec. 5.3.2 in single precision: the powers with exponents p,
+  // 1/p and p-1 and the stabilized difference of large numbers are
+  // numerically sensitive, i.e. the poloidal field is calculated in
+  // double precision for each half of the lanes
+  template<bool isFast, bool isExpX>
+  static UF23_ALWAYS_INLINE
+  void
+  PoloidalHaloField(const UF23Field& f, const Cylindrical<float>& cyl,
+                    vmath::VFloat& bR, vmath::VFloat& bZ)
+  {
+    for (unsigned int h = 0; h < vmath::kLanesFloat; h += kLanes) {
+      Cylindrical<double> cd;
+      for (unsigned int l = 0; l < kLanes; ++l) {
+        cd.fR[l] = cyl.fR[h + l];
+        cd.fZ[l] = cyl.fZ[h + l];
+        cd.fAbsZ[l] = cyl.fAbsZ[h + l];
+      }
+      cd.fOffAxis = cd.fR > std::numeric_limits<double>::min();
+      VDouble bRd = VDouble();
+      VDouble bZd = VDouble();
+      PoloidalHaloField<isFast, isExpX>(f, cd, bRd, bZd);
+      for (unsigned int l = 0; l < kLanes; ++l) {
+        bR[h + l] += bRd[l];
+        bZ[h + l] += bZd[l];
+      }
+    }
+  }
+
+  // -- Sec. 5.3.3, see UF23Field::AddTwistedHaloField()
+  template<bool isFast, typename T, typename V>
+  static UF23_ALWAYS_INLINE
+  void
+  TwistedHaloField(const UF23Field& f, const Cylindrical<T>& c,
+                   V& bR, V& bPhi, V& bZ)
+  {
+    typedef VMath<isFast> Math;
+    using vmath::Select;
+    V bRX = V();
+    V bZX = V();
+    PoloidalHaloField<isFast, false>(f, c, bRX, bZX);
+
+    // radial rotation curve parameters (fit to Reid et al 2014)
+    const T v0 = -240 * utl::kilometer/utl::second;
+    const T r0 = 1.6 * utl::kpc;
+    // vertical gradient (Levine+08)
+    const T z0 = 10 * utl::kpc;
+
+    const V rr = c.fRSafe;
+
+    // Eq.(43)
+    const V fr = 1 - Math::Exp(-rr/r0);
+    // Eq.(44)
+    const V t0 = Math::Exp(2*c.fAbsZ/z0);
+    const V gz = 2 / (1 + t0);
+
+    // Eq. (46)
+    const V signZ = Select(c.fZ < 0, T(-1), T(1));
+    const V deltaZ =  -signZ * v0 * fr / z0  * t0 * gz * gz;
+    // Eq. (47)
+    const V deltaR = v0 * ((1-fr)/r0 - fr/rr) * gz;
+
+    // Eq.(45)
+    bPhi += Select(c.fOffAxis,
+                   (bZX * deltaZ + bRX * deltaR) * T(f.fTwistingTime), T(0));
+    bR += bRX;
+    bZ += bZX;
+  }
+};
+
+namespace {
+
+  // the kernels compiled for different instruction sets
+  template<typename T, bool isFast, bool isSpur, bool isTwistX, bool isExpX>
+  struct Kernels {
+
+    static
+    void
+    Generic(const UF23Field& f,
+            const T* x, const T* y, const T* z,
+            const std::size_t inStride,
+            T* bx, T* by, T* bz,
+            const std::size_t outStride,
+            const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<T, isFast, isSpur, isTwistX, isExpX>
+        (f, x, y, z, inStride, bx, by, bz, outStride, n);
+    }
+
+#ifdef UF23_X86_DISPATCH
+    static
+    __attribute__((target("avx2,fma")))
+    void
+    AVX2(const UF23Field& f,
+         const T* x, const T* y, const T* z,
+         const std::size_t inStride,
+         T* bx, T* by, T* bz,
+         const std::size_t outStride,
+         const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<T, isFast, isSpur, isTwistX, isExpX>
+        (f, x, y, z, inStride, bx, by, bz, outStride, n);
+    }
+
+    static
+    __attribute__((target("avx512f,avx512dq,fma")))
+    void
+    AVX512(const UF23Field& f,
+           const T* x, const T* y, const T* z,
+           const std::size_t inStride,
+           T* bx, T* by, T* bz,
+           const std::size_t outStride,
+           const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<T, isFast, isSpur, isTwistX, isExpX>
+        (f, x, y, z, inStride, bx, by, bz, outStride, n);
+    }
+#endif
+  };
+
+  // the multi-field kernels compiled for different instruction sets
+  template<bool isFast>
+  struct SetKernels {
+
+    static
+    void
+    Generic(const UF23Field* fields, const unsigned int nFields,
+            const double* x, const double* y, const double* z,
+            const std::size_t inStride,
+            double* bx, double* by, double* bz,
+            const std::size_t outStride,
+            const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<isFast>(fields, nFields, x, y, z,
+                                            inStride, bx, by, bz,
+                                            outStride, n);
+    }
+
+#ifdef UF23_X86_DISPATCH
+    static
+    __attribute__((target("avx2,fma")))
+    void
+    AVX2(const UF23Field* fields, const unsigned int nFields,
+         const double* x, const double* y, const double* z,
+         const std::size_t inStride,
+         double* bx, double* by, double* bz,
+         const std::size_t outStride,
+         const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<isFast>(fields, nFields, x, y, z,
+                                            inStride, bx, by, bz,
+                                            outStride, n);
+    }
+
+    static
+    __attribute__((target("avx512f,avx512dq,fma")))
+    void
+    AVX512(const UF23Field* fields, const unsigned int nFields,
+           const double* x, const double* y, const double* z,
+           const std::size_t inStride,
+           double* bx, double* by, double* bz,
+           const std::size_t outStride,
+           const std::size_t n)
+    {
+      UF23FieldSIMD::EvaluateBlocks<isFast>(fields, nFields, x, y, z,
+                                            inStride, bx, by, bz,
+                                            outStride, n);
+    }
+#endif
+  };
+}
+
+#endif // UF23_VECTOR_EXTENSIONS
+
+namespace {
+
+  enum EInstructionSet {
+    eScalar,
+    eGeneric,
+    eAVX2,
+    eAVX512
+  };
+
+  EInstructionSet
+  DetectInstructionSet()
+  {
+#if defined(UF23_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+      return eAVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return eAVX2;
+#endif
+#if defined(UF23_VECTOR_EXTENSIONS)
+    return eGeneric;
+#else
+    return eScalar;
+#endif
+  }
+
+  // CPU features are only detected once
+  EInstructionSet
+  GetDetectedInstructionSet()
+  {
+    static const EInstructionSet instructionSet = DetectInstructionSet();
+    return instructionSet;
+  }
+
+#ifdef UF23_VECTOR_EXTENSIONS
+  template<typename T, bool isFast, bool isSpur, bool isTwistX, bool isExpX>
+  void
+  Dispatch(const UF23Field& f,
+           const T* x, const T* y, const T* z,
+           const std::size_t inStride,
+           T* bx, T* by, T* bz,
+           const std::size_t outStride,
+           const std::size_t n)
+  {
+    using K = Kernels<T, isFast, isSpur, isTwistX, isExpX>;
+    switch (GetDetectedInstructionSet()) {
+#ifdef UF23_X86_DISPATCH
+    case eAVX512:
+      K::AVX512(f, x, y, z, inStride, bx, by, bz, outStride, n);
+      break;
+    case eAVX2:
+      K::AVX2(f, x, y, z, inStride, bx, by, bz, outStride, n);
+      break;
+#endif
+    default:
+      K::Generic(f, x, y, z, inStride, bx, by, bz, outStride, n);
+      break;
+    }
+  }
+
+  // dispatch the model type
+  template<typename T, bool isFast>
+  void
+  DispatchModel(const UF23Field& f,
+                const T* x, const T* y, const T* z,
+                const std::size_t inStride,
+                T* bx, T* by, T* bz,
+                const std::size_t outStride,
+                const std::size_t n)
+  {
+    switch (f.GetModelType()) {
+    case UF23Field::spur:
+      Dispatch<T, isFast, true, false, false>(f, x, y, z, inStride,
+                                              bx, by, bz, outStride, n);
+      break;
+    case UF23Field::twistX:
+      Dispatch<T, isFast, false, true, false>(f, x, y, z, inStride,
+                                              bx, by, bz, outStride, n);
+      break;
+    case UF23Field::expX:
+      Dispatch<T, isFast, false, false, true>(f, x, y, z, inStride,
+                                              bx, by, bz, outStride, n);
+      break;
+    default:
+      Dispatch<T, isFast, false, false, false>(f, x, y, z, inStride,
+                                               bx, by, bz, outStride, n);
+      break;
+    }
+  }
+#endif
+}
+
+bool
+UF23Field::EvaluateVectorized(const double* x, const double* y, const double* z,
+                              const std::size_t inStride,
+                              double* bx, double* by, double* bz,
+                              const std::size_t outStride,
+                              const std::size_t n)
+  const
+{
+#ifdef UF23_VECTOR_EXTENSIONS
+  if (fFastMath)
+    DispatchModel<double, true>(*this, x, y, z, inStride,
+                                bx, by, bz, outStride, n);
+  else
+    DispatchModel<double, false>(*this, x, y, z, inStride,
+                                 bx, by, bz, outStride, n);
+  return true;
+#else
+  // no vector extensions, use scalar implementation
+  (void) x; (void) y; (void) z; (void) inStride;
+  (void) bx; (void) by; (void) bz; (void) outStride; (void) n;
+  return false;
+#endif
+}
+
+bool
+UF23Field::EvaluateVectorized(const float* x, const float* y, const float* z,
+                              const std::size_t inStride,
+                              float* bx, float* by, float* bz,
+                              const std::size_t outStride,
+                              const std::size_t n)
+  const
+{
+#ifdef UF23_VECTOR_EXTENSIONS
+  // (the single precision kernels have a similar accuracy as the fast
+  // approximations in double precision, i.e. there is no fast version)
+  DispatchModel<float, false>(*this, x, y, z, inStride,
+                              bx, by, bz, outStride, n);
+  return true;
+#else
+  (void) x; (void) y; (void) z; (void) inStride;
+  (void) bx; (void) by; (void) bz; (void) outStride; (void) n;
+  return false;
+#endif
+}
+
+bool
+UF23Field::EvaluateVectorized(const UF23Field* fields,
+                              const unsigned int nFields,
+                              const bool fastMath,
+                              const double* x, const double* y,
+                              const double* z,
+                              const std::size_t inStride,
+                              double* bx, double* by, double* bz,
+                              const std::size_t outStride,
+                              const std::size_t n)
+{
+#ifdef UF23_VECTOR_EXTENSIONS
+  switch (GetDetectedInstructionSet()) {
+#ifdef UF23_X86_DISPATCH
+  case eAVX512:
+    if (fastMath)
+      SetKernels<true>::AVX512(fields, nFields, x, y, z, inStride,
+                               bx, by, bz, outStride, n);
+    else
+      SetKernels<false>::AVX512(fields, nFields, x, y, z, inStride,
+                                bx, by, bz, outStride, n);
+    break;
+  case eAVX2:
+    if (fastMath)
+      SetKernels<true>::AVX2(fields, nFields, x, y, z, inStride,
+                             bx, by, bz, outStride, n);
+    else
+      SetKernels<false>::AVX2(fields, nFields, x, y, z, inStride,
+                              bx, by, bz, outStride, n);
+    break;
+#endif
+  default:
+    if (fastMath)
+      SetKernels<true>::Generic(fields, nFields, x, y, z, inStride,
+                                bx, by, bz, outStride, n);
+    else
+      SetKernels<false>::Generic(fields, nFields, x, y, z, inStride,
+                                 bx, by, bz, outStride, n);
+    break;
+  }
+  return true;
+#else
+  (void) fields; (void) nFields; (void) fastMath;
+  (void) x; (void) y; (void) z; (void) inStride;
+  (void) bx; (void) by; (void) bz; (void) outStride; (void) n;
+  return false;
+#endif
+}
+
+namespace utl {
+  // units of the parameters of GetParameters() (see UF23Field.cc)
+  extern const std::vector<double> unitConv;
+}
+
+void
+UF23Field::SetParameterSets(const double* parameters,
+                            const unsigned int nFields,
+                            UF23Field* fields)
+  const
+{
+#ifdef UF23_VECTOR_EXTENSIONS
+  using namespace vmath;
+  const double* const unit = utl::unitConv.data();
+  // kLanes rows at a time, the last block repeats the last row
+  for (unsigned int first = 0; first < nFields; first += kLanes) {
+    unsigned int row[kLanes];
+    for (unsigned int l = 0; l < kLanes; ++l)
+      row[l] = std::min(first + l, nFields - 1);
+
+    // -- parameters in internal units
+    VDouble p[eNpar];
+    for (unsigned int i = 0; i < eNpar; ++i)
+      for (unsigned int l = 0; l < kLanes; ++l)
+        p[i][l] = parameters[row[l] * eNpar + i] * unit[i];
+    if (fModelType == expX) {
+      VDouble s, c;
+      SinCos(p[ePoloidalXi], s, c);
+      p[ePoloidalZ] = p[ePoloidalA] * s / c;
+    }
+
+    // -- angles
+    VDouble sinPitch, cosPitch;
+    SinCos(p[eDiskPitch], sinPitch, cosPitch);
+    const VDouble tanPitch = sinPitch / cosPitch;
+    VDouble sinPhase[3], cosPhase[3];
+    const unsigned int phases[3] = { eDiskPhase1, eDiskPhase2, eDiskPhase3 };
+    for (unsigned int k = 0; k < 3; ++k)
+      SinCos((k+1) * p[phases[k]], sinPhase[k], cosPhase[k]);
+
+    // -- powers of the poloidal field, x^p = exp(p log(x)) for x > 0
+    const VDouble logA = Log(p[ePoloidalA]);
+    const VDouble poloidalC =
+      Exp(p[ePoloidalP] * (logA - Log(p[ePoloidalZ])));
+    const VDouble poloidalA0p = Exp(p[ePoloidalP] * logA);
+
+    for (unsigned int l = 0; l < kLanes && first + l < nFields; ++l) {
+      UF23Field& f = fields[first + l];
+      for (unsigned int i = 0; i < eNpar; ++i)
+        f.*fParameterPointers[i] = p[i][l];
+      f.fSinPitch = sinPitch[l];
+      f.fCosPitch = cosPitch[l];
+      f.fTanPitch = tanPitch[l];
+      f.fInvTanPitch = 1 / tanPitch[l];
+      for (unsigned int k = 0; k < 3; ++k) {
+        f.fCosDiskPhase[k] = cosPhase[k][l];
+        f.fSinDiskPhase[k] = sinPhase[k][l];
+      }
+      f.fInvDiskW = 1 / f.fDiskW;
+      f.fInvSpurWidth = 1 / f.fSpurWidth;
+      f.fInvToroidalW = 1 / f.fToroidalW;
+      f.fInvToroidalZ = 1 / f.fToroidalZ;
+      f.fInvPoloidalR = 1 / f.fPoloidalR;
+      f.fInvPoloidalW = 1 / f.fPoloidalW;
+      f.fPoloidalC = poloidalC[l];
+      f.fPoloidalA0p = poloidalA0p[l];
+      f.fInvPoloidalP = 1 / f.fPoloidalP;
+      f.fPoloidalPMinus1 = f.fPoloidalP - 1;
+      f.fPoloidalPMinus2 = f.fPoloidalP - 2;
+      // without tolerance the cutoffs do not depend on the parameters
+      if (fTolerance > 0)
+        f.UpdateCutoffs();
+    }
+  }
+#else
+  for (unsigned int j = 0; j < nFields; ++j)
+    fields[j].SetParameterValues(parameters + j * eNpar);
+#endif
+}
+
+const std::string&
+UF23Field::GetInstructionSet()
+{
+  static const std::string names[] = {"scalar", "generic", "avx2", "avx512"};
+  return names[GetDetectedInstructionSet()];
+}
@@ -0,0 +1,90 @@
+#include "UF23FieldSet.h"
+
+
+UF23FieldSet::UF23FieldSet(const double maxRadiusInKpc)
+{
+  for (const auto& m : UF23Field::GetModelNames())
+    fFields.push_back(UF23Field(m.first, maxRadiusInKpc));
+}
+
+UF23FieldSet::UF23FieldSet(const std::vector<UF23Field::ModelType>& models,
+                           const double maxRadiusInKpc)
+{
+  for (const auto m : models)
+    fFields.push_back(UF23Field(m, maxRadiusInKpc));
+}
+
+UF23FieldSet::UF23FieldSet(const std::vector<UF23Field>& fields) :
+  fFields(fields)
+{
+  // same settings for all fields
+  SetVectorization(fVectorization);
+  SetFastMath(fFastMath);
+}
+
+void
+UF23FieldSet::SetVectorization(const bool v)
+{
+  fVectorization = v;
+  for (auto& f : fFields)
+    f.SetVectorization(v);
+}
+
+void
+UF23FieldSet::SetFastMath(const bool f)
+{
+  fFastMath = f;
+  for (auto& field : fFields)
+    field.SetFastMath(f);
+}
+
+void
+UF23FieldSet::Evaluate(const double* x, const double* y, const double* z,
+                       double* bx, double* by, double* bz,
+                       const std::size_t n)
+  const
+{
+  EvaluateStrided(x, y, z, 1, bx, by, bz, 1, n);
+}
+
+void
+UF23FieldSet::Evaluate(const std::vector<Vector3>& posInKpc,
+                       std::vector<Vector3>& fieldInMicrogauss)
+  const
+{
+  const std::size_t n = posInKpc.size();
+  fieldInMicrogauss.resize(fFields.size() * n);
+  if (n == 0)
+    return;
+  static_assert(sizeof(Vector3) == 3*sizeof(double),
+                "unexpected memory layout of Vector3");
+  const Vector3* const pos = posInKpc.data();
+  Vector3* const field = fieldInMicrogauss.data();
+  EvaluateStrided(&pos->x, &pos->y, &pos->z, 3,
+                  &field->x, &field->y, &field->z, 3, n);
+}
+
+void
+UF23FieldSet::EvaluateStrided(const double* x, const double* y,
+                              const double* z,
+                              const std::size_t inStride,
+                              double* bx, double* by, double* bz,
+                              const std::size_t outStride,
+                              const std::size_t n)
+  const
+{
+  if (fFields.empty() || n == 0)
+    return;
+  if (fVectorization &&
+      UF23Field::EvaluateVectorized(fFields.data(), fFields.size(), fFastMath,
+                                    x, y, z, inStride,
+                                    bx, by, bz, outStride, n))
+    return;
+
+  // one pass per field
+  for (unsigned int m = 0; m < fFields.size(); ++m) {
+    const std::size_t offset = m * n * outStride;
+    fFields[m].EvaluateStrided(x, y, z, inStride, bx + offset, by + offset,
+                               bz + offset, outStride, n);
+  }
+}
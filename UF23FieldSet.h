@@ -0,0 +1,115 @@
+#ifndef _UF23FieldSet_h_
+#define _UF23FieldSet_h_
+/**
+ @class UF23FieldSet
+ @brief several UF23 fields evaluated in one pass over the positions
+
+ Evaluates any subset of the eight UF23 models (or fields with
+ modified parameters) at the same positions. The vectorized
+ evaluation calculates the position-dependent terms of each block of
+ positions (cylindrical coordinates, azimuth and log(r)) only once
+ and then adds the components of each field, i.e. the cost per
+ field is lower than that of separate UF23Field::Evaluate() calls.
+
+ The fields are returned as a structure of arrays with the field of
+ model m at position i at index m * n + i.
+
+ */
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+#include "UF23Field.h"
+#include "Vector3.h"
+
+class UF23FieldSet {
+public:
+  /**
+     @brief constructor for all eight model types
+     @param maxRadiusInKpc maximum radius of field in kpc
+  */
+  explicit UF23FieldSet(const double maxRadiusInKpc = 30);
+  /**
+     @brief constructor for a subset of model types
+     @param models model types in the order of the output
+     @param maxRadiusInKpc maximum radius of field in kpc
+  */
+  explicit UF23FieldSet(const std::vector<UF23Field::ModelType>& models,
+                        const double maxRadiusInKpc = 30);
+  /// (resolves UF23FieldSet({base, twistX}), UF23Field converts from
+  /// ModelType)
+  UF23FieldSet(const std::initializer_list<UF23Field::ModelType> models,
+               const double maxRadiusInKpc = 30) :
+    UF23FieldSet(std::vector<UF23Field::ModelType>(models), maxRadiusInKpc) {}
+  /// constructor for arbitrary fields, e.g. with modified parameters
+  explicit UF23FieldSet(const std::vector<UF23Field>& fields);
+
+  unsigned int GetNumberOfFields() const { return fFields.size(); }
+  /// field m
+  const UF23Field& GetField(const unsigned int m) const
+  { return fFields.at(m); }
+
+  /**
+     @brief calculate the fields of all models at many positions
+     @param x x-components of n positions given in kpc
+     @param y y-components of n positions given in kpc
+     @param z z-components of n positions given in kpc
+     @param bx output x-components of GetNumberOfFields() * n field
+            values in microgauss, model m at position i at m * n + i
+     @param by output y-components (see bx)
+     @param bz output z-components (see bx)
+     @param n number of positions
+  */
+  void Evaluate(const double* x, const double* y, const double* z,
+                double* bx, double* by, double* bz,
+                const std::size_t n) const;
+  /**
+     @brief calculate the fields of all models at many strided positions
+     @param x x-component of the first position given in kpc
+     @param y y-component of the first position given in kpc
+     @param z z-component of the first position given in kpc
+     @param inStride distance between the components of consecutive
+            positions
+     @param bx output x-component of the first field value in
+            microgauss, model m at position i at (m * n + i) * outStride
+     @param by output y-component (see bx)
+     @param bz output z-component (see bx)
+     @param outStride distance between the components of consecutive
+            field values
+     @param n number of positions
+  */
+  void Evaluate(const double* x, const double* y, const double* z,
+                const std::size_t inStride,
+                double* bx, double* by, double* bz,
+                const std::size_t outStride,
+                const std::size_t n) const
+  { EvaluateStrided(x, y, z, inStride, bx, by, bz, outStride, n); }
+  /**
+     @brief calculate the fields of all models at many positions
+     @param posInKpc positions with components given in kpc
+     @param fieldInMicrogauss output field values in microgauss, model
+            m at position i at m * n + i (resized to
+            GetNumberOfFields() * n)
+  */
+  void Evaluate(const std::vector<Vector3>& posInKpc,
+                std::vector<Vector3>& fieldInMicrogauss) const;
+
+  /// vectorized evaluation (default: true), see UF23Field
+  void SetVectorization(const bool v);
+  bool GetVectorization() const { return fVectorization; }
+  /// fast approximate math (default: false), see UF23Field
+  void SetFastMath(const bool f);
+  bool GetFastMath() const { return fFastMath; }
+
+private:
+  void EvaluateStrided(const double* x, const double* y, const double* z,
+                       const std::size_t inStride,
+                       double* bx, double* by, double* bz,
+                       const std::size_t outStride,
+                       const std::size_t n) const;
+
+  std::vector<UF23Field> fFields;
+  bool fVectorization = true;
+  bool fFastMath = false;
+};
+#endif
@@ -0,0 +1,57 @@
+#ifndef _UF23FieldT_h_
+#define _UF23FieldT_h_
+/**
+ @class UF23FieldT
+ @brief UF23Field with the model type fixed at compile time
+
+ UF23Field::operator() selects the disk (spiral or spur) and halo
+ (toroidal and poloidal or twisted) components and the radial profile
+ of the poloidal halo at runtime. UF23FieldT<mt> resolves these
+ branches at compile time, i.e. operator() is a branch-free kernel
+ containing only the components of model mt, e.g.
+
+   const UF23FieldT<UF23Field::twistX> field;
+   const Vector3 b = field(pos);
+
+ All other member functions, including the batch interface Evaluate(),
+ are the ones of UF23Field (which dispatches the model type once per
+ batch). A UF23FieldT can be used wherever a UF23Field is expected.
+
+ */
+
+#include <stdexcept>
+#include "UF23Field.h"
+#include "UF23Units.h"
+#include "Vector3.h"
+
+template<UF23Field::ModelType mt>
+class UF23FieldT : public UF23Field {
+public:
+  typedef ModelTraits<mt> Traits;
+
+  /// constructor with the default parameters of model mt
+  explicit UF23FieldT(const double maxRadiusInKpc = 30) :
+    UF23Field(mt, maxRadiusInKpc) {}
+
+  /// constructor from a UF23Field of model type mt (e.g. with modified parameters)
+  explicit UF23FieldT(const UF23Field& field) :
+    UF23Field(field)
+  {
+    if (field.GetModelType() != mt)
+      throw std::runtime_error("UF23FieldT: model type mismatch, expected "
+                               + GetModelName(mt) + ", got "
+                               + field.GetModelName());
+  }
+
+  /**
+     @brief calculate coherent magnetic field at a given position
+     @param posInKpc position with components given in kpc
+     @return coherent field in microgauss
+  */
+  Vector3 operator()(const Vector3& posInKpc) const
+  {
+    return EvaluateKernel<Traits::kSpur, Traits::kTwistX, Traits::kExpX>
+      (posInKpc.x * utl::kpc, posInKpc.y * utl::kpc, posInKpc.z * utl::kpc);
+  }
+};
+#endif
@@ -0,0 +1,251 @@
+#include "UF23LineOfSight.h"
+#include "UF23Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+  // directions per parallel task
+  const std::size_t kDirectionsPerTask = 16;
+  // positions per call of the batch evaluation
+  const std::size_t kBatchSize = 1024;
+
+  // integer square root
+  inline
+  std::uint64_t
+  ISqrt(const std::uint64_t n)
+  {
+    std::uint64_t r = sqrt(double(n));
+    while (r * r > n)
+      --r;
+    while ((r + 1) * (r + 1) <= n)
+      ++r;
+    return r;
+  }
+
+}
+
+UF23LineOfSight::UF23LineOfSight(const UF23Field& field,
+                                 const Vector3& observerInKpc,
+                                 const double stepInKpc,
+                                 const double maxDistanceInKpc) :
+  fField(field),
+  fObserver(observerInKpc),
+  fStep(stepInKpc),
+  fMaxDistance(maxDistanceInKpc)
+{
+  if (!(fStep > 0))
+    throw std::runtime_error("UF23LineOfSight: invalid step size "
+                             + std::to_string(fStep));
+}
+
+bool
+UF23LineOfSight::GetSegment(const Vector3& d, double& sMin, double& sMax)
+  const
+{
+  // |o + s d|^2 = R^2  <=>  s^2 + 2 b s + c = 0
+  const double b = dotprod(fObserver, d);
+  const double c = fObserver.SquaredLength() - fField.GetMaximumSquaredRadius();
+  const double discriminant = b * b - c;
+  if (discriminant <= 0)
+    return false;
+  const double sqrtD = sqrt(discriminant);
+  sMin = std::max(0., -b - sqrtD);
+  sMax = std::min(fMaxDistance, -b + sqrtD);
+  return sMax > sMin;
+}
+
+std::vector<std::vector<double>>
+UF23LineOfSight::Integrate(const std::vector<Vector3>& directions,
+                           const std::vector<Projection>& projections)
+  const
+{
+  const std::size_t nDir = directions.size();
+  const unsigned int nProj = projections.size();
+  std::vector<std::vector<double>> integrals(nProj,
+                                             std::vector<double>(nDir, 0));
+  if (nDir == 0 || nProj == 0)
+    return integrals;
+
+  // |B_perp|^((p+1)/2) = (|B_perp|^2)^synchrotronPower
+  const double synchrotronPower = (fSpectralIndex + 1) / 4;
+  const bool isQuadratic = synchrotronPower == 1;
+
+  // work buffers of each thread
+  struct Buffer {
+    std::vector<double> fX, fY, fZ, fBx, fBy, fBz;
+    // direction index of each position
+    std::vector<std::size_t> fDirection;
+    // weights[iProjection][iPosition]
+    std::vector<std::vector<double>> fWeights;
+    // local basis (e_1, e_2, d) and step length of each direction of a task
+    std::vector<Vector3> fE1, fE2, fD;
+    std::vector<double> fDl;
+  };
+  const std::size_t nTasks =
+    (nDir + kDirectionsPerTask - 1) / kDirectionsPerTask;
+  const unsigned int nThreads = fParallelOptions.GetNumberOfThreads(nTasks);
+  std::vector<Buffer> buffers(nThreads);
+  for (auto& b : buffers) {
+    for (auto v : { &b.fX, &b.fY, &b.fZ, &b.fBx, &b.fBy, &b.fBz })
+      v->resize(kBatchSize);
+    b.fDirection.resize(kBatchSize);
+    b.fWeights.resize(nProj);
+    for (unsigned int i = 0; i < nProj; ++i)
+      if (projections[i].fWeight)
+        b.fWeights[i].resize(kBatchSize);
+    for (auto v : { &b.fE1, &b.fE2, &b.fD })
+      v->resize(kDirectionsPerTask);
+    b.fDl.resize(kDirectionsPerTask);
+  }
+
+  utl::ParallelFor(nTasks, fParallelOptions,
+    [&](const std::size_t iTask, const unsigned int iThread)
+    {
+      Buffer& b = buffers[iThread];
+      const std::size_t first = iTask * kDirectionsPerTask;
+      const std::size_t last = std::min(first + kDirectionsPerTask, nDir);
+
+      // evaluate field and weights for n buffered positions and accumulate
+      auto flush =
+        [&](const std::size_t n)
+        {
+          fField.Evaluate(b.fX.data(), b.fY.data(), b.fZ.data(),
+                          b.fBx.data(), b.fBy.data(), b.fBz.data(), n);
+          for (unsigned int iProj = 0; iProj < nProj; ++iProj)
+            if (projections[iProj].fWeight)
+              projections[iProj].fWeight(b.fX.data(), b.fY.data(),
+                                         b.fZ.data(),
+                                         b.fWeights[iProj].data(), n);
+          for (std::size_t i = 0; i < n; ++i) {
+            const std::size_t iDir = b.fDirection[i];
+            const std::size_t iLocal = iDir - first;
+            const Vector3 field(b.fBx[i], b.fBy[i], b.fBz[i]);
+            const double bPar = dotprod(field, b.fD[iLocal]);
+            const double b1 = dotprod(field, b.fE1[iLocal]);
+            const double b2 = dotprod(field, b.fE2[iLocal]);
+            const double bPerp2 = b1 * b1 + b2 * b2;
+            const double synchrotron =
+              isQuadratic ? bPerp2 : pow(bPerp2, synchrotronPower);
+            // synchrotron * cos(2 chi) and synchrotron * sin(2 chi)
+            const double polFactor = bPerp2 > 0 ? synchrotron / bPerp2 : 0;
+            for (unsigned int iProj = 0; iProj < nProj; ++iProj) {
+              double value = 0;
+              switch (projections[iProj].fType) {
+              case eParallel:
+                value = bPar;
+                break;
+              case eSynchrotronI:
+                value = synchrotron;
+                break;
+              case eSynchrotronQ:
+                value = polFactor * (b1 * b1 - b2 * b2);
+                break;
+              case eSynchrotronU:
+                value = polFactor * 2 * b1 * b2;
+                break;
+              case eLength:
+                value = 1;
+                break;
+              }
+              if (projections[iProj].fWeight)
+                value *= b.fWeights[iProj][i];
+              integrals[iProj][iDir] += value * b.fDl[iLocal];
+            }
+          }
+        };
+
+      std::size_t n = 0;
+      for (std::size_t iDir = first; iDir < last; ++iDir) {
+        const double length = directions[iDir].Length();
+        if (!(length > 0))
+          throw std::runtime_error("UF23LineOfSight: invalid direction");
+        const Vector3 d = directions[iDir] / length;
+        double sMin, sMax;
+        if (!GetSegment(d, sMin, sMax))
+          continue;
+
+        const std::size_t iLocal = iDir - first;
+        const double cosTheta = std::max(-1., std::min(1., d.z));
+        const double sinTheta = sqrt(1 - cosTheta * cosTheta);
+        const double phi = atan2(d.y, d.x);
+        const double cosPhi = cos(phi);
+        const double sinPhi = sin(phi);
+        b.fD[iLocal] = d;
+        b.fE1[iLocal] = Vector3(cosTheta * cosPhi, cosTheta * sinPhi, -sinTheta);
+        b.fE2[iLocal] = Vector3(-sinPhi, cosPhi, 0);
+
+        // equal steps of at most fStep, positions at the midpoints
+        const std::size_t nSteps = std::max(1., ceil((sMax - sMin) / fStep));
+        const double dl = (sMax - sMin) / nSteps;
+        b.fDl[iLocal] = dl;
+        for (std::size_t iStep = 0; iStep < nSteps; ++iStep) {
+          const double s = sMin + (iStep + 0.5) * dl;
+          b.fX[n] = fObserver.x + s * d.x;
+          b.fY[n] = fObserver.y + s * d.y;
+          b.fZ[n] = fObserver.z + s * d.z;
+          b.fDirection[n] = iDir;
+          if (++n == kBatchSize) {
+            flush(n);
+            n = 0;
+          }
+        }
+      }
+      if (n > 0)
+        flush(n);
+    });
+
+  return integrals;
+}
+
+std::vector<Vector3>
+UF23LineOfSight::GetHealpixDirections(const unsigned int nside)
+{
+  if (nside == 0)
+    throw std::runtime_error("UF23LineOfSight: nside must be positive");
+
+  // pix2ang in RING scheme (Gorski et al. 2005)
+  const std::uint64_t n = nside;
+  const std::uint64_t nPix = 12 * n * n;
+  const std::uint64_t nCap = 2 * n * (n - 1);
+  const double fact2 = 4. / nPix;
+  const double fact1 = 2 * n * fact2;
+  const double halfPi = utl::kPi / 2;
+
+  std::vector<Vector3> directions(nPix);
+  for (std::uint64_t pix = 0; pix < nPix; ++pix) {
+    double z, phi;
+    if (pix < nCap) {
+      // north polar cap
+      const std::uint64_t iRing = (1 + ISqrt(1 + 2 * pix)) >> 1;
+      const std::uint64_t iPhi = (pix + 1) - 2 * iRing * (iRing - 1);
+      z = 1 - iRing * iRing * fact2;
+      phi = (iPhi - 0.5) * halfPi / iRing;
+    }
+    else if (pix < nPix - nCap) {
+      // equatorial region
+      const std::uint64_t ip = pix - nCap;
+      const std::uint64_t tmp = ip / (4 * n);
+      const std::uint64_t iRing = tmp + n;
+      const std::uint64_t iPhi = ip - tmp * 4 * n + 1;
+      const double fOdd = ((iRing + n) & 1) ? 1 : 0.5;
+      z = (2. * n - double(iRing)) * fact1;
+      phi = (iPhi - fOdd) * utl::kPi / (2 * n);
+    }
+    else {
+      // south polar cap
+      const std::uint64_t ip = nPix - pix;
+      const std::uint64_t iRing = (1 + ISqrt(2 * ip - 1)) >> 1;
+      const std::uint64_t iPhi = 4 * iRing + 1 - (ip - 2 * iRing * (iRing - 1));
+      z = -1 + iRing * iRing * fact2;
+      phi = (iPhi - 0.5) * halfPi / iRing;
+    }
+    const double sinTheta = sqrt((1 - z) * (1 + z));
+    directions[pix] = Vector3(sinTheta * cos(phi), sinTheta * sin(phi), z);
+  }
+  return directions;
+}
@@ -0,0 +1,134 @@
+#ifndef _UF23LineOfSight_h_
+#define _UF23LineOfSight_h_
+/**
+ @class UF23LineOfSight
+ @brief line-of-sight integrals of the UF23 field
+
+ Integrates projections of the coherent field along rays from an
+ observer position with the midpoint rule. Each ray is divided into
+ equal steps of at most the given step size and ends where it leaves
+ the sphere of radius sqrt(GetMaximumSquaredRadius()) of the field (or
+ at the maximum distance, whichever is closer). The field is evaluated
+ with the batch interface of UF23Field, where consecutive steps of
+ several rays are packed into one batch, and the directions are
+ distributed over threads.
+
+ The projections are calculated from the field components parallel to
+ the line of sight, B_par = B.d, and perpendicular to it, B_1 = B.e_1
+ and B_2 = B.e_2, with the local basis (e_1, e_2, d) given by
+
+   e_1 = (cos(theta) cos(phi), cos(theta) sin(phi), -sin(theta))
+   e_2 = (-sin(phi), cos(phi), 0)
+
+ for d = (sin(theta) cos(phi), sin(theta) sin(phi), cos(theta)), i.e.
+ e_1 points to the south and e_2 to the east for an observer at the
+ position of the Sun in galactocentric coordinates. The synchrotron
+ projections use |B_perp|^((p+1)/2) for a cosmic-ray electron spectral
+ index p (default 3, i.e. |B_perp|^2) and the angle chi of B_perp with
+ cos(2 chi) = (B_1^2 - B_2^2)/|B_perp|^2, sin(2 chi) = 2 B_1 B_2/|B_perp|^2.
+
+ Each projection can be multiplied by a weight evaluated at the same
+ positions, e.g. the thermal electron density for the rotation measure
+
+   RM = 0.812 rad/m^2 * 1000 * Integral(n_e / cm^-3 * B_par / muG * dl / kpc)
+
+ */
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "UF23Field.h"
+#include "UF23Parallel.h"
+#include "Vector3.h"
+
+class UF23LineOfSight {
+public:
+  /// projection of the field integrated along the line of sight
+  enum EProjection {
+    eParallel,      ///< B_par (muG kpc)
+    eSynchrotronI,  ///< |B_perp|^((p+1)/2)
+    eSynchrotronQ,  ///< |B_perp|^((p+1)/2) cos(2 chi)
+    eSynchrotronU,  ///< |B_perp|^((p+1)/2) sin(2 chi)
+    eLength         ///< 1, i.e. the path length inside the field (kpc)
+  };
+
+  /// weights w[i] at n positions x[i], y[i], z[i] given in kpc
+  typedef std::function<void(const double* x, const double* y,
+                             const double* z, double* w,
+                             const std::size_t n)> WeightFunction;
+
+  /// projection with optional weight (empty weight function means w = 1)
+  struct Projection {
+    EProjection fType;
+    WeightFunction fWeight;
+  };
+
+public:
+  /**
+     @brief constructor
+     @param field UF23 field (copied)
+     @param observerInKpc position of the observer in kpc
+     @param stepInKpc maximum step size in kpc
+     @param maxDistanceInKpc maximum distance from the observer in kpc
+  */
+  UF23LineOfSight(const UF23Field& field,
+                  const Vector3& observerInKpc,
+                  const double stepInKpc = 0.01,
+                  const double maxDistanceInKpc =
+                  std::numeric_limits<double>::infinity());
+  /// no default constructor
+  UF23LineOfSight() = delete;
+
+  /// set number of threads (0: all hardware threads)
+  void SetNumberOfThreads(const unsigned int n)
+  { fParallelOptions.fNThreads = n; }
+  /// set number of threads and their pinning to CPUs
+  void SetParallelOptions(const utl::ParallelOptions& options)
+  { fParallelOptions = options; }
+  const utl::ParallelOptions& GetParallelOptions() const
+  { return fParallelOptions; }
+  /// spectral index p of cosmic-ray electrons for synchrotron projections
+  void SetSpectralIndex(const double p) { fSpectralIndex = p; }
+
+  /**
+     @brief integrate projections along the lines of sight
+     @param directions directions of the lines of sight (normalized
+            internally)
+     @param projections projections to integrate
+     @return integrals[iProjection][iDirection]
+
+     Weight functions are called concurrently from several threads.
+  */
+  std::vector<std::vector<double>>
+  Integrate(const std::vector<Vector3>& directions,
+            const std::vector<Projection>& projections) const;
+
+  /**
+     @brief ray segment inside of the field sphere
+     @param direction normalized direction
+     @param sMin output: distance where the ray enters the sphere
+     @param sMax output: distance where the ray leaves the sphere
+            (limited to the maximum distance)
+     @return false if the ray does not intersect the sphere
+  */
+  bool GetSegment(const Vector3& direction, double& sMin, double& sMax) const;
+
+  /**
+     @brief centers of HEALPix pixels (RING ordering)
+     @param nside HEALPix resolution parameter
+     @return 12*nside^2 unit vectors with theta measured from the
+             z-axis and phi from the x-axis, i.e. Galactic latitude
+             and longitude for an observer in galactocentric coordinates
+  */
+  static std::vector<Vector3> GetHealpixDirections(const unsigned int nside);
+
+private:
+  UF23Field fField;
+  Vector3 fObserver;
+  double fStep;
+  double fMaxDistance;
+  double fSpectralIndex = 3;
+  utl::ParallelOptions fParallelOptions;
+};
+#endif
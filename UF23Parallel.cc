@@ -0,0 +1,318 @@
+#include "UF23Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#endif
+
+namespace utl {
+
+  unsigned int
+  GetNumberOfThreads(const unsigned int nThreads)
+  {
+    if (nThreads > 0)
+      return nThreads;
+    const unsigned int nHardware = std::thread::hardware_concurrency();
+    return nHardware > 0 ? nHardware : 1;
+  }
+
+  unsigned int
+  ParallelOptions::GetNumberOfThreads(const std::size_t nTasks)
+    const
+  {
+    return std::max<std::size_t>(1,
+      std::min<std::size_t>(utl::GetNumberOfThreads(fNThreads), nTasks));
+  }
+
+  namespace {
+
+#ifdef __linux__
+    // CPUs of a list like "0-3,8,10-11" in /sys
+    std::vector<int>
+    ParseCPUList(const std::string& list)
+    {
+      std::vector<int> cpus;
+      const char* s = list.c_str();
+      while (*s) {
+        char* end;
+        const long first = std::strtol(s, &end, 10);
+        if (end == s)
+          break;
+        long last = first;
+        s = end;
+        if (*s == '-') {
+          last = std::strtol(s + 1, &end, 10);
+          s = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+          cpus.push_back(cpu);
+        if (*s == ',')
+          ++s;
+      }
+      return cpus;
+    }
+
+    // CPUs available to the process, grouped by NUMA node
+    std::vector<std::vector<int>>
+    GetNodeCPUs()
+    {
+      cpu_set_t available;
+      CPU_ZERO(&available);
+      if (sched_getaffinity(0, sizeof(available), &available))
+        return std::vector<std::vector<int>>();
+
+      std::vector<std::pair<int, std::vector<int>>> nodes;
+      std::vector<bool> assigned(CPU_SETSIZE, false);
+      const std::string path = "/sys/devices/system/node/";
+      if (DIR* const dir = opendir(path.c_str())) {
+        while (const dirent* const entry = readdir(dir)) {
+          const std::string name = entry->d_name;
+          if (name.compare(0, 4, "node") || name.size() == 4 ||
+              name.find_first_not_of("0123456789", 4) != std::string::npos)
+            continue;
+          std::ifstream in(path + name + "/cpulist");
+          std::string list;
+          std::getline(in, list);
+          std::vector<int> cpus;
+          for (const int cpu : ParseCPUList(list))
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &available) &&
+                !assigned[cpu]) {
+              assigned[cpu] = true;
+              cpus.push_back(cpu);
+            }
+          if (!cpus.empty())
+            nodes.emplace_back(std::stoi(name.substr(4)), cpus);
+        }
+        closedir(dir);
+      }
+      std::sort(nodes.begin(), nodes.end());
+
+      // CPUs not listed in /sys (e.g. no NUMA support) as one node
+      std::vector<int> other;
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &available) && !assigned[cpu])
+          other.push_back(cpu);
+      if (!other.empty())
+        nodes.emplace_back(nodes.size(), other);
+
+      std::vector<std::vector<int>> nodeCPUs;
+      for (auto& node : nodes)
+        nodeCPUs.push_back(node.second);
+      return nodeCPUs;
+    }
+
+    bool
+    SetAffinity(const pthread_t thread, const cpu_set_t& cpus)
+    {
+      return !pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    }
+
+    bool
+    SetAffinity(const pthread_t thread, const int cpu)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      return SetAffinity(thread, cpus);
+    }
+
+    // pins the calling thread to the CPU of worker 0 and restores its
+    // affinity on destruction
+    class CallerPinning {
+    public:
+      CallerPinning(const std::vector<int>& cpus)
+      {
+        fPinned = !cpus.empty() &&
+          !pthread_getaffinity_np(pthread_self(), sizeof(fCPUs), &fCPUs) &&
+          SetAffinity(pthread_self(), cpus[0]);
+      }
+      ~CallerPinning() { if (fPinned) SetAffinity(pthread_self(), fCPUs); }
+    private:
+      cpu_set_t fCPUs;
+      bool fPinned;
+    };
+#else
+    struct CallerPinning {
+      CallerPinning(const std::vector<int>& /*cpus*/) {}
+    };
+#endif
+
+    /*
+      tasks [begin, end) of one thread relative to the first task of
+      the block, packed into one word (begin in the upper, end in the
+      lower 32 bits) such that the owner and the thieves update it
+      with one compare-and-swap, padded against false sharing
+    */
+    struct TaskRange {
+      std::atomic<std::uint64_t> fRange{0};
+      char fPadding[64];
+    };
+
+    // maximum number of tasks of one block
+    const std::size_t kMaxBlockSize = 0xFFFFFFFF;
+
+    std::uint64_t
+    Pack(const std::uint64_t begin, const std::uint64_t end)
+    {
+      return begin << 32 | end;
+    }
+
+    // next task of the own range
+    bool
+    PopFront(TaskRange& range, std::size_t& iTask)
+    {
+      std::uint64_t r = range.fRange.load();
+      while (true) {
+        const std::uint64_t begin = r >> 32;
+        const std::uint64_t end = r & kMaxBlockSize;
+        if (begin == end)
+          return false;
+        if (range.fRange.compare_exchange_weak(r, Pack(begin + 1, end))) {
+          iTask = begin;
+          return true;
+        }
+      }
+    }
+
+    // back half of the range of the victim, at least one task
+    bool
+    StealBack(TaskRange& victim, std::size_t& begin, std::size_t& end)
+    {
+      std::uint64_t r = victim.fRange.load();
+      while (true) {
+        const std::uint64_t b = r >> 32;
+        const std::uint64_t e = r & kMaxBlockSize;
+        if (b == e)
+          return false;
+        const std::uint64_t split = e - (e - b + 1) / 2;
+        if (victim.fRange.compare_exchange_weak(r, Pack(b, split))) {
+          begin = split;
+          end = e;
+          return true;
+        }
+      }
+    }
+
+  }
+
+  std::vector<int>
+  GetWorkerCPUs(const unsigned int nThreads,
+                const ParallelOptions::EPinning pinning)
+  {
+    std::vector<int> cpus;
+#ifdef __linux__
+    if (pinning == ParallelOptions::eNoPinning)
+      return cpus;
+    const std::vector<std::vector<int>> nodes = GetNodeCPUs();
+    if (nodes.empty())
+      return cpus;
+    std::vector<int> all;
+    for (const auto& node : nodes)
+      all.insert(all.end(), node.begin(), node.end());
+    // more threads than CPUs: start again with the first CPU
+    for (unsigned int i = 0; i < nThreads; ++i) {
+      if (pinning == ParallelOptions::eCompact)
+        cpus.push_back(all[i % all.size()]);
+      else {
+        const std::vector<int>& node = nodes[i % nodes.size()];
+        cpus.push_back(node[(i / nodes.size()) % node.size()]);
+      }
+    }
+#else
+    (void) nThreads;
+    (void) pinning;
+#endif
+    return cpus;
+  }
+
+  void
+  ParallelFor(const std::size_t nTasks,
+              const ParallelOptions& options,
+              const std::function<void(std::size_t, unsigned int)>& task)
+  {
+    const unsigned int n = options.GetNumberOfThreads(nTasks);
+    const std::vector<int> cpus = GetWorkerCPUs(n, options.fPinning);
+    const CallerPinning callerPinning(cpus);
+    if (n == 1) {
+      for (std::size_t i = 0; i < nTasks; ++i)
+        task(i, 0);
+      return;
+    }
+
+    // blocks of at most kMaxBlockSize tasks (see TaskRange)
+    for (std::size_t offset = 0; offset < nTasks; offset += kMaxBlockSize) {
+      const std::size_t nBlock = std::min(nTasks - offset, kMaxBlockSize);
+      std::vector<TaskRange> ranges(n);
+      for (unsigned int i = 0; i < n; ++i)
+        ranges[i].fRange = Pack(nBlock * i / n, nBlock * (i + 1) / n);
+
+      std::atomic<bool> stop(false);
+      std::exception_ptr error;
+      std::mutex errorMutex;
+      auto worker =
+        [&](const unsigned int iThread)
+        {
+          TaskRange& own = ranges[iThread];
+          try {
+            while (!stop) {
+              std::size_t iTask;
+              if (PopFront(own, iTask)) {
+                task(offset + iTask, iThread);
+                continue;
+              }
+              // steal from the other threads, starting with the next one
+              std::size_t begin = 0;
+              std::size_t end = 0;
+              for (unsigned int i = 1; i < n && begin == end; ++i)
+                StealBack(ranges[(iThread + i) % n], begin, end);
+              if (begin == end)
+                break;
+              // the own range is empty, i.e. not changed by other threads
+              own.fRange = Pack(begin + 1, end);
+              task(offset + begin, iThread);
+            }
+          }
+          catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+              error = std::current_exception();
+            stop = true;
+          }
+        };
+
+      // if no more threads can be started, the ranges of the missing
+      // workers are taken by the running ones
+      std::vector<std::thread> threads;
+      try {
+        for (unsigned int i = 1; i < n; ++i) {
+          threads.emplace_back(worker, i);
+#ifdef __linux__
+          if (!cpus.empty())
+            SetAffinity(threads.back().native_handle(), cpus[i]);
+#endif
+        }
+      }
+      catch (const std::system_error&) {
+      }
+      worker(0);
+      for (auto& t : threads)
+        t.join();
+      if (error)
+        std::rethrow_exception(error);
+    }
+  }
+
+}
@@ -0,0 +1,86 @@
+#ifndef _UF23Parallel_h_
+#define _UF23Parallel_h_
+/**
+ @file UF23Parallel.h
+ @brief minimal thread pool helpers for the UF23 tools
+
+ ParallelFor() distributes nTasks independent tasks over nThreads
+ worker threads (std::thread) with work stealing: each thread starts
+ with a contiguous range of nTasks/nThreads tasks, which it processes
+ from the front, and a thread without tasks left takes the back half
+ of the range of another thread. Tasks of very different cost (e.g.
+ positions beyond the maximum radius of the field next to positions
+ in the spur) are thus balanced with one compare-and-swap per task on
+ the range of the own thread, which is only contended by steals, and
+ neighbouring tasks mostly run in the same thread. An exception thrown
+ by a task stops the distribution of further tasks and is rethrown in
+ the calling thread. If not all worker threads can be started, the
+ tasks are distributed over the ones that are running.
+
+ With ParallelOptions, the worker threads can be pinned to the CPUs
+ available to the process (Linux only, ignored elsewhere), either
+ filling one NUMA node after the other (eCompact) or distributed
+ round-robin over the NUMA nodes (eScatter). Worker 0 is the calling
+ thread, its affinity is restored at the end of ParallelFor().
+
+ */
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace utl {
+
+  /// number of threads to use, 0 means all hardware threads
+  unsigned int GetNumberOfThreads(const unsigned int nThreads);
+
+  /// thread count and placement of ParallelFor()
+  struct ParallelOptions {
+    enum EPinning {
+      eNoPinning,  ///< threads placed by the operating system
+      eCompact,    ///< fill one NUMA node after the other
+      eScatter     ///< round-robin over the NUMA nodes
+    };
+
+    ParallelOptions(const unsigned int nThreads = 0,
+                    const EPinning pinning = eNoPinning) :
+      fNThreads(nThreads), fPinning(pinning) {}
+
+    /// number of worker threads for nTasks tasks
+    unsigned int GetNumberOfThreads(const std::size_t nTasks) const;
+
+    /// number of threads (0: all hardware threads)
+    unsigned int fNThreads;
+    EPinning fPinning;
+  };
+
+  /**
+     @brief CPUs of the worker threads for a pinning strategy
+     @param nThreads number of worker threads
+     @param pinning pinning strategy
+     @return CPU index of each worker thread, empty without pinning or
+             if the affinity cannot be set on this system
+  */
+  std::vector<int> GetWorkerCPUs(const unsigned int nThreads,
+                                 const ParallelOptions::EPinning pinning);
+
+  /**
+     @brief call task(iTask, iThread) for iTask = 0 ... nTasks-1
+     @param nTasks number of tasks
+     @param options number of threads and pinning
+     @param task function called with the task and thread index
+            (iThread < options.GetNumberOfThreads(nTasks))
+  */
+  void ParallelFor(const std::size_t nTasks,
+                   const ParallelOptions& options,
+                   const std::function<void(std::size_t, unsigned int)>& task);
+
+  /// ParallelFor() with nThreads threads (0: all hardware threads)
+  inline
+  void ParallelFor(const std::size_t nTasks,
+                   const unsigned int nThreads,
+                   const std::function<void(std::size_t, unsigned int)>& task)
+  { ParallelFor(nTasks, ParallelOptions(nThreads), task); }
+
+}
+#endif
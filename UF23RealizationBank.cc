@@ -0,0 +1,123 @@
+#include "UF23RealizationBank.h"
+#include "ParameterCovariance.h"
+#include "UF23FieldCache.h"
+#include "UF23Parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+UF23RealizationBank::UF23RealizationBank(const UF23Field::ModelType mt,
+                                         const std::size_t nRealizations,
+                                         const unsigned int seed,
+                                         const unsigned int nThreads) :
+  fModelType(mt),
+  fNominalParameters(UF23Field(mt).GetParameters()),
+  fSeed(seed),
+  fNRealizations(nRealizations),
+  fParameters(nRealizations * UF23Field::eNpar)
+{
+  if (nRealizations > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error("UF23RealizationBank: too many realizations");
+  Draw(nThreads);
+}
+
+UF23RealizationBank::UF23RealizationBank(const std::string& filename) :
+  fCache(std::make_shared<UF23FieldCache>(filename,
+                                          UF23FieldCache::eRealizations))
+{
+  const UF23FieldCache::Header& header = fCache->GetHeader();
+  fModelType = UF23Field::ModelType(header.fModelType);
+  fNominalParameters.assign(header.fParameters,
+                            header.fParameters + UF23Field::eNpar);
+  fSeed = header.fFlags[0];
+  fNRealizations = header.fN[0];
+  if (fCache->GetArraySize(0) !=
+      fNRealizations * UF23Field::eNpar * sizeof(double))
+    throw std::runtime_error("UF23RealizationBank: inconsistent bank size in "
+                             + filename);
+  fMappedParameters = static_cast<const double*>(fCache->GetArray(0));
+}
+
+void
+UF23RealizationBank::Draw(const unsigned int nThreads)
+{
+  const ParameterCovariance pcov(fModelType);
+  const unsigned int dim = pcov.GetDimension();
+  const std::vector<UF23Field::EPar>& indices = pcov.GetParameterIndices();
+
+  // work buffers of each thread
+  const unsigned int n = utl::GetNumberOfThreads(nThreads);
+  std::vector<std::vector<double>> normals(n,
+                                           std::vector<double>(kBlockSize * dim));
+  std::vector<std::vector<double>> deltas(n,
+                                          std::vector<double>(kBlockSize * dim));
+
+  const std::size_t nBlocks = (fNRealizations + kBlockSize - 1) / kBlockSize;
+  utl::ParallelFor(nBlocks, n,
+    [&](const std::size_t iBlock, const unsigned int iThread)
+    {
+      // random number stream of this block
+      std::seed_seq seedSequence{ fSeed, static_cast<unsigned int>(iBlock) };
+      std::mt19937_64 engine(seedSequence);
+      std::normal_distribution<double> ndist;
+      std::vector<double>& normal = normals[iThread];
+      std::vector<double>& delta = deltas[iThread];
+
+      const std::size_t first = iBlock * kBlockSize;
+      const std::size_t last = std::min(first + kBlockSize, fNRealizations);
+      for (auto& x : normal)
+        x = ndist(engine);
+      pcov.GetRandomDeltas(normal.data(), last - first, delta.data());
+      for (std::size_t iReal = first; iReal < last; ++iReal) {
+        // add random delta to the nominal parameter values
+        double* const sampledParameters =
+          &fParameters[iReal * UF23Field::eNpar];
+        std::copy(fNominalParameters.begin(), fNominalParameters.end(),
+                  sampledParameters);
+        const double* const d = &delta[(iReal - first) * dim];
+        for (unsigned int i = 0; i < dim; ++i)
+          sampledParameters[indices[i]] += d[i];
+      }
+    });
+}
+
+void
+UF23RealizationBank::Write(const std::string& filename)
+  const
+{
+  // maximum radius not used
+  UF23FieldCache::Header header =
+    UF23FieldCache::MakeHeader(UF23FieldCache::eRealizations, fModelType,
+                               fNominalParameters, 0);
+  header.fFlags[0] = fSeed;
+  header.fN[0] = fNRealizations;
+  const std::size_t size = fNRealizations * UF23Field::eNpar * sizeof(double);
+  UF23FieldCache::Write(filename, header, { { GetParameters(), size } });
+}
+
+bool
+UF23RealizationBank::Matches(const UF23Field& field)
+  const
+{
+  return
+    fModelType == field.GetModelType() &&
+    fNominalParameters == field.GetParameters();
+}
+
+UF23Field
+UF23RealizationBank::GetRealization(const std::size_t i,
+                                    const double maxRadiusInKpc)
+  const
+{
+  if (i >= fNRealizations)
+    throw std::runtime_error("UF23RealizationBank: no realization "
+                             + std::to_string(i));
+  UF23Field field(fModelType, maxRadiusInKpc);
+  const double* const p = GetParameters(i);
+  field.SetParameters(std::vector<double>(p, p + UF23Field::eNpar));
+  return field;
+}
@@ -0,0 +1,115 @@
+#ifndef _UF23RealizationBank_h_
+#define _UF23RealizationBank_h_
+/**
+ @class UF23RealizationBank
+ @brief parameter realizations of a UF23 model drawn from the
+        parameter uncertainties
+
+ Holds k parameter vectors of one model type (in the units of
+ UF23Field::GetParameters()) drawn from the covariance matrix of
+ ParameterCovariance. Realizations are drawn in blocks of kBlockSize,
+ each block with its own random number stream seeded from (seed,
+ block index), i.e. the bank is reproducible for a given seed
+ independent of the number of threads. These are the realizations of
+ UF23Ensemble(model, k, seed).
+
+ A bank can be written to a binary file (see UF23FieldCache) and
+ mapped into memory read-only, such that many jobs on any number of
+ nodes use the same realizations without drawing them again, e.g.
+
+   UF23RealizationBank(UF23Field::base, 10000).Write("base.bank");
+
+ once and then in each job
+
+   const UF23RealizationBank bank("base.bank");
+   field.EvaluateParameterSets(bank.GetParameters(),
+                               bank.GetNumberOfRealizations(), ...);
+
+ The file header records the model, its nominal parameters and the
+ seed, the parameter matrix is stored as k x UF23Field::eNpar doubles.
+
+ */
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "UF23Field.h"
+
+class UF23FieldCache;
+
+class UF23RealizationBank {
+public:
+  /// number of realizations per random number stream
+  static const unsigned int kBlockSize = 64;
+
+  /**
+     @brief draw parameter realizations
+     @param mt model type
+     @param nRealizations number of parameter realizations
+     @param seed seed of random number streams (see UF23Ensemble)
+     @param nThreads number of threads (0: all hardware threads)
+  */
+  UF23RealizationBank(const UF23Field::ModelType mt,
+                      const std::size_t nRealizations,
+                      const unsigned int seed = 123,
+                      const unsigned int nThreads = 0);
+
+  /**
+     @brief map a bank from a file written with Write()
+     @param filename name of file
+  */
+  explicit UF23RealizationBank(const std::string& filename);
+
+  /// no default constructor
+  UF23RealizationBank() = delete;
+
+  /// write bank to a cache file (see UF23FieldCache)
+  void Write(const std::string& filename) const;
+
+  /// true if the bank was drawn for a field with the same model and
+  /// nominal parameters
+  bool Matches(const UF23Field& field) const;
+
+  UF23Field::ModelType GetModelType() const { return fModelType; }
+  /// nominal parameters (units of UF23Field::GetParameters())
+  const std::vector<double>& GetNominalParameters() const
+  { return fNominalParameters; }
+  unsigned int GetSeed() const { return fSeed; }
+  std::size_t GetNumberOfRealizations() const { return fNRealizations; }
+
+  /**
+     @brief parameter matrix
+     @return k x UF23Field::eNpar matrix, row i is the parameter vector
+             of realization i as in UF23Field::SetParameters(), e.g.
+             for UF23Field::EvaluateParameterSets()
+  */
+  const double* GetParameters() const
+  { return fCache ? fMappedParameters : fParameters.data(); }
+  /// parameter vector of realization i (UF23Field::eNpar values)
+  const double* GetParameters(const std::size_t i) const
+  { return GetParameters() + i * UF23Field::eNpar; }
+
+  /**
+     @brief field of a realization
+     @param i index of realization
+     @param maxRadiusInKpc maximum radius of field in kpc
+  */
+  UF23Field GetRealization(const std::size_t i,
+                           const double maxRadiusInKpc = 30) const;
+
+  /// true if the bank is mapped from a cache file
+  bool IsMapped() const { return bool(fCache); }
+
+private:
+  void Draw(const unsigned int nThreads);
+
+  std::shared_ptr<const UF23FieldCache> fCache;
+  UF23Field::ModelType fModelType;
+  std::vector<double> fNominalParameters;
+  unsigned int fSeed = 0;
+  std::size_t fNRealizations = 0;
+  std::vector<double> fParameters;
+  const double* fMappedParameters = nullptr;
+};
+#endif
@@ -0,0 +1,48 @@
+#ifndef _UF23TableDeviation_h_
+#define _UF23TableDeviation_h_
+/**
+ @file UF23TableDeviation.h
+ @brief deviation of a tabulated field from the analytic model
+
+ utl::GetMaximumDeviation() is shared by UF23FieldGrid and
+ UF23FieldOctree (and works for any Table with a Vector3
+ operator()(const Vector3&) in kpc and microgauss).
+ */
+
+#include <algorithm>
+#include <vector>
+#include "UF23Field.h"
+#include "Vector3.h"
+
+namespace utl {
+
+  /**
+     @brief maximum deviation of a table from the analytic field model
+     @param table tabulated field
+     @param field UF23 field used to build the table
+     @param positionsInKpc positions to test (kpc)
+     @param maxRelDeviation output: maximum of |B_table - B| / |B|
+            for positions with |B| > 0
+     @return maximum of |B_table - B| in microgauss
+  */
+  template<class Table>
+  double
+  GetMaximumDeviation(const Table& table, const UF23Field& field,
+                      const std::vector<Vector3>& positionsInKpc,
+                      double& maxRelDeviation)
+  {
+    double maxDeviation = 0;
+    maxRelDeviation = 0;
+    for (const auto& pos : positionsInKpc) {
+      const Vector3 b = field(pos);
+      const double deviation = (table(pos) - b).Length();
+      maxDeviation = std::max(maxDeviation, deviation);
+      const double bLength = b.Length();
+      if (bLength > 0)
+        maxRelDeviation = std::max(maxRelDeviation, deviation / bLength);
+    }
+    return maxDeviation;
+  }
+
+}
+#endif
@@ -0,0 +1,343 @@
+#include "UF23Tracker.h"
+#include "UF23Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+  // particles per parallel task
+  const std::size_t kChunkSize = 4096;
+  // steps below this fraction of the maximum step are always accepted
+  const double kMinStepFraction = 1e-6;
+
+  // Cash-Karp Runge-Kutta coefficients (Numerical Recipes, 16.2)
+  const double kA[6][5] = {
+    { 0, 0, 0, 0, 0 },
+    { 1./5, 0, 0, 0, 0 },
+    { 3./40, 9./40, 0, 0, 0 },
+    { 3./10, -9./10, 6./5, 0, 0 },
+    { -11./54, 5./2, -70./27, 35./27, 0 },
+    { 1631./55296, 175./512, 575./13824, 44275./110592, 253./4096 }
+  };
+  // fifth order weights
+  const double kC5[6] = {
+    37./378, 0, 250./621, 125./594, 0, 512./1771
+  };
+  // fifth minus fourth order weights
+  const double kDC[6] = {
+    37./378 - 2825./27648, 0, 250./621 - 18575./48384,
+    125./594 - 13525./55296, -277./14336, 512./1771 - 1./4
+  };
+
+  // number of variables of the equations of motion (x, y, z, ux, uy, uz)
+  const unsigned int kNVar = 6;
+}
+
+// state of the active particles of a chunk and stage buffers
+struct UF23Tracker::Work {
+  // state, compacted to the first n entries
+  std::vector<double> fY[kNVar];
+  // 1/(c0 R) in 1/(kpc muG)
+  std::vector<double> fK;
+  std::vector<double> fStep;
+  std::vector<double> fLength;
+  std::vector<std::size_t> fIndex;
+  // stage positions and field
+  std::vector<double> fX, fYs, fZ, fBx, fBy, fBz;
+  // derivatives of each Runge-Kutta stage, dY[stage][variable]
+  std::vector<double> fDY[6][kNVar];
+
+  void Resize(const std::size_t n, const EMethod method)
+  {
+    for (auto& v : fY)
+      v.resize(n);
+    for (auto v : { &fK, &fStep, &fLength, &fX, &fYs, &fZ,
+                    &fBx, &fBy, &fBz })
+      v->resize(n);
+    fIndex.resize(n);
+    if (method == eCashKarp)
+      for (auto& stage : fDY)
+        for (auto& v : stage)
+          v.resize(n);
+  }
+
+  // move the state of particle j to slot i
+  void Move(const std::size_t j, const std::size_t i)
+  {
+    for (auto& v : fY)
+      v[i] = v[j];
+    fK[i] = fK[j];
+    fStep[i] = fStep[j];
+    fLength[i] = fLength[j];
+    fIndex[i] = fIndex[j];
+  }
+};
+
+void
+UF23Tracker::Particles::Add(const Vector3& posInKpc,
+                            const Vector3& direction,
+                            const double rigidityInEV)
+{
+  fX.push_back(posInKpc.x);
+  fY.push_back(posInKpc.y);
+  fZ.push_back(posInKpc.z);
+  fUx.push_back(direction.x);
+  fUy.push_back(direction.y);
+  fUz.push_back(direction.z);
+  fRigidity.push_back(rigidityInEV);
+  fLength.push_back(0);
+  fStatus.push_back(eActive);
+}
+
+UF23Tracker::UF23Tracker(const UF23Field& field,
+                         const EMethod method,
+                         const double stepInKpc,
+                         const double tolerance,
+                         const double maxLengthInKpc) :
+  fField(field),
+  fMethod(method),
+  fStep(stepInKpc),
+  fTolerance(tolerance),
+  fMaxLength(maxLengthInKpc)
+{
+  if (!(fStep > 0))
+    throw std::runtime_error("UF23Tracker: invalid step size "
+                             + std::to_string(fStep));
+  if (!(fTolerance > 0))
+    throw std::runtime_error("UF23Tracker: invalid tolerance "
+                             + std::to_string(fTolerance));
+  if (!(fMaxLength > 0))
+    throw std::runtime_error("UF23Tracker: invalid maximum length "
+                             + std::to_string(fMaxLength));
+}
+
+double
+UF23Tracker::GetLarmorRadiusConstant()
+{
+  // r_L = E/(Z e c B) for E = 1 EeV and B = 1 muG = 1e-10 T
+  const double speedOfLight = 299792458;  // m/s
+  const double meterPerKpc = 3.0856775814913673e19;
+  return 1e18 / (speedOfLight * 1e-10) / meterPerKpc * utl::kpc;
+}
+
+void
+UF23Tracker::Propagate(Particles& p)
+  const
+{
+  const std::size_t n = p.Size();
+  for (const std::size_t size :
+         { p.fY.size(), p.fZ.size(), p.fUx.size(), p.fUy.size(),
+           p.fUz.size(), p.fRigidity.size(), p.fLength.size(),
+           p.fStatus.size() })
+    if (size != n)
+      throw std::runtime_error("UF23Tracker: inconsistent particle arrays");
+  for (std::size_t i = 0; i < n; ++i) {
+    if (p.fStatus[i] != eActive)
+      continue;
+    if (!(std::isfinite(p.fRigidity[i]) && p.fRigidity[i] != 0))
+      throw std::runtime_error("UF23Tracker: invalid rigidity "
+                               + std::to_string(p.fRigidity[i]));
+    if (!(p.GetDirection(i).Length() > 0))
+      throw std::runtime_error("UF23Tracker: invalid direction");
+  }
+  if (n == 0)
+    return;
+
+  const std::size_t nTasks = (n + kChunkSize - 1) / kChunkSize;
+  const unsigned int nThreads = fParallelOptions.GetNumberOfThreads(nTasks);
+  std::vector<Work> work(nThreads);
+  for (auto& w : work)
+    w.Resize(std::min(n, kChunkSize), fMethod);
+
+  utl::ParallelFor(nTasks, fParallelOptions,
+    [&](const std::size_t iTask, const unsigned int iThread)
+    {
+      const std::size_t first = iTask * kChunkSize;
+      const std::size_t last = std::min(first + kChunkSize, n);
+      PropagateChunk(p, first, last, work[iThread]);
+    });
+}
+
+template<>
+void
+UF23Tracker::Step<UF23Tracker::eBoris>(Work& w, const std::size_t n)
+  const
+{
+  double* const x[3] = { w.fY[0].data(), w.fY[1].data(), w.fY[2].data() };
+  double* const u[3] = { w.fY[3].data(), w.fY[4].data(), w.fY[5].data() };
+  double* const xm[3] = { w.fX.data(), w.fYs.data(), w.fZ.data() };
+
+  // drift half a step, rotate, drift half a step
+  for (std::size_t i = 0; i < n; ++i) {
+    const double h2 = 0.5 * w.fStep[i];
+    for (unsigned int c = 0; c < 3; ++c)
+      xm[c][i] = x[c][i] + h2 * u[c][i];
+  }
+  fField.Evaluate(xm[0], xm[1], xm[2],
+                  w.fBx.data(), w.fBy.data(), w.fBz.data(), n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const double h = w.fStep[i];
+    const double f = 0.5 * h * w.fK[i];
+    const Vector3 t(f * w.fBx[i], f * w.fBy[i], f * w.fBz[i]);
+    const Vector3 u0(u[0][i], u[1][i], u[2][i]);
+    const Vector3 u1 = u0 + crossprod(u0, t);
+    const Vector3 u2 = u0 + crossprod(u1, t) * (2 / (1 + t.SquaredLength()));
+    u[0][i] = u2.x;
+    u[1][i] = u2.y;
+    u[2][i] = u2.z;
+    for (unsigned int c = 0; c < 3; ++c)
+      x[c][i] = xm[c][i] + 0.5 * h * u[c][i];
+    w.fLength[i] += h;
+  }
+}
+
+template<>
+void
+UF23Tracker::Step<UF23Tracker::eCashKarp>(Work& w, const std::size_t n)
+  const
+{
+  double* const xs[3] = { w.fX.data(), w.fYs.data(), w.fZ.data() };
+  double* const bs[3] = { w.fBx.data(), w.fBy.data(), w.fBz.data() };
+
+  for (unsigned int stage = 0; stage < 6; ++stage) {
+    // stage state y + h sum_l a_stage,l dY_l, the direction is stored as
+    // dx/ds in dY[stage]
+    for (unsigned int v = 0; v < kNVar; ++v) {
+      const double* const y = w.fY[v].data();
+      double* const ys = v < 3 ? xs[v] : w.fDY[stage][v - 3].data();
+      for (std::size_t i = 0; i < n; ++i) {
+        double sum = 0;
+        for (unsigned int l = 0; l < stage; ++l)
+          sum += kA[stage][l] * w.fDY[l][v][i];
+        ys[i] = y[i] + w.fStep[i] * sum;
+      }
+    }
+    fField.Evaluate(xs[0], xs[1], xs[2], bs[0], bs[1], bs[2], n);
+    // dx/ds = u, du/ds = k u x B
+    std::vector<double>* const d = w.fDY[stage];
+    for (std::size_t i = 0; i < n; ++i) {
+      const double ux = d[0][i];
+      const double uy = d[1][i];
+      const double uz = d[2][i];
+      const double k = w.fK[i];
+      d[3][i] = k * (uy * bs[2][i] - uz * bs[1][i]);
+      d[4][i] = k * (uz * bs[0][i] - ux * bs[2][i]);
+      d[5][i] = k * (ux * bs[1][i] - uy * bs[0][i]);
+    }
+  }
+
+  // fifth order solution and error estimate
+  const double minStep = kMinStepFraction * fStep;
+  for (std::size_t i = 0; i < n; ++i) {
+    const double h = w.fStep[i];
+    double y5[kNVar];
+    double err2Pos = 0;
+    double err2Dir = 0;
+    for (unsigned int v = 0; v < kNVar; ++v) {
+      double sum = 0;
+      double delta = 0;
+      for (unsigned int l = 0; l < 6; ++l) {
+        sum += kC5[l] * w.fDY[l][v][i];
+        delta += kDC[l] * w.fDY[l][v][i];
+      }
+      y5[v] = w.fY[v][i] + h * sum;
+      (v < 3 ? err2Pos : err2Dir) += delta * delta;
+    }
+    // |dx|/h and |du|, in units of the tolerance
+    const double err =
+      sqrt(std::max(err2Pos, err2Dir * h * h)) / fTolerance;
+    if (err <= 1 || h <= minStep) {
+      const double uNorm =
+        1 / sqrt(y5[3] * y5[3] + y5[4] * y5[4] + y5[5] * y5[5]);
+      for (unsigned int v = 0; v < 3; ++v) {
+        w.fY[v][i] = y5[v];
+        w.fY[v + 3][i] = y5[v + 3] * uNorm;
+      }
+      w.fLength[i] += h;
+      const double grow = err > 0 ? 0.9 * pow(err, -0.2) : 5;
+      w.fStep[i] = std::min(fStep, h * std::min(5., std::max(grow, 0.2)));
+    }
+    else {
+      // retry with smaller step
+      const double shrink = 0.9 * pow(err, -0.25);
+      w.fStep[i] = std::max(minStep, h * std::max(shrink, 0.1));
+    }
+  }
+}
+
+void
+UF23Tracker::PropagateChunk(Particles& p,
+                            const std::size_t first,
+                            const std::size_t last,
+                            Work& w)
+  const
+{
+  const double maxR2 = fField.GetMaximumSquaredRadius();
+  const double c0 = GetLarmorRadiusConstant();
+
+  // load active particles
+  std::size_t n = 0;
+  for (std::size_t i = first; i < last; ++i) {
+    if (p.fStatus[i] != eActive)
+      continue;
+    if (p.GetPosition(i).SquaredLength() > maxR2) {
+      p.fStatus[i] = eEscaped;
+      continue;
+    }
+    if (p.fLength[i] >= fMaxLength) {
+      p.fStatus[i] = eMaxLength;
+      continue;
+    }
+    const Vector3 u = p.GetDirection(i) / p.GetDirection(i).Length();
+    w.fY[0][n] = p.fX[i];
+    w.fY[1][n] = p.fY[i];
+    w.fY[2][n] = p.fZ[i];
+    w.fY[3][n] = u.x;
+    w.fY[4][n] = u.y;
+    w.fY[5][n] = u.z;
+    w.fK[n] = 1 / (c0 * p.fRigidity[i]);
+    w.fStep[n] = std::min(fStep, fMaxLength - p.fLength[i]);
+    w.fLength[n] = p.fLength[i];
+    w.fIndex[n] = i;
+    ++n;
+  }
+
+  while (n > 0) {
+    if (fMethod == eCashKarp)
+      Step<eCashKarp>(w, n);
+    else
+      Step<eBoris>(w, n);
+
+    // store and remove particles that left the field or reached the
+    // maximum length
+    for (std::size_t i = 0; i < n; ) {
+      const double r2 =
+        w.fY[0][i] * w.fY[0][i] + w.fY[1][i] * w.fY[1][i] +
+        w.fY[2][i] * w.fY[2][i];
+      const EStatus status =
+        r2 > maxR2 ? eEscaped :
+        (w.fLength[i] >= fMaxLength ? eMaxLength : eActive);
+      if (status == eActive) {
+        // do not step beyond the maximum length
+        w.fStep[i] = std::min(w.fStep[i], fMaxLength - w.fLength[i]);
+        ++i;
+        continue;
+      }
+      const std::size_t index = w.fIndex[i];
+      p.fX[index] = w.fY[0][i];
+      p.fY[index] = w.fY[1][i];
+      p.fZ[index] = w.fY[2][i];
+      p.fUx[index] = w.fY[3][i];
+      p.fUy[index] = w.fY[4][i];
+      p.fUz[index] = w.fY[5][i];
+      p.fLength[index] = w.fLength[i];
+      p.fStatus[index] = status;
+      --n;
+      if (i < n)
+        w.Move(n, i);
+    }
+  }
+}
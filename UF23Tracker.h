@@ -0,0 +1,126 @@
+#ifndef _UF23Tracker_h_
+#define _UF23Tracker_h_
+/**
+ @class UF23Tracker
+ @brief propagation of charged particles through the UF23 field
+
+ Integrates the trajectories of ultra-relativistic charged particles,
+
+   dx/ds = u,   du/ds = u x B / (c0 R),   c0 = 1.0810 kpc EV/muG,
+
+ where s is the path length, u the direction of motion and R = E/(Z e)
+ the rigidity, i.e. c0 R / B is the Larmor radius. To backtrack an
+ observed cosmic ray, start at the observer with the direction
+ pointing to the arrival direction on the sky and the negative
+ rigidity (anti-particle).
+
+ Particles are stored as a structure of arrays and propagated in
+ chunks, each chunk in parallel with the other chunks. Within a chunk
+ all active particles take one step at a time, evaluating the field
+ with the batch interface of UF23Field. Particles that leave the
+ sphere of radius sqrt(GetMaximumSquaredRadius()) or reach the maximum
+ path length are compacted out of the active set.
+
+ Two integrators are available:
+   eCashKarp: embedded Runge-Kutta 4(5) with adaptive step size per
+              particle (6 field evaluations per step)
+   eBoris:    Boris push with fixed step size (1 field evaluation per
+              step, |u| is conserved exactly)
+
+ */
+
+#include <cstddef>
+#include <vector>
+#include "UF23Field.h"
+#include "UF23Parallel.h"
+#include "Vector3.h"
+
+class UF23Tracker {
+public:
+  /// integration method
+  enum EMethod {
+    eCashKarp,
+    eBoris
+  };
+
+  /// state of a particle
+  enum EStatus {
+    eActive,     ///< not propagated yet
+    eEscaped,    ///< left the field sphere
+    eMaxLength   ///< stopped at maximum path length
+  };
+
+  /// particles in a structure of arrays
+  struct Particles {
+    /// position in kpc
+    std::vector<double> fX, fY, fZ;
+    /// direction of motion (normalized)
+    std::vector<double> fUx, fUy, fUz;
+    /// rigidity E/(Z e) in EV
+    std::vector<double> fRigidity;
+    /// path length in kpc
+    std::vector<double> fLength;
+    std::vector<EStatus> fStatus;
+
+    void Add(const Vector3& posInKpc, const Vector3& direction,
+             const double rigidityInEV);
+    std::size_t Size() const { return fX.size(); }
+    Vector3 GetPosition(const std::size_t i) const
+    { return Vector3(fX[i], fY[i], fZ[i]); }
+    Vector3 GetDirection(const std::size_t i) const
+    { return Vector3(fUx[i], fUy[i], fUz[i]); }
+  };
+
+public:
+  /**
+     @brief constructor
+     @param field UF23 field (copied)
+     @param method integration method
+     @param stepInKpc maximum (eCashKarp) or fixed (eBoris) step size in kpc
+     @param tolerance tolerated error per step of eCashKarp in the
+            direction and relative to the step size in the position
+     @param maxLengthInKpc maximum path length in kpc
+  */
+  UF23Tracker(const UF23Field& field,
+              const EMethod method = eCashKarp,
+              const double stepInKpc = 0.1,
+              const double tolerance = 1e-8,
+              const double maxLengthInKpc = 1000);
+  /// no default constructor
+  UF23Tracker() = delete;
+
+  /// set number of threads (0: all hardware threads)
+  void SetNumberOfThreads(const unsigned int n)
+  { fParallelOptions.fNThreads = n; }
+  /// set number of threads and their pinning to CPUs
+  void SetParallelOptions(const utl::ParallelOptions& options)
+  { fParallelOptions = options; }
+  const utl::ParallelOptions& GetParallelOptions() const
+  { return fParallelOptions; }
+
+  /**
+     @brief propagate active particles until they leave the field
+     @param particles input: initial state, output: final state
+
+     Particles with status != eActive are not propagated.
+  */
+  void Propagate(Particles& particles) const;
+
+  /// Larmor radius c0 R / B in kpc for rigidity R = 1 EV and B = 1 muG
+  static double GetLarmorRadiusConstant();
+
+private:
+  struct Work;
+  void PropagateChunk(Particles& particles, const std::size_t first,
+                      const std::size_t last, Work& work) const;
+  template<EMethod method>
+  void Step(Work& work, const std::size_t n) const;
+
+  UF23Field fField;
+  EMethod fMethod;
+  double fStep;
+  double fTolerance;
+  double fMaxLength;
+  utl::ParallelOptions fParallelOptions;
+};
+#endif
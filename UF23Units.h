@@ -0,0 +1,20 @@
+#ifndef _UF23Units_h_
+#define _UF23Units_h_
+/**
+ @file UF23Units.h
+ @brief constants and internal units used in the UF23 field implementation
+ */
+
+namespace utl {
+  const double kPi = 3.1415926535897932384626;
+  const double kTwoPi = 2*kPi;
+  const double degree = kPi/180.;
+  const double kpc = 1;
+  const double microgauss = 1;
+  const double megayear = 1;
+  const double Gpc = 1e6*kpc;
+  const double pc = 1e-3*kpc;
+  const double second  = megayear / (1e6*60*60*24*365.25);
+  const double kilometer = kpc / 3.0856775807e+16;
+}
+#endif
@@ -139,6 +139,7 @@ template<typename T> inline std::ostream &operator<<
   }
 
 typedef vec3_t<double> Vector3;
+typedef vec3_t<float> Vector3f;
 
 /*! \} */
 
@@ -16,7 +16,7 @@
  note: this is just a test program. If many evaluations are needed
  it is very inefficient to call this program repeatedly due to
  the overhead of initialization. For that case it is better
- to implement a loop over positions.
+ to implement a loop over positions or to use streamUF23Field.
 
  Please send bugs and suggestions to michael.unger@kit.edu and gf25@nyu.edu
 
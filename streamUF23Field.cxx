@@ -0,0 +1,537 @@
+/** @file streamUF23Field.cxx
+
+ @brief  program to calculate the coherent Galactic magnetic field for a
+         stream of positions
+ @return an integer 0 upon success
+
+ command line parameters are
+
+    [options] <model name(s)>   or   [options] --model=<model name(s)>
+
+ where the model is one of either base, cre10, expX, neCL, nebCor,
+ spur, synCG or twistX (see arXiv:2311.12120 for details), a
+ comma-separated list of models, or "all" for all eight models.
+
+ The positions (galactocentric coordinates x/y/z in kpc, Earth at
+ negative x, North at positive z) are read from stdin or a file in
+ batches, evaluated in parallel and the three components of the
+ coherent field in microgauss of each model are written to stdout or
+ a file. Several models are evaluated in one pass with UF23FieldSet.
+
+ options:
+
+   --input=<file>          input file (default: stdin)
+   --input-format=<f>      text (one position per line, separated by
+                           spaces or commas, lines starting with # and a
+                           header line are skipped), binary (x, y, z as
+                           native doubles) or npy (float64 or float32
+                           array of shape (n, 3)), default: from the
+                           file name extension (.npy, .bin) or text
+   --output=<file>         output file (default: stdout)
+   --output-format=<f>     text (columns separated by spaces), csv (with
+                           header line), binary (native doubles) or npy
+                           (float64 array of shape (n, 3) or (n, m, 3)
+                           for m models, only for files), default: from
+                           the file name extension (.npy, .bin, .csv) or
+                           text
+   --positions             also write the positions (text and csv)
+   --precision=<p>         significant digits of text output (default 10)
+   --threads=<n>           number of threads (default: all)
+   --pinning=<p>           pin threads to CPUs: none (default), compact
+                           (one NUMA node after the other) or scatter
+                           (round-robin over the NUMA nodes)
+   --batch=<n>             positions per batch (default 65536)
+   --fast-math             use fast approximate math (see UF23Field)
+
+ example:
+
+   awk '{print $2, $3, $4}' positions.txt | ./streamUF23Field all > b.txt
+
+ Please send bugs and suggestions to michael.unger@kit.edu and gf25@nyu.edu
+
+ If you use this code, please cite arXiv:2311.12120
+
+*/
+
+#include "UF23Field.h"
+#include "UF23FieldSet.h"
+#include "UF23Parallel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using ModelType = UF23Field::ModelType;
+
+namespace {
+
+  // positions per parallel task
+  const size_t kTaskSize = 4096;
+  // size of the npy header of the output, allows to rewrite the shape
+  const size_t kNpyHeaderSize = 128;
+  const char kNpyMagic[] = "\x93NUMPY";
+
+  enum EFormat {
+    eText,
+    eCSV,
+    eBinary,
+    eNpy
+  };
+
+  struct Options {
+    string fInput;
+    string fOutput;
+    string fInputFormat;
+    string fOutputFormat;
+    bool fPositions = false;
+    int fPrecision = 10;
+    utl::ParallelOptions fParallel;
+    size_t fBatch = 65536;
+    bool fFastMath = false;
+    vector<ModelType> fModels;
+  };
+
+  bool
+  EndsWith(const string& s, const string& suffix)
+  {
+    return s.size() >= suffix.size() &&
+      s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  EFormat
+  GetFormat(const string& format, const string& filename, const bool isInput)
+  {
+    const string f =
+      !format.empty() ? format :
+      EndsWith(filename, ".npy") ? "npy" :
+      EndsWith(filename, ".bin") ? "binary" :
+      EndsWith(filename, ".csv") ? "csv" : "text";
+    if (f == "text" || (isInput && f == "csv"))
+      return eText;
+    if (f == "csv")
+      return eCSV;
+    if (f == "binary")
+      return eBinary;
+    if (f == "npy")
+      return eNpy;
+    throw runtime_error("unknown format " + f);
+  }
+
+  /// reads positions from a text, binary or npy stream
+  class PositionReader {
+  public:
+    PositionReader(FILE* const file, const EFormat format) :
+      fFile(file), fFormat(format)
+    {
+      if (fFormat == eNpy)
+        ReadNpyHeader();
+    }
+
+    /// number of positions if known from the header, otherwise 0
+    size_t GetSize() const { return fSize; }
+
+    /// read at most nMax positions, returns number of positions read
+    size_t
+    Read(vector<double>& xyz, const size_t nMax)
+    {
+      xyz.resize(3 * nMax);
+      if (fFormat == eText)
+        return ReadText(xyz, nMax);
+      if (fFormat == eNpy && fIsFloat) {
+        vector<float> buffer(3 * nMax);
+        const size_t n = ReadBinary(buffer.data(), sizeof(float), nMax);
+        copy(buffer.begin(), buffer.begin() + 3 * n, xyz.begin());
+        return n;
+      }
+      return ReadBinary(xyz.data(), sizeof(double), nMax);
+    }
+
+  private:
+    size_t
+    ReadBinary(void* const data, const size_t size, const size_t nMax)
+    {
+      const size_t nValues = fread(data, size, 3 * nMax, fFile);
+      if (nValues % 3)
+        throw runtime_error("incomplete position at end of input");
+      return nValues / 3;
+    }
+
+    size_t
+    ReadText(vector<double>& xyz, const size_t nMax)
+    {
+      size_t n = 0;
+      char line[4096];
+      while (n < nMax && fgets(line, sizeof(line), fFile)) {
+        ++fLine;
+        const char* p = line;
+        while (*p == ' ' || *p == '\t')
+          ++p;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+          continue;
+        double v[3];
+        unsigned int i = 0;
+        for (; i < 3; ++i) {
+          while (*p == ' ' || *p == '\t' || *p == ',')
+            ++p;
+          char* end;
+          v[i] = strtod(p, &end);
+          if (end == p)
+            break;
+          p = end;
+        }
+        if (i < 3) {
+          // header line of csv files
+          if (fLine == 1)
+            continue;
+          throw runtime_error("invalid position in line " +
+                              to_string(fLine));
+        }
+        copy(v, v + 3, &xyz[3 * n]);
+        ++n;
+      }
+      return n;
+    }
+
+    void
+    ReadNpyHeader()
+    {
+      char magic[8];
+      if (fread(magic, 1, 8, fFile) != 8 || memcmp(magic, kNpyMagic, 6))
+        throw runtime_error("invalid npy file");
+      size_t headerLength = 0;
+      unsigned char length[4] = { 0, 0, 0, 0 };
+      const unsigned int nLength = magic[6] == 1 ? 2 : 4;
+      if (fread(length, 1, nLength, fFile) != nLength)
+        throw runtime_error("invalid npy file");
+      for (unsigned int i = 0; i < nLength; ++i)
+        headerLength += size_t(length[i]) << (8 * i);
+      string header(headerLength, ' ');
+      if (fread(&header[0], 1, headerLength, fFile) != headerLength)
+        throw runtime_error("invalid npy file");
+
+      if (header.find("'<f8'") != string::npos)
+        fIsFloat = false;
+      else if (header.find("'<f4'") != string::npos)
+        fIsFloat = true;
+      else
+        throw runtime_error("npy input must be float64 or float32");
+      if (header.find("'fortran_order': False") == string::npos)
+        throw runtime_error("npy input must be in C order");
+      const size_t shape = header.find("'shape': (");
+      if (shape == string::npos)
+        throw runtime_error("invalid npy header");
+      char* end;
+      fSize = strtoul(header.c_str() + shape + 10, &end, 10);
+      while (*end == ',' || *end == ' ')
+        ++end;
+      if (strtoul(end, nullptr, 10) != 3)
+        throw runtime_error("npy input must have shape (n, 3)");
+    }
+
+    FILE* fFile;
+    EFormat fFormat;
+    bool fIsFloat = false;
+    size_t fSize = 0;
+    size_t fLine = 0;
+  };
+
+  /// writes fields (and positions) to a text, csv, binary or npy stream
+  class FieldWriter {
+  public:
+    FieldWriter(FILE* const file, const EFormat format,
+                const vector<string>& models, const bool positions,
+                const int precision, const size_t size) :
+      fFile(file), fFormat(format), fNModels(models.size()),
+      fPositions(positions), fPrecision(precision)
+    {
+      if (fFormat == eNpy)
+        WriteNpyHeader(size);
+      else if (fFormat == eText || fFormat == eCSV) {
+        const char* const sep = fFormat == eCSV ? "," : " ";
+        string header = fFormat == eCSV ? "" : "# ";
+        if (fPositions)
+          header += string("x") + sep + "y" + sep + "z" + sep;
+        for (const auto& m : models)
+          for (const char* c : { "bx", "by", "bz" })
+            header += fNModels > 1 ? m + "_" + c + sep : string(c) + sep;
+        header.back() = '\n';
+        Write(header.data(), header.size());
+      }
+    }
+
+    /// positions xyz[3*i+j], fields b[(i*nModels + m)*3 + j]
+    void
+    Write(const double* const xyz, const double* const b, const size_t n)
+    {
+      fCount += n;
+      if (fFormat == eBinary || fFormat == eNpy) {
+        Write(b, 3 * fNModels * n * sizeof(double));
+        return;
+      }
+      const char sep = fFormat == eCSV ? ',' : ' ';
+      string out;
+      out.reserve(n * (fNModels + 1) * 3 * (fPrecision + 8));
+      char number[64];
+      for (size_t i = 0; i < n; ++i) {
+        if (fPositions)
+          for (unsigned int j = 0; j < 3; ++j) {
+            snprintf(number, sizeof(number), "%.*g", fPrecision, xyz[3*i + j]);
+            out += number;
+            out += sep;
+          }
+        for (unsigned int j = 0; j < 3 * fNModels; ++j) {
+          snprintf(number, sizeof(number), "%.*e", fPrecision - 1,
+                   b[3 * fNModels * i + j]);
+          out += number;
+          out += j + 1 < 3 * fNModels ? sep : '\n';
+        }
+      }
+      Write(out.data(), out.size());
+    }
+
+    /// rewrite the npy header with the number of positions written
+    void
+    Close()
+    {
+      if (fFormat == eNpy && fCount != fHeaderSize) {
+        if (fseek(fFile, 0, SEEK_SET))
+          throw runtime_error("cannot rewrite npy header");
+        WriteNpyHeader(fCount);
+      }
+      if (fflush(fFile))
+        throw runtime_error(string("write error: ") + strerror(errno));
+    }
+
+  private:
+    void
+    Write(const void* const data, const size_t size)
+    {
+      if (fwrite(data, 1, size, fFile) != size)
+        throw runtime_error(string("write error: ") + strerror(errno));
+    }
+
+    void
+    WriteNpyHeader(const size_t n)
+    {
+      fHeaderSize = n;
+      string dict = "{'descr': '<f8', 'fortran_order': False, 'shape': (" +
+        to_string(n) + ", " +
+        (fNModels > 1 ? to_string(fNModels) + ", " : "") + "3), }";
+      // magic, version, header length, padded dictionary and newline
+      const size_t prefix = 10;
+      dict.resize(kNpyHeaderSize - prefix - 1, ' ');
+      dict += '\n';
+      const unsigned char version[4] = { 1, 0, kNpyHeaderSize - prefix, 0 };
+      Write(kNpyMagic, 6);
+      Write(version, 4);
+      Write(dict.data(), dict.size());
+    }
+
+    FILE* fFile;
+    EFormat fFormat;
+    unsigned int fNModels;
+    bool fPositions;
+    int fPrecision;
+    size_t fCount = 0;
+    size_t fHeaderSize = 0;
+  };
+
+  void
+  Usage(const string& progName)
+  {
+    cerr << " usage: " << progName << " [options] <model name(s)>\n"
+         << "         model: name, comma-separated names or all"
+         << " (or --model=<...>)\n"
+         << "         options: --input=<file> --input-format=<text|binary|npy>\n"
+         << "                  --output=<file>"
+         << " --output-format=<text|csv|binary|npy>\n"
+         << "                  --positions --precision=<p> --threads=<n>\n"
+         << "                  --pinning=<none|compact|scatter>"
+         << " --batch=<n> --fast-math\n"
+         << "         positions x/y/z in galactocentric coordinates (kpc)\n"
+         << "         available models: ";
+    for (const auto& m : UF23Field::GetModelNames())
+      cerr << m.second << " ";
+    cerr << endl;
+  }
+
+  int
+  ReadCommandLine(const int argc, const char** argv, Options& options)
+  {
+    map<string, ModelType> uf23Models;
+    for (const auto& mn : UF23Field::GetModelNames())
+      uf23Models[mn.second] = mn.first;
+
+    string models;
+    try {
+      for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const string key = arg.substr(0, eq);
+        const string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--input")
+          options.fInput = value;
+        else if (key == "--output")
+          options.fOutput = value;
+        else if (key == "--input-format")
+          options.fInputFormat = value;
+        else if (key == "--output-format")
+          options.fOutputFormat = value;
+        else if (key == "--model")
+          models = value;
+        else if (key == "--positions")
+          options.fPositions = true;
+        else if (key == "--precision")
+          options.fPrecision = max(1, min(17, stoi(value)));
+        else if (key == "--threads")
+          options.fParallel.fNThreads = stoul(value);
+        else if (key == "--pinning") {
+          if (value == "none")
+            options.fParallel.fPinning = utl::ParallelOptions::eNoPinning;
+          else if (value == "compact")
+            options.fParallel.fPinning = utl::ParallelOptions::eCompact;
+          else if (value == "scatter")
+            options.fParallel.fPinning = utl::ParallelOptions::eScatter;
+          else
+            throw runtime_error("unknown pinning " + value);
+        }
+        else if (key == "--batch")
+          options.fBatch = max(1ul, stoul(value));
+        else if (key == "--fast-math")
+          options.fFastMath = true;
+        else if (arg.size() > 1 && arg[0] == '-')
+          throw runtime_error("unknown option " + arg);
+        else if (models.empty())
+          models = arg;
+        else
+          throw runtime_error("more than one model argument");
+      }
+    }
+    catch (const exception& e) {
+      cerr << " error: " << e.what() << endl;
+      Usage(argv[0]);
+      return 1;
+    }
+
+    if (models == "all") {
+      for (const auto& m : UF23Field::GetModelNames())
+        options.fModels.push_back(m.first);
+    }
+    else {
+      size_t start = 0;
+      while (start <= models.size() && !models.empty()) {
+        const size_t end = min(models.find(',', start), models.size());
+        const string name = models.substr(start, end - start);
+        if (!uf23Models.count(name)) {
+          Usage(argv[0]);
+          return 2;
+        }
+        options.fModels.push_back(uf23Models.at(name));
+        start = end + 1;
+      }
+    }
+    if (options.fModels.empty()) {
+      Usage(argv[0]);
+      return 2;
+    }
+    return 0;
+  }
+}
+
+int
+main(const int argc, const char** argv)
+{
+  Options options;
+  if (const int iError = ReadCommandLine(argc, argv, options))
+    return iError;
+
+  try {
+    const EFormat inputFormat =
+      GetFormat(options.fInputFormat, options.fInput, true);
+    const EFormat outputFormat =
+      GetFormat(options.fOutputFormat, options.fOutput, false);
+    if (outputFormat == eNpy && options.fOutput.empty())
+      throw runtime_error("npy output requires --output=<file>");
+
+    FILE* const in = options.fInput.empty() ? stdin :
+      fopen(options.fInput.c_str(), inputFormat == eText ? "r" : "rb");
+    if (!in)
+      throw runtime_error("cannot open " + options.fInput);
+    FILE* const out = options.fOutput.empty() ? stdout :
+      fopen(options.fOutput.c_str(), outputFormat == eText ||
+            outputFormat == eCSV ? "w" : "wb");
+    if (!out)
+      throw runtime_error("cannot open " + options.fOutput);
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    UF23FieldSet fields(options.fModels);
+    fields.SetFastMath(options.fFastMath);
+    vector<string> modelNames;
+    for (const auto m : options.fModels)
+      modelNames.push_back(UF23Field::GetModelName(m));
+    const unsigned int nModels = modelNames.size();
+
+    PositionReader reader(in, inputFormat);
+    FieldWriter writer(out, outputFormat, modelNames, options.fPositions,
+                       options.fPrecision, reader.GetSize());
+
+    // per batch: positions, output [i][m] and per-task buffers of the
+    // components of positions [i] and fields [m][i]
+    vector<double> xyz;
+    vector<double> b(3 * nModels * options.fBatch);
+    const size_t nTaskMax = (options.fBatch + kTaskSize - 1) / kTaskSize;
+    vector<vector<double>> taskBuffers(nTaskMax);
+    while (const size_t n = reader.Read(xyz, options.fBatch)) {
+      const size_t nTasks = (n + kTaskSize - 1) / kTaskSize;
+      utl::ParallelFor(nTasks, options.fParallel,
+        [&](const size_t iTask, const unsigned int /*iThread*/)
+        {
+          const size_t first = iTask * kTaskSize;
+          const size_t nTask = min(kTaskSize, n - first);
+          vector<double>& buffer = taskBuffers[iTask];
+          buffer.resize(3 * (nModels + 1) * nTask);
+          double* const x = buffer.data();
+          double* const y = x + nTask;
+          double* const z = y + nTask;
+          double* const bx = z + nTask;
+          double* const by = bx + nModels * nTask;
+          double* const bz = by + nModels * nTask;
+          for (size_t i = 0; i < nTask; ++i) {
+            x[i] = xyz[3 * (first + i)];
+            y[i] = xyz[3 * (first + i) + 1];
+            z[i] = xyz[3 * (first + i) + 2];
+          }
+          fields.Evaluate(x, y, z, bx, by, bz, nTask);
+          for (unsigned int m = 0; m < nModels; ++m)
+            for (size_t i = 0; i < nTask; ++i) {
+              double* const bi = &b[3 * (nModels * (first + i) + m)];
+              bi[0] = bx[m * nTask + i];
+              bi[1] = by[m * nTask + i];
+              bi[2] = bz[m * nTask + i];
+            }
+        });
+      writer.Write(xyz.data(), b.data(), n);
+    }
+    if (ferror(in))
+      throw runtime_error("read error");
+    writer.Close();
+    if (in != stdin)
+      fclose(in);
+    if (out != stdout && fclose(out))
+      throw runtime_error("cannot close " + options.fOutput);
+  }
+  catch (const exception& e) {
+    cerr << " error: " << e.what() << endl;
+    return 3;
+  }
+  return 0;
+}